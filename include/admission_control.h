@@ -0,0 +1,139 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file admission_control.h
+/// Admission control for new sessions.
+/// ----------------------------------------------------------
+/// $Id: admission_control.h 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./include/admission_control.h $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#ifndef MNSLP__ADMISSION_CONTROL_H
+#define MNSLP__ADMISSION_CONTROL_H
+
+#include <pthread.h>
+#include <map>
+#include <ostream>
+
+#include "protlib_types.h"
+
+
+namespace mnslp {
+    using protlib::uint32;
+    using protlib::uint64;
+
+
+/**
+ * Decides whether a new session may be created.
+ *
+ * Only CONFIGUREs that would create a session are subject to admission
+ * control. Messages for existing sessions, in particular REFRESHes and
+ * teardowns, are always processed, so an overloaded node keeps its
+ * sessions alive while it turns new ones away.
+ *
+ * A new session is rejected if
+ *  - the number of live sessions reached max_sessions,
+ *  - the policy rule installations in progress plus the removals queued
+ *    for the teardown thread reached max_pending_installs,
+ *  - the input queue holds more than queue_watermark messages, or
+ *  - the neighbour it comes from used up its token bucket, which is
+ *    refilled with peer_rate tokens per second up to peer_burst.
+ *
+ * A limit of 0 disables the respective check. The counters for each
+ * verdict can be read at any time; they are 32 bit wide, so they can be
+ * updated and read atomically on every platform. Instances are shared by
+ * all dispatcher threads.
+ *
+ * The bucket of a neighbour that has been idle long enough to be full
+ * again is dropped, a new bucket starts full anyway.
+ */
+class admission_control {
+
+  public:
+	enum verdict_t {
+		ADMITTED			= 0,
+		REJECT_SESSIONS		= 1,	///< too many live sessions
+		REJECT_INSTALLS		= 2,	///< too many pending installations
+		REJECT_BACKLOG		= 3,	///< input queue above the watermark
+		REJECT_RATE			= 4,	///< neighbour exceeded its rate
+		NUM_VERDICTS		= 5
+	};
+
+	admission_control(uint32 max_sessions=0, uint32 max_pending_installs=0,
+		uint32 queue_watermark=0, uint32 peer_rate=0, uint32 peer_burst=0);
+	~admission_control();
+
+	verdict_t admit(uint32 peer, size_t sessions, size_t removals);
+	verdict_t admit(uint32 peer, size_t sessions, size_t removals,
+		uint64 now_ms);
+
+	/// Called by the daemon with the current depth of the input queue.
+	inline void set_backlog(size_t depth) { backlog = depth; }
+
+	inline void begin_install() { __sync_fetch_and_add(&installs, 1); }
+	inline void end_install() { __sync_fetch_and_sub(&installs, 1); }
+
+	uint32 get_count(verdict_t v) const;
+	uint32 get_rejected() const;
+
+	size_t get_bucket_count();
+
+	static const char *get_verdict_name(verdict_t v);
+
+  private:
+	uint32 max_sessions;
+	uint32 max_pending_installs;
+	uint32 queue_watermark;
+	uint32 peer_rate;
+	uint32 peer_burst;
+
+	volatile size_t backlog;
+	volatile size_t installs;
+
+	volatile uint32 counts[NUM_VERDICTS];
+
+	/// A token bucket, tokens are counted in thousandths.
+	struct bucket {
+		uint64 tokens;
+		uint64 last;	///< time of the last refill in milliseconds
+	};
+
+	pthread_mutex_t mutex;
+	std::map<uint32, bucket> buckets;	// by SII handle of the neighbour
+	uint64 last_prune;
+
+	static const uint64 PRUNE_INTERVAL_MS = 10000;
+
+	bool take_token(uint32 peer, uint64 now_ms);
+	void prune_buckets(uint64 now_ms);
+	verdict_t count(verdict_t v);
+
+	// Not implemented, the admission control is shared by reference.
+	admission_control(const admission_control &);
+	admission_control &operator=(const admission_control &);
+};
+
+std::ostream &operator<<(std::ostream &out, const admission_control &ac);
+
+
+} // namespace mnslp
+
+#endif // MNSLP__ADMISSION_CONTROL_H
@@ -0,0 +1,97 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file cpu_placement.h
+/// Pin threads to CPUs and find their NUMA nodes.
+/// ----------------------------------------------------------
+/// $Id: cpu_placement.h 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./include/cpu_placement.h $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#ifndef MNSLP__CPU_PLACEMENT_H
+#define MNSLP__CPU_PLACEMENT_H
+
+#include <sched.h>
+#include <string>
+#include <vector>
+
+
+namespace mnslp {
+
+
+/**
+ * A list of CPUs that threads are pinned to.
+ *
+ * The list is given like "0-3,8,10-11". Entries that can't be parsed are
+ * skipped; an empty list means that threads are not pinned at all.
+ *
+ * Pinning a thread before it allocates its working data also keeps that
+ * data on the thread's NUMA node, because Linux places a page on the
+ * node of the CPU that first touches it.
+ */
+class cpu_placement {
+
+  public:
+	explicit cpu_placement(const std::string &cpu_list="");
+
+	inline bool empty() const { return cpus.empty(); }
+
+	inline size_t size() const { return cpus.size(); }
+
+	/// The CPU for the given thread, the list is used round robin.
+	inline int get_cpu(size_t index) const {
+		return cpus[index % cpus.size()];
+	}
+
+	bool pin_thread(size_t index) const;
+
+	bool pin_thread_to_all() const;
+
+	static int get_node(int cpu);
+
+	static int get_current_cpu();
+
+  private:
+	std::vector<int> cpus;
+
+	bool pin_thread(const cpu_set_t &set) const;
+};
+
+
+/**
+ * Page allocation counters of all NUMA nodes, from the kernel's numastat.
+ *
+ * local_pages counts pages placed on the node of the allocating CPU,
+ * other_pages those that ended up on another node.
+ */
+struct numa_stats {
+	numa_stats() : local_pages(0), other_pages(0) { }
+
+	bool read();
+
+	unsigned long local_pages;
+	unsigned long other_pages;
+};
+
+
+} // namespace mnslp
+
+#endif // MNSLP__CPU_PLACEMENT_H
@@ -36,6 +36,10 @@
 #include "mnslp_config.h"
 #include "session_manager.h"
 #include "policy_rule_installer.h"
+#include "refresh_scheduler.h"
+#include "refresh_bundler.h"
+#include "admission_control.h"
+#include "session_checkpoint.h"
 #include "events.h"
 #include "msg/ntlp_msg.h"
 #include "gistka_mapper.h"
@@ -55,6 +59,10 @@ namespace mnslp {
  * Because of this, the dispatcher doesn't have to be thread-safe, it is enough
  * that the used components (session_manager etc.) are thread-safe.
  *
+ * Dispatcher threads don't block each other on a session. Events are
+ * handed to the session's mailbox, and the thread that finds it idle
+ * processes them all; see deliver().
+ *
  * This class contains a rich interface which offers all functionality the
  * lower-level state machines (implemented in the session classes) require.
  * The services include sending messages, starting times, installing policy
@@ -71,12 +79,30 @@ class dispatcher {
 
 	virtual void process(event *evt) throw ();
 
+	void dispatch(event *evt) throw ();
+
+	void flush_refreshes() throw ();
+
+	inline void set_refresh_scheduler(refresh_scheduler *s) { scheduler = s; }
+
+	inline void set_refresh_bundler(refresh_bundler *b) { bundler = b; }
+
+	inline void set_admission_control(admission_control *a) { admission = a; }
+
+	inline void set_session_checkpoint(session_checkpoint *c) { checkpoint = c; }
+
+	size_t restore_sessions(session_checkpoint *c) throw ();
+
 	/*
 	 * Services which are used by the event handlers.
 	 */
 	virtual void send_message(msg::ntlp_msg *msg) throw ();
 	
 	virtual id_t start_timer(const session *s, int secs) throw ();
+
+	virtual uint32 next_refresh(uint32 interval) throw ();
+
+	virtual bool bundle_refresh(msg::ntlp_msg *msg, uint32 peer) throw ();
 	
 	virtual void report_async_event(std::string msg) throw ();
 	
@@ -88,21 +114,48 @@ class dispatcher {
 	virtual void remove_policy_rules(const mt_policy_rule *mt_rule)
 		throw (policy_rule_installer_error);
 
+	virtual void teardown_policy_rules(const mt_policy_rule *mt_rule) throw ();
+
+	virtual mt_policy_rule * update_policy_rules(const mt_policy_rule *installed,
+												 const mt_policy_rule *requested)
+		throw (policy_rule_installer_error);
+
 	virtual bool is_authorized(const msg_event *evt) const throw ();
 
 
   private:
 	/*
-	 * The targets of these four pointers are shared among dispatchers.
+	 * The targets of these pointers are shared among dispatchers.
 	 * They may not be deleted by the destructor!
 	 */
 	session_manager *session_mgr;
 	policy_rule_installer *rule_installer;
 	mnslp_config *config;
+	refresh_scheduler *scheduler;	///< may be NULL
+	refresh_bundler *bundler;		///< may be NULL
+	admission_control *admission;	///< may be NULL
+	session_checkpoint *checkpoint;	///< may be NULL
 
 	gistka_mapper mapper;
 
+	/// REFRESH messages waiting to be bundled, by peer SII handle.
+	typedef std::map<uint32, std::vector<msg::ntlp_msg *> > pending_refreshes_t;
+	pending_refreshes_t pending_refreshes;
+
 	session *create_session(event *evt) const throw ();
+
+	bool admit_session(event *evt) throw ();
+
+	bool handle(event *evt, bool owned) throw ();
+
+	void deliver(session *s, event *evt, bool owned) throw ();
+
+	void run_mailbox(session *s) throw ();
+
+	void process_session(session *s, event *evt) throw ();
+
+	void process_refresh_list(const msg_event *e, const refresh_list *list,
+		bool rejected) throw ();
 	
 	void send_receive_answer(const routing_state_check_event *evt) const;
 };
@@ -0,0 +1,192 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file event_batch.h
+/// Batched reception and ordering of MNSLP events.
+/// ----------------------------------------------------------
+/// $Id: event_batch.h 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./include/event_batch.h $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#ifndef MNSLP__EVENT_BATCH_H
+#define MNSLP__EVENT_BATCH_H
+
+#include <deque>
+#include <ext/hash_map>
+#include <string>
+#include <vector>
+
+#include "protlib_types.h"
+#include "fqueue.h"
+
+#include "events.h"
+
+
+namespace mnslp {
+    using protlib::FastQueue;
+    using protlib::message;
+
+
+/**
+ * Take up to max messages from a queue.
+ *
+ * Waits at most timeout milliseconds for the first message. Further
+ * messages are only taken if they are already queued, so a partial batch
+ * is returned as soon as the queue runs empty.
+ *
+ * @return the number of messages appended to msgs
+ */
+size_t dequeue_batch(FastQueue *queue, std::vector<message *> &msgs,
+		size_t max, long timeout);
+
+
+/**
+ * A batch of events mapped from one dequeue_batch() call.
+ *
+ * The batch owns its events. Before dispatching, group_by_session() moves
+ * the events of each session next to each other, so the dispatcher looks
+ * up each session once per run of events and keeps its state in cache.
+ */
+class event_batch {
+
+  public:
+	explicit event_batch(size_t capacity);
+
+	~event_batch();
+
+	/// Append an event and take ownership. NULL events are ignored.
+	void add(event *evt);
+
+	/**
+	 * Reorder the events so that events of the same session are adjacent.
+	 *
+	 * Sessions appear in the order of their first event, and the events
+	 * of one session keep their relative order. Events without a session
+	 * stay where they are relative to the sessions around them. The
+	 * grouping is quadratic in the batch size, which is small.
+	 */
+	void group_by_session();
+
+	inline size_t size() const { return events.size(); }
+
+	inline bool empty() const { return events.empty(); }
+
+	inline event *get(size_t i) const { return events[i]; }
+
+	/// Hand the i-th event over to the caller, clear() won't delete it.
+	inline event *take(size_t i) {
+		event *evt = events[i];
+		events[i] = NULL;
+		return evt;
+	}
+
+	/// Delete all events in the batch.
+	void clear();
+
+  private:
+	std::vector<event *> events;
+	std::vector<event *> grouped;	///< scratch space for grouping
+	std::vector<bool> taken;		///< scratch space for grouping
+
+	// Not implemented, the batch owns its events.
+	event_batch(const event_batch &);
+	event_batch &operator=(const event_batch &);
+};
+
+
+/**
+ * Events waiting to be dispatched, sorted into priority lanes.
+ *
+ * Work for established sessions must not wait behind a flood of new
+ * sessions, or their timers fire late and the sessions expire. Each event
+ * goes to a lane by type, and next() serves the lanes in weighted round
+ * robin: per round, a lane with weight w yields up to w events. Empty
+ * lanes give up their turn, so no lane starves and no turn is wasted.
+ * Within a lane, events keep their order.
+ *
+ * The lanes must not reorder the events of a session. While a session has
+ * events waiting, its further events join the lane of the first one,
+ * whatever their type.
+ *
+ * The lanes own their events until next() hands them out.
+ */
+class event_lanes {
+
+  public:
+	enum lane_t {
+		LANE_TIMER		= 0,	///< timers
+		LANE_REFRESH	= 1,	///< REFRESH messages and teardowns
+		LANE_RESPONSE	= 2,	///< RESPONSEs and other session events
+		LANE_NEW		= 3,	///< CONFIGUREs, which may create sessions
+		NUM_LANES		= 4
+	};
+
+	explicit event_lanes(const std::string &weights="8,4,2,1");
+
+	~event_lanes();
+
+	static lane_t classify(const event *evt);
+
+	/// Append an event to its lane and take ownership. NULL is ignored.
+	/// The lane is chosen by classify() or by the session's waiting events.
+	void add(event *evt);
+
+	/// Remove the next event and pass ownership, NULL if all lanes are empty.
+	event *next();
+
+	inline size_t size() const { return count; }
+
+	inline bool empty() const { return count == 0; }
+
+	inline size_t size(lane_t lane) const { return lanes[lane].size(); }
+
+	inline uint32 get_weight(lane_t lane) const { return weights[lane]; }
+
+	/// Delete all waiting events.
+	void clear();
+
+  private:
+	std::deque<event *> lanes[NUM_LANES];
+	uint32 weights[NUM_LANES];
+	uint32 credit[NUM_LANES];	///< events left in the current round
+	size_t current;				///< the lane whose turn it is
+	size_t count;
+
+	/// The lane of a session with waiting events and how many there are.
+	struct waiting_t {
+		lane_t lane;
+		size_t events;
+	};
+
+	typedef __gnu_cxx::hash_map<session_id, waiting_t> waiting_map_t;
+	waiting_map_t waiting;
+
+	void set_weights(const std::string &weights);
+
+	// Not implemented, the lanes own their events.
+	event_lanes(const event_lanes &);
+	event_lanes &operator=(const event_lanes &);
+};
+
+
+} // namespace mnslp
+
+#endif // MNSLP__EVENT_BATCH_H
@@ -42,6 +42,7 @@
 #include "policy_rule.h"
 #include "mnslp_timers.h"
 #include "msg/selection_metering_entities.h"
+#include "msg/mnslp_trace.h"
 #include <vector>
 
 
@@ -243,6 +244,44 @@ inline mnslp_notify *msg_event::get_notify() const {
 	return dynamic_cast<mnslp_notify *>(msg->get_mnslp_msg());
 }
 
+/**
+ * One session's entry of a bundled REFRESH, or of a RESPONSE rejecting it.
+ *
+ * The dispatcher creates one event per refresh_list entry and hands it to
+ * the named session. A session calls set_accepted() if it refreshed its
+ * state; the entries nobody accepted are rejected back to the sender.
+ */
+class bundled_refresh_event : public event {
+
+  public:
+	bundled_refresh_event(session_id *sid, uint32 msn, uint32 lifetime,
+			uint32 sii_handle, bool rejected=false)
+		: event(sid), msn(msn), lifetime(lifetime), sii_handle(sii_handle),
+		  rejected(rejected), accepted(false) { }
+
+	virtual ~bundled_refresh_event() { }
+
+	inline uint32 get_msg_sequence_number() const { return msn; }
+	inline uint32 get_session_lifetime() const { return lifetime; }
+	inline uint32 get_sii_handle() const { return sii_handle; }
+
+	inline bool is_rejected() const { return rejected; }
+
+	inline bool is_accepted() const { return accepted; }
+	inline void set_accepted() { accepted = true; }
+
+	virtual ostream &print(ostream &out) const {
+		return out << "[bundled_refresh_event]"; }
+
+  private:
+	uint32 msn;
+	uint32 lifetime;
+	uint32 sii_handle;
+	bool rejected;
+	bool accepted;
+};
+
+
 class timer_event : public event {
 	
   public:
@@ -631,7 +670,8 @@ inline bool is_mnslp_response(const event *evt, uint32 msn) {
 	if ( r == NULL )
 		return false;
 
-	std::cout << "Event Message number:" << r->get_msg_sequence_number() << std::endl;
+	MNSLP_TRACE(msg::trace::tc_events, msg::trace::ev_response_msn, msn,
+		r->has_msg_sequence_number() ? r->get_msg_sequence_number() : 0, 0);
 
 	return r->has_msg_sequence_number()
 		&& msn == r->get_msg_sequence_number();
@@ -646,8 +686,6 @@ inline bool is_mnslp_response(const event *evt, ntlp_msg *msg) {
 	if ( m == NULL || ! m->has_msg_sequence_number() )
 		return false;
 
-	std::cout << "Message number:" << m->get_msg_sequence_number() << std::endl;
-	
 	return is_mnslp_response(evt, m->get_msg_sequence_number());
 }
 
@@ -678,6 +716,20 @@ inline bool is_mnslp_notify(const event *evt) {
 		return e->get_notify() != NULL;
 }
 
+inline bool is_bundled_refresh(const event *evt) {
+	const bundled_refresh_event *e
+		= dynamic_cast<const bundled_refresh_event *>(evt);
+
+	return e != NULL && ! e->is_rejected();
+}
+
+inline bool is_bundled_refresh_rejected(const event *evt) {
+	const bundled_refresh_event *e
+		= dynamic_cast<const bundled_refresh_event *>(evt);
+
+	return e != NULL && e->is_rejected();
+}
+
 inline bool is_invalid_mnslp_msg(const event *evt) {
 	const msg_event *e = dynamic_cast<const msg_event *>(evt);
 
@@ -0,0 +1,297 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file ipfix_collector.h
+/// Collector for the IPFIX results of the metering application.
+/// ----------------------------------------------------------
+/// $Id: ipfix_collector.h 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./include/ipfix_collector.h $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#ifndef MNSLP__IPFIX_COLLECTOR_H
+#define MNSLP__IPFIX_COLLECTOR_H
+
+#include <pthread.h>
+#include <deque>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "protlib_types.h"
+#include "mspec_rule_key.h"
+
+
+namespace mnslp {
+    using protlib::uchar;
+    using protlib::uint16;
+    using protlib::uint32;
+    using protlib::uint64;
+
+
+/**
+ * What the records of an observation domain counted.
+ */
+struct ipfix_counters {
+	ipfix_counters() : messages(0), records(0), octets(0), packets(0) { }
+
+	uint64 messages;
+	uint64 records;
+	uint64 octets;		///< Sum of octetDeltaCount
+	uint64 packets;		///< Sum of packetDeltaCount
+};
+
+std::ostream &operator<<(std::ostream &out, const ipfix_counters &c);
+
+
+/**
+ * The templates of an observation domain and the counters of its records.
+ *
+ * Templates are kept across messages, as IPFIX and NetFlow v9 exporters
+ * send them only now and then. The layout of a template is worked out
+ * when it arrives, so for records of fixed length the counters are read
+ * at known offsets without walking the fields.
+ *
+ * Instances of this class are not thread-safe.
+ */
+class ipfix_domain {
+
+  public:
+	ipfix_domain();
+
+	size_t decode(const uchar *msg, size_t length);
+
+	inline const ipfix_counters &get_counters() const { return counters; }
+
+	inline void reset_counters() { counters = ipfix_counters(); }
+
+	/// The transport session ended, its templates are no longer valid.
+	inline void clear_templates() { templates.clear(); }
+
+	inline size_t get_num_templates() const { return templates.size(); }
+
+	/// Data sets dropped because their template wasn't known.
+	inline uint64 get_missing_templates() const { return missing_templates; }
+
+	/// Messages and sets that could not be read.
+	inline uint64 get_malformed() const { return malformed; }
+
+  private:
+	enum field_kind_t { FK_OTHER, FK_OCTETS, FK_PACKETS };
+
+	struct field_layout {
+		uint16 length;		///< 65535 for variable length fields
+		uint16 offset;		///< In a fixed length record
+		field_kind_t kind;
+	};
+
+	struct record_layout {
+		std::vector<field_layout> fields;
+		std::vector<field_layout> counters;	///< The fields to add up
+		uint16 length;		///< Of every record, 0 if it varies
+	};
+
+	typedef std::map<uint16, record_layout> templates_t;
+
+	templates_t templates;
+	ipfix_counters counters;
+	uint64 missing_templates;
+	uint64 malformed;
+
+	bool decode_templates(uint16 setid, bool ipfix,
+		const uchar *buf, size_t length);
+
+	void decode_records(const record_layout &layout,
+		const uchar *buf, size_t length);
+};
+
+
+/**
+ * Identifies an observation domain.
+ *
+ * Observation Domain IDs are only unique within a transport session
+ * (RFC 7011, section 3.1), so the domain is qualified by the exporter.
+ * Domains are ordered by ID first, which keeps the domains of one ID
+ * from different exporters next to each other.
+ */
+struct ipfix_domain_id {
+	ipfix_domain_id(uint32 odid=0, const std::string &exporter="")
+		: odid(odid), exporter(exporter) { }
+
+	uint32 odid;
+	std::string exporter;	///< The exporter's address and port, if known
+
+	inline bool operator<(const ipfix_domain_id &other) const {
+		return odid < other.odid
+			|| ( odid == other.odid && exporter < other.exporter );
+	}
+};
+
+
+/**
+ * Totals of a collector, for all observation domains.
+ */
+struct ipfix_collector_stats {
+	ipfix_collector_stats() : received(0), dropped(0), malformed(0),
+		missing_templates(0), records(0) { }
+
+	uint64 received;			///< Messages passed to the workers
+	uint64 dropped;				///< Messages a full queue didn't take
+	uint64 malformed;
+	uint64 missing_templates;
+	uint64 records;
+};
+
+std::ostream &operator<<(std::ostream &out, const ipfix_collector_stats &s);
+
+
+/**
+ * Receives the IPFIX and NetFlow v9 results of the metering application.
+ *
+ * A listener thread reads messages from a local UDP or TCP port and hands
+ * them to a pool of workers. All messages of an observation domain go to
+ * the same worker, which owns the domain's templates, so they are decoded
+ * in order and without locking. A message a worker's full queue can't
+ * take is dropped, like a lost datagram.
+ *
+ * A domain is identified by the exporter, which is the sending address
+ * and port of a datagram or a TCP connection, and the Observation Domain
+ * ID. When a TCP connection closes, the templates of its domains are
+ * dropped.
+ *
+ * The records of a domain are added up. The counters of an Observation
+ * Domain ID are the sum over all exporters using it. The policy rule
+ * installer gives each task exporting to the collector an ID of its own
+ * and ties the rules using the task to it with bind_rule(), so the
+ * counters can be asked for by the rule key.
+ *
+ * Instances of this class are thread-safe.
+ */
+class ipfix_collector {
+
+  public:
+	enum protocol_t { UDP, TCP };
+
+	ipfix_collector(const std::string &address, uint16 port,
+		protocol_t protocol, size_t num_workers,
+		size_t queue_limit=DEFAULT_QUEUE_LIMIT);
+
+	~ipfix_collector();
+
+	bool start();
+
+	void stop();
+
+	bool submit(const uchar *msg, size_t length,
+		const std::string &exporter="");
+
+	void end_session(const std::string &exporter);
+
+	void flush();
+
+	void bind_rule(uint32 domain, const mspec_rule_key &key);
+
+	void unbind_rule(const mspec_rule_key &key);
+
+	bool get_counters(const mspec_rule_key &key, ipfix_counters &c);
+
+	bool get_counters(uint32 domain, ipfix_counters &c);
+
+	ipfix_collector_stats get_stats();
+
+	inline const std::string &get_address() const { return address; }
+
+	inline uint16 get_port() const { return port; }
+
+	static bool parse_protocol(const std::string &name, protocol_t &protocol);
+
+	static bool parse_header(const uchar *msg, size_t length,
+		uint32 &domain, size_t &msg_length);
+
+	/// Messages each worker may have waiting.
+	static const size_t DEFAULT_QUEUE_LIMIT = 4096;
+
+	/// Largest IPFIX message, its length is a 16 bit field.
+	static const size_t MAX_MESSAGE_SIZE = 65535;
+
+  private:
+	/// A message to decode, or the end of a session if data is NULL.
+	struct message {
+		ipfix_domain_id domain;
+		size_t length;
+		uchar *data;
+	};
+
+	typedef std::map<ipfix_domain_id, ipfix_domain> domains_t;
+
+	struct worker {
+		pthread_t thread;
+		pthread_mutex_t mutex;		///< Guards queue and busy
+		pthread_cond_t ready;		///< Signalled for new messages
+		pthread_cond_t idle;		///< Signalled when the queue is empty
+		std::deque<message> queue;
+		bool busy;					///< Decoding messages
+		pthread_mutex_t domains_mutex;
+		domains_t domains;
+		ipfix_collector *collector;
+	};
+
+	std::string address;
+	uint16 port;
+	protocol_t protocol;
+	size_t queue_limit;
+	std::vector<worker *> workers;
+
+	int sock;				///< -1 if not listening
+	pthread_t listener;
+	volatile bool running;
+
+	pthread_mutex_t rules_mutex;		///< Guards rules and bound
+	std::map<mspec_rule_key, uint32> rules;
+	std::map<uint32, size_t> bound;		///< Rules by domain ID
+
+	volatile uint64 received;
+	volatile uint64 dropped;
+	volatile uint64 malformed;	///< Without a readable header
+
+	bool open_socket();
+
+	worker *get_worker(uint32 domain);
+
+	void listen_udp();
+
+	void listen_tcp();
+
+	void run_worker(worker *w);
+
+	static void *listener_thread(void *arg);
+
+	static void *worker_thread(void *arg);
+
+	// Not implemented, the workers point to their collector.
+	ipfix_collector(const ipfix_collector &other);
+	ipfix_collector &operator=(const ipfix_collector &other);
+};
+
+
+} // namespace mnslp
+
+#endif // MNSLP__IPFIX_COLLECTOR_H
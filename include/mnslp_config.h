@@ -51,6 +51,26 @@ namespace mnslp {
     mnslpconf_invalid,
     mnslpconf_conffilename,
     mnslpconf_dispatcher_threads,
+    mnslpconf_dispatcher_batch_size,
+    mnslpconf_dispatcher_batch_timeout,
+    mnslpconf_dispatcher_lane_limit,
+    mnslpconf_dispatcher_lane_weights,
+    mnslpconf_dispatcher_cpus,
+    mnslpconf_gist_cpus,
+    mnslpconf_admission_max_sessions,
+    mnslpconf_admission_max_pending_installs,
+    mnslpconf_admission_queue_watermark,
+    mnslpconf_admission_peer_rate,
+    mnslpconf_admission_peer_burst,
+    mnslpconf_log_level,
+    mnslpconf_log_async,
+    mnslpconf_trace_components,
+    mnslpconf_trace_file,
+    mnslpconf_checkpoint_file,
+    mnslpconf_collector_address,
+    mnslpconf_collector_port,
+    mnslpconf_collector_protocol,
+    mnslpconf_collector_threads,
     mnslpconf_ms_is_meter,
     mnslpconf_ms_install_policy_rules,    
     mnslpconf_ms_export_config_file,
@@ -71,6 +91,8 @@ namespace mnslp {
     mnslpconf_ni_max_session_lifetime,
     mnslpconf_ni_max_retries,
     mnslpconf_ni_msg_hop_count,
+    mnslpconf_ni_refresh_load_aware,
+    mnslpconf_refresh_bundling,
 
     /* NF  */
     mnslpconf_nf_max_session_lifetime,
@@ -134,6 +156,66 @@ class mnslp_config {
 	uint32 get_num_dispatcher_threads() const {
 		return getpar<uint32>(mnslpconf_dispatcher_threads); }
 
+	uint32 get_dispatcher_batch_size() const {
+		return getpar<uint32>(mnslpconf_dispatcher_batch_size); }
+
+	uint32 get_dispatcher_batch_timeout() const {
+		return getpar<uint32>(mnslpconf_dispatcher_batch_timeout); }
+
+	uint32 get_dispatcher_lane_limit() const {
+		return getpar<uint32>(mnslpconf_dispatcher_lane_limit); }
+
+	string get_dispatcher_lane_weights() const {
+		return getpar<string>(mnslpconf_dispatcher_lane_weights); }
+
+	string get_dispatcher_cpus() const {
+		return getpar<string>(mnslpconf_dispatcher_cpus); }
+
+	string get_gist_cpus() const {
+		return getpar<string>(mnslpconf_gist_cpus); }
+
+	uint32 get_admission_max_sessions() const {
+		return getpar<uint32>(mnslpconf_admission_max_sessions); }
+
+	uint32 get_admission_max_pending_installs() const {
+		return getpar<uint32>(mnslpconf_admission_max_pending_installs); }
+
+	uint32 get_admission_queue_watermark() const {
+		return getpar<uint32>(mnslpconf_admission_queue_watermark); }
+
+	uint32 get_admission_peer_rate() const {
+		return getpar<uint32>(mnslpconf_admission_peer_rate); }
+
+	uint32 get_admission_peer_burst() const {
+		return getpar<uint32>(mnslpconf_admission_peer_burst); }
+
+	uint32 get_log_level() const {
+		return getpar<uint32>(mnslpconf_log_level); }
+
+	bool is_log_async() const {
+		return getpar<bool>(mnslpconf_log_async); }
+
+	string get_trace_components() const {
+		return getpar<string>(mnslpconf_trace_components); }
+
+	string get_trace_file() const {
+		return getpar<string>(mnslpconf_trace_file); }
+
+	string get_checkpoint_file() const {
+		return getpar<string>(mnslpconf_checkpoint_file); }
+
+	string get_collector_address() const {
+		return getpar<string>(mnslpconf_collector_address); }
+
+	uint32 get_collector_port() const {
+		return getpar<uint32>(mnslpconf_collector_port); }
+
+	string get_collector_protocol() const {
+		return getpar<string>(mnslpconf_collector_protocol); }
+
+	uint32 get_collector_threads() const {
+		return getpar<uint32>(mnslpconf_collector_threads); }
+
 	bool is_ms_meter() const { return getpar<bool>(mnslpconf_ms_is_meter); }
 	
 	string get_metering_application() const { 
@@ -175,6 +257,12 @@ class mnslp_config {
     uint32 get_ni_response_timeout() const { 
 		return getpar<uint32>(mnslpconf_ni_response_timeout); }
 
+	bool is_ni_refresh_load_aware() const {
+		return getpar<bool>(mnslpconf_ni_refresh_load_aware); }
+
+	bool is_refresh_bundling() const {
+		return getpar<bool>(mnslpconf_refresh_bundling); }
+
 	uint32 get_nf_max_session_lifetime() const { 
 	  return getpar<uint32>(mnslpconf_nf_max_session_lifetime); }
 	  
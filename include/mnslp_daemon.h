@@ -36,6 +36,11 @@
 #include "mnslp_config.h"
 #include "session_manager.h"
 #include "policy_rule_installer.h"
+#include "refresh_scheduler.h"
+#include "refresh_bundler.h"
+#include "admission_control.h"
+#include "session_checkpoint.h"
+#include "ipfix_collector.h"
 
 
 namespace mnslp {
@@ -83,6 +88,16 @@ class mnslp_daemon : public Thread {
 		
 	policy_rule_installer *rule_installer;
 
+	refresh_scheduler *refresh_sched;
+
+	refresh_bundler *refresh_bundles;
+
+	admission_control *admission;
+
+	session_checkpoint *checkpoint;	///< NULL if disabled
+
+	ipfix_collector *collector;		///< NULL if disabled
+
 	ThreadStarter<NTLPStarter, NTLPStarterParam> *ntlp_starter;
 };
 
@@ -0,0 +1,153 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file mnslp_log.h
+/// Logging facade with compile-time and run-time level filtering.
+/// ----------------------------------------------------------
+/// $Id: mnslp_log.h 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./include/mnslp_log.h $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#ifndef MNSLP__MNSLP_LOG_H
+#define MNSLP__MNSLP_LOG_H
+
+#include <sstream>
+#include <string>
+
+
+#define MNSLP_LOG_LEVEL_ERROR	0
+#define MNSLP_LOG_LEVEL_WARN	1
+#define MNSLP_LOG_LEVEL_INFO	2
+#define MNSLP_LOG_LEVEL_DEBUG	3
+
+/**
+ * The most verbose level compiled into the daemon. Log statements above
+ * this level are removed by the compiler, including the evaluation of
+ * their arguments. Configure with --disable-debug-log to set it to
+ * MNSLP_LOG_LEVEL_INFO.
+ */
+#ifndef MNSLP_LOG_LEVEL
+  #define MNSLP_LOG_LEVEL MNSLP_LOG_LEVEL_DEBUG
+#endif
+
+
+/**
+ * Log a message if level is compiled in and enabled at run time.
+ *
+ * The ostream expression in msg is only evaluated after both checks
+ * passed, so disabled statements cost a comparison.
+ */
+#define MNSLP_LOG(level, module, msg) \
+	do { \
+		if ( (level) <= MNSLP_LOG_LEVEL \
+				&& mnslp::logging::is_enabled(level) ) { \
+			std::ostringstream mnslp_log_os; \
+			mnslp_log_os << msg; \
+			mnslp::logging::write(level, module, mnslp_log_os.str()); \
+		} \
+	} while ( false )
+
+#define MNSLP_LOG_INFO(module, msg) MNSLP_LOG(MNSLP_LOG_LEVEL_INFO, module, msg)
+#define MNSLP_LOG_DEBUG(module, msg) MNSLP_LOG(MNSLP_LOG_LEVEL_DEBUG, module, msg)
+
+
+namespace mnslp {
+  namespace logging {
+
+/**
+ * The most verbose level that is written at run time.
+ */
+extern volatile int runtime_level;
+
+inline bool is_enabled(int level) {
+	return level <= runtime_level;
+}
+
+void set_level(int level);
+
+int get_level();
+
+/**
+ * Hand a formatted message to the log.
+ *
+ * While the background writer runs, the message is queued in a ring
+ * owned by the calling thread and written later. Otherwise, or when
+ * the ring is full, it is passed to the protlib logfile immediately.
+ *
+ * @param level one of the MNSLP_LOG_LEVEL_* values
+ * @param module the module name, it must be a string literal
+ * @param text the message; its contents may be taken over
+ */
+void write(int level, const char *module, std::string text);
+
+/**
+ * Start the background thread that writes queued messages.
+ */
+void start_writer();
+
+/**
+ * Stop the background thread after writing all queued messages.
+ */
+void stop_writer();
+
+bool is_writer_running();
+
+
+/**
+ * A single-producer single-consumer ring of log records.
+ *
+ * Each thread that logs owns one ring and is its only producer. The
+ * background writer is the only consumer. head and tail are only ever
+ * incremented, the slot index is taken modulo RING_SIZE.
+ */
+class log_ring {
+
+  public:
+	static const unsigned RING_SIZE = 1024;
+
+	log_ring() : head(0), tail(0), busy(false), dead(false), next(NULL) { }
+
+	bool push(int level, const char *module, std::string &text);
+	bool pop(int &level, const char *&module, std::string &text);
+
+	inline bool empty() const { return head == tail; }
+
+  private:
+	struct record {
+		int level;
+		const char *module;
+		std::string text;
+	};
+
+	record records[RING_SIZE];
+	volatile unsigned head;		///< next slot to write, producer only
+	volatile unsigned tail;		///< next slot to read, consumer only
+
+  public:
+	volatile bool busy;			///< the producer is between check and push
+	volatile bool dead;			///< the producer thread has exited
+	log_ring *next;				///< all rings form a list for the writer
+};
+
+  } // namespace logging
+} // namespace mnslp
+
+#endif // MNSLP__MNSLP_LOG_H
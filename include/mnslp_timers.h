@@ -68,6 +68,10 @@ class timer {
 	timer(session *s, id_t initial_id);
 
 	inline id_t get_id() const { return id; }
+
+	/// When the timer fires, in seconds since the epoch, 0 if stopped.
+	inline time_t get_expiry() const { return expires; }
+
 	void start(dispatcher *d, int seconds);
 	void restart(dispatcher *d, int seconds);
 	void stop();
@@ -77,6 +81,7 @@ class timer {
 	
   private:
 	id_t id;
+	time_t expires;
 	session *owning_session;
 };
 
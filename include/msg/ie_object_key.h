@@ -64,6 +64,9 @@ private:
 
 public:
 	
+	/// Default constructor, creates the empty key (0,0).
+	inline ie_object_key(): object_type(0), seq_nbr(0){}
+	
 	/// Constructor of the field key
 	inline ie_object_key(uint32 _object_type, uint32 _seq_nbr): 
 			object_type(_object_type), seq_nbr(_seq_nbr){}
@@ -7,10 +7,11 @@
 #ifndef PROTLIB__IE_STORE_H
 #define PROTLIB__IE_STORE_H
 
-#include <map>
+#include <utility>
 
 #include "ie.h"
 #include "ie_object_key.h"
+#include "small_vector.h"
 
 
 namespace protlib 
@@ -20,8 +21,9 @@ namespace protlib
 /**
  * Stores (ID, IE) mappings.
  *
- * This is a helper class intented for internal use. It mainly specializes
- * std::map and takes care of memory management issues.
+ * This is a helper class intented for internal use. Entries are kept in a
+ * vector sorted by ie_object_key, so iteration order is the same as the one
+ * of a std::map. It also takes care of memory management issues.
  */
 class ie_store 
 {
@@ -36,24 +38,47 @@ class ie_store
 	void set(ie_object_key id, IE *ie) throw();
 	IE *remove(ie_object_key id) throw();
 
+	ie_store &operator=(const ie_store &other);
+
 	bool operator==(const ie_store &other) const throw();
 	uint32 getMaxSequence(uint32 id) const;
 
-	typedef std::map<ie_object_key, IE *>::const_iterator const_iterator;
+	typedef std::pair<ie_object_key, IE *> entry_type;
+	typedef const entry_type *const_iterator;
 
 	const_iterator begin() const throw() { return entries.begin(); }
 	const_iterator end() const throw() { return entries.end(); }
 
+	/**
+	 * Number of entries kept without a heap allocation. A typical
+	 * CONFIGURE carries less than ten objects.
+	 */
+	static const size_t INLINE_ENTRIES = 12;
+
   private:
+	typedef std::pair<uint32, uint32> max_seq_type;
+
 	/**
-	 * Maps IDs to IEs.
+	 * Maps IDs to IEs, sorted by ID.
 	 *
 	 * Note: Don't use __gnu_cxx::hash_map here. It is vector-based and
 	 *       *extremely* expensive to initialize. The constructor eats
 	 *       up much more processing time than we can ever gain by the
 	 *       cheaper lookup method.
 	 */
-	std::map<ie_object_key, IE *> entries;
+	small_vector<entry_type, INLINE_ENTRIES> entries;
+
+	/**
+	 * Highest sequence number stored per object type, updated on every
+	 * set() and remove().
+	 */
+	small_vector<max_seq_type, 4> max_sequences;
+
+	size_t lower_bound(const ie_object_key &id) const throw();
+	bool matches(size_t pos, const ie_object_key &id) const throw();
+	void update_max_sequence(const ie_object_key &id) throw();
+	void recompute_max_sequence(uint32 object_type) throw();
+	void clear() throw();
 
 	/**
 	 * Shortcut.
@@ -94,7 +94,8 @@ class information_code : public mnslp_object {
 		obj_message_hop_count 		= 0x00F6,
 		obj_msg_sequence_number 	= 0x00F7,
 		obj_session_lifetime		= 0x00F8,
-		obj_msnlp_ipfix_message		= 0x00F9   // 249
+		obj_msnlp_ipfix_message		= 0x00F9,  // 249
+		obj_refresh_list			= 0x00FA
 	};	
 
 	explicit information_code();
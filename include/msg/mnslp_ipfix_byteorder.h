@@ -0,0 +1,62 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file mnslp_ipfix_byteorder.h
+/// Bulk byte order conversion for columns of IPFIX values.
+/// ----------------------------------------------------------
+/// $Id: mnslp_ipfix_byteorder.h 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./include/msg/mnslp_ipfix_byteorder.h $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+
+#ifndef MNSLP_IPFIX_BYTEORDER_H
+#define MNSLP_IPFIX_BYTEORDER_H
+
+#include <cstddef>
+#include <inttypes.h>
+
+namespace mnslp {
+  namespace msg {
+
+/**
+ * Convert n values in place between host and network byte order. The 
+ * conversion is its own inverse, so the same calls are used to decode.
+ * 
+ * The kernel is chosen once from the features of the running CPU: AVX2 
+ * or SSSE3 byte shuffles on x86 when built with GCC 4.9 or later, a 
+ * scalar loop otherwise, and nothing at all on big endian hosts.
+ */
+void ipfix_hton_n( uint16_t *values, size_t n );
+
+void ipfix_hton_n( uint32_t *values, size_t n );
+
+void ipfix_hton_n( uint64_t *values, size_t n );
+
+/**
+ * Returns the name of the selected kernel: "avx2", "ssse3", "scalar" 
+ * or "none".
+ */
+const char *ipfix_byteorder_kernel( void );
+
+  } // namespace msg
+} // namespace mnslp
+
+#endif // MNSLP_IPFIX_BYTEORDER_H
@@ -0,0 +1,98 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file mnslp_ipfix_codec.h
+/// Coding specialized encoders and decoders for IPFIX fields.
+/// ----------------------------------------------------------
+/// $Id: mnslp_ipfix_codec.h 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./include/msg/mnslp_ipfix_codec.h $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+
+#ifndef MNSLP_IPFIX_CODEC_H
+#define MNSLP_IPFIX_CODEC_H
+
+#include "mnslp_ipfix_field.h"
+
+namespace mnslp {
+  namespace msg {
+
+/**
+ * Writes the value of a field into out. It returns 0 on success and -1
+ * when the value can not be represented, in the same way than 
+ * mnslp_ipfix_field::encode.
+ */
+typedef int (*ipfix_encode_fn)( const mnslp_ipfix_field &field, 
+								const mnslp_ipfix_value_field &in, 
+								uint8_t *out );
+
+/**
+ * Reads len bytes from in and builds the value of the field.
+ */
+typedef mnslp_ipfix_value_field (*ipfix_decode_fn)( const mnslp_ipfix_field &field, 
+													 const uint8_t *in, 
+													 size_t len );
+
+/**
+ * Returns the encoder for a field with the given length on the wire.
+ * 
+ * Integer, float and NTP fields with a fixed length of 1, 2, 4 or 8 bytes,
+ * byte strings, addresses and character strings get a kernel specialized 
+ * for their coding, length and relay flag, so no switch on the coding or 
+ * length is done per value. Any other field gets a kernel that calls 
+ * mnslp_ipfix_field::encode.
+ * 
+ * @param field_type - type of the field
+ * @param flength	 - length of the field in the template.
+ * @param relay_f	 - 1 to copy the value without changing the byte order.
+ */
+ipfix_encode_fn ipfix_resolve_encoder( const ipfix_field_type_t &field_type, 
+									   uint16_t flength, int relay_f );
+
+/**
+ * Returns the decoder for a field with the given length on the wire. 
+ * The kernels are selected as in ipfix_resolve_encoder; the generic 
+ * kernel calls mnslp_ipfix_field::decode.
+ */
+ipfix_decode_fn ipfix_resolve_decoder( const ipfix_field_type_t &field_type, 
+									   uint16_t flength, int relay_f );
+
+/**
+ * How the bulk record path handles a field when every field of a template
+ * has a fixed length.
+ */
+typedef enum
+{
+	IPFIX_COLUMN_NONE = 0,		///< the record must be coded field by field.
+	IPFIX_COLUMN_RAW,			///< bytes copied as they are.
+	IPFIX_COLUMN_NUMBER			///< 1, 2, 4 or 8 byte number, swapped unless relayed.
+} ipfix_column_t;
+
+/**
+ * Returns the column kind of a field with the given length on the wire.
+ */
+ipfix_column_t ipfix_resolve_column( const ipfix_field_type_t &field_type, 
+									 uint16_t flength );
+
+  } // namespace msg
+} // namespace mnslp
+
+#endif // MNSLP_IPFIX_CODEC_H
@@ -124,6 +124,13 @@ public:
      * Throws mnslp_ipfix_bad_argument if the field is not found
      */
     mnslp_ipfix_value_field get_field(const mnslp_ipfix_field_key &param) const;
+
+    /** 
+     * Return a reference to the field value stored for the field key, 
+     * without copying it. The reference is valid until the record changes.
+     * Throws mnslp_ipfix_bad_argument if the field is not found
+     */
+    const mnslp_ipfix_value_field & get_field_value(const mnslp_ipfix_field_key &param) const;
     
     /** 
      * Return the length on bytes of the value based on components of the field key
@@ -214,12 +214,7 @@ class mnslp_ipfix_field : public mnslp_field
 		/** Get the field type
 		*  @param  None
 		*/
-		inline ipfix_field_type_t get_field_type(){ return field_type; }
-
-		/** Get the field type
-		*  @param  None
-		*/
-		inline ipfix_field_type_t get_field_type() const { return field_type; }
+		inline const ipfix_field_type_t &get_field_type() const { return field_type; }
 
 		
 		/** Encode a field value of type int into a uint8_t array. 
@@ -229,7 +224,7 @@ class mnslp_ipfix_field : public mnslp_field
 		* 		   relay_f - if 0 it must do network encoding, 
 		* 						1 just copy the information.
 		*/
-		int ipfix_encode_int( mnslp_ipfix_value_field &in, uint8_t *out, int relay_f ); /* Tested */
+		int ipfix_encode_int( const mnslp_ipfix_value_field &in, uint8_t *out, int relay_f ) const; /* Tested */
 
 		/** Decode from a uint8_t array to a field value of type int.
 		*   verifies that the value is of type int. 
@@ -238,7 +233,7 @@ class mnslp_ipfix_field : public mnslp_field
 		* 		   relay_f - if 0 it must do network encoding, 
 		* 						1 just copy the information.
 		*/
-		mnslp_ipfix_value_field ipfix_decode_int( uint8_t *in, size_t len, int relay_f ); /* Tested */
+		mnslp_ipfix_value_field ipfix_decode_int( uint8_t *in, size_t len, int relay_f ) const; /* Tested */
 	
 		/** Put the field value int into a char string 
 		*  @param  in - value to put
@@ -279,7 +274,7 @@ class mnslp_ipfix_field : public mnslp_field
 		* 		   relay_f - if 0 it must do network encoding, 
 		* 						1 just copy the information.
 		*/
-		int ipfix_encode_bytes(mnslp_ipfix_value_field in, uint8_t *out, int relay_f ); /* Tested */
+		int ipfix_encode_bytes( const mnslp_ipfix_value_field &in, uint8_t *out, int relay_f ) const; /* Tested */
 
 		/** Decode from a uint8_t array to a field value of type bytes.
 		*   verifies that the value is of type bytes. 
@@ -288,7 +283,7 @@ class mnslp_ipfix_field : public mnslp_field
 		* 		   relay_f - if 0 it must do network encoding, 
 		* 						1 just copy the information.
 		*/
-		mnslp_ipfix_value_field ipfix_decode_bytes( uint8_t *in, size_t len, int relay_f ); /* Tested */
+		mnslp_ipfix_value_field ipfix_decode_bytes( uint8_t *in, size_t len, int relay_f ) const; /* Tested */
 
 		/** Put a bytes field value into a char string 
 		*  @param  in - value to put
@@ -345,7 +340,7 @@ class mnslp_ipfix_field : public mnslp_field
 		* 		   relay_f - if 0 it must do network encoding, 
 		* 						1 just copy the information.
 		*/
-		int ipfix_encode_float( mnslp_ipfix_value_field in, uint8_t *out, int relay_f ); /* Tested */
+		int ipfix_encode_float( const mnslp_ipfix_value_field &in, uint8_t *out, int relay_f ) const; /* Tested */
 	
 		/** Decode from a uint8_t array to a field value of type float.
 		*   verifies that the value is a float type. 
@@ -354,7 +349,7 @@ class mnslp_ipfix_field : public mnslp_field
 		* 		   relay_f - if 0 it must do network encoding, 
 		* 						1 just copy the information.
 		*/
-		mnslp_ipfix_value_field ipfix_decode_float( uint8_t *in, size_t len, int relay_f ); /* Tested */
+		mnslp_ipfix_value_field ipfix_decode_float( uint8_t *in, size_t len, int relay_f ) const; /* Tested */
 
 		/** Put a float field value into a char string 
 		*  @param  in - value to put
@@ -376,28 +371,28 @@ class mnslp_ipfix_field : public mnslp_field
 		*  verifies that the field is of type int and one character long.
 		*  @param  _value8 - Value that is going to be assigned
 		*/
-		mnslp_ipfix_value_field get_ipfix_value_field(uint8_t &_value8); /* Tested */
+		mnslp_ipfix_value_field get_ipfix_value_field(uint8_t &_value8) const; /* Tested */
 
 		/** Get the field value from a field of type int of two characters
 		*  verifies that the field is of type int and two characters long.
 		*  @param  _value16 - Value that is going to be assigned
 		*  @throw   mnslp_ipfix_exception The length of field is not one byte
 		*/
-		mnslp_ipfix_value_field get_ipfix_value_field(uint16_t &_value16); /* Tested */
+		mnslp_ipfix_value_field get_ipfix_value_field(uint16_t &_value16) const; /* Tested */
 
 		/** Get the field value from a field of type int of four characters
 		*  verifies that the field is of type int and four characters long.
 		*  @param  _value32 - Value that is going to be assigned
 		*  @throw   mnslp_ipfix_exception The length of field is not two bytes
 		*/
-		mnslp_ipfix_value_field get_ipfix_value_field(uint32_t &_value32); /* Tested */
+		mnslp_ipfix_value_field get_ipfix_value_field(uint32_t &_value32) const; /* Tested */
 
 		/** Get the field value from a field of type int of eight characters
 		*  verifies that the field is of type int and eight characters long.
 		*  @param  _value64 - Value that is going to be assigned
 		*  @throw   mnslp_ipfix_exception The length of field is not four bytes
 		*/
-		mnslp_ipfix_value_field get_ipfix_value_field(uint64_t &_value64); /* Tested */
+		mnslp_ipfix_value_field get_ipfix_value_field(uint64_t &_value64) const; /* Tested */
 
 		/** Get the field value from a field of type char
 		*  verifies that the field is of type char
@@ -405,7 +400,7 @@ class mnslp_ipfix_field : public mnslp_field
 		* 		   _length	  - number of characters to copy from the _valuechar pointer
 		*  @throw   mnslp_ipfix_exception The length of field is not eight bytes
 		*/
-		mnslp_ipfix_value_field get_ipfix_value_field(char * _valuechar, int _length); /* Tested */
+		mnslp_ipfix_value_field get_ipfix_value_field(char * _valuechar, int _length) const; /* Tested */
 
 		/** Get the field value from a field of type unit8_t
 		*  verifies that the field is of type char
@@ -413,7 +408,7 @@ class mnslp_ipfix_field : public mnslp_field
 		* 		   _length	  - number of characters to copy from the _valuebyte pointer
 		*  @throw   mnslp_ipfix_exception The length requested is not as the field length
 		*/
-		mnslp_ipfix_value_field get_ipfix_value_field(uint8_t * _valuebyte, int _length); /* Tested */
+		mnslp_ipfix_value_field get_ipfix_value_field(uint8_t * _valuebyte, int _length) const; /* Tested */
 		
 		/** Encode a field value. It takes the field type from the field 
 		*   and encode based on the coding for that field type 
@@ -423,8 +418,8 @@ class mnslp_ipfix_field : public mnslp_field
 		* 						1 just copy the information.
 		* @throw   mnslp_ipfix_exception The length requested is not as the field length
 		*/
-		int encode( mnslp_ipfix_value_field in, 
-						uint8_t *out, int relay_f);
+		int encode( const mnslp_ipfix_value_field &in, 
+						uint8_t *out, int relay_f) const;
 				
 		/** Decode a field value. It takes the field type from the field 
 		*   and decode based on the coding for that field type 
@@ -433,7 +428,7 @@ class mnslp_ipfix_field : public mnslp_field
 		* 		   relay_f - if 0 it must do network encoding, 
 		* 						1 just copy the information.
 		*/
-		mnslp_ipfix_value_field decode( uint8_t *in, size_t len, int relay_f);
+		mnslp_ipfix_value_field decode( uint8_t *in, size_t len, int relay_f) const;
 		
 		/** Put a field value into a char string. It takes the field type from
 		 *  the field object for who is call is method.
@@ -481,14 +476,76 @@ class mnslp_ipfix_value_field
 {
 
 private:
-	uint8_t value8; 		///< The field is int, and it has one character
-	uint16_t value16;		///< The field is int, and it has two characters
-	uint32_t value32;		///< The field is int or float, and it has four characters
-	uint64_t value64;		///< The field is int or float, and it has eight characters
+
+	/// Values of up to this many bytes are kept inside the object itself.
+	static const int INLINE_LENGTH = 16;
+
+	enum value_kind_t
+	{
+		KIND_EMPTY = 0,
+		KIND_NUMBER,
+		KIND_STRING,
+		KIND_BYTES
+	};
+
+	/**
+	 * Heap block holding a string or byte value longer than INLINE_LENGTH.
+	 * It is never modified once built, so copies of the value share it and
+	 * the last one to go releases it.
+	 */
+	struct shared_buffer
+	{
+		int refs;				///< Number of values pointing to the block
+		uint8_t data[1];		///< First byte of the value
+	};
+
+	union
+	{
+		uint8_t value8; 		///< The field is int, and it has one character
+		uint16_t value16;		///< The field is int, and it has two characters
+		uint32_t value32;		///< The field is int or float, and it has four characters
+		uint64_t value64;		///< The field is int or float, and it has eight characters
+		uint8_t inline_data[INLINE_LENGTH];	///< Short character or byte string
+		shared_buffer *shared;	///< Long character or byte string
+	};
 	int length;				///< The length of the field value in characters
-	char *valuechar;		///< The value is a character string
-	uint8_t *valuebyte;		///< The value is a byte string
-	
+	uint8_t kind;			///< Which member of the union holds the value
+
+	/// Point to the bytes of a string or byte value.
+	inline const uint8_t *data() const
+	{
+		return (length <= INLINE_LENGTH) ? inline_data : shared->data;
+	}
+
+	/// Whether the value lives in a shared heap block.
+	inline bool is_shared() const
+	{
+		return ((kind == KIND_STRING) || (kind == KIND_BYTES)) 
+				&& (length > INLINE_LENGTH);
+	}
+
+	/// Store a copy of a string or byte value.
+	void set_data(uint8_t _kind, const uint8_t *_data, int _length);
+
+	/// Share the contents of param, which must not be this object.
+	void copy_from(const mnslp_ipfix_value_field &param);
+
+	/// Drop the current value, releasing its shared block if this was the last user.
+	void release();
+
+	/// Store a number of the given width.
+	inline void set_number(int _length)
+	{
+		kind = KIND_NUMBER;
+		length = _length;
+	}
+
+	/// Whether the value is a number of the given width.
+	inline bool is_number(int _length) const
+	{
+		return (kind == KIND_NUMBER) && (length == _length);
+	}
+
 public:
 	
 	/** 
@@ -500,14 +557,16 @@ public:
 	 * Contructor of the class, creates a field value empty
 	 */
 	mnslp_ipfix_value_field():
-		value8(0), value16(0), value32(0), value64(0), 
-		length(0), valuechar(NULL), valuebyte(NULL) 
+		value64(0), length(0), kind(KIND_EMPTY) 
 		 {};
 		
 	/** 
 	 * Destructor of the class
 	 */
-	~mnslp_ipfix_value_field();
+	inline ~mnslp_ipfix_value_field()
+	{
+		release();
+	}
 	
 	/** 
 	 * Assigment operator. 
@@ -519,102 +578,120 @@ public:
 	 * Set the value as one byte long  - Int
 	 * @param _value - value to copy.
 	 */
-	inline void set_value_int8(uint8_t &_value){value8 =_value; length = 1;}
+	inline void set_value_int8(uint8_t &_value){ release(); value8 =_value; set_number(1); }
 
 	/** 
 	 * Set the value as two byte long - Int
 	 * @param _value - value to copy.
 	 */
-	inline void set_value_int16(uint16_t &_value){value16 =_value; length = 2;}
+	inline void set_value_int16(uint16_t &_value){ release(); value16 =_value; set_number(2); }
 
 	/** 
 	 * Set the value as four byte long - Int
 	 * @param _value - value to copy.
 	 */
-	inline void set_value_int32(uint32_t &_value){value32 =_value; length = 4;}
+	inline void set_value_int32(uint32_t &_value){ release(); value32 =_value; set_number(4); }
 
 	/** 
 	 * Set the value as eight byte long - Int
 	 * @param _value - value to copy.
 	 */
-	inline void set_value_int64(uint64_t &_value){value64 =_value; length = 8;}
+	inline void set_value_int64(uint64_t &_value){ release(); value64 =_value; set_number(8); }
 
 	/** 
 	 * Set the value as four byte long - float
 	 * @param _value - value to copy.
 	 */
-	inline void set_value_float32(uint32_t &_value){value32 =_value; length = 4;}
+	inline void set_value_float32(uint32_t &_value){ release(); value32 =_value; set_number(4); }
 
 	/** 
 	 * Set the value as eight byte long - float
 	 * @param _value - value to copy.
 	 */
-	inline void set_value_float64(uint64_t &_value){value64 =_value; length = 8;}
+	inline void set_value_float64(uint64_t &_value){ release(); value64 =_value; set_number(8); }
 
 	/** 
 	 * Set the value as a variable string of type unit8. 
 	 * @param _value - value to copy.
 	 * 		  _lenght - number of bytes to copy
 	 */
-	void set_value_vunit8(uint8_t * _valuebyte, int _length);
+	inline void set_value_vunit8(const uint8_t * _valuebyte, int _length)
+	{
+		set_data(KIND_BYTES, _valuebyte, _length);
+	}
 
 	/** 
 	 * Set the value as a variable string of type char. 
 	 * @param _value - value to copy.
 	 * 		  _lenght - number of characters to copy
 	 */
-	void set_value_vchar(char * _valuechar, int _length);
+	inline void set_value_vchar(const char * _valuechar, int _length)
+	{
+		set_data(KIND_STRING, (const uint8_t *) _valuechar, _length);
+	}
 	
 	
 	/** 
 	 * Obtain the value as one byte long  - Int
 	 */
-	inline uint8_t get_value_int8(){ return value8; }
+	inline uint8_t get_value_int8() const { return is_number(1) ? value8 : 0; }
 
 	/** 
 	 * Obtain the value as two byte long  - Int
 	 */
-	inline uint16_t get_value_int16(){ return value16; }
+	inline uint16_t get_value_int16() const { return is_number(2) ? value16 : 0; }
 
 	/** 
 	 * Obtain the value as four byte long  - Int
 	 */
-	inline uint32_t get_value_int32(){ return value32; }
+	inline uint32_t get_value_int32() const { return is_number(4) ? value32 : 0; }
 
 	/** 
 	 * Obtain the value as eight byte long  - Int
 	 */
-	inline uint64_t get_value_int64(){ return value64; }
+	inline uint64_t get_value_int64() const { return is_number(8) ? value64 : 0; }
 
 	/** 
 	 * Obtain the value as four byte long  - float
 	 */
-	inline uint32_t get_value_float32(){ return value32; }
+	inline uint32_t get_value_float32() const { return is_number(4) ? value32 : 0; }
 
 	/** 
 	 * Obtain the value as eight byte long  - float
 	 */
-	inline uint64_t get_value_float64(){ return value64; }
+	inline uint64_t get_value_float64() const { return is_number(8) ? value64 : 0; }
 
 	/** 
-	 * Obtain the value as string of characters
+	 * Obtain the value as string of characters, NULL if it is not a string.
 	 */
-	inline char * get_value_string(){ return valuechar; }
+	inline const char * get_value_string() const 
+	{ 
+		return (kind == KIND_STRING) ? (const char *) data() : NULL; 
+	}
 
 	/** 
-	 * Obtain the value as string of bytes
+	 * Obtain the value as string of bytes, NULL if it is not a byte string.
 	 */
-	inline uint8_t * get_value_byte(){ return valuebyte; }
+	inline const uint8_t * get_value_byte() const 
+	{ 
+		return (kind == KIND_BYTES) ? data() : NULL; 
+	}
 
 	/** 
 	 * Obtain the ip address represented as a byte string
 	 */
-	inline uint8_t * get_value_address(){ return valuebyte; }
+	inline const uint8_t * get_value_address() const { return get_value_byte(); }
 
 	/** 
 	 * Obtain the number of bytes required to represent the value
 	 */
-	inline int get_length(){ return length; }
+	inline int get_length() const { return length; }
+
+	/** 
+	 * Tell whether the value is kept inside the object, so copying it 
+	 * does not touch the allocator.
+	 */
+	inline bool is_inline() const { return !is_shared(); }
 	
 	bool operator != (const mnslp_ipfix_value_field &rhs) const;
 	
@@ -623,12 +700,12 @@ public:
 	/**
 	 *Print the value on cout
 	 */
-	void print(void);
+	void print(void) const;
 	
 	/**
 	 *Print the value in a string and return the string.
 	 */
-	std::string to_string(void);
+	std::string to_string(void) const;
 	
 };
 
@@ -160,6 +160,7 @@ class mnslp_ipfix_message : public mnslp_mspec_object
 	   std::vector<mnslp_ipfix_data_record> data_list; 					///< List of data record asociated with the message
 	   bool                             	encode_network;				///< convert to network encoding 
 	   static const char *const 			ie_name;
+	   static size_t						bulk_min_records;			///< Records from which fixed length sets are coded by columns.
 	   bool 								require_output;				/// Control in the messsage has changed since the last
 																		/// output execution.
 	   
@@ -271,12 +272,68 @@ class mnslp_ipfix_message : public mnslp_mspec_object
 	    *  @param templid 		- Template Id.
 	    */
 	   void output_set( uint16_t templid );
+	   
+	   /**
+	    * Export the data records of a template whose fields all have a fixed
+	    * length column by column, converting the byte order of whole columns.
+	    * Every record goes in its own set, as in output_set.
+	    *  @param templ 		- Template, with get_record_length() > 0.
+	    *  @return false, without writing anything, when there are fewer than 
+	    *  		bulk_min_records records or a value does not have the length 
+	    * 		of its field.
+	    */
+	   bool output_fixed_records( mnslp_ipfix_template *templ );
+	   
+	   /**
+	    * Decode consecutive records of a template whose fields all have a
+	    * fixed length column by column.
+	    *  @param templ 		- Template, with get_record_length() > 0.
+	    * 		  buf			- character string to read.
+	    * 		  nrecords		- number of records in buf.
+	    */
+	   void decode_fixed_records( mnslp_ipfix_template *templ,
+								  uchar *buf, size_t nrecords );
+	   
+	   /**
+	    * Run output() if the message changed since the last time it was
+	    * executed. The buffer is a cache of the message content, so this 
+	    * can be used from const methods.
+	    */
+	   void flush_output( void ) const;
+
+	   /**
+	    * Hash the exported buffer, which is the canonical form of the 
+	    * templates and data records.
+	    */
+	   virtual object_fingerprint compute_fingerprint( void ) const throw (IEError);
+
+	   /**
+	    * Length of the message header at the start of the exported buffer.
+	    */
+	   size_t get_header_length( void ) const;
+
+	   /**
+	    * Hash the template and data sets of an exported buffer of len bytes, 
+	    * together with the version and observation domain of the header. 
+	    * The export time and the NF9 sequence number change with every 
+	    * output, so they are left out.
+	    */
+	   object_fingerprint fingerprint_content( const uchar *buf, size_t len ) const;
 
 	   	   
    public:	
 
 	   static const uint16 OBJECT_TYPE = 0x00F9;
 
+	   /**
+	    * Set the number of records of a fixed length template from which 
+	    * they are exported and imported column by column. 0 always codes 
+	    * them field by field.
+	    */
+	   static void set_bulk_min_records( size_t min_records );
+	   
+	   static size_t get_bulk_min_records( void );
+
 	   /**
 	    * Find a return a reference to a template with id: templid
 	    * @param templid - Id of the template
@@ -486,7 +543,8 @@ class mnslp_ipfix_message : public mnslp_mspec_object
 	   *  Equals operator. 
 	   *  It is equal when it has the same amount of templates and 
 	   *  data records, and the information inside is equal. The order in
-	   * the data records must be same too.
+	   * the data records must be same too. Messages are compared by their
+	   * fingerprint first, the buffers are compared only when it matches.
 	   */
 		virtual bool isEqual(const mnslp_mspec_object &rhs) const;
 	
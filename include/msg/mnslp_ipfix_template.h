@@ -37,6 +37,7 @@
 #include <map>
 #include <list>
 #include "mnslp_ipfix_field.h"
+#include "mnslp_ipfix_codec.h"
 
 namespace mnslp {
   namespace msg {
@@ -74,9 +75,36 @@ typedef struct
     mnslp_ipfix_field   	elem;
 } ipfix_template_field_t;
 
-typedef vector<ipap_template_field_t> 			templateFieldList_t;
-typedef vector<ipap_template_field_t>::iterator 	templateFieldIterList_t;
-typedef vector<ipap_template_field_t>::const_iterator 	templateFieldConstIterList_t;
+typedef vector<ipfix_template_field_t> 			templateFieldList_t;
+typedef vector<ipfix_template_field_t>::iterator 	templateFieldIterList_t;
+typedef vector<ipfix_template_field_t>::const_iterator 	templateFieldConstIterList_t;
+
+/**
+ * \class ipfix_field_descriptor_t
+ *
+ * \brief Compiled form of a template field used by the codecs.
+ * 
+ * Descriptors are plain data, so the codecs can walk them without copying
+ * the names and documentation held by the field definition. elem points
+ * to the definition stored in the template; it remains valid until the
+ * field set of the template changes. encode is resolved for relay_f, and
+ * decode is indexed by the relay flag of the message being read.
+ */
+typedef struct
+{
+    int                     eno;               /* enterprise number or 0 */
+    int                     ftype;             /* field type */
+    uint16_t                flength;           /* length on the wire */
+    bool                    varlen;            /* flength == IPFIX_FT_VARLEN */
+    int                     coding;            /* IPFIX_CODING_* */
+    int                     relay_f;           /* just relay no, encoding (exp.) */
+    ipfix_unknown_field_t   unknown_f;         /* set if unknown elem */
+    mnslp_ipfix_field      *elem;              /* field definition */
+    ipfix_encode_fn         encode;            /* encoder for this field */
+    ipfix_decode_fn         decode[2];         /* decoders, by relay flag */
+    ipfix_column_t          column;            /* kind for the bulk path */
+    uint16_t                offset;            /* offset in a fixed length record */
+} ipfix_field_descriptor_t;
 
 /**
  * \class mnslp_ipfix_template
@@ -104,12 +132,21 @@ class mnslp_ipfix_template
 		int 								maxfields; 		///< Maximum number of fields
 		std::vector<ipfix_template_field_t> datafields;		///< Subset of data fields
 		std::vector<ipfix_template_field_t> scopefields;	///< Subset of scope fields
+		std::vector<ipfix_field_descriptor_t> descriptors;	///< Scope, then data fields
+		bool compiled;										///< descriptors are up to date
+		uint16_t record_length;								///< length of every record, 0 if it varies
+		
+		/**
+		 * Build the descriptors from the scope and data fields.
+		 */
+		void compile();
+		
 	public:
 		
 		/**
 		 * Constructor for the class mnslp_ipfix_template
 		 */
-		inline mnslp_ipfix_template():tsend(0){}
+		inline mnslp_ipfix_template():tsend(0), compiled(false), record_length(0){}
 		
 		/**
 		 * Constructor from the data of another template
@@ -222,7 +259,36 @@ class mnslp_ipfix_template
 		 * The order is scope and then data fields 
 		 * @param i - position of the field to get. 
 		 */
-		ipfix_template_field_t get_field(int i);
+		const ipfix_template_field_t &get_field(int i) const;
+		
+		/**
+		 * Get the descriptors of all fields, scope and then data fields.
+		 * They are compiled on the first call after the field set changed.
+		 */
+		inline const std::vector<ipfix_field_descriptor_t> &get_field_descriptors()
+		{
+			if (!compiled)
+				compile();
+			return descriptors;
+		}
+		
+		/**
+		 * Get the length of the records of this template when every field
+		 * can be coded column by column by the bulk record path, or 0 when
+		 * the records must be coded field by field.
+		 */
+		inline uint16_t get_record_length()
+		{
+			if (!compiled)
+				compile();
+			return record_length;
+		}
+		
+		/**
+		 * Get the descriptor of the field located in the position i
+		 * @param i - position of the field to get. 
+		 */
+		const ipfix_field_descriptor_t &get_field_descriptor(int i);
 		
 		/**
 		 * Remove all fields market with the unknown tag.
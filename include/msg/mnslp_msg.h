@@ -63,7 +63,14 @@ class mnslp_msg : public IE {
 	virtual bool has_msg_sequence_number() const;
 	virtual uint32 get_msg_sequence_number() const;
 
+	/// Header flag: the sending node accepts bundled REFRESH messages.
+	static const uint32 FLAG_REFRESH_BUNDLING = 0x000001;
+
+	uint32 get_flags() const;
+	inline bool has_flag(uint32 flag) const { return (get_flags() & flag) != 0; }
+
 	static uint8 extract_msg_type(uint32 header_raw) throw ();
+	static uint32 extract_flags(uint32 header_raw) throw ();
 
   protected:
 	static const uint16 HEADER_LENGTH;
@@ -79,6 +86,7 @@ class mnslp_msg : public IE {
 	virtual mnslp_object *remove_object(ie_object_key &object_type);
 
 	virtual void set_msg_type(uint8 mt);
+	void set_flags(uint32 flags);
 
 	/**
 	 * Map MNSLP Object Type to mnslp_object.
@@ -94,6 +102,7 @@ class mnslp_msg : public IE {
 	 * MNSLP Message header fields.
 	 */
 	uint8 msg_type;
+	uint32 flags;		///< 24 bits, formerly reserved
 
 };
 
@@ -8,7 +8,10 @@
 #ifndef MNSLP_MSG__MNSLP_OBJECT_H
 #define MNSLP_MSG__MNSLP_OBJECT_H
 
+#include <pthread.h>
+
 #include "ie.h"
+#include "object_fingerprint.h"
 
 
 namespace mnslp {
@@ -70,6 +73,11 @@ class mnslp_object : public IE {
 
 	static uint16 extract_object_type(uint32 header_raw) throw ();
 
+	uint32 get_encoded_size() const throw (IEError);
+	const uchar *get_encoded(uint32 &length) const throw (IEError);
+
+	const object_fingerprint &get_fingerprint() const throw (IEError);
+
   protected:
 	/**
 	 * Length of a MNSLP Object header in bytes.
@@ -84,6 +92,31 @@ class mnslp_object : public IE {
 
 	mnslp_object();
 	mnslp_object(uint16 object_type, treatment_t tr, bool _unique);
+	mnslp_object(const mnslp_object &other);
+
+	mnslp_object &operator=(const mnslp_object &other);
+
+	void invalidate_encoding() const;
+
+	/**
+	 * Holds the lock of the cached wire format and fingerprint while in
+	 * scope. Objects are shared between dispatcher threads, so const
+	 * methods that fill a cache have to take it. It may be taken again
+	 * by the same thread.
+	 */
+	class cache_lock {
+	  public:
+		explicit cache_lock(const mnslp_object *obj);
+		~cache_lock();
+
+	  private:
+		const mnslp_object *obj;
+	};
+
+	friend class cache_lock;
+
+	virtual object_fingerprint compute_fingerprint() const throw (IEError);
+	void set_fingerprint(const object_fingerprint &fp) const;
 
 	virtual bool deserialize_header(NetMsg &msg, uint16 &body_length,
 			IEErrorList &err, bool skip);
@@ -106,6 +139,26 @@ class mnslp_object : public IE {
 	uint16 object_type;
 	bool unique;				///< This value identifies if the object must be unique within the message.
 	treatment_t treatment;
+
+	/**
+	 * Wire format of this object (header, body and padding), built on
+	 * first use and dropped by invalidate_encoding() whenever the object
+	 * changes.
+	 */
+	mutable uchar *encoded;
+	mutable uint32 encoded_length;
+
+	/**
+	 * Hash of the body, cached like the wire format and dropped with it.
+	 */
+	mutable object_fingerprint fingerprint;
+	mutable bool has_fingerprint;
+
+	mutable pthread_mutex_t cache_mutex;	///< Recursive, see cache_lock
+
+	void init_cache_mutex();
+
+	void encode() const throw (IEError);
 };
 
 
@@ -121,6 +174,7 @@ class mnslp_object : public IE {
 #include "selection_metering_entities.h"
 #include "msg_sequence_number.h"
 #include "message_hop_count.h"
+#include "refresh_list.h"
 
 
 
@@ -49,6 +49,9 @@ class mnslp_refresh : public mnslp_msg {
 	void set_msg_sequence_number(uint32 msn);
 	uint32 get_msg_sequence_number() const;
 
+	void set_refresh_list(refresh_list *list);
+	refresh_list *get_refresh_list() const;
+
   protected:
 	uint32 serialize_object(ie_object_key &key, 
 						    NetMsg &msg, 
@@ -146,6 +146,16 @@ class mnslp_response : public mnslp_msg {
 	 */ 
 	void set_ipfix_message(mnslp_ipfix_message *message);
 
+	/**
+	 * Set the list of rejected sessions of a bundled REFRESH
+	 */
+	void set_refresh_list(refresh_list *list);
+
+	/**
+	 * Get the list of rejected sessions, NULL if there is none
+	 */
+	refresh_list *get_refresh_list() const;
+
   protected:
 	uint32 serialize_object(ie_object_key &key, NetMsg &msg, coding_t coding) const;
 
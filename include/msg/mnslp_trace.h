@@ -0,0 +1,159 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file mnslp_trace.h
+/// Structured, opt-in trace channel for the message layer.
+/// ----------------------------------------------------------
+/// $Id: mnslp_trace.h 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./include/msg/mnslp_trace.h $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#ifndef MNSLP_MSG__MNSLP_TRACE_H
+#define MNSLP_MSG__MNSLP_TRACE_H
+
+#include <inttypes.h>
+#include <iostream>
+#include <string>
+
+
+/**
+ * Record a trace event if its component is enabled.
+ *
+ * Arguments are plain integers, nothing is formatted on the hot path. The
+ * cost of a disabled trace point is a load and a bit test.
+ */
+#define MNSLP_TRACE(component, event, a0, a1, a2) \
+	do { \
+		if ( mnslp::msg::trace::is_enabled(component) ) \
+			mnslp::msg::trace::record(component, event, \
+				(int64_t) (a0), (int64_t) (a1), (int64_t) (a2)); \
+	} while ( false )
+
+
+namespace mnslp {
+  namespace msg {
+    namespace trace {
+
+/**
+ * Components that can be traced independently.
+ */
+enum component_t {
+	tc_ipfix		= 0,	///< IPFIX import and export in the message layer
+	tc_events		= 1,	///< event classification
+	tc_session		= 2,	///< session state machines
+	tc_installer	= 3,	///< policy rule installers
+	tc_config		= 4,	///< metering configuration files
+	tc_admission	= 5,	///< admission control
+	tc_max			= 6
+};
+
+/**
+ * Trace points. The meaning of the three arguments is given in brackets;
+ * unused arguments are zero.
+ */
+enum event_t {
+	ev_ipfix_deserialize_body = 0,	///< [body length]
+	ev_ipfix_deserialize_done,		///< [bytes read, body length]
+	ev_ipfix_write_hdr,				///< [buffer offset, records]
+	ev_ipfix_hdr_written,			///< [message size]
+	ev_ipfix_write_template,		///< [template id, fields, scope fields]
+	ev_ipfix_template_field,		///< [template id, field index]
+	ev_ipfix_template_written,		///< [template id, template size]
+	ev_ipfix_output_set,			///< [template id, data length]
+	ev_ipfix_parse_hdr,				///< [version, buffer length]
+	ev_ipfix_decode_template,		///< [set id, length]
+	ev_ipfix_template_decoded,		///< [set id, bytes read]
+	ev_ipfix_decode_datarecord,		///< [template id, buffer length]
+	ev_ipfix_datarecord_decoded,	///< [template id, bytes read]
+	ev_ipfix_import,				///< [message length]
+	ev_ipfix_import_set,			///< [set id, set length, bytes read]
+	ev_ipfix_import_done,			///< [success, bytes read]
+	ev_ipfix_header_differs,		///< [source id, other source id, version]
+	ev_ipfix_fingerprint_differs,	///< [fingerprint high half, other high half]
+	ev_ipfix_output_records,		///< [template id, records]
+	ev_ipfix_decode_records,		///< [template id, records]
+	ev_response_msn,				///< [expected msn, received msn]
+	ev_session_participating,		///< [session type, sme, result]
+	ev_session_process_event,		///< [session state]
+	ev_install,						///< [mspec objects]
+	ev_install_failed,				///< [mspec objects]
+	ev_install_template_missing,	///< [template type]
+	ev_install_command,				///< [stage, response code]
+	ev_install_shared,				///< [references]
+	ev_remove_shared,				///< [references left]
+	ev_update,						///< [unchanged, added, removed]
+	ev_command_compiled,			///< [cached commands, evicted]
+	ev_teardown,					///< [policy rules, tasks, requests]
+	ev_config_loaded,				///< [configuration, applications]
+	ev_config_parse_error,			///< [xml depth]
+	ev_admission_rejected,			///< [verdict, neighbour, sessions]
+	ev_max
+};
+
+/**
+ * Bit mask of enabled components, bit n enables component n.
+ */
+extern volatile uint32_t enabled_mask;
+
+inline bool is_enabled(component_t c) {
+	return ( enabled_mask & (1u << c) ) != 0;
+}
+
+void enable(component_t c);
+
+void disable(component_t c);
+
+void set_mask(uint32_t mask);
+
+/**
+ * Parse a comma separated list of component names, "all" or "none".
+ *
+ * @return the mask for set_mask(); unknown names are ignored.
+ */
+uint32_t parse_components(const std::string &names);
+
+const char *get_component_name(component_t c);
+
+const char *get_event_name(event_t e);
+
+/**
+ * Append a record to the calling thread's ring. When the ring is full,
+ * the oldest record is overwritten.
+ */
+void record(component_t c, event_t e, int64_t a0, int64_t a1, int64_t a2);
+
+/**
+ * Write the records of all threads to os, oldest first per thread.
+ *
+ * Records added while dumping may or may not be included.
+ */
+void dump(std::ostream &os);
+
+/**
+ * Discard all records.
+ */
+void clear();
+
+    } // namespace trace
+  } // namespace msg
+} // namespace mnslp
+
+#endif // MNSLP_MSG__MNSLP_TRACE_H
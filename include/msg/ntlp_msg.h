@@ -7,6 +7,8 @@
 #ifndef MNSLP_MSG__NTLP_MSG_H
 #define MNSLP_MSG__NTLP_MSG_H
 
+#include <pthread.h>
+
 #include "mri.h"	// from NTLP
 
 #include "mnslp_msg.h"
@@ -31,6 +33,11 @@ namespace mnslp {
  *
  * Note: We don't inherit from IE because this message will not be serialized
  * or deserialized (only the MNSLP message will).
+ *
+ * Copies share the MNSLP message and its wire format, which is created at
+ * most once by get_serialized(). Because of this, the MNSLP message must
+ * not be changed once the ntlp_msg has been copied or serialized. Copies
+ * may be serialized by different threads.
  */
 class ntlp_msg {
 
@@ -40,13 +47,22 @@ class ntlp_msg {
 	virtual ~ntlp_msg();
 
 	inline session_id get_session_id() const { return sid; }
-	inline mnslp_msg *get_mnslp_msg() const { return msg; }
+	inline mnslp_msg *get_mnslp_msg() const { return body->msg; }
 	inline ntlp::mri *get_mri() const { return routing_info; }
 	inline uint32 get_sii_handle() const { return sii_handle; }
 
 
 	ntlp_msg *copy() const;
 	ntlp_msg *copy_for_forwarding(ntlp::mri *new_mri=NULL) const;
+	ntlp_msg *copy_for_refresh(uint32 msn, uint32 session_lifetime,
+			ntlp::mri *new_mri, uint32 sii_handle) const;
+
+	const uchar *get_serialized(uint32 &length) const throw (IEError);
+	void set_serialized(const uchar *buffer, uint32 length);
+
+	inline bool is_shared() const { return body->refs > 1; }
+
+	size_t get_memory_usage() const;
 
 	ntlp_msg *create_response(uint8 severity, uint8 response_code) const;
 	ntlp_msg *create_error_response(const request_error &e) const;
@@ -59,15 +75,32 @@ class ntlp_msg {
 	inline mnslp_options *get_mnslp_options() const;
 
   private:
+	/**
+	 * The NTLP body, shared by all copies of a message.
+	 */
+	struct shared_body {
+		mnslp_msg *msg;		///< May be NULL if deserialize() failed
+		uchar *wire;		///< The serialized msg, NULL until needed
+		uint32 wire_length;
+		int refs;
+		pthread_mutex_t lock;	///< Guards wire and wire_length
+	};
+
 	ntlp_msg(const mnslp_msg &other);
 
+	ntlp_msg(const session_id &id, shared_body *body,
+			ntlp::mri *m, uint32 sii_handle);
+
 	session_id sid;
 
 	ntlp::mri *routing_info;
 	uint32 sii_handle;
 
 	// This will be deserialized and used as the NTLP body.
-	mnslp_msg *msg;
+	shared_body *body;
+
+	static bool patch_object(uchar *wire, uint32 length, 
+							 uint16 object_type, uint32 value);
 };
 
 std::ostream &operator<<(std::ostream &out, const ntlp_msg &s);
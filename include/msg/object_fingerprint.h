@@ -0,0 +1,87 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file object_fingerprint.h
+/// Content hash of MNSLP objects.
+/// ----------------------------------------------------------
+/// $Id: object_fingerprint.h 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./include/msg/object_fingerprint.h $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+
+#ifndef MNSLP_MSG__OBJECT_FINGERPRINT_H
+#define MNSLP_MSG__OBJECT_FINGERPRINT_H
+
+#include <stddef.h>
+#include <inttypes.h>
+
+namespace mnslp {
+  namespace msg {
+
+/**
+ * \class object_fingerprint
+ *
+ * \brief 128 bit hash of the canonical content of an object.
+ *
+ * Two objects with the same content have the same fingerprint, so a
+ * different fingerprint is enough to tell them apart. Equal fingerprints
+ * only have to be confirmed by a full comparison to rule out a collision.
+ * The ordering makes the fingerprint usable as a map key.
+ */
+class object_fingerprint
+{
+
+public:
+
+	uint64_t high;		///< First half of the hash
+	uint64_t low;		///< Second half of the hash
+
+	inline object_fingerprint(): high(0), low(0) {}
+
+	inline object_fingerprint(uint64_t _high, uint64_t _low): 
+			high(_high), low(_low) {}
+
+	/**
+	 * Compute the fingerprint of len bytes starting at data.
+	 */
+	static object_fingerprint compute(const void *data, size_t len);
+
+	inline bool operator==(const object_fingerprint &rhs) const
+	{
+		return (high == rhs.high) && (low == rhs.low);
+	}
+
+	inline bool operator!=(const object_fingerprint &rhs) const
+	{
+		return !(operator==(rhs));
+	}
+
+	inline bool operator<(const object_fingerprint &rhs) const
+	{
+		return (high < rhs.high) || ((high == rhs.high) && (low < rhs.low));
+	}
+
+};
+
+  } // namespace msg
+} // namespace mnslp
+
+#endif // MNSLP_MSG__OBJECT_FINGERPRINT_H
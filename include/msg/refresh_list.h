@@ -0,0 +1,99 @@
+/*
+ * The Refresh List Object.
+ *
+ * $Id: refresh_list.h 2558 2015-03-10 $
+ * $HeadURL: https://./include/msg/refresh_list.h $
+ */
+#ifndef MNSLP_MSG__REFRESH_LIST_H
+#define MNSLP_MSG__REFRESH_LIST_H
+
+#include <vector>
+
+#include "protlib_types.h"
+#include "mnslp_object.h"
+
+
+namespace mnslp {
+ namespace msg {
+
+    using namespace protlib;
+
+
+/**
+ * \class refresh_list
+ *
+ * \brief A list of (session ID, MSN, session lifetime) tuples.
+ *
+ * In a REFRESH, the list names further sessions that are refreshed by the
+ * same message. This way, a single message refreshes many sessions that
+ * share the next hop. In a RESPONSE, it names the sessions from a bundled
+ * REFRESH that the peer rejected, usually because it has no state for
+ * them (anymore).
+ *
+ * Each entry takes 24 bytes. Because the object length is limited to 4095
+ * words, a list holds at most MAX_ENTRIES entries.
+ */
+class refresh_list : public mnslp_object {
+
+  public:
+	static const uint16 OBJECT_TYPE = 0x00FA;
+
+	static const size_t MAX_ENTRIES = 512;
+
+	struct entry {
+		uint128 session;
+		uint32 msn;
+		uint32 lifetime;
+
+		entry() : session(0, 0, 0, 0), msn(0), lifetime(0) { }
+		entry(const uint128 &s, uint32 m, uint32 l)
+			: session(s), msn(m), lifetime(l) { }
+	};
+
+	typedef std::vector<entry>::const_iterator const_iterator;
+
+	explicit refresh_list(treatment_t t = tr_mandatory, bool _unique = true);
+
+	virtual ~refresh_list();
+
+	virtual refresh_list *new_instance() const;
+	virtual refresh_list *copy() const;
+
+	virtual size_t get_serialized_size(coding_t coding) const;
+	virtual bool check_body() const;
+	virtual bool equals_body(const mnslp_object &other) const;
+	virtual const char *get_ie_name() const;
+	virtual ostream &print_attributes(ostream &os) const;
+
+	virtual bool deserialize_body(NetMsg &msg, uint16 body_length,
+			IEErrorList &err, bool skip);
+
+	virtual void serialize_body(NetMsg &msg) const;
+
+	/*
+	 * New methods
+	 */
+	bool add(const uint128 &session, uint32 msn, uint32 lifetime);
+
+	inline size_t size() const { return entries.size(); }
+	inline bool is_full() const { return entries.size() >= MAX_ENTRIES; }
+
+	inline const_iterator begin() const { return entries.begin(); }
+	inline const_iterator end() const { return entries.end(); }
+
+  private:
+	// Disallow assignment for now.
+	refresh_list &operator=(const refresh_list &other);
+
+	static const char *const ie_name;
+
+	static const uint16 ENTRY_LENGTH = 24;
+
+	std::vector<entry> entries;
+};
+
+
+ } // namespace msg
+} // namespace mnslp
+
+#endif // MNSLP_MSG__REFRESH_LIST_H
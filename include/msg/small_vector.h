@@ -0,0 +1,188 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file small_vector.h
+/// Vector with inline storage for a small number of elements.
+/// ----------------------------------------------------------
+/// $Id: small_vector.h 2558 2015-03-10 $
+/// $HeadURL: https://./include/msg/small_vector.h $
+// ===========================================================
+//
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+
+#ifndef PROTLIB__SMALL_VECTOR_H
+#define PROTLIB__SMALL_VECTOR_H
+
+#include <cstddef>
+
+namespace protlib
+{
+
+/**
+ * \class small_vector
+ *
+ * \brief Contiguous container that keeps up to N elements inline.
+ *
+ * The first N elements live inside the object itself, so containers that
+ * stay small never touch the allocator. Past N elements the contents are
+ * moved to a heap block that grows geometrically.
+ *
+ * T must be default constructible and assignable. Iterators are plain
+ * pointers and are invalidated by insert() and erase().
+ */
+template <typename T, size_t N>
+class small_vector
+{
+
+public:
+
+	typedef T value_type;
+	typedef T *iterator;
+	typedef const T *const_iterator;
+
+	inline small_vector():
+			data(inline_data), count(0), capacity(N) {}
+
+	inline small_vector(const small_vector &other):
+			data(inline_data), count(0), capacity(N)
+	{
+		assign(other);
+	}
+
+	inline ~small_vector()
+	{
+		release();
+	}
+
+	inline small_vector &operator=(const small_vector &other)
+	{
+		if ( this != &other ){
+			count = 0;
+			assign(other);
+		}
+		return *this;
+	}
+
+	inline size_t size() const { return count; }
+
+	inline bool empty() const { return count == 0; }
+
+	/// Returns true while the elements are still held in the inline buffer.
+	inline bool is_inline() const { return data == inline_data; }
+
+	inline iterator begin() { return data; }
+	inline iterator end() { return data + count; }
+	inline const_iterator begin() const { return data; }
+	inline const_iterator end() const { return data + count; }
+
+	inline T &operator[](size_t i) { return data[i]; }
+	inline const T &operator[](size_t i) const { return data[i]; }
+
+	/**
+	 * Insert a copy of value before pos.
+	 *
+	 * @return an iterator pointing to the inserted element.
+	 */
+	iterator insert(iterator pos, const T &value)
+	{
+		size_t index = pos - data;
+
+		if ( count == capacity )
+			reserve(capacity * 2);
+
+		for ( size_t i = count; i > index; i-- )
+			data[i] = data[i - 1];
+
+		data[index] = value;
+		count++;
+		return data + index;
+	}
+
+	/**
+	 * Remove the element at pos.
+	 *
+	 * @return an iterator pointing to the element after the removed one.
+	 */
+	iterator erase(iterator pos)
+	{
+		size_t index = pos - data;
+
+		for ( size_t i = index + 1; i < count; i++ )
+			data[i - 1] = data[i];
+
+		count--;
+		data[count] = T();
+		return data + index;
+	}
+
+	inline void push_back(const T &value)
+	{
+		insert(end(), value);
+	}
+
+	/// Remove all elements, keeping the current storage.
+	inline void clear()
+	{
+		for ( size_t i = 0; i < count; i++ )
+			data[i] = T();
+		count = 0;
+	}
+
+	void reserve(size_t new_capacity)
+	{
+		if ( new_capacity <= capacity )
+			return;
+
+		T *new_data = new T[new_capacity];
+		for ( size_t i = 0; i < count; i++ )
+			new_data[i] = data[i];
+
+		release();
+		data = new_data;
+		capacity = new_capacity;
+	}
+
+private:
+
+	T inline_data[N];		///< Storage used while size() <= N.
+	T *data;				///< Either inline_data or a heap block.
+	size_t count;			///< Number of elements in use.
+	size_t capacity;		///< Number of elements data can hold.
+
+	/// Copy the elements of other, which must be a different container.
+	void assign(const small_vector &other)
+	{
+		reserve(other.count);
+		for ( size_t i = 0; i < other.count; i++ )
+			data[i] = other.data[i];
+		count = other.count;
+	}
+
+	inline void release()
+	{
+		if ( data != inline_data )
+			delete [] data;
+	}
+
+};
+
+} // namespace protlib
+
+#endif // PROTLIB__SMALL_VECTOR_H
@@ -95,6 +95,13 @@ public:
 	 * Return the key represented as string. 
 	 */
 	std::string to_string() const;
+
+	/**
+	 * Set the key from its string representation, as returned by
+	 * to_string(). Returns false and leaves the key unchanged if the
+	 * string is not a valid key.
+	 */
+	bool from_string(const std::string &str);
 	
 	/** 
 	 * Not equal to operator. 
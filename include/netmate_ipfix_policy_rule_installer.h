@@ -30,8 +30,13 @@
 #define MNSLP__NETMATE_IPFIX_POLICY_RULE_INSTALLER_H
 
 
+#include <pthread.h>
+#include <list>
+#include <set>
+
 #include "session.h"
 #include "msg/mnslp_mspec_object.h"
+#include "msg/object_fingerprint.h"
 #include "mnslp_config.h"
 #include "msg/mnslp_ipfix_message.h"
 #include "msg/mnslp_ipfix_template.h"
@@ -49,9 +54,16 @@ namespace mnslp {
  * This implementation is Linux-specific and uses the netmate library to
  * install and remove policy rules.
  *
- * This class is currently stateless, so no locking is required. Library calls
- * are done using the HTTP-enabled API interface, so multithreaded calls to the
- * library are safe.
+ * Sessions asking for the same filter and export command share one task in
+ * the metering application. The installer keeps a reference count for each
+ * task, protected by a mutex, and only removes the task with the last
+ * reference. Library calls are done using the HTTP-enabled API interface,
+ * so multithreaded calls to the library are safe.
+ *
+ * Building the command for a metering object means formatting every filter
+ * value and looking up the translation of every field. The result, without
+ * the rule key, is kept in a least recently used cache by the fingerprint
+ * of the object, so installing the same object again only inserts the key.
  */
 class netmate_ipfix_policy_rule_installer : public policy_rule_installer 
 {
@@ -87,6 +99,26 @@ class netmate_ipfix_policy_rule_installer : public policy_rule_installer
 
 	virtual bool remove_all();
 
+	/**
+	 * Take a reference to each task of the rule, so tasks shared by
+	 * restored sessions are removed with the last of them.
+	 */
+	virtual void adopt(const mt_policy_rule *rule);
+
+	/**
+	 * Forget the adopted tasks the metering application doesn't have
+	 * anymore, so no new session shares them. If the tasks can't be
+	 * listed, none of the adopted tasks is shared.
+	 */
+	virtual void reconcile();
+
+	/**
+	 * Remove the tasks of many policy rules with one rm_task request for
+	 * up to MAX_TASKS_PER_REQUEST tasks. If the metering application 
+	 * rejects the list, each task is removed with a request of its own.
+	 */
+	virtual void remove_bulk(const std::vector<const mt_policy_rule *> &rules);
+
 
   protected:
 
@@ -96,11 +128,34 @@ class netmate_ipfix_policy_rule_installer : public policy_rule_installer
     
     msg::mnslp_ipfix_template * get_export_template(const msg::mnslp_ipfix_message *mess) const;
     
-    std::map<std::string, std::string> 
-    build_command_export_fields( const mspec_rule_key &key, 
-	 							 const msg::mnslp_ipfix_message *mess, 
-								 msg::mnslp_ipfix_template *templ,
-								 std::string filter_def) const;
+	/**
+	 * The commands for a metering object, less the rule key. Each export
+	 * target gets a command running its packages over the filter.
+	 */
+	struct compiled_command
+	{
+		/// Packages by export target.
+		typedef std::map<std::string, std::string> exports_t;
+
+		std::string filter;		///< Filter definition, may be empty
+		exports_t exports;		///< File targets get the rule key appended
+	};
+
+	static const size_t DEFAULT_COMMAND_CACHE_SIZE = 256;
+
+	void set_command_cache_size(size_t size);
+
+	size_t get_number_cached_commands() const;
+
+	compiled_command compile_command(const msg::mnslp_ipfix_message *mess) const;
+
+	std::map<std::string, std::string> 
+	build_commands(const mspec_rule_key &key, 
+				   const compiled_command &compiled) const;
+
+	void build_command_export_fields(const msg::mnslp_ipfix_message *mess, 
+									 msg::mnslp_ipfix_template *templ,
+									 compiled_command &compiled) const;
 
 	std::string build_command_filter_fields(const msg::mnslp_ipfix_message *mess, 
 									msg::mnslp_ipfix_template *templ) const;
@@ -116,7 +171,83 @@ class netmate_ipfix_policy_rule_installer : public policy_rule_installer
 	create_postfield_command(const mspec_rule_key &key, 
 							 const msg::mnslp_ipfix_message *mess) const throw ();
 			
-	bool execute_command(std::string action, std::string post_fields);
+	virtual bool execute_command(std::string action, std::string post_fields);
+
+	/**
+	 * Send a command to the metering application. Throws if it can't be
+	 * reached or doesn't accept the command.
+	 */
+	bool send_command(std::string action, std::string post_fields,
+					  std::string &reply);
+
+	/**
+	 * Throw if the reply of the metering application to a command isn't
+	 * a success.
+	 */
+	static void check_reply(const std::string &action, unsigned long rcode,
+							const std::string &reply);
+
+	/**
+	 * Ask the metering application for the names of the tasks in our
+	 * rule group.
+	 */
+	virtual void list_tasks(std::set<std::string> &names)
+			throw (policy_rule_installer_error);
+
+	/**
+	 * Collect the names of the tasks in our rule group from a get_info
+	 * reply, which lists each task as <rule group>.<name>.
+	 */
+	static void parse_task_list(const std::string &reply,
+								std::set<std::string> &names);
+
+	/**
+	 * Hash of a command with the key of the rule and the domain ID derived
+	 * from it left out, so identical requests from different sessions get
+	 * the same fingerprint.
+	 */
+	msg::object_fingerprint command_fingerprint(const mspec_rule_key &key,
+												const std::string &command) const;
+
+	/**
+	 * The Observation Domain ID a task exports its results with. It is
+	 * derived from the task name, so it is the same after a restart.
+	 */
+	static uint32 task_domain(const std::string &name);
+
+	/**
+	 * Tie a rule to the domain ID of a task on the collector, if the task
+	 * exports its results there.
+	 */
+	void bind_task(const mspec_rule_key &key, const std::string &name,
+				   const std::string &command);
+
+	/**
+	 * Take a reference to the task installed for a command, if any, and 
+	 * return its rule name in name.
+	 */
+	bool acquire_task(const msg::object_fingerprint &fp, std::string &name);
+
+	/**
+	 * Record a task just installed for a command, with one reference.
+	 */
+	void register_task(const msg::object_fingerprint &fp, const std::string &name);
+
+	/**
+	 * Drop a reference to a task. Returns true if the task has to be removed
+	 * from the metering application, which is the case for the last 
+	 * reference and for tasks the installer does not know. The last
+	 * reference is kept, but no longer shared, until finish_release()
+	 * reports the outcome of the removal.
+	 */
+	bool release_task(const std::string &name);
+
+	/**
+	 * Forget a task after rm_task succeeded. If the metering application
+	 * still has it, keep it without references, so the next session that
+	 * shares it also removes it.
+	 */
+	void finish_release(const std::string &name, bool removed);
 	
 	/**
 	 * This function verifies that all options fields included in the option template
@@ -149,6 +280,48 @@ class netmate_ipfix_policy_rule_installer : public policy_rule_installer
 	std::string getErr(char *e);
 	
 	static std::string rule_group; 
+
+	static const size_t MAX_TASKS_PER_REQUEST = 64;
+
+  private:
+
+	/**
+	 * A task installed in the metering application.
+	 */
+	struct installed_task
+	{
+		msg::object_fingerprint fingerprint;	///< Of the command that created it
+		int refs;								///< Sessions using the task
+	};
+
+	/// Installed tasks by rule name.
+	std::map<std::string, installed_task> installed_tasks;
+
+	/// Rule name of the task to share for each command fingerprint.
+	std::map<msg::object_fingerprint, std::string> shared_tasks;
+
+	pthread_mutex_t tasks_mutex;
+
+	typedef std::list< std::pair<msg::object_fingerprint, compiled_command> > 
+			command_lru_t;
+
+	/// Compiled commands, the most recently used first.
+	mutable command_lru_t command_lru;
+
+	/// Position in command_lru by object fingerprint.
+	mutable std::map<msg::object_fingerprint, command_lru_t::iterator> command_index;
+
+	size_t command_cache_size;
+
+	mutable pthread_mutex_t command_mutex;
+	
+	bool find_command(const msg::object_fingerprint &fp, 
+					  compiled_command &compiled) const;
+
+	void cache_command(const msg::object_fingerprint &fp, 
+					   const compiled_command &compiled) const;
+
+	void clear_command_cache();
 	
 };
 
@@ -59,6 +59,15 @@ class nf_session : public session {
 
 	bool is_final() const; // inherited from session
 
+	static void *operator new(size_t size) { return slab.allocate(size); }
+	static void operator delete(void *p, size_t size) {
+		slab.deallocate(p, size);
+	}
+
+	static const session_slab &get_slab() { return slab; }
+
+	void restore(dispatcher *d, session_snapshot &snap); // inherited
+
   protected:
 	/**
 	 * States of a session.
@@ -72,6 +81,8 @@ class nf_session : public session {
 	nf_session(state_t s, const mnslp_config *conf);
 
 	void process_event(dispatcher *d, event *evt);
+
+	bool save(session_snapshot &snap) const; // inherited from session
 	
 	state_t get_state() const { return state; }
 
@@ -111,28 +122,37 @@ class nf_session : public session {
 	void set_nr_mri(ntlp::mri_pathcoupled *m);
 
 
+	void count_memory(session_memory_usage &usage) const; // inherited
+
   private:
-  
+	/*
+	 * Fields used by every event come first, so they share the cache
+	 * lines of the session header. The rest is only needed when a
+	 * message has to be built and is kept out of line.
+	 */
 	state_t state;
 
-	const mnslp_config *config;	// shared among sessions, don't delete!
-
-	bool proxy_mode;
-	
 	uint32 lifetime;
 	
 	uint32 max_lifetime;
 	
 	uint32 response_timeout;
+
+	bool proxy_mode;
 	
 	timer state_timer;
 	
 	timer response_timer;
 
+	const mnslp_config *config;	// shared among sessions, don't delete!
+
 	ntlp::mri_pathcoupled *ni_mri;	// the MRI to use for reaching the NI
 	ntlp::mri_pathcoupled *nr_mri;	// the MRI to use for reaching the NR
 	msg::ntlp_msg *configure_message;
 	msg::ntlp_msg *refresh_message;
+	mt_policy_rule *requested_rule;	// waiting for the downstream peer
+
+	static session_slab slab;
 
 	state_t process_state_close(dispatcher *d, event *evt);
 	state_t handle_state_close(dispatcher *d, event *evt);
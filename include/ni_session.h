@@ -70,6 +70,13 @@ class ni_session : public session {
 
 	bool is_final() const; // inherited from session
 
+	static void *operator new(size_t size) { return slab.allocate(size); }
+	static void operator delete(void *p, size_t size) {
+		slab.deallocate(p, size);
+	}
+
+	static const session_slab &get_slab() { return slab; }
+
   protected:
 	/**
 	 * States of a session.
@@ -100,7 +107,7 @@ class ni_session : public session {
 
 	inline uint32 get_refresh_interval() const { return refresh_interval; }
 	inline void set_refresh_interval(uint32 sec) { refresh_interval = sec; }
-	inline void cal_refresh_interval() { refresh_interval = (uint32) lifetime * 2/3; }
+	void cal_refresh_interval();
 
 	inline uint32 get_lifetime() const { return lifetime; }
 	inline void set_lifetime(uint32 seconds) { lifetime = seconds; }
@@ -124,26 +131,16 @@ class ni_session : public session {
 	inline timer &get_refresh_timer() { return refresh_timer; }
 
 
-  private:
-	state_t state;
-
-	ntlp::mri *routing_info;
+	void count_memory(session_memory_usage &usage) const; // inherited
 
+  private:
 	/*
-	 * The latest CONFIGURE message we sent. We keep it because we need it for
-	 * retransmission and to check if a received RESPONSE matches the
-	 * CONFIGURE sent earlier.
+	 * Fields used by every event come first, so they share the cache
+	 * lines of the session header. The MRI and the saved messages are
+	 * kept out of line.
 	 */
-	msg::ntlp_msg *last_configure_msg;
+	state_t state;
 
-	/*
-	 * The latest REFRESH message we sent. We keep it because we need it for
-	 * retransmission and to check if a received RESPONSE matches the
-	 * REFRESH sent earlier.
-	 */
-	msg::ntlp_msg *last_refresh_msg;
-	
-	bool proxy_mode;
 	uint32 lifetime;
 	uint32 refresh_interval;
 	uint32 response_timeout;
@@ -151,6 +148,7 @@ class ni_session : public session {
 	uint32 refresh_counter; 
 	uint32 max_retries;
 
+	bool proxy_mode;
 	bool proxy_session;
 
 	/*
@@ -160,6 +158,24 @@ class ni_session : public session {
 	timer response_timer;
 	timer refresh_timer;
 
+	ntlp::mri *routing_info;
+
+	/*
+	 * The latest CONFIGURE message we sent. We keep it because we need it for
+	 * retransmission and to check if a received RESPONSE matches the
+	 * CONFIGURE sent earlier.
+	 */
+	msg::ntlp_msg *last_configure_msg;
+
+	/*
+	 * The latest REFRESH message we sent. We keep it because we need it for
+	 * retransmission and to check if a received RESPONSE matches the
+	 * REFRESH sent earlier.
+	 */
+	msg::ntlp_msg *last_refresh_msg;
+
+	static session_slab slab;
+
 	/*
 	 * State machine methods:
 	 */
@@ -58,6 +58,15 @@ class nr_session : public session {
 
 	bool is_final() const; // inherited from session
 
+	static void *operator new(size_t size) { return slab.allocate(size); }
+	static void operator delete(void *p, size_t size) {
+		slab.deallocate(p, size);
+	}
+
+	static const session_slab &get_slab() { return slab; }
+
+	void restore(dispatcher *d, session_snapshot &snap); // inherited
+
   protected:
 	/**
 	 * States of a session.
@@ -69,6 +78,8 @@ class nr_session : public session {
 	};
 
 	void process_event(dispatcher *d, event *evt);
+
+	bool save(session_snapshot &snap) const; // inherited from session
 	
 	state_t get_state() const;
 
@@ -81,17 +92,19 @@ class nr_session : public session {
 	void set_mt_policy_rule(mt_policy_rule *r);	
 
   private:
-  
+	/*
+	 * Fields used by every event come first, so they share the cache
+	 * lines of the session header. The policy rule is the inherited one.
+	 */
 	state_t state;
 
-	mnslp_config *config;		// shared among instances, don't delete!
-
 	uint32 lifetime;
 	uint32 max_lifetime;
 	timer state_timer;
-	
-	mt_policy_rule *mt_rule;
 
+	mnslp_config *config;		// shared among instances, don't delete!
+
+	static session_slab slab;
 
 	/*
 	 * State machine methods:
@@ -142,12 +155,12 @@ inline bool nr_session::is_final() const
 
 
 inline void nr_session::set_mt_policy_rule(mt_policy_rule *r) {
-	delete mt_rule;
-	mt_rule = r;
+	delete rule;
+	rule = r;
 }
 
 inline mt_policy_rule *nr_session::get_mt_policy_rule() const {
-	return mt_rule; // may return NULL!
+	return rule; // may return NULL!
 }
 
 
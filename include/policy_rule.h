@@ -107,6 +107,12 @@ class mt_policy_rule {
 	
 	const_iterator_commands begin_commands() const throw() { return rule_keys.begin(); }
 	const_iterator_commands end_commands() const throw() { return rule_keys.end(); }
+
+	const_iterator find(const mspec_rule_key &key) const { return objects.find(key); }
+	const_iterator_commands find_commands(const mspec_rule_key &key) const 
+	{ 
+		return rule_keys.find(key); 
+	}
 	
 	bool operator==(const mt_policy_rule &rhs);
 	
@@ -116,6 +122,8 @@ class mt_policy_rule {
 	
 	void clear_commands();
 
+	size_t get_memory_usage() const;
+
   protected:
 	
 	/// Map for all mspec objects belonging to the rule to be used in the 
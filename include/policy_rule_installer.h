@@ -30,6 +30,9 @@
 #define MNSLP__POLICY_RULE_INSTALLER_H
 
 
+#include <pthread.h>
+#include <vector>
+
 #include "session.h"
 #include "mnslp_config.h"
 
@@ -40,6 +43,8 @@
 
 namespace mnslp {
 
+class ipfix_collector;
+
 /**
  * An exception to be thrown if the policy_rule_installer failed.
  */
@@ -69,13 +74,17 @@ inline std::ostream &operator<<(
  * be removed using remove().
  *
  * Subclasses have to implement locking if necessary.
+ *
+ * Rules of sessions that go away can be handed to schedule_remove(). They
+ * are then removed in batches by a teardown thread, which is started with
+ * start_teardown() and has to be stopped with stop_teardown() before the
+ * installer is deleted.
  */
 class policy_rule_installer {
 
   public:
   
-	policy_rule_installer(mnslp_config *conf) throw () : 
-		config(conf), action_container(NULL), app_container(NULL) { }
+	policy_rule_installer(mnslp_config *conf) throw ();
 	
 	virtual ~policy_rule_installer() throw ();
 
@@ -112,8 +121,81 @@ class policy_rule_installer {
 	 */
 	virtual mt_policy_rule * remove(const mt_policy_rule * mt_object) = 0;
 
+	/**
+	 * Change an installed policy rule into the requested one.
+	 *
+	 * Objects of the requested rule are matched against the installed ones
+	 * by key and then by content fingerprint. Matching objects are left 
+	 * untouched and keep their installed key and commands, installed objects
+	 * without a match are removed and requested objects without a match are
+	 * installed. 
+	 *
+	 * Returns the rule now in effect, with its commands. Requested objects
+	 * that could not be installed are missing from it.
+	 */
+	virtual mt_policy_rule * update(const mt_policy_rule *installed,
+									const mt_policy_rule *requested);
+
 	virtual bool remove_all() = 0;
 
+	/**
+	 * Take over a policy rule installed before the daemon was restarted.
+	 *
+	 * The rule is one returned by install(), with its commands. It is
+	 * still in effect, so the metering application is not contacted.
+	 * Subclasses which keep track of installed rules have to update their
+	 * bookkeeping. The default does nothing.
+	 */
+	virtual void adopt(const mt_policy_rule *rule);
+
+	/**
+	 * Check the rules taken over by adopt() against the metering
+	 * application, which may have lost some of them while the daemon was
+	 * down. Called once after all rules were adopted. The default does
+	 * nothing.
+	 */
+	virtual void reconcile();
+
+	/**
+	 * Remove many policy rules at once.
+	 *
+	 * Subclasses may group the removals into fewer requests to the
+	 * metering application. The default removes the rules one by one.
+	 */
+	virtual void remove_bulk(const std::vector<const mt_policy_rule *> &rules);
+
+	/**
+	 * Queue a policy rule for removal and take ownership of it.
+	 *
+	 * The teardown thread removes queued rules with remove_bulk(). If it
+	 * is not running, the rule is removed right away.
+	 */
+	void schedule_remove(mt_policy_rule *mt_object);
+
+	void start_teardown();
+
+	/**
+	 * Stop the teardown thread after it removed all queued rules.
+	 */
+	void stop_teardown();
+
+	/**
+	 * Return the number of queued rules the teardown thread hasn't
+	 * removed yet, including those it is removing right now.
+	 */
+	size_t get_teardown_backlog();
+
+	/// Upper limit for the rules passed to one remove_bulk() call.
+	static const size_t TEARDOWN_BATCH_SIZE = 256;
+
+	/**
+	 * Send the results of installed rules to a collector and tie them to
+	 * the rules there. Has to be set before the first rule is installed.
+	 */
+	inline void set_collector(ipfix_collector *c) { collector = c; }
+
+	inline ipfix_collector *get_collector() const { return collector; }
+
 			
 	const policy_action_container * get_action_container() const;	
 	
@@ -140,9 +222,24 @@ class policy_rule_installer {
   private:
   
 	mnslp_config *config;
+	ipfix_collector *collector;		///< NULL if results aren't collected
 	policy_action_container * action_container;
 	policy_application_configuration_container * app_container;
 
+	/// Rules waiting for the teardown thread.
+	std::vector<mt_policy_rule *> teardown_queue;
+	bool teardown_running;
+	size_t teardown_pending;
+	pthread_t teardown_thread;
+	pthread_mutex_t teardown_mutex;
+	pthread_cond_t teardown_cond;
+
+	static void *teardown_main(void *installer);
+
+	void teardown_loop();
+
+	void remove_batches(std::vector<mt_policy_rule *> &rules);
+
 	/**
 	* parse_export_definition_file:
 	* @filename: the file name to parse
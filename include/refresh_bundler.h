@@ -0,0 +1,83 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file refresh_bundler.h
+/// Bundling of REFRESH messages sent to the same peer.
+/// ----------------------------------------------------------
+/// $Id: refresh_bundler.h 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./include/refresh_bundler.h $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#ifndef MNSLP__REFRESH_BUNDLER_H
+#define MNSLP__REFRESH_BUNDLER_H
+
+#include <pthread.h>
+#include <set>
+#include <vector>
+
+#include "protlib_types.h"
+#include "msg/ntlp_msg.h"
+
+
+namespace mnslp {
+    using protlib::uint32;
+
+
+/**
+ * Bundles the REFRESH messages of sessions that share the next hop.
+ *
+ * Peers which accept bundled REFRESH messages set FLAG_REFRESH_BUNDLING
+ * in the header of every message they send. The bundler learns the SII
+ * handles of these peers from the received messages; refreshes for other
+ * peers are always sent one by one.
+ *
+ * One bundler is shared by all dispatchers. The refreshes waiting to be
+ * bundled are kept by each dispatcher, so only the peer table is locked.
+ */
+class refresh_bundler {
+
+  public:
+	refresh_bundler(bool enabled=true);
+	~refresh_bundler();
+
+	inline bool is_enabled() const { return enabled; }
+
+	void learn(uint32 sii_handle, const msg::mnslp_msg *msg);
+	bool is_capable(uint32 sii_handle) const;
+
+	static void bundle(const std::vector<msg::ntlp_msg *> &refreshes,
+			uint32 peer, std::vector<msg::ntlp_msg *> &out);
+
+  private:
+	bool enabled;
+
+	std::set<uint32> peers;
+	mutable pthread_rwlock_t lock;
+
+	// Not implemented, the bundler is shared by reference.
+	refresh_bundler(const refresh_bundler &);
+	refresh_bundler &operator=(const refresh_bundler &);
+};
+
+
+} // namespace mnslp
+
+#endif // MNSLP__REFRESH_BUNDLER_H
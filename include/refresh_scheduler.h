@@ -0,0 +1,96 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file refresh_scheduler.h
+/// Jittered and load-aware scheduling of NI refreshes.
+/// ----------------------------------------------------------
+/// $Id: refresh_scheduler.h 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./include/refresh_scheduler.h $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#ifndef MNSLP__REFRESH_SCHEDULER_H
+#define MNSLP__REFRESH_SCHEDULER_H
+
+#include <pthread.h>
+#include <ctime>
+#include <vector>
+
+#include "protlib_types.h"
+
+
+namespace mnslp {
+    using protlib::uint32;
+
+
+/**
+ * Picks the delay until the next REFRESH of an NI session.
+ *
+ * A session with refresh interval R refreshes after a delay drawn
+ * uniformly from [R/2, 3R/2], so sessions created in a burst drift apart
+ * instead of refreshing in lockstep. The NI derives R from the session
+ * lifetime such that even the longest delay leaves room for all retries.
+ *
+ * In load-aware mode the delay is the one with the fewest refreshes
+ * already due within the same window, which spreads the refreshes of
+ * all sessions evenly over time. Random numbers come from a per-thread
+ * generator, so the scheduler may be shared by all dispatcher threads.
+ */
+class refresh_scheduler {
+
+  public:
+	refresh_scheduler(bool load_aware=false);
+	~refresh_scheduler();
+
+	inline bool is_load_aware() const { return load_aware; }
+
+	uint32 next_refresh(uint32 interval);
+	uint32 next_refresh(uint32 interval, time_t now);
+
+	static uint32 jitter(uint32 interval);
+	static uint32 random();
+
+  private:
+	bool load_aware;
+
+	pthread_mutex_t mutex;
+
+	/// Number of refreshes due per second, a ring starting at slots[head].
+	std::vector<uint32> slots;
+	size_t head;
+
+	/// The time slots[head] refers to.
+	time_t base;
+
+	void advance(time_t now);
+	void grow(size_t min_size);
+
+	// Large enough for the default session lifetimes.
+	static const size_t INITIAL_SLOTS = 256;
+
+	// Not implemented, the scheduler is shared by reference.
+	refresh_scheduler(const refresh_scheduler &);
+	refresh_scheduler &operator=(const refresh_scheduler &);
+};
+
+
+} // namespace mnslp
+
+#endif // MNSLP__REFRESH_SCHEDULER_H
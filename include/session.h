@@ -33,9 +33,15 @@
 #include "session_id.h"
 #include "address.h"
 #include "policy_rule.h"
+#include "session_slab.h"
+#include "session_mailbox.h"
 #include <vector>
 
 
+namespace ntlp {
+	class mri_pathcoupled;
+}
+
 namespace mnslp {
     using protlib::uint8;
     using protlib::uint32;
@@ -108,11 +114,73 @@ inline std::ostream &operator<<(std::ostream &os, const request_error &err) {
 	return os << err.get_msg();
 }
 
+
+/**
+ * The state of a session that survives a restart of the daemon.
+ *
+ * Filled in by session::snapshot() and kept in the checkpoint log. The
+ * snapshot owns the MRIs and the policy rule until a session takes them
+ * over in restore().
+ */
+struct session_snapshot {
+	session_snapshot();
+	~session_snapshot();
+
+	session_id id;
+	uint8 type;				///< A session::session_type_t
+	uint8 state;			///< Subclass specific
+	uint32 msn;
+	uint32 lifetime;
+	uint32 expires;			///< When the state timer fires, seconds since the epoch
+	uint32 upstream_peer;
+	uint32 downstream_peer;
+	ntlp::mri_pathcoupled *ni_mri;		///< may be NULL
+	ntlp::mri_pathcoupled *nr_mri;		///< may be NULL
+	mt_policy_rule *rule;				///< may be NULL
+
+  private:
+	// Not copyable, the pointers are owned.
+	session_snapshot(const session_snapshot &);
+	session_snapshot &operator=(const session_snapshot &);
+};
+
+
+/**
+ * The memory used by the sessions of one role.
+ *
+ * The session objects are taken from the role's slab. What they point
+ * to is estimated, mostly from serialized sizes; a message body shared
+ * by several messages is split evenly among them.
+ */
+struct session_memory_usage {
+	session_memory_usage();
+
+	size_t get_total_bytes() const;
+
+	size_t sessions;
+	size_t object_bytes;		///< Slab slots in use
+	size_t reserved_bytes;		///< Slab memory, including free slots
+	size_t message_bytes;		///< Saved messages
+	size_t mri_bytes;			///< MRIs not belonging to a message
+	size_t rule_bytes;			///< Metering policy rules
+};
+
+std::ostream &operator<<(std::ostream &out, const session_memory_usage &u);
+
+
 /**
  * The abstract session class.
  *
  * Only three subclasses will exist, one for initiator, forwarder, and
  * receiver, respectively.
+ *
+ * A session isn't locked. Instead, events are handed to it through its
+ * mailbox, and only the thread that claimed the mailbox may call
+ * process() and the other methods that read or change its state.
+ *
+ * Sessions are reference counted. Whoever gets a session from the
+ * session manager holds a reference and has to release() it; the last
+ * release() deletes the session.
  */
 class session {
 
@@ -127,6 +195,23 @@ class session {
 
 	virtual void process(dispatcher *d, event *evt);
 
+	inline session_mailbox &get_mailbox() { return mailbox; }
+
+	void acquire();
+	void release();
+
+	bool snapshot(session_snapshot &snap);
+
+	/**
+	 * Take over the state of a session saved before a restart.
+	 *
+	 * The MRIs and the policy rule are moved out of the snapshot, and the
+	 * timers are started for the time that was left when it was taken.
+	 */
+	virtual void restore(dispatcher *d, session_snapshot &snap);
+
+	void get_memory_usage(session_memory_usage &usage);
+
 	inline session_id get_id() const { return id; }
 	
 	inline session_type_t get_session_type() const { return type; }
@@ -143,6 +228,14 @@ class session {
 	
 	uint32 next_msg_sequence_number();
 
+	/// SII handle of the peer towards the NI, 0 if not known yet.
+	inline uint32 get_upstream_peer() const { return upstream_peer; }
+	inline void set_upstream_peer(uint32 sii) { upstream_peer = sii; }
+
+	/// SII handle of the peer towards the NR, 0 if not known yet.
+	inline uint32 get_downstream_peer() const { return downstream_peer; }
+	inline void set_downstream_peer(uint32 sii) { downstream_peer = sii; }
+
 	virtual bool is_final() const = 0;
 
 	void set_mspec_object(msg::mnslp_mspec_object *object);
@@ -174,6 +267,22 @@ class session {
 	 */
 	virtual void process_event(dispatcher *d, event *evt) = 0;
 
+	/**
+	 * Fill in the state to keep across a restart of the daemon.
+	 *
+	 * Returns false if the session can't be restored, which is the case
+	 * for sessions that are not in a stable state. The default only fills
+	 * in the common part and returns false. Called by the mailbox owner.
+	 */
+	virtual bool save(session_snapshot &snap) const;
+
+	/**
+	 * Add the memory held outside of the session object to usage.
+	 *
+	 * The default counts the policy rule.
+	 */
+	virtual void count_memory(session_memory_usage &usage) const;
+
 	mt_policy_rule *rule;
 
   private:
@@ -185,8 +294,13 @@ class session {
 	uint32 msn;
 	
 	uint32 msg_hop_count;
-	
-	pthread_mutex_t	mutex;
+
+	uint32 upstream_peer;
+	uint32 downstream_peer;
+
+	volatile int refs;
+
+	session_mailbox mailbox;
 
 	void init();
 };
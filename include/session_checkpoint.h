@@ -0,0 +1,165 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file session_checkpoint.h
+/// Checkpoint log of the session table.
+/// ----------------------------------------------------------
+/// $Id: session_checkpoint.h 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./include/session_checkpoint.h $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#ifndef MNSLP__SESSION_CHECKPOINT_H
+#define MNSLP__SESSION_CHECKPOINT_H
+
+#include <pthread.h>
+#include <ext/hash_map>
+#include <string>
+#include <vector>
+
+#include "protlib_types.h"
+#include "session.h"
+
+
+namespace mnslp {
+    using protlib::uchar;
+    using protlib::uint32;
+
+
+/**
+ * An append-only log of the session table, so sessions survive a restart.
+ *
+ * The log is a file mapped into memory. Each time a session changes, a
+ * record with its snapshot is appended, and sessions that end get a
+ * removal record. Only the sessions touched by a batch of events are
+ * written, and a record equal to the session's last one is skipped.
+ * On startup, replay() returns the latest snapshot of every session.
+ *
+ * Records carry their length and a checksum. Reading stops at the first
+ * record that is incomplete or corrupt, which is where a crash interrupted
+ * the writer, and the next record overwrites it. Once less than half of
+ * the log belongs to live sessions, compact_if_needed() copies the live
+ * records to a new file. This waits for the disk and blocks all writers,
+ * so the daemon only calls it while idle and on shutdown.
+ *
+ * A crash of the daemon doesn't lose records, they are in the page cache.
+ * sync() starts writing them to disk, to survive a crash of the host.
+ *
+ * Instances of this class are thread-safe.
+ */
+class session_checkpoint {
+
+  public:
+	session_checkpoint(const std::string &filename);
+	~session_checkpoint();
+
+	bool open();
+
+	inline bool is_open() const { return map != NULL; }
+
+	size_t replay(std::vector<session_snapshot *> &snapshots);
+
+	void save(session *s);
+
+	void save(const session_snapshot &snap);
+
+	void remove(const session_id &id);
+
+	void sync();
+
+	void compact();
+
+	bool compact_if_needed();
+
+	/// Return the number of sessions in the log.
+	size_t get_num_sessions();
+
+	/// Return the number of bytes in use, including outdated records.
+	size_t get_log_size();
+
+	/// The file grows by this many bytes at a time.
+	static const size_t CHUNK_SIZE = 4 * 1024 * 1024;
+
+  protected:
+	enum record_kind_t {
+		REC_SESSION	= 1,
+		REC_REMOVE	= 2
+	};
+
+	void append(record_kind_t kind, const session_id &id,
+		const uchar *body, uint32 body_length);
+
+	static std::vector<uchar> encode(const session_snapshot &snap);
+
+	static session_snapshot *decode(const uchar *body, uint32 length);
+
+  private:
+	/**
+	 * The start of every record in the file, followed by the body.
+	 */
+	struct record_header {
+		uint32 length;		///< Of the whole record, 0 marks the end
+		uint32 checksum;	///< Of everything after this field
+		uint32 kind;		///< A record_kind_t
+		uint32 id[4];		///< The session ID
+	};
+
+	/// Where the latest record of a session is.
+	struct record_pos {
+		size_t offset;
+		uint32 length;
+		uint32 checksum;
+	};
+
+	typedef __gnu_cxx::hash_map<session_id, record_pos> index_t;
+
+	std::string filename;
+	int fd;
+	uchar *map;
+	size_t map_size;
+	size_t used;		///< Bytes up to the end of the last record
+	size_t synced;		///< Bytes passed to msync() already
+	size_t live;		///< Bytes in records listed in the index, padded
+
+	index_t index;
+
+	pthread_mutex_t mutex;
+
+	bool map_file(size_t size);
+	void unmap_file();
+	bool reserve(size_t length);
+	void scan();
+	void rewrite();
+
+	inline bool is_compaction_due() const {
+		return used > 2 * live + CHUNK_SIZE;
+	}
+
+	static uint32 compute_checksum(const uchar *record, uint32 length);
+
+	// Not implemented, the checkpoint is shared by reference.
+	session_checkpoint(const session_checkpoint &);
+	session_checkpoint &operator=(const session_checkpoint &);
+};
+
+
+} // namespace mnslp
+
+#endif // MNSLP__SESSION_CHECKPOINT_H
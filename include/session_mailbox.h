@@ -0,0 +1,92 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file session_mailbox.h
+/// Lock-free queue of the events waiting for a session.
+/// ----------------------------------------------------------
+/// $Id: session_mailbox.h 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./include/session_mailbox.h $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#ifndef MNSLP__SESSION_MAILBOX_H
+#define MNSLP__SESSION_MAILBOX_H
+
+#include <cstddef>
+
+
+namespace mnslp {
+
+class event;
+
+
+/**
+ * The events waiting for a session, and the thread processing them.
+ *
+ * Any thread may post() events. Only the thread that claim()ed the
+ * mailbox takes them out, so a session processes one event at a time and
+ * in the order the events were posted, without a lock. Posting pushes
+ * onto a lock-free stack; take() detaches the whole stack at once and
+ * reverses it.
+ *
+ * No event may be left behind when the owner gives up its claim. Because
+ * of this, a thread that posted an event has to try to claim the mailbox
+ * afterwards, and unclaim() takes the claim back if events arrived while
+ * the owner wasn't looking. If it returns true, the caller still owns the
+ * mailbox and has to process these events too.
+ *
+ * Events still queued when the mailbox is destroyed are deleted.
+ */
+class session_mailbox {
+
+  public:
+	session_mailbox();
+	~session_mailbox();
+
+	void post(event *evt);
+
+	bool claim();
+
+	bool unclaim();
+
+	event *take();
+
+	/// Only a hint unless called by the owner.
+	inline bool is_empty() const { return head == NULL && pending == NULL; }
+
+  private:
+	struct node {
+		event *evt;
+		node *next;
+	};
+
+	node *volatile head;	///< Posted events, newest first
+	node *pending;			///< Taken from head by the owner, oldest first
+	volatile int claimed;
+
+	// Not copyable.
+	session_mailbox(const session_mailbox &);
+	session_mailbox &operator=(const session_mailbox &);
+};
+
+
+} // namespace mnslp
+
+#endif // MNSLP__SESSION_MAILBOX_H
@@ -49,7 +49,8 @@ namespace mnslp {
  * session factory, because it can verify that a created session_id is really
  * unique on this node.
  *
- * Instances of this class are thread-safe.
+ * Instances of this class are thread-safe. The table holds a reference to
+ * each of its sessions.
  */
 class session_manager {
 
@@ -61,14 +62,18 @@ class session_manager {
 
 	ni_session *create_ni_session();
 		
-	nf_session *create_nf_session(const session_id &sid);
+	session *create_nf_session(const session_id &sid);
 	
-	nr_session *create_nr_session(const session_id &sid);
+	session *create_nr_session(const session_id &sid);
 	
 	session *get_session(const session_id &sid);
 	
 	session *remove_session(const session_id &sid);
 
+	size_t get_session_count();
+
+	session_memory_usage get_memory_usage(session::session_type_t role);
+
   private:
   
 	pthread_mutex_t mutex;
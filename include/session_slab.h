@@ -0,0 +1,95 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file session_slab.h
+/// Fixed-size allocator for session objects.
+/// ----------------------------------------------------------
+/// $Id: session_slab.h 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./include/session_slab.h $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#ifndef MNSLP__SESSION_SLAB_H
+#define MNSLP__SESSION_SLAB_H
+
+#include <pthread.h>
+#include <cstddef>
+#include <vector>
+
+
+namespace mnslp {
+
+
+/**
+ * Allocates objects of one size from large, cache line aligned blocks.
+ *
+ * Each session class has one slab, so the sessions of a role are packed
+ * together instead of being spread over the heap, and no session shares
+ * a cache line with another one. Slots are rounded up to a multiple of
+ * CACHE_LINE bytes. Freed slots are reused, but blocks are only returned
+ * when the slab is destroyed.
+ *
+ * Requests for a different size than the slab was created for, as made
+ * by subclasses of a session class, are passed on to the global operator
+ * new. Instances are thread-safe.
+ */
+class session_slab {
+
+  public:
+	static const size_t CACHE_LINE = 64;
+
+	session_slab(size_t object_size, size_t objects_per_block=4096);
+	~session_slab();
+
+	void *allocate(size_t size);
+	void deallocate(void *p, size_t size);
+
+	/// The size of a slot, object_size rounded up to a cache line.
+	inline size_t get_slot_size() const { return slot_size; }
+
+	size_t get_objects_in_use() const;
+	size_t get_bytes_reserved() const;
+
+  private:
+	size_t object_size;
+	size_t slot_size;
+	size_t objects_per_block;
+
+	struct free_slot {
+		free_slot *next;
+	};
+
+	free_slot *free_list;
+	std::vector<void *> blocks;
+	size_t in_use;
+
+	mutable pthread_mutex_t mutex;
+
+	void add_block();
+
+	// Not copyable.
+	session_slab(const session_slab &);
+	session_slab &operator=(const session_slab &);
+};
+
+
+} // namespace mnslp
+
+#endif // MNSLP__SESSION_SLAB_H
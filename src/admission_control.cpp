@@ -0,0 +1,233 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file admission_control.cpp
+/// Admission control for new sessions.
+/// ----------------------------------------------------------
+/// $Id: admission_control.cpp 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./src/admission_control.cpp $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#include <ctime>
+
+#include "admission_control.h"
+
+
+using namespace mnslp;
+
+
+/**
+ * Constructor.
+ *
+ * A limit of 0 disables the check. If peer_burst is 0, a neighbour may
+ * send up to peer_rate CONFIGUREs at once.
+ */
+admission_control::admission_control(uint32 max_sessions,
+		uint32 max_pending_installs, uint32 queue_watermark,
+		uint32 peer_rate, uint32 peer_burst)
+		: max_sessions(max_sessions),
+		  max_pending_installs(max_pending_installs),
+		  queue_watermark(queue_watermark), peer_rate(peer_rate),
+		  peer_burst(peer_burst != 0 ? peer_burst : peer_rate),
+		  backlog(0), installs(0), last_prune(0) {
+
+	for ( int i = 0; i < NUM_VERDICTS; i++ )
+		counts[i] = 0;
+
+	pthread_mutex_init(&mutex, NULL);
+}
+
+
+admission_control::~admission_control() {
+	pthread_mutex_destroy(&mutex);
+}
+
+
+/**
+ * Decide whether a new session may be created.
+ *
+ * @param peer the SII handle of the neighbour, 0 for local applications
+ * @param sessions the number of live sessions
+ * @param removals the policy rules waiting to be removed
+ * @return ADMITTED or the reason for rejecting the session
+ */
+admission_control::verdict_t admission_control::admit(uint32 peer,
+		size_t sessions, size_t removals) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return admit(peer, sessions, removals,
+		uint64(now.tv_sec) * 1000 + now.tv_nsec / 1000000);
+}
+
+
+/**
+ * Decide whether a new session may be created, at the given time.
+ *
+ * The checks are ordered from cheapest to most expensive. A rejected
+ * session doesn't use up a token of its neighbour.
+ */
+admission_control::verdict_t admission_control::admit(uint32 peer,
+		size_t sessions, size_t removals, uint64 now_ms) {
+
+	if ( queue_watermark != 0 && backlog > queue_watermark )
+		return count(REJECT_BACKLOG);
+
+	if ( max_sessions != 0 && sessions >= max_sessions )
+		return count(REJECT_SESSIONS);
+
+	if ( max_pending_installs != 0
+			&& installs + removals >= max_pending_installs )
+		return count(REJECT_INSTALLS);
+
+	if ( peer_rate != 0 && ! take_token(peer, now_ms) )
+		return count(REJECT_RATE);
+
+	return count(ADMITTED);
+}
+
+
+/**
+ * Refill the neighbour's bucket and take a token if there is one.
+ */
+bool admission_control::take_token(uint32 peer, uint64 now_ms) {
+
+	const uint64 capacity = uint64(peer_burst) * 1000;
+
+	pthread_mutex_lock(&mutex);
+
+	std::map<uint32, bucket>::iterator i = buckets.find(peer);
+
+	if ( i == buckets.end() ) {
+		bucket full = { capacity, now_ms };
+		i = buckets.insert(std::make_pair(peer, full)).first;
+	}
+
+	bucket &b = i->second;
+
+	// Tolerate a clock that seems to go backwards between threads.
+	if ( now_ms > b.last ) {
+		b.tokens += (now_ms - b.last) * peer_rate;
+		if ( b.tokens > capacity )
+			b.tokens = capacity;
+		b.last = now_ms;
+	}
+
+	bool ret = b.tokens >= 1000;
+	if ( ret )
+		b.tokens -= 1000;
+
+	if ( now_ms - last_prune >= PRUNE_INTERVAL_MS && now_ms > last_prune )
+		prune_buckets(now_ms);
+
+	pthread_mutex_unlock(&mutex);
+
+	return ret;
+}
+
+
+/**
+ * Drop the buckets that would be full by now.
+ *
+ * Such a bucket doesn't differ from the one a returning neighbour gets.
+ * The mutex has to be held by the caller.
+ */
+void admission_control::prune_buckets(uint64 now_ms) {
+
+	const uint64 capacity = uint64(peer_burst) * 1000;
+
+	std::map<uint32, bucket>::iterator i = buckets.begin();
+
+	while ( i != buckets.end() ) {
+		const bucket &b = i->second;
+
+		if ( now_ms > b.last
+				&& (now_ms - b.last) * peer_rate >= capacity - b.tokens )
+			buckets.erase(i++);
+		else
+			++i;
+	}
+
+	last_prune = now_ms;
+}
+
+
+/**
+ * Return the number of neighbours that have a token bucket.
+ */
+size_t admission_control::get_bucket_count() {
+	pthread_mutex_lock(&mutex);
+	size_t ret = buckets.size();
+	pthread_mutex_unlock(&mutex);
+
+	return ret;
+}
+
+
+admission_control::verdict_t admission_control::count(verdict_t v) {
+	__sync_fetch_and_add(&counts[v], 1);
+	return v;
+}
+
+
+uint32 admission_control::get_count(verdict_t v) const {
+	return ( v < NUM_VERDICTS ) ? counts[v] : 0;
+}
+
+
+/**
+ * Return the number of sessions rejected for any reason.
+ */
+uint32 admission_control::get_rejected() const {
+	uint32 sum = 0;
+
+	for ( int i = REJECT_SESSIONS; i < NUM_VERDICTS; i++ )
+		sum += counts[i];
+
+	return sum;
+}
+
+
+const char *admission_control::get_verdict_name(verdict_t v) {
+	static const char *const names[NUM_VERDICTS] = {
+		"admitted", "sessions", "installs", "backlog", "rate"
+	};
+
+	return ( v < NUM_VERDICTS ) ? names[v] : "unknown";
+}
+
+
+std::ostream &mnslp::operator<<(std::ostream &out,
+		const admission_control &ac) {
+
+	out << "[admission_control:";
+
+	for ( int i = 0; i < admission_control::NUM_VERDICTS; i++ ) {
+		admission_control::verdict_t v = admission_control::verdict_t(i);
+		out << " " << admission_control::get_verdict_name(v)
+			<< "=" << ac.get_count(v);
+	}
+
+	return out << "]";
+}
+
+// EOF
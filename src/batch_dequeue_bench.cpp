@@ -0,0 +1,114 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file batch_dequeue_bench.cpp
+/// Throughput benchmark for batched dequeueing from the MNSLP input queue.
+/// ----------------------------------------------------------
+/// $Id: batch_dequeue_bench.cpp 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./src/batch_dequeue_bench.cpp $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#include <cstdlib>
+#include <iostream>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "event_batch.h"
+
+using namespace protlib;
+using namespace mnslp;
+
+
+/*
+ * A synthetic producer fills the queue while the consumer drains it with
+ * dequeue_batch(), the way mnslp_daemon::main_loop does. Messages are only
+ * deleted by the consumer, so the result is the cost of the queue itself.
+ */
+struct producer_param {
+	FastQueue *queue;
+	unsigned long count;
+};
+
+
+static void *producer(void *arg) {
+	producer_param *param = static_cast<producer_param *>(arg);
+
+	for ( unsigned long i = 0; i < param->count; i++ )
+		param->queue->enqueue(new message(message::type_transport));
+
+	return NULL;
+}
+
+
+static double now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+
+static double run(unsigned long count, size_t batch_size) {
+	FastQueue queue;
+	producer_param param = { &queue, count };
+	std::vector<message *> msgs;
+	msgs.reserve(batch_size);
+
+	double start = now();
+
+	pthread_t thread;
+	pthread_create(&thread, NULL, producer, &param);
+
+	unsigned long received = 0;
+	while ( received < count ) {
+		received += dequeue_batch(&queue, msgs, batch_size, 1000);
+
+		for ( size_t i = 0; i < msgs.size(); i++ )
+			delete msgs[i];
+		msgs.clear();
+	}
+
+	pthread_join(thread, NULL);
+
+	return count / (now() - start);
+}
+
+
+int main(int argc, char *argv[]) {
+	unsigned long count = 1000000;
+
+	if ( argc > 1 )
+		count = strtoul(argv[1], NULL, 10);
+
+	const size_t batch_sizes[] = { 1, 8, 32, 128 };
+
+	std::cout << "messages: " << count << std::endl;
+
+	for ( size_t i = 0; i < sizeof(batch_sizes) / sizeof(size_t); i++ ) {
+		double rate = run(count, batch_sizes[i]);
+
+		std::cout << "batch size " << batch_sizes[i] << ": "
+			<< (unsigned long) rate << " messages/s" << std::endl;
+	}
+
+	return 0;
+}
+
+// EOF
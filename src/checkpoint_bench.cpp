@@ -0,0 +1,230 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file checkpoint_bench.cpp
+/// Benchmark for restarting with a session checkpoint log.
+/// ----------------------------------------------------------
+/// $Id: checkpoint_bench.cpp 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./src/checkpoint_bench.cpp $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "logfile.h"
+#include "gist_conf.h"
+#include "mri_pc.h"
+
+#include "mnslp_config.h"
+#include "mnslp_daemon.h"
+#include "dispatcher.h"
+#include "session_checkpoint.h"
+#include "msg/mnslp_ipfix_message.h"
+
+using namespace protlib;
+using namespace protlib::log;
+using namespace mnslp;
+using namespace mnslp::msg;
+
+
+namespace ntlp {
+// configuration class
+gistconf gconf;
+}
+
+logfile commonlog("", false, true); // no colours, quiet start
+logfile &protlib::log::DefaultLog(commonlog);
+
+
+static double now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+
+class bench_config : public mnslp_config {
+  public:
+	bench_config() {
+		repository_init();
+		setRepository();
+		ntlp::gconf.setRepository();
+	}
+};
+
+
+/*
+ * A dispatcher that only counts the timers it is asked to start, there
+ * is no timer module.
+ */
+class bench_dispatcher : public dispatcher {
+  public:
+	bench_dispatcher(session_manager *m, policy_rule_installer *p,
+					 mnslp_config *conf)
+		: dispatcher(m, p, conf), num_timers(0) { }
+
+	virtual id_t start_timer(const session *s, int secs) throw () {
+		return ++num_timers;
+	}
+
+	id_t num_timers;
+};
+
+
+/*
+ * The MSPEC object of the signaling benchmark: a filter on the flow in
+ * an option template and the counters to export in a data template.
+ */
+static mnslp_ipfix_message *create_mspec_object() {
+	mnslp_ipfix_message *mess = new mnslp_ipfix_message(0, IPFIX_VERSION, true);
+
+	uint16_t templid = mess->new_data_template(2);
+	mess->add_field(templid, 0, IPFIX_FT_OCTETDELTACOUNT, 8);
+	mess->add_field(templid, 0, IPFIX_FT_PACKETDELTACOUNT, 8);
+
+	uint8_t addr[4] = { 10, 0, 2, 15 };
+	uint16_t port = 80;
+	uint8_t protocol = 6;
+
+	uint16_t optid = mess->new_option_template(3);
+	mess->add_field(optid, 0, IPFIX_FT_SOURCEIPV4ADDRESS, 4);
+	mess->add_field(optid, 0, IPFIX_FT_TCPDESTINATIONPORT, 2);
+	mess->add_field(optid, 0, IPFIX_FT_PROTOCOLIDENTIFIER, 1);
+
+	mnslp_ipfix_data_record data(optid);
+	data.insert_field(0, IPFIX_FT_SOURCEIPV4ADDRESS, 
+		mess->get_field_definition(0, IPFIX_FT_SOURCEIPV4ADDRESS)
+			.get_ipfix_value_field(addr, 4));
+	data.insert_field(0, IPFIX_FT_TCPDESTINATIONPORT, 
+		mess->get_field_definition(0, IPFIX_FT_TCPDESTINATIONPORT)
+			.get_ipfix_value_field(port));
+	data.insert_field(0, IPFIX_FT_PROTOCOLIDENTIFIER, 
+		mess->get_field_definition(0, IPFIX_FT_PROTOCOLIDENTIFIER)
+			.get_ipfix_value_field(protocol));
+	mess->include_data(optid, data);
+
+	return mess;
+}
+
+
+/*
+ * Fills a checkpoint log with metering NF sessions, the way the dispatchers
+ * leave it, and then measures a restart: opening the log and restoring
+ * every session into a fresh session table, with its rule handed to the
+ * installer and its state timer started. This is the time until the
+ * daemon is ready to take the next REFRESH of all sessions.
+ */
+int main(int argc, char *argv[]) {
+	unsigned long num_sessions = 100000;
+	std::string filename = "checkpoint_bench.log";
+
+	if ( argc > 1 )
+		num_sessions = strtoul(argv[1], NULL, 10);
+	if ( argc > 2 )
+		filename = argv[2];
+
+	commonlog.set_filter(ERROR_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(WARNING_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(EVENT_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(INFO_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(DEBUG_LOG, LOG_EMERG + 1);
+
+	bench_config conf;
+	init_framework();
+	logging::set_level(0);
+
+	unlink(filename.c_str());
+
+	/*
+	 * Write one record per session.
+	 */
+	double start = now();
+	size_t log_size;
+	{
+		session_checkpoint checkpoint(filename);
+		if ( ! checkpoint.open() ) {
+			std::cerr << "unable to open " << filename << std::endl;
+			return 1;
+		}
+
+		session_snapshot snap;
+		snap.type = session::st_forwarder;
+		snap.state = 2;	// METERING
+		snap.lifetime = 60;
+		snap.expires = time(NULL) + 600;
+		snap.upstream_peer = 1;
+		snap.downstream_peer = 2;
+		snap.ni_mri = new ntlp::mri_pathcoupled(
+			hostaddress("10.0.3.15"), 32, 80,
+			hostaddress("10.0.2.15"), 32, 10000, 6, 0, 0, 0, false);
+		snap.nr_mri = new ntlp::mri_pathcoupled(
+			hostaddress("10.0.2.15"), 32, 10000,
+			hostaddress("10.0.3.15"), 32, 80, 6, 0, 0, 0, true);
+		snap.rule = new mt_policy_rule();
+
+		mspec_rule_key key = snap.rule->set_object(create_mspec_object());
+		snap.rule->set_commands(key,
+			std::vector<std::string>(1, key.to_string()));
+
+		for ( unsigned long i = 0; i < num_sessions; i++ ) {
+			snap.id = session_id();
+			snap.msn = i;
+			checkpoint.save(snap);
+		}
+
+		log_size = checkpoint.get_log_size();
+	}
+	double written = now() - start;
+
+	/*
+	 * Restart.
+	 */
+	start = now();
+
+	session_checkpoint checkpoint(filename);
+	checkpoint.open();
+	double opened = now() - start;
+
+	session_manager mgr(&conf);
+	nop_policy_rule_installer installer(&conf);
+	bench_dispatcher disp(&mgr, &installer, &conf);
+
+	size_t restored = disp.restore_sessions(&checkpoint);
+	double ready = now() - start;
+
+	std::cout << "sessions: " << num_sessions << ", log: "
+		<< log_size / 1024 << " KiB, written in " << written << " s"
+		<< std::endl;
+	std::cout << "restart: " << restored << " sessions restored, "
+		<< disp.num_timers << " timers, log opened in " << opened
+		<< " s, ready after " << ready << " s ("
+		<< (unsigned long) ( restored / ready ) << " sessions/s)"
+		<< std::endl;
+
+	unlink(filename.c_str());
+
+	return restored == num_sessions ? 0 : 1;
+}
+
+// EOF
@@ -0,0 +1,197 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file cpu_placement.cpp
+/// Pin threads to CPUs and find their NUMA nodes.
+/// ----------------------------------------------------------
+/// $Id: cpu_placement.cpp 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./src/cpu_placement.cpp $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#include <dirent.h>
+#include <pthread.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "cpu_placement.h"
+
+
+using namespace mnslp;
+
+
+/**
+ * Constructor.
+ *
+ * @param cpu_list comma separated CPU numbers and ranges
+ */
+cpu_placement::cpu_placement(const std::string &cpu_list) {
+	std::istringstream in(cpu_list);
+	std::string entry;
+
+	while ( std::getline(in, entry, ',') ) {
+		int first, last;
+		char dash;
+		std::istringstream range(entry);
+
+		if ( ! (range >> first) || first < 0 || first >= CPU_SETSIZE )
+			continue;
+
+		if ( range >> dash ) {
+			if ( dash != '-' || ! (range >> last) || last < first )
+				continue;
+		}
+		else
+			last = first;
+
+		for ( int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++ )
+			cpus.push_back(cpu);
+	}
+}
+
+
+/**
+ * Pin the calling thread to the CPU for the given thread index.
+ *
+ * @return false if the list is empty or the CPU can't be used
+ */
+bool cpu_placement::pin_thread(size_t index) const {
+	if ( empty() )
+		return false;
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(get_cpu(index), &set);
+
+	return pin_thread(set);
+}
+
+
+/**
+ * Let the calling thread run on any CPU of the list.
+ *
+ * Threads it starts afterwards inherit this.
+ *
+ * @return false if the list is empty or none of the CPUs can be used
+ */
+bool cpu_placement::pin_thread_to_all() const {
+	if ( empty() )
+		return false;
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+
+	for ( size_t i = 0; i < cpus.size(); i++ )
+		CPU_SET(cpus[i], &set);
+
+	return pin_thread(set);
+}
+
+
+bool cpu_placement::pin_thread(const cpu_set_t &set) const {
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+
+/**
+ * Return the NUMA node a CPU belongs to, or -1 if it is not known.
+ */
+int cpu_placement::get_node(int cpu) {
+	char path[64];
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+
+	DIR *dir = opendir(path);
+	if ( dir == NULL )
+		return -1;
+
+	int node = -1;
+	struct dirent *e;
+
+	// The CPU's directory has a link named after its node.
+	while ( node < 0 && (e = readdir(dir)) != NULL ) {
+		if ( strncmp(e->d_name, "node", 4) == 0 && e->d_name[4] != '\0' )
+			node = atoi(e->d_name + 4);
+	}
+
+	closedir(dir);
+
+	return node;
+}
+
+
+/**
+ * Return the CPU the calling thread is running on, or -1.
+ */
+int cpu_placement::get_current_cpu() {
+	return sched_getcpu();
+}
+
+
+/**
+ * Sum up the counters of all nodes.
+ *
+ * @return false if there is no NUMA information, as on kernels without
+ *         NUMA support
+ */
+bool numa_stats::read() {
+	local_pages = 0;
+	other_pages = 0;
+
+	DIR *dir = opendir("/sys/devices/system/node");
+	if ( dir == NULL )
+		return false;
+
+	bool found = false;
+	struct dirent *e;
+
+	// Node numbers need not be contiguous.
+	while ( (e = readdir(dir)) != NULL ) {
+		if ( strncmp(e->d_name, "node", 4) != 0 || e->d_name[4] == '\0' )
+			continue;
+
+		std::string path = std::string("/sys/devices/system/node/")
+			+ e->d_name + "/numastat";
+
+		std::ifstream in(path.c_str());
+		if ( ! in )
+			continue;
+
+		std::string name;
+		unsigned long value;
+
+		while ( in >> name >> value ) {
+			if ( name == "local_node" )
+				local_pages += value;
+			else if ( name == "other_node" )
+				other_pages += value;
+		}
+
+		found = true;
+	}
+
+	closedir(dir);
+
+	return found;
+}
+
+// EOF
@@ -28,6 +28,7 @@
 // ===========================================================
 #include "timer_module.h"
 #include "logfile.h"
+#include "mnslp_log.h"
 
 #include "apimessage.h"		// from NTLP
 
@@ -36,7 +37,10 @@
 #include "dispatcher.h"
 #include "events.h"
 #include "benchmark_journal.h"
+#include "msg/mnslp_trace.h"
 #include <iostream>
+#include <sched.h>
+#include <time.h>
 
 
 using namespace mnslp;
@@ -46,8 +50,8 @@ using namespace protlib::log;
 
 #define LogError(msg) ERRLog("dispatcher", msg)
 #define LogWarn(msg) WLog("dispatcher", msg)
-#define LogInfo(msg) ILog("dispatcher", msg)
-#define LogDebug(msg) DLog("dispatcher", msg)
+#define LogInfo(msg) MNSLP_LOG_INFO("dispatcher", msg)
+#define LogDebug(msg) MNSLP_LOG_DEBUG("dispatcher", msg)
 
 #define LogUnimp(msg) Log(ERROR_LOG, LOG_UNIMP, "dispatcher", \
 	msg << " at " << __FILE__ << ":" << __LINE__)
@@ -58,6 +62,30 @@ using namespace protlib::log;
 #endif
 
 
+namespace {
+
+/**
+ * Counts an installation as pending for as long as it is in scope.
+ */
+class install_guard {
+  public:
+	install_guard(admission_control *a) : admission(a) {
+		if ( admission != NULL )
+			admission->begin_install();
+	}
+
+	~install_guard() {
+		if ( admission != NULL )
+			admission->end_install();
+	}
+
+  private:
+	admission_control *admission;
+};
+
+} // anonymous namespace
+
+
 /**
  * Constructor.
  *
@@ -72,7 +100,8 @@ using namespace protlib::log;
  */
 dispatcher::dispatcher(session_manager *m, policy_rule_installer *p, 
 					   mnslp_config *conf)
-		: session_mgr(m), rule_installer(p), config(conf) {
+		: session_mgr(m), rule_installer(p), config(conf), scheduler(NULL),
+		  bundler(NULL), admission(NULL), checkpoint(NULL) {
 
 	// nothing to do
 }
@@ -82,7 +111,7 @@ dispatcher::dispatcher(session_manager *m, policy_rule_installer *p,
  * Destructor.
  */
 dispatcher::~dispatcher() {
-	// nothing to do
+	flush_refreshes();
 }
 
 
@@ -90,9 +119,33 @@ dispatcher::~dispatcher() {
  * Process an incoming event.
  *
  * Depending on the event, sessions may be created, modified, or deleted.
- * Sometimes events will be discarded, too.
+ * Sometimes events will be discarded, too. The event is processed before
+ * this returns and the caller keeps ownership of it.
  */
 void dispatcher::process(event *evt) throw () {
+	handle(evt, false);
+}
+
+
+/**
+ * Process an incoming event and take ownership of it.
+ *
+ * Like process(), but if the event's session is busy in another thread,
+ * the event is left in the session's mailbox and processed and deleted
+ * by that thread. The event may not be used after this returns.
+ */
+void dispatcher::dispatch(event *evt) throw () {
+	if ( ! handle(evt, true) )
+		delete evt;
+}
+
+
+/**
+ * The implementation of process() and dispatch().
+ *
+ * @return true if the event was handed to a session, which deletes it
+ */
+bool dispatcher::handle(event *evt, bool owned) throw () {
 	assert( evt != NULL );
 
 	LogDebug("processing received event " << *evt);
@@ -104,6 +157,9 @@ void dispatcher::process(event *evt) throw () {
 		LogDebug("received message for session "
 				<< *(e->get_session_id()) << " "
 				<< *(e->get_ntlp_msg()));
+
+		if ( bundler != NULL )
+			bundler->learn(e->get_sii_handle(), e->get_mnslp_msg());
 	}
 
 	/*
@@ -118,7 +174,7 @@ void dispatcher::process(event *evt) throw () {
 		LogInfo("Accepting QUERY");
 
 		send_receive_answer(rsc);
-		return;
+		return false;
 	}
 	
 	/*
@@ -137,7 +193,18 @@ void dispatcher::process(event *evt) throw () {
 			information_code::sc_protocol_error, 0);
 
 		send_message( resp );
-		return;
+		return false;
+	}
+
+	/*
+	 * A RESPONSE listing the sessions of a bundled REFRESH that the peer
+	 * rejected. It concerns the listed sessions only, not the session it
+	 * was sent in.
+	 */
+	else if ( is_mnlsp_response(evt)
+			&& e->get_response()->get_refresh_list() != NULL ) {
+		process_refresh_list(e, e->get_response()->get_refresh_list(), true);
+		return false;
 	}
 
 
@@ -157,42 +224,195 @@ void dispatcher::process(event *evt) throw () {
 	/*
 	 * There can be several reasons if we don't find the session.
 	 * In some cases (tg_CREATE, rx_CREATE, etc.), we create a new
-	 * session.
+	 * session, unless we are overloaded.
 	 */
-	if ( s == NULL )
+	if ( s == NULL ) {
+		if ( ! admit_session(evt) )
+			return false;
+
 		s = create_session(evt);
+	}
 
 	MP(benchmark_journal::POST_SESSION_MANAGER);
 
+	/*
+	 * A bundled REFRESH also refreshes the sessions in its list, so we
+	 * still need it after its own session is done with it.
+	 */
+	bool has_refresh_list = is_mnslp_refresh(evt)
+			&& e->get_refresh()->get_refresh_list() != NULL;
+
+	bool handed_over = false;
+
 	/*
 	 * If we have a session now, process the event. Otherwise simply
 	 * discard it. Top candidates for discarding are obsolete timers.
 	 */
 	if ( s != NULL ) {
-		try {
-			MP(benchmark_journal::PRE_SESSION);
-			s->process(this, evt);
-			MP(benchmark_journal::POST_SESSION);
-		}
-		catch ( ... ) {
-			LogError("process() threw exception, aborting session");
-			session_mgr->remove_session(s->get_id());
-			return;
-		}
-
-		/*
-		 * If a session is in state FINAL after processing, delete it.
-		 */
-		if ( s->is_final() ) {
-			session_mgr->remove_session(s->get_id());
-			delete s;
-		}
+		handed_over = owned && ! has_refresh_list;
+		deliver(s, evt, handed_over);
+		s->release();
 	}
 	else {
 		// Don't log obsolete timers, there are lots of them.
 		if ( ! is_timer(evt) )
 			LogWarn("discarding event " << *evt);
 	}
+
+	if ( has_refresh_list )
+		process_refresh_list(e, e->get_refresh()->get_refresh_list(), false);
+
+	return handed_over;
+}
+
+
+/**
+ * Hand an event to a session, in order with the events of other threads.
+ *
+ * If the session's mailbox is idle, this thread claims it and processes
+ * the waiting events and then the given one. Otherwise an owned event is
+ * posted to the mailbox and left to the thread owning it, while for an
+ * event the caller keeps we wait until the mailbox is ours.
+ *
+ * @param owned true if the session has to delete the event
+ */
+void dispatcher::deliver(session *s, event *evt, bool owned) throw () {
+	session_mailbox &mailbox = s->get_mailbox();
+
+	if ( ! mailbox.claim() ) {
+		if ( owned ) {
+			mailbox.post(evt);
+
+			if ( ! mailbox.claim() )
+				return;		// the owner will process it
+
+			evt = NULL;		// it is in the mailbox now
+		}
+		else {
+			while ( ! mailbox.claim() )
+				sched_yield();
+		}
+	}
+
+	// Events posted before this one go first.
+	run_mailbox(s);
+
+	if ( evt != NULL ) {
+		process_session(s, evt);
+
+		if ( owned )
+			delete evt;
+	}
+
+	while ( mailbox.unclaim() )
+		run_mailbox(s);
+}
+
+
+/**
+ * Process and delete the events in a session's mailbox.
+ *
+ * The caller has to own the mailbox.
+ */
+void dispatcher::run_mailbox(session *s) throw () {
+	event *evt;
+
+	while ( (evt = s->get_mailbox().take()) != NULL ) {
+		process_session(s, evt);
+		delete evt;
+	}
+}
+
+
+/**
+ * Let a session process an event.
+ */
+void dispatcher::process_session(session *s, event *evt) throw () {
+	try {
+		MP(benchmark_journal::PRE_SESSION);
+		s->process(this, evt);
+		MP(benchmark_journal::POST_SESSION);
+	}
+	catch ( ... ) {
+		LogError("process() threw exception, aborting session");
+
+		session *removed = session_mgr->remove_session(s->get_id());
+		if ( removed != NULL )
+			removed->release();
+
+		if ( checkpoint != NULL )
+			checkpoint->remove(s->get_id());
+		return;
+	}
+
+	if ( checkpoint != NULL )
+		checkpoint->save(s);
+
+	/*
+	 * If a session is in state FINAL after processing, remove it at once.
+	 * STATE_CLOSE is the initial state, too, so a session left in the table
+	 * would be picked up again by the next event for its ID. The policy
+	 * rules of the session are torn down in batches by the installer.
+	 */
+	if ( s->is_final() ) {
+		session *removed = session_mgr->remove_session(s->get_id());
+		if ( removed != NULL )
+			removed->release();
+	}
+}
+
+
+/**
+ * Hand each entry of a refresh list to its session.
+ *
+ * For a bundled REFRESH, the entries that could not be refreshed are sent
+ * back in a single RESPONSE, so the sender can close these sessions.
+ *
+ * @param e the message containing the list
+ * @param list the entries
+ * @param rejected true if the list comes from a rejecting RESPONSE
+ */
+void dispatcher::process_refresh_list(const msg_event *e,
+		const refresh_list *list, bool rejected) throw () {
+
+	refresh_list *failed = NULL;
+
+	for ( refresh_list::const_iterator i = list->begin();
+			i != list->end(); i++ ) {
+
+		session_id id(i->session);
+		session *s = session_mgr->get_session(id);
+
+		bundled_refresh_event evt(new session_id(id), i->msn, i->lifetime,
+			e->get_sii_handle(), rejected);
+
+		// The event is on the stack, wait for the session to take it.
+		if ( s != NULL ) {
+			deliver(s, &evt, false);
+			s->release();
+		}
+
+		if ( ! rejected && ! evt.is_accepted() ) {
+			if ( failed == NULL )
+				failed = new refresh_list();
+			failed->add(i->session, i->msn, i->lifetime);
+		}
+	}
+
+	if ( failed == NULL )
+		return;
+
+	LogInfo("rejecting " << failed->size() << " bundled refreshes");
+
+	ntlp_msg *resp = e->get_ntlp_msg()->create_response(
+		information_code::sc_signaling_session_failures,
+		information_code::sigfail_no_reservation_found);
+
+	mnslp_response *r = dynamic_cast<mnslp_response *>(resp->get_mnslp_msg());
+	assert( r != NULL );
+	r->set_refresh_list(failed);
+
+	send_message(resp);
 }
 
 
@@ -223,6 +443,56 @@ session *dispatcher::create_session(event *evt) const throw () {
 }
 
 
+/**
+ * Check if the event may create a new session.
+ *
+ * Events that don't create a session always pass. A rejected CONFIGURE
+ * from a peer is answered right away, without creating any state.
+ *
+ * @return true if the session may be created
+ */
+bool dispatcher::admit_session(event *evt) throw () {
+
+	if ( admission == NULL )
+		return true;
+
+	uint32 peer = 0;	// local applications
+
+	if ( is_mnslp_configure(evt) )
+		peer = dynamic_cast<msg_event *>(evt)->get_sii_handle();
+	else if ( ! is_api_configure(evt) )
+		return true;
+
+	size_t removals = ( rule_installer != NULL )
+		? rule_installer->get_teardown_backlog() : 0;
+
+	admission_control::verdict_t verdict = admission->admit(
+		peer, session_mgr->get_session_count(), removals);
+
+	if ( verdict == admission_control::ADMITTED )
+		return true;
+
+	MNSLP_TRACE(msg::trace::tc_admission, msg::trace::ev_admission_rejected,
+		verdict, peer, 0);
+
+	LogDebug("rejecting new session ("
+		<< admission_control::get_verdict_name(verdict) << ")");
+
+	if ( is_mnslp_configure(evt) ) {
+		msg_event *e = dynamic_cast<msg_event *>(evt);
+
+		send_message( e->get_ntlp_msg()->create_response(
+			information_code::sc_transient_failure,
+			information_code::tfail_resources_unavailable) );
+	}
+	else {
+		report_async_event("CONFIGURE rejected, node overloaded");
+	}
+
+	return false;
+}
+
+
 /**
  * Send a MNSLP message.
  *
@@ -293,6 +563,23 @@ id_t dispatcher::start_timer(const session *s, int seconds) throw () {
 }
 
 
+/**
+ * Return the delay until a session's next refresh.
+ *
+ * Uses the shared refresh scheduler if there is one. Otherwise the delay
+ * is just jittered around the refresh interval.
+ *
+ * @param interval the session's refresh interval in seconds
+ * @return the number of seconds from now
+ */
+uint32 dispatcher::next_refresh(uint32 interval) throw () {
+	if ( scheduler != NULL )
+		return scheduler->next_refresh(interval);
+	else
+		return refresh_scheduler::jitter(interval);
+}
+
+
 /**
  * Report an asynchronous event to the user.
  *
@@ -316,6 +603,8 @@ dispatcher::install_policy_rules(const mt_policy_rule *mt_rule)
 	if ( mt_rule != NULL )
 		LogDebug("installing MNSLP policy rule " << *mt_rule);
 
+	install_guard guard(admission);
+
 	mt_policy_rule * result = rule_installer->install(mt_rule);
 	return result;
 }
@@ -342,6 +631,153 @@ void dispatcher::remove_policy_rules(const mt_policy_rule *mt_rule)
 				
 }
 
+/**
+ * Queue a REFRESH message to be sent in a bundle.
+ *
+ * This only succeeds if bundling is enabled and the peer accepts bundles.
+ * Otherwise the caller has to send the message itself.
+ *
+ * @param msg a REFRESH with a non-zero lifetime, deleted by the dispatcher
+ * @param peer the SII handle of the next hop
+ * @return true if msg has been queued
+ */
+bool dispatcher::bundle_refresh(msg::ntlp_msg *msg, uint32 peer) throw () {
+	if ( bundler == NULL || ! bundler->is_enabled() || peer == 0 )
+		return false;
+
+	mnslp_refresh *refresh = msg->get_mnslp_refresh();
+	if ( refresh == NULL || refresh->get_session_lifetime() == 0 )
+		return false;
+
+	if ( ! bundler->is_capable(peer) )
+		return false;
+
+	pending_refreshes[peer].push_back(msg);
+
+	return true;
+}
+
+
+/**
+ * Send the queued REFRESH messages, bundled by peer.
+ *
+ * The caller has to make sure this is called regularly, at the latest
+ * after each batch of events.
+ */
+void dispatcher::flush_refreshes() throw () {
+
+	if ( pending_refreshes.empty() )
+		return;
+
+	std::vector<ntlp_msg *> out;
+
+	for ( pending_refreshes_t::iterator i = pending_refreshes.begin();
+			i != pending_refreshes.end(); i++ )
+		refresh_bundler::bundle(i->second, i->first, out);
+
+	pending_refreshes.clear();
+
+	for ( size_t i = 0; i < out.size(); i++ )
+		send_message(out[i]);
+}
+
+
+/**
+ * Recreate the sessions saved in a checkpoint log.
+ *
+ * The policy rules of all saved sessions are handed to the installer,
+ * which takes them over without reinstalling them and then forgets the
+ * ones the metering application lost. Sessions whose state
+ * timer ran out while the daemon was down are not restored, their rules
+ * are queued for removal instead.
+ *
+ * @return the number of sessions restored
+ */
+size_t dispatcher::restore_sessions(session_checkpoint *c) throw () {
+
+	std::vector<session_snapshot *> snapshots;
+	c->replay(snapshots);
+
+	// Take over the rules first, the metering application may have lost some.
+	for ( size_t i = 0; i < snapshots.size(); i++ )
+		if ( snapshots[i]->rule != NULL )
+			rule_installer->adopt(snapshots[i]->rule);
+
+	rule_installer->reconcile();
+
+	time_t now = time(NULL);
+	size_t restored = 0;
+
+	for ( size_t i = 0; i < snapshots.size(); i++ ) {
+		session_snapshot *snap = snapshots[i];
+		session *s = NULL;
+
+		if ( (time_t) snap->expires <= now ) {
+			LogInfo("session " << snap->id << " expired while down");
+
+			if ( snap->rule != NULL && snap->rule->get_number_rule_keys() > 0 ) {
+				rule_installer->schedule_remove(snap->rule);
+				snap->rule = NULL;
+			}
+			c->remove(snap->id);
+		}
+		else if ( snap->type == session::st_forwarder )
+			s = session_mgr->create_nf_session(snap->id);
+		else if ( snap->type == session::st_receiver )
+			s = session_mgr->create_nr_session(snap->id);
+
+		if ( s != NULL ) {
+			s->restore(this, *snap);
+			s->release();
+			restored++;
+		}
+
+		delete snap;
+	}
+
+	LogInfo("restored " << restored << " of " << snapshots.size()
+		<< " sessions");
+
+	return restored;
+}
+
+
+/**
+ * Remove the given policy rules of a session that goes away.
+ *
+ * The removal is left to the installer's teardown thread, which groups
+ * the rules of many sessions, so errors are not reported to the caller.
+ */
+void dispatcher::teardown_policy_rules(const mt_policy_rule *mt_rule) throw () {
+
+	assert( rule_installer != NULL );
+
+	if ( mt_rule != NULL ) {
+		LogDebug("tearing down MNSLP policy rule " << *mt_rule);
+		rule_installer->schedule_remove(mt_rule->copy());
+	}
+}
+
+/**
+ * Change the installed policy rules into the requested ones, touching only
+ * the objects that differ.
+ */
+mt_policy_rule * 
+dispatcher::update_policy_rules(const mt_policy_rule *installed,
+								const mt_policy_rule *requested)
+		throw (policy_rule_installer_error) {
+
+	assert( rule_installer != NULL );
+
+	if ( requested != NULL )
+		LogDebug("updating MNSLP policy rule " << *requested);
+
+	install_guard guard(admission);
+
+	return rule_installer->update(installed, requested);
+}
+
+
 bool dispatcher::check(const msg::mnslp_mspec_object *object) {	
 		
 	assert( rule_installer != NULL );
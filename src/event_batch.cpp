@@ -0,0 +1,239 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file event_batch.cpp
+/// Batched reception and ordering of MNSLP events.
+/// ----------------------------------------------------------
+/// $Id: event_batch.cpp 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./src/event_batch.cpp $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#include <sstream>
+
+#include "event_batch.h"
+
+
+using namespace mnslp;
+
+
+size_t mnslp::dequeue_batch(FastQueue *queue, std::vector<message *> &msgs,
+		size_t max, long timeout) {
+
+	size_t received = 0;
+
+	if ( max == 0 )
+		return 0;
+
+	message *msg = queue->dequeue_timedwait(timeout);
+
+	while ( msg != NULL ) {
+		msgs.push_back(msg);
+
+		if ( ++received == max )
+			break;
+
+		msg = queue->dequeue(false);	// don't block
+	}
+
+	return received;
+}
+
+
+event_batch::event_batch(size_t capacity) {
+	events.reserve(capacity);
+	grouped.reserve(capacity);
+	taken.reserve(capacity);
+}
+
+
+event_batch::~event_batch() {
+	clear();
+}
+
+
+void event_batch::add(event *evt) {
+	if ( evt != NULL )
+		events.push_back(evt);
+}
+
+
+void event_batch::group_by_session() {
+
+	const size_t n = events.size();
+
+	if ( n < 3 )
+		return;	// nothing can move
+
+	grouped.clear();
+	taken.assign(n, false);
+
+	for ( size_t i = 0; i < n; i++ ) {
+		if ( taken[i] )
+			continue;
+
+		grouped.push_back(events[i]);
+
+		const session_id *sid = events[i]->get_session_id();
+		if ( sid == NULL )
+			continue;
+
+		// Pull the later events of this session forward.
+		for ( size_t j = i + 1; j < n; j++ ) {
+			const session_id *other = events[j]->get_session_id();
+
+			if ( ! taken[j] && other != NULL && *other == *sid ) {
+				grouped.push_back(events[j]);
+				taken[j] = true;
+			}
+		}
+	}
+
+	events.swap(grouped);
+}
+
+
+void event_batch::clear() {
+	for ( size_t i = 0; i < events.size(); i++ )
+		delete events[i];
+
+	events.clear();
+}
+
+
+/**
+ * Constructor.
+ *
+ * @param weights comma separated weights for the timer, refresh, response
+ *        and new session lanes; missing or invalid weights are 1
+ */
+event_lanes::event_lanes(const std::string &weights)
+		: current(0), count(0) {
+
+	set_weights(weights);
+}
+
+
+event_lanes::~event_lanes() {
+	clear();
+}
+
+
+void event_lanes::set_weights(const std::string &str) {
+	std::istringstream in(str);
+	std::string item;
+
+	for ( int i = 0; i < NUM_LANES; i++ ) {
+		long w = 0;
+
+		if ( std::getline(in, item, ',') )
+			std::istringstream(item) >> w;
+
+		weights[i] = ( w > 0 ) ? w : 1;
+		credit[i] = weights[i];
+	}
+}
+
+
+/**
+ * Return the lane an event belongs to.
+ */
+event_lanes::lane_t event_lanes::classify(const event *evt) {
+
+	if ( is_timer(evt) )
+		return LANE_TIMER;
+	else if ( is_mnslp_refresh(evt) || is_api_teardown(evt) )
+		return LANE_REFRESH;
+	else if ( is_mnslp_configure(evt) || is_api_configure(evt) )
+		return LANE_NEW;
+	else
+		return LANE_RESPONSE;
+}
+
+
+void event_lanes::add(event *evt) {
+	if ( evt == NULL )
+		return;
+
+	lane_t lane = classify(evt);
+
+	const session_id *sid = evt->get_session_id();
+
+	if ( sid != NULL ) {
+		waiting_t w = { lane, 0 };
+		waiting_map_t::iterator i
+			= waiting.insert(std::make_pair(*sid, w)).first;
+
+		lane = i->second.lane;
+		i->second.events++;
+	}
+
+	lanes[lane].push_back(evt);
+	count++;
+}
+
+
+event *event_lanes::next() {
+
+	if ( count == 0 )
+		return NULL;
+
+	// Terminates because some lane has an event and all weights are > 0.
+	while ( credit[current] == 0 || lanes[current].empty() ) {
+		credit[current] = 0;
+
+		if ( ++current == NUM_LANES ) {
+			current = 0;
+			for ( int i = 0; i < NUM_LANES; i++ )
+				credit[i] = weights[i];
+		}
+	}
+
+	event *evt = lanes[current].front();
+	lanes[current].pop_front();
+	credit[current]--;
+	count--;
+
+	const session_id *sid = evt->get_session_id();
+
+	if ( sid != NULL ) {
+		waiting_map_t::iterator i = waiting.find(*sid);
+
+		if ( i != waiting.end() && --i->second.events == 0 )
+			waiting.erase(i);
+	}
+
+	return evt;
+}
+
+
+void event_lanes::clear() {
+	for ( int i = 0; i < NUM_LANES; i++ ) {
+		for ( size_t j = 0; j < lanes[i].size(); j++ )
+			delete lanes[i][j];
+
+		lanes[i].clear();
+	}
+
+	waiting.clear();
+	count = 0;
+}
+
+// EOF
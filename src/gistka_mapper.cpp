@@ -28,6 +28,7 @@
 // ===========================================================
 #include "timer_module.h"
 #include "logfile.h"
+#include "mnslp_log.h"
 
 #include "apimessage.h"		// from NTLP
 
@@ -45,8 +46,8 @@ using namespace protlib::log;
 
 #define LogError(msg) ERRLog("gistka_mapper", msg)
 #define LogWarn(msg) WLog("gistka_mapper", msg)
-#define LogInfo(msg) ILog("gistka_mapper", msg)
-#define LogDebug(msg) DLog("gistka_mapper", msg)
+#define LogInfo(msg) MNSLP_LOG_INFO("gistka_mapper", msg)
+#define LogDebug(msg) MNSLP_LOG_DEBUG("gistka_mapper", msg)
 
 #define LogUnimp(msg) Log(ERROR_LOG, LOG_UNIMP, "gistka_mapper", \
 	msg << " at " << __FILE__ << ":" << __LINE__)
@@ -65,14 +66,14 @@ ntlp::APIMsg *gistka_mapper::create_api_msg(msg::ntlp_msg *msg) const throw () {
 	MP(benchmark_journal::PRE_SERIALIZE);
 
 	/*
-	 * Construct the NSLP payload (the NTLP's body).
+	 * Construct the NSLP payload (the NTLP's body). Retransmissions and
+	 * forwarded messages reuse the wire format of the message they copy.
 	 */
-	const mnslp_msg *m = msg->get_mnslp_msg();
-	NetMsg payload( m->get_serialized_size(IE::protocol_v1) );
+	const uchar *payload = NULL;
+	uint32 payload_length = 0;
 
 	try {
-		uint32 bytes_written;
-		m->serialize(payload, IE::protocol_v1, bytes_written);
+		payload = msg->get_serialized(payload_length);
 	}
 	catch ( IEError &e ) {
 		LogError("serializing M-NSLP message failed");
@@ -80,7 +81,7 @@ ntlp::APIMsg *gistka_mapper::create_api_msg(msg::ntlp_msg *msg) const throw () {
 	}
 
 	// Note: The nslpdata constructor copies the buffer.
-	nslpdata *data = new nslpdata(payload.get_buffer(), payload.get_size());
+	nslpdata *data = new nslpdata(payload, payload_length);
 
 
 	/*
@@ -270,6 +271,11 @@ event *gistka_mapper::map_api_receive_message(
 
 	// Note that m may be NULL if deserialize() failed!
 	ntlp_msg *ret = new ntlp_msg(*sid, m, apimsg->get_mri()->copy(), sii);
+
+	// Forwarding the message sends the bytes we got.
+	if ( m != NULL && errlist.is_empty() && num_read == data->get_size() )
+		ret->set_serialized(data->get_buffer(), data->get_size());
+
 	msg_event *evt = new msg_event(sid, ret, final_hop);
 
 	MP(benchmark_journal::POST_DESERIALIZE);
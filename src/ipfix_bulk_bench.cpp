@@ -0,0 +1,207 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file ipfix_bulk_bench.cpp
+/// Compare the column by column and field by field IPFIX record paths.
+/// ----------------------------------------------------------
+/// $Id: ipfix_bulk_bench.cpp 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./src/ipfix_bulk_bench.cpp $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <sys/time.h>
+
+#include "msg/mnslp_ipfix_message.h"
+#include "msg/mnslp_ipfix_byteorder.h"
+
+using namespace mnslp::msg;
+
+
+/*
+ * Every record has the flow key and counters of a metered flow: nine
+ * fixed length integer and IPv4 fields. The message is encoded in host
+ * byte order, so every integer column is swapped on export and import.
+ */
+static const int field_types[] = {
+	IPFIX_FT_SOURCEIPV4ADDRESS, IPFIX_FT_DESTINATIONIPV4ADDRESS,
+	IPFIX_FT_SOURCETRANSPORTPORT, IPFIX_FT_DESTINATIONTRANSPORTPORT,
+	IPFIX_FT_PROTOCOLIDENTIFIER, IPFIX_FT_INGRESSINTERFACE,
+	IPFIX_FT_EGRESSINTERFACE, IPFIX_FT_OCTETDELTACOUNT,
+	IPFIX_FT_PACKETDELTACOUNT
+};
+
+static const int num_fields = sizeof(field_types) / sizeof(int);
+
+
+static double now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+
+static mnslp_ipfix_value_field make_value(const mnslp_ipfix_field &field, int i, int r) {
+	const ipfix_field_type_t &type = field.get_field_type();
+
+	if ( type.coding == IPFIX_CODING_IPADDR ) {
+		uint8_t addr[4] = { 10, (uint8_t) i, (uint8_t) (r >> 8), (uint8_t) r };
+		return field.get_ipfix_value_field(addr, 4);
+	}
+
+	switch ( type.length ) {
+	  case 1: { uint8_t v = r; return field.get_ipfix_value_field(v); }
+	  case 2: { uint16_t v = r; return field.get_ipfix_value_field(v); }
+	  case 4: { uint32_t v = r; return field.get_ipfix_value_field(v); }
+	  default: { uint64_t v = r; return field.get_ipfix_value_field(v); }
+	}
+}
+
+
+static mnslp_ipfix_message *build_message(int nrecords) {
+	mnslp_ipfix_message *mess = new mnslp_ipfix_message(1, IPFIX_VERSION, false);
+
+	uint16_t templid = mess->new_data_template( num_fields );
+	for ( int i = 0; i < num_fields; i++ ) {
+		mnslp_ipfix_field field = mess->get_field_definition(0, field_types[i]);
+		mess->add_field(templid, 0, field_types[i], field.get_field_type().length);
+	}
+
+	for ( int r = 0; r < nrecords; r++ ) {
+		mnslp_ipfix_data_record data(templid);
+
+		for ( int i = 0; i < num_fields; i++ ) {
+			mnslp_ipfix_field field = mess->get_field_definition(0, field_types[i]);
+			mnslp_ipfix_value_field value = make_value(field, i, r);
+			data.insert_field(0, field_types[i], value);
+		}
+		mess->include_data(templid, data);
+	}
+
+	return mess;
+}
+
+
+/*
+ * The exporter puts every record in its own set; collectors usually get 
+ * all the records of a template in one set, which is what the import 
+ * path reads column by column.
+ */
+static size_t merge_data_sets(const uchar *in, size_t len, std::vector<uchar> &out) {
+	size_t i = IPFIX_HDR_BYTES, data_set = 0;
+	uint16_t setid = 0, setlen;
+
+	out.assign(in, in + IPFIX_HDR_BYTES);
+
+	while ( i + 4 <= len ) {
+		memcpy(&setid, in + i, 2);
+		memcpy(&setlen, in + i + 2, 2);
+
+		if ( setid > 255 ) {
+			if ( data_set == 0 ) {
+				data_set = out.size();
+				out.resize(out.size() + 4);
+			}
+			out.insert(out.end(), in + i + 4, in + i + setlen);
+		}
+		else
+			out.insert(out.end(), in + i, in + i + setlen);
+		i += setlen;
+	}
+
+	setlen = out.size() - data_set;
+	memcpy(&out[data_set], &setid, 2);
+	memcpy(&out[data_set + 2], &setlen, 2);
+
+	uint16_t length = out.size();
+	memcpy(&out[2], &length, 2);
+	return out.size();
+}
+
+
+static double run_export(int nrecords, int rounds, size_t min_records) {
+	mnslp_ipfix_message::set_bulk_min_records(min_records);
+	double elapsed = 0;
+
+	for ( int i = 0; i < rounds; i++ ) {
+		mnslp_ipfix_message *mess = build_message(nrecords);
+
+		double start = now();
+		mess->output();
+		elapsed += now() - start;
+
+		delete mess;
+	}
+
+	return ( (double) nrecords * rounds ) / elapsed;
+}
+
+
+static double run_import(int nrecords, int rounds, size_t min_records) {
+	mnslp_ipfix_message::set_bulk_min_records(0);
+	mnslp_ipfix_message *mess = build_message(nrecords);
+	mess->output();
+
+	std::vector<uchar> buffer;
+	size_t len = merge_data_sets(mess->get_message(), mess->get_offset(), buffer);
+	delete mess;
+
+	mnslp_ipfix_message::set_bulk_min_records(min_records);
+
+	double start = now();
+	for ( int i = 0; i < rounds; i++ ) {
+		mnslp_ipfix_message imported(&buffer[0], len, false);
+	}
+
+	return ( (double) nrecords * rounds ) / (now() - start);
+}
+
+
+int main(int argc, char *argv[]) {
+	int rounds = 200;
+
+	if ( argc > 1 )
+		rounds = atoi(argv[1]);
+
+	const int record_counts[] = { 16, 128, 512 };
+	const size_t bulk_min_records = mnslp_ipfix_message::get_bulk_min_records();
+
+	std::cout << "byte order kernel: " << ipfix_byteorder_kernel() << std::endl;
+	std::cout << "rounds: " << rounds << std::endl;
+
+	for ( size_t i = 0; i < sizeof(record_counts) / sizeof(int); i++ ) {
+		int nrecords = record_counts[i];
+
+		std::cout << nrecords << " records: export "
+			<< (unsigned long) run_export(nrecords, rounds, 0) << " -> "
+			<< (unsigned long) run_export(nrecords, rounds, bulk_min_records) 
+			<< " records/s, import "
+			<< (unsigned long) run_import(nrecords, rounds, 0) << " -> "
+			<< (unsigned long) run_import(nrecords, rounds, bulk_min_records)
+			<< " records/s" << std::endl;
+	}
+
+	return 0;
+}
+
+// EOF
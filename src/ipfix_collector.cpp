@@ -0,0 +1,995 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file ipfix_collector.cpp
+/// Collector for the IPFIX results of the metering application.
+/// ----------------------------------------------------------
+/// $Id: ipfix_collector.cpp 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./src/ipfix_collector.cpp $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#include <algorithm>
+#include <sstream>
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "logfile.h"
+#include "mnslp_log.h"
+
+#include "msg/mnslp_ipfix_message.h"
+#include "ipfix_collector.h"
+
+
+using namespace mnslp;
+using namespace protlib;
+using namespace protlib::log;
+
+
+#define LogError(msg) ERRLog("ipfix_collector", msg)
+#define LogWarn(msg) WLog("ipfix_collector", msg)
+#define LogInfo(msg) MNSLP_LOG_INFO("ipfix_collector", msg)
+#define LogDebug(msg) MNSLP_LOG_DEBUG("ipfix_collector", msg)
+
+
+namespace {
+
+/// How often the listener checks whether it has to stop.
+const int POLL_TIMEOUT = 200;	// ms
+
+/// Receive buffer asked for on UDP sockets, bursts are common.
+const int UDP_RECEIVE_BUFFER = 4 * 1024 * 1024;
+
+/// Datagrams read per poll(), so a flood doesn't keep stop() waiting.
+const int UDP_BURST = 1024;
+
+inline uint16 read16(const uchar *p) {
+	return (uint16(p[0]) << 8) | p[1];
+}
+
+inline uint32 read32(const uchar *p) {
+	return (uint32(p[0]) << 24) | (uint32(p[1]) << 16)
+		| (uint32(p[2]) << 8) | p[3];
+}
+
+/// Counters may be sent with fewer bytes than their type has.
+inline uint64 read_unsigned(const uchar *p, size_t length) {
+	uint64 value = 0;
+	for ( size_t i = 0; i < length; i++ )
+		value = (value << 8) | p[i];
+	return value;
+}
+
+inline void add_counters(ipfix_counters &sum, const ipfix_counters &c) {
+	sum.messages += c.messages;
+	sum.records += c.records;
+	sum.octets += c.octets;
+	sum.packets += c.packets;
+}
+
+/// The address and port of an exporter, like 10.0.0.1:4739 or [::1]:4739.
+std::string format_exporter(const struct sockaddr_storage &addr) {
+	char name[INET6_ADDRSTRLEN] = "";
+	std::ostringstream out;
+
+	if ( addr.ss_family == AF_INET ) {
+		const sockaddr_in *in4 = reinterpret_cast<const sockaddr_in *>(&addr);
+		inet_ntop(AF_INET, &in4->sin_addr, name, sizeof(name));
+		out << name << ":" << ntohs(in4->sin_port);
+	}
+	else if ( addr.ss_family == AF_INET6 ) {
+		const sockaddr_in6 *in6 = reinterpret_cast<const sockaddr_in6 *>(&addr);
+		inet_ntop(AF_INET6, &in6->sin6_addr, name, sizeof(name));
+		out << "[" << name << "]:" << ntohs(in6->sin6_port);
+	}
+
+	return out.str();
+}
+
+} // anonymous namespace
+
+
+const size_t ipfix_collector::DEFAULT_QUEUE_LIMIT;
+const size_t ipfix_collector::MAX_MESSAGE_SIZE;
+
+
+std::ostream &mnslp::operator<<(std::ostream &out, const ipfix_counters &c) {
+	return out << "[ipfix_counters: messages=" << c.messages
+		<< " records=" << c.records << " octets=" << c.octets
+		<< " packets=" << c.packets << "]";
+}
+
+
+std::ostream &mnslp::operator<<(std::ostream &out,
+		const ipfix_collector_stats &s) {
+
+	return out << "[ipfix_collector: received=" << s.received
+		<< " dropped=" << s.dropped << " malformed=" << s.malformed
+		<< " missing_templates=" << s.missing_templates
+		<< " records=" << s.records << "]";
+}
+
+
+/**
+ * Constructor.
+ */
+ipfix_domain::ipfix_domain() : missing_templates(0), malformed(0) {
+	// nothing to do
+}
+
+
+/**
+ * Decode an IPFIX or NetFlow v9 message of this domain.
+ *
+ * Template sets replace the templates they define, data sets are added
+ * to the counters. Data sets of unknown templates are skipped.
+ *
+ * @param msg the message, starting with its header
+ * @param length the number of bytes in msg
+ * @return the number of data records decoded
+ */
+size_t ipfix_domain::decode(const uchar *msg, size_t length) {
+	uint32 domain;
+	size_t msg_length;
+
+	if ( ! ipfix_collector::parse_header(msg, length, domain, msg_length) ) {
+		malformed++;
+		return 0;
+	}
+
+	bool ipfix = ( read16(msg) == IPFIX_VERSION );
+	size_t pos = ipfix ? IPFIX_HDR_BYTES : IPFIX_HDR_BYTES_NF9;
+	uint64 records = counters.records;
+
+	counters.messages++;
+
+	while ( pos + 4 <= msg_length ) {
+		uint16 setid = read16(msg + pos);
+		uint16 setlen = read16(msg + pos + 2);
+
+		if ( setlen < 4 || pos + setlen > msg_length ) {
+			malformed++;
+			break;
+		}
+
+		const uchar *body = msg + pos + 4;
+		size_t body_length = setlen - 4;
+
+		if ( setid > 255 ) {
+			templates_t::const_iterator i = templates.find(setid);
+
+			if ( i != templates.end() )
+				decode_records(i->second, body, body_length);
+			else
+				missing_templates++;
+		}
+		else if ( ipfix ? ( setid == IPFIX_SETID_TEMPLATE 
+						|| setid == IPFIX_SETID_OPTTEMPLATE )
+					: ( setid == IPFIX_SETID_TEMPLATE_NF9
+						|| setid == IPFIX_SETID_OPTTEMPLATE_NF9 ) ) {
+			if ( ! decode_templates(setid, ipfix, body, body_length) )
+				malformed++;
+		}
+
+		// Other sets are reserved, skip them.
+		pos += setlen;
+	}
+
+	return counters.records - records;
+}
+
+
+/**
+ * Read the template records of a template set.
+ *
+ * @return false if the set is cut short or defines an invalid template
+ */
+bool ipfix_domain::decode_templates(uint16 setid, bool ipfix,
+		const uchar *buf, size_t length) {
+
+	bool options = ( setid == ( ipfix ? IPFIX_SETID_OPTTEMPLATE 
+									  : IPFIX_SETID_OPTTEMPLATE_NF9 ) );
+	size_t pos = 0;
+
+	// Up to three bytes of padding may follow the last record.
+	while ( pos + 4 <= length ) {
+		uint16 tid = read16(buf + pos);
+		size_t nfields;
+
+		if ( options && pos + 6 > length )
+			return false;
+
+		// NetFlow v9 gives the lengths of the scope and option fields.
+		if ( options && ! ipfix )
+			nfields = ( read16(buf + pos + 2) + read16(buf + pos + 4) ) / 4;
+		else
+			nfields = read16(buf + pos + 2);
+
+		pos += options ? 6 : 4;
+
+		// An IPFIX withdrawal, of all templates if it uses the set ID.
+		if ( nfields == 0 ) {
+			if ( tid == setid )
+				templates.clear();
+			else
+				templates.erase(tid);
+			continue;
+		}
+
+		if ( tid <= 255 )
+			return false;
+
+		record_layout layout;
+		size_t offset = 0;
+		bool fixed = true;
+
+		for ( size_t i = 0; i < nfields; i++ ) {
+			if ( pos + 4 > length )
+				return false;
+
+			uint16 type = read16(buf + pos);
+			field_layout field;
+			field.length = read16(buf + pos + 2);
+			field.offset = fixed ? offset : 0;
+			field.kind = FK_OTHER;
+			pos += 4;
+
+			// Enterprise specific, followed by the enterprise number.
+			if ( ipfix && ( type & IPFIX_EFT_VENDOR_BIT ) ) {
+				if ( pos + 4 > length )
+					return false;
+				pos += 4;
+			}
+			else if ( field.length >= 1 && field.length <= 8 ) {
+				if ( type == IPFIX_FT_OCTETDELTACOUNT )
+					field.kind = FK_OCTETS;
+				else if ( type == IPFIX_FT_PACKETDELTACOUNT )
+					field.kind = FK_PACKETS;
+			}
+
+			if ( field.length == IPFIX_FT_VARLEN )
+				fixed = false;
+			else
+				offset += field.length;
+
+			layout.fields.push_back(field);
+			if ( field.kind != FK_OTHER )
+				layout.counters.push_back(field);
+		}
+
+		layout.length = ( fixed && offset <= 0xFFFF ) ? offset : 0;
+
+		templates[tid] = layout;
+	}
+
+	return true;
+}
+
+
+/**
+ * Add up the records of a data set.
+ *
+ * Records of fixed length are read at the offsets of the counters, the
+ * others field by field. Padding at the end of the set is ignored.
+ */
+void ipfix_domain::decode_records(const record_layout &layout,
+		const uchar *buf, size_t length) {
+
+	uint64 octets = 0, packets = 0;
+
+	if ( layout.length > 0 ) {
+		size_t nrecords = length / layout.length;
+		const std::vector<field_layout> &fields = layout.counters;
+
+		for ( size_t r = 0; r < nrecords; r++ ) {
+			const uchar *record = buf + r * layout.length;
+
+			for ( size_t i = 0; i < fields.size(); i++ ) {
+				uint64 value = read_unsigned(record + fields[i].offset, 
+											 fields[i].length);
+				if ( fields[i].kind == FK_OCTETS )
+					octets += value;
+				else
+					packets += value;
+			}
+		}
+
+		counters.records += nrecords;
+		counters.octets += octets;
+		counters.packets += packets;
+		return;
+	}
+
+	size_t pos = 0;
+
+	while ( pos < length ) {
+		uint64 record_octets = 0, record_packets = 0;
+		size_t p = pos;
+
+		for ( size_t i = 0; i < layout.fields.size(); i++ ) {
+			const field_layout &field = layout.fields[i];
+			size_t flength = field.length;
+
+			if ( flength == IPFIX_FT_VARLEN ) {
+				if ( p >= length )
+					return;		// padding
+				flength = buf[p++];
+
+				if ( flength == 255 ) {
+					if ( p + 2 > length )
+						return;
+					flength = read16(buf + p);
+					p += 2;
+				}
+			}
+
+			if ( p + flength > length )
+				return;			// padding
+
+			if ( field.kind == FK_OCTETS )
+				record_octets += read_unsigned(buf + p, flength);
+			else if ( field.kind == FK_PACKETS )
+				record_packets += read_unsigned(buf + p, flength);
+
+			p += flength;
+		}
+
+		// Only empty fields, nothing more to read.
+		if ( p == pos )
+			return;
+
+		counters.records++;
+		counters.octets += record_octets;
+		counters.packets += record_packets;
+		pos = p;
+	}
+}
+
+
+/**
+ * Constructor.
+ *
+ * @param address the local address to listen on
+ * @param port the port to listen on, 0 to only decode submitted messages
+ * @param protocol UDP or TCP
+ * @param num_workers the number of decoding threads
+ * @param queue_limit the messages each worker may have waiting
+ */
+ipfix_collector::ipfix_collector(const std::string &address, uint16 port,
+		protocol_t protocol, size_t num_workers, size_t queue_limit)
+		: address(address), port(port), protocol(protocol),
+		  queue_limit(queue_limit), sock(-1), running(false),
+		  received(0), dropped(0), malformed(0) {
+
+	pthread_mutex_init(&rules_mutex, NULL);
+
+	for ( size_t i = 0; i < std::max(num_workers, size_t(1)); i++ ) {
+		worker *w = new worker();
+
+		pthread_mutex_init(&w->mutex, NULL);
+		pthread_cond_init(&w->ready, NULL);
+		pthread_cond_init(&w->idle, NULL);
+		pthread_mutex_init(&w->domains_mutex, NULL);
+		w->busy = false;
+		w->collector = this;
+
+		workers.push_back(w);
+	}
+}
+
+
+/**
+ * Destructor.
+ *
+ * Stops the collector, messages still queued are decoded first.
+ */
+ipfix_collector::~ipfix_collector() {
+	stop();
+
+	for ( size_t i = 0; i < workers.size(); i++ ) {
+		worker *w = workers[i];
+
+		// Only left if the collector was never started.
+		for ( size_t j = 0; j < w->queue.size(); j++ )
+			delete [] w->queue[j].data;
+
+		pthread_mutex_destroy(&w->mutex);
+		pthread_cond_destroy(&w->ready);
+		pthread_cond_destroy(&w->idle);
+		pthread_mutex_destroy(&w->domains_mutex);
+		delete w;
+	}
+
+	pthread_mutex_destroy(&rules_mutex);
+}
+
+
+/**
+ * Open the port and start the listener and worker threads.
+ *
+ * @return false if the port can't be opened
+ */
+bool ipfix_collector::start() {
+	if ( running )
+		return true;
+
+	if ( port != 0 && ! open_socket() )
+		return false;
+
+	running = true;
+
+	for ( size_t i = 0; i < workers.size(); i++ )
+		pthread_create(&workers[i]->thread, NULL, worker_thread, workers[i]);
+
+	if ( sock >= 0 ) {
+		pthread_create(&listener, NULL, listener_thread, this);
+		LogInfo("collecting IPFIX on " 
+			<< ( protocol == UDP ? "udp:" : "tcp:" ) << address << ":"
+			<< port << " with " << workers.size() << " workers");
+	}
+
+	return true;
+}
+
+
+/**
+ * Close the port and wait for the threads.
+ */
+void ipfix_collector::stop() {
+	if ( ! running )
+		return;
+
+	running = false;
+
+	if ( sock >= 0 ) {
+		pthread_join(listener, NULL);
+		close(sock);
+		sock = -1;
+	}
+
+	for ( size_t i = 0; i < workers.size(); i++ ) {
+		pthread_mutex_lock(&workers[i]->mutex);
+		pthread_cond_signal(&workers[i]->ready);
+		pthread_mutex_unlock(&workers[i]->mutex);
+	}
+
+	for ( size_t i = 0; i < workers.size(); i++ )
+		pthread_join(workers[i]->thread, NULL);
+}
+
+
+/**
+ * Queue a message for the worker of its observation domain.
+ *
+ * The message is copied, msg may be reused when this returns.
+ *
+ * @param exporter the address and port the message came from
+ * @return false if the message was malformed or the queue was full
+ */
+bool ipfix_collector::submit(const uchar *msg, size_t length,
+		const std::string &exporter) {
+	uint32 domain;
+	size_t msg_length;
+
+	if ( ! parse_header(msg, length, domain, msg_length) ) {
+		__sync_fetch_and_add(&malformed, 1);
+		return false;
+	}
+
+	worker *w = get_worker(domain);
+
+	message m;
+	m.domain = ipfix_domain_id(domain, exporter);
+	m.length = msg_length;
+	m.data = new uchar[msg_length];
+	memcpy(m.data, msg, msg_length);
+
+	pthread_mutex_lock(&w->mutex);
+
+	if ( w->queue.size() >= queue_limit ) {
+		pthread_mutex_unlock(&w->mutex);
+		delete [] m.data;
+		__sync_fetch_and_add(&dropped, 1);
+		return false;
+	}
+
+	w->queue.push_back(m);
+	pthread_cond_signal(&w->ready);
+
+	pthread_mutex_unlock(&w->mutex);
+
+	__sync_fetch_and_add(&received, 1);
+	return true;
+}
+
+
+/**
+ * Drop the templates of an exporter whose transport session ended.
+ *
+ * The counters are kept. The exporter's domains may be spread over all
+ * workers, each one gets a message that is never dropped.
+ */
+void ipfix_collector::end_session(const std::string &exporter) {
+	for ( size_t i = 0; i < workers.size(); i++ ) {
+		worker *w = workers[i];
+
+		message m;
+		m.domain = ipfix_domain_id(0, exporter);
+		m.length = 0;
+		m.data = NULL;
+
+		pthread_mutex_lock(&w->mutex);
+		w->queue.push_back(m);
+		pthread_cond_signal(&w->ready);
+		pthread_mutex_unlock(&w->mutex);
+	}
+}
+
+
+/**
+ * Wait until the workers have decoded all messages submitted so far.
+ */
+void ipfix_collector::flush() {
+	for ( size_t i = 0; i < workers.size(); i++ ) {
+		worker *w = workers[i];
+
+		pthread_mutex_lock(&w->mutex);
+		while ( running && ( ! w->queue.empty() || w->busy ) )
+			pthread_cond_wait(&w->idle, &w->mutex);
+		pthread_mutex_unlock(&w->mutex);
+	}
+}
+
+
+/**
+ * Count the records of an Observation Domain ID for a policy rule.
+ *
+ * Rules sharing a task are bound to the same ID. The counters of the ID
+ * start over when the first rule is bound, earlier records belong to
+ * whatever exported to it before.
+ */
+void ipfix_collector::bind_rule(uint32 domain, const mspec_rule_key &key) {
+	pthread_mutex_lock(&rules_mutex);
+
+	std::map<mspec_rule_key, uint32>::iterator r = rules.find(key);
+	if ( r != rules.end() && --bound[r->second] == 0 )
+		bound.erase(r->second);
+
+	rules[key] = domain;
+	bool first = ( bound[domain]++ == 0 );
+
+	pthread_mutex_unlock(&rules_mutex);
+
+	if ( ! first )
+		return;
+
+	worker *w = get_worker(domain);
+
+	pthread_mutex_lock(&w->domains_mutex);
+
+	domains_t::iterator i = w->domains.lower_bound(ipfix_domain_id(domain));
+	for ( ; i != w->domains.end() && i->first.odid == domain; ++i )
+		i->second.reset_counters();
+
+	pthread_mutex_unlock(&w->domains_mutex);
+}
+
+
+void ipfix_collector::unbind_rule(const mspec_rule_key &key) {
+	pthread_mutex_lock(&rules_mutex);
+
+	std::map<mspec_rule_key, uint32>::iterator r = rules.find(key);
+	if ( r != rules.end() ) {
+		if ( --bound[r->second] == 0 )
+			bound.erase(r->second);
+		rules.erase(r);
+	}
+
+	pthread_mutex_unlock(&rules_mutex);
+}
+
+
+/**
+ * Get the counters of the domain a policy rule is bound to.
+ *
+ * @return false if the rule isn't bound or nothing arrived for it yet
+ */
+bool ipfix_collector::get_counters(const mspec_rule_key &key,
+		ipfix_counters &c) {
+
+	pthread_mutex_lock(&rules_mutex);
+
+	std::map<mspec_rule_key, uint32>::const_iterator i = rules.find(key);
+	bool bound = ( i != rules.end() );
+	uint32 domain = bound ? i->second : 0;
+
+	pthread_mutex_unlock(&rules_mutex);
+
+	return bound && get_counters(domain, c);
+}
+
+
+/**
+ * Get the counters of an Observation Domain ID, summed over all exporters.
+ *
+ * @return false if nothing arrived for the ID yet
+ */
+bool ipfix_collector::get_counters(uint32 domain, ipfix_counters &c) {
+	worker *w = get_worker(domain);
+	ipfix_counters sum;
+	bool found = false;
+
+	pthread_mutex_lock(&w->domains_mutex);
+
+	domains_t::const_iterator i = w->domains.lower_bound(ipfix_domain_id(domain));
+	for ( ; i != w->domains.end() && i->first.odid == domain; ++i ) {
+		add_counters(sum, i->second.get_counters());
+		found = true;
+	}
+
+	pthread_mutex_unlock(&w->domains_mutex);
+
+	if ( found )
+		c = sum;
+
+	return found;
+}
+
+
+ipfix_collector_stats ipfix_collector::get_stats() {
+	ipfix_collector_stats s;
+
+	s.received = received;
+	s.dropped = dropped;
+	s.malformed = malformed;
+
+	for ( size_t i = 0; i < workers.size(); i++ ) {
+		worker *w = workers[i];
+
+		pthread_mutex_lock(&w->domains_mutex);
+
+		domains_t::const_iterator d;
+		for ( d = w->domains.begin(); d != w->domains.end(); ++d ) {
+			s.malformed += d->second.get_malformed();
+			s.missing_templates += d->second.get_missing_templates();
+			s.records += d->second.get_counters().records;
+		}
+
+		pthread_mutex_unlock(&w->domains_mutex);
+	}
+
+	return s;
+}
+
+
+bool ipfix_collector::parse_protocol(const std::string &name,
+		protocol_t &protocol) {
+
+	if ( name == "udp" )
+		protocol = UDP;
+	else if ( name == "tcp" )
+		protocol = TCP;
+	else
+		return false;
+
+	return true;
+}
+
+
+/**
+ * Read the observation domain and length of a message.
+ *
+ * NetFlow v9 has no length field, the message is all of its datagram.
+ *
+ * @return false if the message is neither IPFIX nor NetFlow v9, or is
+ * 	shorter than its header says
+ */
+bool ipfix_collector::parse_header(const uchar *msg, size_t length,
+		uint32 &domain, size_t &msg_length) {
+
+	if ( length < 2 )
+		return false;
+
+	switch ( read16(msg) ) {
+	  case IPFIX_VERSION:
+		if ( length < IPFIX_HDR_BYTES )
+			return false;
+		msg_length = read16(msg + 2);
+		if ( msg_length < IPFIX_HDR_BYTES || msg_length > length )
+			return false;
+		domain = read32(msg + 12);
+		return true;
+
+	  case IPFIX_VERSION_NF9:
+		if ( length < IPFIX_HDR_BYTES_NF9 )
+			return false;
+		msg_length = length;
+		domain = read32(msg + 16);
+		return true;
+
+	  default:
+		return false;
+	}
+}
+
+
+bool ipfix_collector::open_socket() {
+	struct sockaddr_storage addr;
+	socklen_t addr_length;
+
+	memset(&addr, 0, sizeof(addr));
+
+	struct sockaddr_in *in4 = reinterpret_cast<sockaddr_in *>(&addr);
+	struct sockaddr_in6 *in6 = reinterpret_cast<sockaddr_in6 *>(&addr);
+
+	if ( inet_pton(AF_INET, address.c_str(), &in4->sin_addr) == 1 ) {
+		in4->sin_family = AF_INET;
+		in4->sin_port = htons(port);
+		addr_length = sizeof(*in4);
+	}
+	else if ( inet_pton(AF_INET6, address.c_str(), &in6->sin6_addr) == 1 ) {
+		in6->sin6_family = AF_INET6;
+		in6->sin6_port = htons(port);
+		addr_length = sizeof(*in6);
+	}
+	else {
+		LogError("invalid collector address " << address);
+		return false;
+	}
+
+	sock = socket(addr.ss_family,
+		protocol == UDP ? SOCK_DGRAM : SOCK_STREAM, 0);
+
+	if ( sock < 0 ) {
+		LogError("unable to create the collector socket: " << strerror(errno));
+		return false;
+	}
+
+	int on = 1;
+	setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+	if ( protocol == UDP )
+		setsockopt(sock, SOL_SOCKET, SO_RCVBUF, 
+			&UDP_RECEIVE_BUFFER, sizeof(UDP_RECEIVE_BUFFER));
+
+	if ( bind(sock, reinterpret_cast<sockaddr *>(&addr), addr_length) < 0
+			|| ( protocol == TCP && listen(sock, SOMAXCONN) < 0 ) ) {
+		LogError("unable to listen on " << address << ":" << port 
+			<< ": " << strerror(errno));
+		close(sock);
+		sock = -1;
+		return false;
+	}
+
+	return true;
+}
+
+
+/**
+ * Return the worker of an Observation Domain ID, whatever the exporter.
+ */
+ipfix_collector::worker *ipfix_collector::get_worker(uint32 domain) {
+	return workers[domain % workers.size()];
+}
+
+
+/**
+ * Read datagrams, each one holds one message. Each sender is a transport
+ * session of its own.
+ */
+void ipfix_collector::listen_udp() {
+	std::vector<uchar> buf(MAX_MESSAGE_SIZE);
+
+	// Most datagrams come from the same sender as the one before.
+	struct sockaddr_storage last;
+	socklen_t last_length = 0;
+	std::string exporter;
+
+	while ( running ) {
+		struct pollfd pfd = { sock, POLLIN, 0 };
+
+		if ( poll(&pfd, 1, POLL_TIMEOUT) <= 0 )
+			continue;
+
+		// Take all that arrived, there is a poll() per burst only.
+		for ( int i = 0; i < UDP_BURST; i++ ) {
+			struct sockaddr_storage from;
+			socklen_t from_length = sizeof(from);
+
+			ssize_t n = recvfrom(sock, &buf[0], buf.size(), MSG_DONTWAIT,
+				reinterpret_cast<sockaddr *>(&from), &from_length);
+			if ( n <= 0 )
+				break;
+
+			if ( from_length != last_length
+					|| memcmp(&from, &last, from_length) != 0 ) {
+				memcpy(&last, &from, from_length);
+				last_length = from_length;
+				exporter = format_exporter(from);
+			}
+
+			submit(&buf[0], n, exporter);
+		}
+	}
+}
+
+
+/**
+ * Accept connections and cut their streams into messages. Streams carry
+ * IPFIX only, NetFlow v9 has no length to tell where a message ends.
+ * Each connection is a transport session.
+ */
+void ipfix_collector::listen_tcp() {
+	std::vector<struct pollfd> fds;
+	std::vector<std::vector<uchar> > streams;
+	std::vector<std::string> exporters;
+	std::vector<uchar> buf(MAX_MESSAGE_SIZE);
+
+	struct pollfd listening = { sock, POLLIN, 0 };
+	fds.push_back(listening);
+	streams.push_back(std::vector<uchar>());
+	exporters.push_back("");
+
+	while ( running ) {
+		if ( poll(&fds[0], fds.size(), POLL_TIMEOUT) <= 0 )
+			continue;
+
+		if ( fds[0].revents & POLLIN ) {
+			struct sockaddr_storage from;
+			socklen_t from_length = sizeof(from);
+
+			int fd = accept(sock, reinterpret_cast<sockaddr *>(&from),
+				&from_length);
+
+			if ( fd >= 0 ) {
+				struct pollfd conn = { fd, POLLIN, 0 };
+				fds.push_back(conn);
+				streams.push_back(std::vector<uchar>());
+				exporters.push_back(format_exporter(from));
+			}
+		}
+
+		for ( size_t i = fds.size() - 1; i > 0; i-- ) {
+			if ( fds[i].revents == 0 )
+				continue;
+
+			ssize_t n = recv(fds[i].fd, &buf[0], buf.size(), MSG_DONTWAIT);
+			bool closed = ( n == 0 || ( n < 0 && errno != EAGAIN ) );
+
+			std::vector<uchar> &stream = streams[i];
+			if ( n > 0 )
+				stream.insert(stream.end(), buf.begin(), buf.begin() + n);
+
+			size_t pos = 0;
+			while ( ! closed && stream.size() - pos >= 4 ) {
+				size_t length = read16(&stream[pos + 2]);
+
+				if ( read16(&stream[pos]) != IPFIX_VERSION 
+						|| length < IPFIX_HDR_BYTES ) {
+					__sync_fetch_and_add(&malformed, 1);
+					closed = true;
+				}
+				else if ( stream.size() - pos >= length ) {
+					submit(&stream[pos], length, exporters[i]);
+					pos += length;
+				}
+				else
+					break;
+			}
+			stream.erase(stream.begin(), stream.begin() + pos);
+
+			if ( closed ) {
+				close(fds[i].fd);
+				end_session(exporters[i]);
+				fds.erase(fds.begin() + i);
+				streams.erase(streams.begin() + i);
+				exporters.erase(exporters.begin() + i);
+			}
+		}
+	}
+
+	for ( size_t i = 1; i < fds.size(); i++ ) {
+		close(fds[i].fd);
+		end_session(exporters[i]);
+	}
+}
+
+
+/**
+ * Decode the messages of a worker's domains, a queue at a time.
+ */
+void ipfix_collector::run_worker(worker *w) {
+	std::deque<message> batch;
+
+	pthread_mutex_lock(&w->mutex);
+
+	while ( true ) {
+		while ( w->queue.empty() && running )
+			pthread_cond_wait(&w->ready, &w->mutex);
+
+		// Stopped, but queued messages are still decoded.
+		if ( w->queue.empty() )
+			break;
+
+		batch.swap(w->queue);
+		w->busy = true;
+
+		pthread_mutex_unlock(&w->mutex);
+
+		pthread_mutex_lock(&w->domains_mutex);
+		for ( size_t i = 0; i < batch.size(); i++ ) {
+			const message &m = batch[i];
+
+			if ( m.data != NULL ) {
+				w->domains[m.domain].decode(m.data, m.length);
+				continue;
+			}
+
+			domains_t::iterator d;
+			for ( d = w->domains.begin(); d != w->domains.end(); ++d )
+				if ( d->first.exporter == m.domain.exporter )
+					d->second.clear_templates();
+		}
+		pthread_mutex_unlock(&w->domains_mutex);
+
+		for ( size_t i = 0; i < batch.size(); i++ )
+			delete [] batch[i].data;
+		batch.clear();
+
+		pthread_mutex_lock(&w->mutex);
+
+		w->busy = false;
+		if ( w->queue.empty() )
+			pthread_cond_broadcast(&w->idle);
+	}
+
+	w->busy = false;
+	pthread_cond_broadcast(&w->idle);
+
+	pthread_mutex_unlock(&w->mutex);
+}
+
+
+void *ipfix_collector::listener_thread(void *arg) {
+	ipfix_collector *collector = static_cast<ipfix_collector *>(arg);
+
+	if ( collector->protocol == UDP )
+		collector->listen_udp();
+	else
+		collector->listen_tcp();
+
+	return NULL;
+}
+
+
+void *ipfix_collector::worker_thread(void *arg) {
+	worker *w = static_cast<worker *>(arg);
+
+	w->collector->run_worker(w);
+
+	return NULL;
+}
+
+// EOF
@@ -0,0 +1,410 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file ipfix_collector_bench.cpp
+/// Replay a capture of IPFIX messages through the collector.
+/// ----------------------------------------------------------
+/// $Id: ipfix_collector_bench.cpp 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./src/ipfix_collector_bench.cpp $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <vector>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "logfile.h"
+#include "ipfix_collector.h"
+
+using namespace mnslp;
+using namespace protlib::log;
+
+
+/*
+ * The capture is a pcap file. The replay takes the UDP payloads of the
+ * IPv4 and IPv6 packets in it, whether captured on Ethernet, as raw IP 
+ * or with the Linux cooked header. Without a file, one is written with
+ * messages like those of the metering application: a data set of flow
+ * records per message, and the template every TEMPLATE_INTERVAL messages
+ * of a domain.
+ */
+static const uint32 PCAP_MAGIC = 0xa1b2c3d4;
+static const uint32 PCAP_MAGIC_NS = 0xa1b23c4d;
+
+static const uint32 LINKTYPE_ETHERNET = 1;
+static const uint32 LINKTYPE_RAW = 101;
+static const uint32 LINKTYPE_LINUX_SLL = 113;
+
+static const int TEMPLATE_INTERVAL = 16;
+static const int RECORDS_PER_MESSAGE = 30;
+
+typedef std::vector<uchar> packet;
+
+
+static double now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+
+static void put16(packet &p, uint16 v) {
+	p.push_back(v >> 8);
+	p.push_back(v);
+}
+
+
+static void put32(packet &p, uint32 v) {
+	put16(p, v >> 16);
+	put16(p, v);
+}
+
+
+static uint16 get16(const uchar *p) {
+	return (uint16(p[0]) << 8) | p[1];
+}
+
+
+/*
+ * A message with the template of flow records, if asked for, followed
+ * by a data set of records: addresses, ports, protocol, and the octet 
+ * and packet counts.
+ */
+static packet build_message(uint32 domain, uint32 sequence, bool with_template) {
+	static const uint16 fields[][2] = {
+		{ 8, 4 }, { 12, 4 }, { 7, 2 }, { 11, 2 }, { 4, 1 },
+		{ 1, 8 }, { 2, 8 }
+	};
+	static const int num_fields = sizeof(fields) / sizeof(fields[0]);
+
+	packet p;
+	put16(p, 10);
+	put16(p, 0);
+	put32(p, 0);
+	put32(p, sequence);
+	put32(p, domain);
+
+	if ( with_template ) {
+		put16(p, 2);
+		put16(p, 8 + 4 * num_fields);
+		put16(p, 256);
+		put16(p, num_fields);
+		for ( int i = 0; i < num_fields; i++ ) {
+			put16(p, fields[i][0]);
+			put16(p, fields[i][1]);
+		}
+	}
+
+	size_t set_start = p.size();
+	put16(p, 256);
+	put16(p, 0);
+
+	for ( int r = 0; r < RECORDS_PER_MESSAGE; r++ ) {
+		put32(p, 0x0a000000 | r);
+		put32(p, 0x0a010000 | domain);
+		put16(p, 10000 + r);
+		put16(p, 80);
+		p.push_back(6);
+		put32(p, 0);  put32(p, 1500 * (r + 1));
+		put32(p, 0);  put32(p, r + 1);
+	}
+
+	p[set_start + 2] = (p.size() - set_start) >> 8;
+	p[set_start + 3] = (p.size() - set_start);
+	p[2] = p.size() >> 8;
+	p[3] = p.size();
+
+	return p;
+}
+
+
+/*
+ * Write messages as UDP datagrams in Ethernet frames.
+ */
+static bool write_capture(const char *filename, int num_messages, int num_domains) {
+	std::ofstream out(filename, std::ios::binary);
+
+	uint32 header[6] = { PCAP_MAGIC, 2 | (4 << 16), 0, 0, 65535, LINKTYPE_ETHERNET };
+	out.write(reinterpret_cast<char *>(header), sizeof(header));
+
+	for ( int i = 0; i < num_messages; i++ ) {
+		uint32 domain = i % num_domains + 1;
+		uint32 sequence = i / num_domains;
+		packet msg = build_message(domain, sequence, 
+			sequence % TEMPLATE_INTERVAL == 0);
+
+		packet frame(12, 0);			// MAC addresses
+		put16(frame, 0x0800);
+		put16(frame, 0x4500);			// IPv4, no options
+		put16(frame, 20 + 8 + msg.size());
+		put32(frame, 0);
+		put16(frame, 0x4011);			// TTL, UDP
+		put16(frame, 0);
+		put32(frame, 0x7f000001);
+		put32(frame, 0x7f000001);
+		put16(frame, 4739);
+		put16(frame, 4739);
+		put16(frame, 8 + msg.size());
+		put16(frame, 0);
+		frame.insert(frame.end(), msg.begin(), msg.end());
+
+		uint32 record[4] = { i / 1000, (i % 1000) * 1000, 
+			(uint32) frame.size(), (uint32) frame.size() };
+		out.write(reinterpret_cast<char *>(record), sizeof(record));
+		out.write(reinterpret_cast<char *>(&frame[0]), frame.size());
+	}
+
+	return out.good();
+}
+
+
+/*
+ * Return the UDP payload of a captured packet, or NULL.
+ */
+static const uchar *udp_payload(uint32 linktype, const uchar *p, size_t &length) {
+	size_t offset;
+	uint16 ethertype;
+
+	switch ( linktype ) {
+	  case LINKTYPE_ETHERNET:
+		if ( length < 14 )
+			return NULL;
+		offset = 14;
+		ethertype = get16(p + 12);
+		if ( ethertype == 0x8100 && length >= 18 ) {	// VLAN tag
+			ethertype = get16(p + 16);
+			offset = 18;
+		}
+		break;
+	  case LINKTYPE_LINUX_SLL:
+		if ( length < 16 )
+			return NULL;
+		offset = 16;
+		ethertype = get16(p + 14);
+		break;
+	  case LINKTYPE_RAW:
+		if ( length < 1 )
+			return NULL;
+		offset = 0;
+		ethertype = ( p[0] >> 4 == 6 ) ? 0x86dd : 0x0800;
+		break;
+	  default:
+		return NULL;
+	}
+
+	size_t ip_length;
+	uchar protocol;
+
+	if ( ethertype == 0x0800 && length >= offset + 20 ) {
+		ip_length = ( p[offset] & 0x0f ) * 4;
+		protocol = p[offset + 9];
+	}
+	else if ( ethertype == 0x86dd && length >= offset + 40 ) {
+		ip_length = 40;		// extension headers are not followed
+		protocol = p[offset + 6];
+	}
+	else
+		return NULL;
+
+	offset += ip_length;
+
+	if ( protocol != 17 || length < offset + 8 )
+		return NULL;
+
+	length -= offset + 8;
+	return p + offset + 8;
+}
+
+
+static bool read_capture(const char *filename, std::vector<packet> &messages) {
+	std::ifstream in(filename, std::ios::binary);
+	uint32 header[6];
+
+	if ( ! in.read(reinterpret_cast<char *>(header), sizeof(header)) )
+		return false;
+
+	bool swapped = ( header[0] == __builtin_bswap32(PCAP_MAGIC) 
+		|| header[0] == __builtin_bswap32(PCAP_MAGIC_NS) );
+
+	if ( ! swapped && header[0] != PCAP_MAGIC && header[0] != PCAP_MAGIC_NS )
+		return false;
+
+	uint32 linktype = swapped ? __builtin_bswap32(header[5]) : header[5];
+	uint32 record[4];
+	packet data;
+
+	while ( in.read(reinterpret_cast<char *>(record), sizeof(record)) ) {
+		size_t caplen = swapped ? __builtin_bswap32(record[2]) : record[2];
+
+		data.resize(caplen);
+		if ( caplen > 0 && ! in.read(reinterpret_cast<char *>(&data[0]), caplen) )
+			break;
+
+		size_t length = caplen;
+		const uchar *payload = udp_payload(linktype, &data[0], length);
+
+		if ( payload != NULL && length > 0 )
+			messages.push_back(packet(payload, payload + length));
+	}
+
+	return true;
+}
+
+
+/*
+ * Decode all messages in this thread, the cost of decoding alone.
+ */
+static double run_inline(const std::vector<packet> &messages, uint64 &records) {
+	std::map<uint32, ipfix_domain> domains;
+	records = 0;
+
+	double start = now();
+
+	for ( size_t i = 0; i < messages.size(); i++ ) {
+		uint32 domain;
+		size_t length;
+
+		if ( ipfix_collector::parse_header(&messages[i][0], 
+				messages[i].size(), domain, length) )
+			records += domains[domain].decode(&messages[i][0], length);
+	}
+
+	return now() - start;
+}
+
+
+/*
+ * Hand all messages to the workers of a collector, as the listener does.
+ */
+static double run_workers(const std::vector<packet> &messages, 
+		size_t num_workers, ipfix_collector_stats &stats) {
+
+	// Nothing is dropped, the replay is faster than any exporter.
+	ipfix_collector collector("127.0.0.1", 0, ipfix_collector::UDP, 
+		num_workers, messages.size());
+	collector.start();
+
+	double start = now();
+
+	for ( size_t i = 0; i < messages.size(); i++ )
+		collector.submit(&messages[i][0], messages[i].size());
+	collector.flush();
+
+	double elapsed = now() - start;
+
+	stats = collector.get_stats();
+	collector.stop();
+
+	return elapsed;
+}
+
+
+static void report(std::ostream &out, const char *name, uint64 records, 
+		size_t bytes, double elapsed) {
+
+	out << std::setw(10) << name << ": " << records << " records, "
+		<< (unsigned long) ( records / elapsed ) << " records/s, "
+		<< std::fixed << std::setprecision(1)
+		<< bytes / elapsed / 1e6 << " MB/s" << std::endl;
+}
+
+
+/*
+ * usage: ipfix_collector_bench [capture [workers [messages [domains]]]]
+ *
+ * Use "-" as capture to replay a generated capture.
+ */
+int main(int argc, char *argv[]) {
+	std::string filename = ( argc > 1 ) ? argv[1] : "-";
+	int num_workers = ( argc > 2 ) ? atoi(argv[2]) : 4;
+	int num_messages = ( argc > 3 ) ? atoi(argv[3]) : 100000;
+	int num_domains = ( argc > 4 ) ? atoi(argv[4]) : 16;
+
+	commonlog.set_filter(INFO_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(DEBUG_LOG, LOG_EMERG + 1);
+
+	bool generated = ( filename == "-" );
+	if ( generated ) {
+		char name[] = "/tmp/ipfix_collector_bench.XXXXXX";
+		int fd = mkstemp(name);
+		if ( fd < 0 ) {
+			std::cerr << "unable to create a capture file" << std::endl;
+			return 1;
+		}
+		close(fd);
+		filename = name;
+
+		if ( ! write_capture(name, num_messages, std::max(num_domains, 1)) ) {
+			std::cerr << "unable to write " << filename << std::endl;
+			unlink(name);
+			return 1;
+		}
+	}
+
+	std::vector<packet> messages;
+	bool ok = read_capture(filename.c_str(), messages);
+
+	if ( generated )
+		unlink(filename.c_str());
+
+	if ( ! ok || messages.empty() ) {
+		std::cerr << "no UDP payloads in " << filename << std::endl;
+		return 1;
+	}
+
+	size_t bytes = 0;
+	for ( size_t i = 0; i < messages.size(); i++ )
+		bytes += messages[i].size();
+
+	std::cout << "capture: " << ( generated ? "generated" : filename ) 
+		<< ", " << messages.size() << " messages, " << bytes << " bytes" 
+		<< std::endl;
+
+	uint64 records;
+	double elapsed = run_inline(messages, records);
+	report(std::cout, "inline", records, bytes, elapsed);
+
+	// Double the workers up to the number asked for.
+	for ( int n = 1; n <= num_workers; 
+			n = ( n == num_workers ) ? n + 1 : std::min(n * 2, num_workers) ) {
+		ipfix_collector_stats stats;
+		elapsed = run_workers(messages, n, stats);
+
+		std::ostringstream name;
+		name << n << ( n == 1 ? " worker" : " workers" );
+		report(std::cout, name.str().c_str(), stats.records, bytes, elapsed);
+
+		if ( stats.dropped || stats.malformed || stats.missing_templates )
+			std::cout << "            " << stats << std::endl;
+	}
+
+	return 0;
+}
+
+// EOF
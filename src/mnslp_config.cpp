@@ -68,10 +68,32 @@ mnslp_config::registerAllPars()
   // register all mnslp parameters now
   registerPar( new configpar<string>(mnslp_realm, mnslpconf_conffilename, "config", "configuration file name", true, "nsis-ka.conf") );
   registerPar( new configpar<uint32>(mnslp_realm, mnslpconf_dispatcher_threads, "dispatcher-threads", "number of dispatcher threads", true, 1) );
+  registerPar( new configpar<uint32>(mnslp_realm, mnslpconf_dispatcher_batch_size, "dispatcher-batch-size", "maximum number of messages a dispatcher thread takes per wakeup", true, 32) );
+  registerPar( new configpar<uint32>(mnslp_realm, mnslpconf_dispatcher_batch_timeout, "dispatcher-batch-timeout", "time a dispatcher thread waits for the first message of a batch", true, 1000, "ms") );
+  registerPar( new configpar<uint32>(mnslp_realm, mnslpconf_dispatcher_lane_limit, "dispatcher-lane-limit", "maximum number of events a dispatcher thread takes from the input queue ahead of dispatching them", true, 1024) );
+  registerPar( new configpar<string>(mnslp_realm, mnslpconf_dispatcher_lane_weights, "dispatcher-lane-weights", "share of dispatching for timers, refreshes and teardowns, responses, and new sessions", true, "8,4,2,1") );
+  registerPar( new configpar<string>(mnslp_realm, mnslpconf_dispatcher_cpus, "dispatcher-cpus", "CPUs to pin the dispatcher threads to, one per thread in turn, e.g. 0-3,8 (empty=not pinned)", true, "") );
+  registerPar( new configpar<string>(mnslp_realm, mnslpconf_gist_cpus, "gist-cpus", "CPUs the GIST threads may run on, e.g. 4-7 (empty=not pinned)", true, "") );
+  registerPar( new configpar<uint32>(mnslp_realm, mnslpconf_admission_max_sessions, "admission-max-sessions", "reject new sessions beyond this number of live sessions (0=no limit)", true, 0) );
+  registerPar( new configpar<uint32>(mnslp_realm, mnslpconf_admission_max_pending_installs, "admission-max-pending-installs", "reject new sessions while this many policy rule installations and removals are pending (0=no limit)", true, 0) );
+  registerPar( new configpar<uint32>(mnslp_realm, mnslpconf_admission_queue_watermark, "admission-queue-watermark", "reject new sessions while the input queue holds more messages (0=no limit)", true, 0) );
+  registerPar( new configpar<uint32>(mnslp_realm, mnslpconf_admission_peer_rate, "admission-peer-rate", "new sessions accepted per second and neighbour (0=no limit)", true, 0) );
+  registerPar( new configpar<uint32>(mnslp_realm, mnslpconf_admission_peer_burst, "admission-peer-burst", "new sessions a neighbour may send at once (0=same as the rate)", true, 0) );
+  registerPar( new configpar<uint32>(mnslp_realm, mnslpconf_log_level, "log-level", "most verbose log level (0=error, 1=warning, 2=info, 3=debug)", true, 3) );
+  registerPar( new configpar<bool>(mnslp_realm, mnslpconf_log_async, "log-async", "write info and debug messages from a background thread", true, true) );
+  registerPar( new configpar<string>(mnslp_realm, mnslpconf_trace_components, "trace-components", "comma separated list of traced components (ipfix, events, session, installer, config, admission, all)", true, "") );
+  registerPar( new configpar<string>(mnslp_realm, mnslpconf_trace_file, "trace-file", "file the trace buffers are written to at shutdown", true, "") );
+  registerPar( new configpar<string>(mnslp_realm, mnslpconf_checkpoint_file, "checkpoint-file", "file the session table is saved to, so sessions survive a restart (empty=disabled)", true, "") );
+  registerPar( new configpar<string>(mnslp_realm, mnslpconf_collector_address, "collector-address", "local address the IPFIX collector listens on", true, "127.0.0.1") );
+  registerPar( new configpar<uint32>(mnslp_realm, mnslpconf_collector_port, "collector-port", "port the IPFIX collector listens on for metering results (0=disabled, at most 65535)", true, 0) );
+  registerPar( new configpar<string>(mnslp_realm, mnslpconf_collector_protocol, "collector-protocol", "transport of the IPFIX collector (udp, tcp)", true, "udp") );
+  registerPar( new configpar<uint32>(mnslp_realm, mnslpconf_collector_threads, "collector-threads", "number of threads decoding IPFIX messages", true, 2) );
   registerPar( new configpar<uint32>(mnslp_realm, mnslpconf_ni_max_session_lifetime, "ni-max-session-lifetime", "NI session lifetime in seconds", true, 30, "s") );
   registerPar( new configpar<uint32>(mnslp_realm, mnslpconf_ni_max_retries, "ni-max-retries", "NI max retries", true, 3) );
   registerPar( new configpar<uint32>(mnslp_realm, mnslpconf_ni_response_timeout, "ni-response-timeout", "NI response timeout", true, 2, "s") );
   registerPar( new configpar<uint32>(mnslp_realm, mnslpconf_ni_msg_hop_count, "ni-msg-hop-count", "NI Message Hop Count", true, 20, "s") );  
+  registerPar( new configpar<bool>(mnslp_realm, mnslpconf_ni_refresh_load_aware, "ni-refresh-load-aware", "spread the refreshes of all NI sessions evenly instead of at random", true, false) );
+  registerPar( new configpar<bool>(mnslp_realm, mnslpconf_refresh_bundling, "refresh-bundling", "send the refreshes of sessions sharing a next hop in one message", true, false) );
   registerPar( new configpar<uint32>(mnslp_realm, mnslpconf_nf_max_session_lifetime, "nf-max-session-lifetime", "NF max session lifetime in seconds", true, 60, "s") );
   registerPar( new configpar<uint32>(mnslp_realm, mnslpconf_nf_response_timeout, "nf-response-timeout", "NF response timeout", true, 2, "s") );
   registerPar( new configpar<bool>(mnslp_realm, mnslpconf_ms_is_meter, "ms-is-meter", "NE is meter", true, true) );
@@ -34,13 +34,19 @@
 #include "apimessage.h" // from NTLP
 
 #include "mnslp_config.h"
+#include "mnslp_log.h"
 #include "msg/mnslp_ie.h"
 #include "msg/mnslp_msg.h"
+#include "msg/mnslp_trace.h"
 #include "dispatcher.h"
+#include "event_batch.h"
 #include "mnslp_daemon.h"
 #include "benchmark_journal.h"
+#include "cpu_placement.h"
 
 #include <openssl/ssl.h>
+#include <fstream>
+#include <algorithm>
 
 using namespace protlib;
 using namespace protlib::log;
@@ -50,8 +56,8 @@ using namespace mnslp::msg;
 
 #define LogError(msg) ERRLog("mnslp_daemon", msg)
 #define LogWarn(msg) WLog("mnslp_daemon", msg)
-#define LogInfo(msg) ILog("mnslp_daemon", msg)
-#define LogDebug(msg) DLog("mnslp_daemon", msg)
+#define LogInfo(msg) MNSLP_LOG_INFO("mnslp_daemon", msg)
+#define LogDebug(msg) MNSLP_LOG_DEBUG("mnslp_daemon", msg)
 
 
 #ifdef BENCHMARK
@@ -65,7 +71,8 @@ using namespace mnslp::msg;
 mnslp_daemon::mnslp_daemon(const mnslp_daemon_param &param)
 		: Thread(param), config(param.config),
 		  session_mgr(&config), rule_installer(NULL), 
-		  ntlp_starter(NULL) {
+		  refresh_sched(NULL), refresh_bundles(NULL), admission(NULL),
+		  checkpoint(NULL), collector(NULL), ntlp_starter(NULL) {
 
 	startup();
 }
@@ -85,6 +92,12 @@ mnslp_daemon::~mnslp_daemon() {
 void mnslp_daemon::startup() {
 	LogInfo("starting MNSLP daemon ...");
 
+	logging::set_level(config.get_log_level());
+	if ( config.is_log_async() )
+		logging::start_writer();
+
+	trace::set_mask(trace::parse_components(config.get_trace_components()));
+
 	/*
 	 * Instantiate an operating system dependent policy rule installer.
 	 * We use the iptables policy rule installer only on NF nodes which
@@ -104,6 +117,65 @@ void mnslp_daemon::startup() {
 		LogError("unable to setup the policy rule installer: " << e);
 	}
 
+	// Rules of expired sessions are removed by a separate thread.
+	rule_installer->start_teardown();
+
+	// Shared by all dispatchers so it sees the refreshes of all sessions.
+	refresh_sched = new refresh_scheduler(config.is_ni_refresh_load_aware());
+
+	// Shared so that all dispatchers know which peers accept bundles.
+	refresh_bundles = new refresh_bundler(config.is_refresh_bundling());
+
+	admission = new admission_control(
+		config.get_admission_max_sessions(),
+		config.get_admission_max_pending_installs(),
+		config.get_admission_queue_watermark(),
+		config.get_admission_peer_rate(),
+		config.get_admission_peer_burst());
+
+	if ( config.get_checkpoint_file() != "" ) {
+		checkpoint = new session_checkpoint(config.get_checkpoint_file());
+
+		if ( ! checkpoint->open() ) {
+			LogError("unable to open the checkpoint log, "
+				"sessions won't survive a restart");
+			delete checkpoint;
+			checkpoint = NULL;
+		}
+	}
+
+	/*
+	 * The collector receives the results the metering application 
+	 * exports to ipfix targets.
+	 */
+	if ( config.get_collector_port() > 65535 ) {
+		LogError("invalid collector port " << config.get_collector_port()
+			<< ", metering results won't be collected");
+	}
+	else if ( config.get_collector_port() != 0 ) {
+		ipfix_collector::protocol_t protocol;
+
+		if ( ! ipfix_collector::parse_protocol(
+				config.get_collector_protocol(), protocol) ) {
+			LogError("invalid collector protocol " 
+				<< config.get_collector_protocol() << ", using udp");
+			protocol = ipfix_collector::UDP;
+		}
+
+		collector = new ipfix_collector(config.get_collector_address(),
+			uint16(config.get_collector_port()), protocol, 
+			config.get_collector_threads());
+
+		if ( ! collector->start() ) {
+			LogError("unable to start the IPFIX collector, "
+				"metering results won't be collected");
+			delete collector;
+			collector = NULL;
+		}
+		else
+			rule_installer->set_collector(collector);
+	}
+
     AddressList *addresses = new AddressList();
 
     hostaddresslist_t& ntlpv4addr= ntlp::gconf.getparref< hostaddresslist_t >(ntlp::gistconf_localaddrv4);
@@ -178,13 +250,32 @@ void mnslp_daemon::startup() {
 
 
 	/*
-	 * Start the GIST thread.
+	 * Start the GIST thread. The threads it starts inherit our CPU
+	 * affinity, so we take on the GIST CPUs while starting it.
 	 */
+	cpu_placement gist_cpus(config.get_gist_cpus());
+	cpu_set_t saved_cpus;
+	bool gist_pinned = false;
+
+	if ( ! gist_cpus.empty() ) {
+		pthread_getaffinity_np(pthread_self(), sizeof(saved_cpus), &saved_cpus);
+		gist_pinned = gist_cpus.pin_thread_to_all();
+
+		if ( ! gist_pinned )
+			LogWarn("unable to pin the GIST threads to CPUs "
+				<< config.get_gist_cpus());
+	}
+
 	NTLPStarterParam ntlpparam;
 	ntlpparam.addresses = addresses;	
 	ntlp_starter= new ThreadStarter<NTLPStarter, NTLPStarterParam>(1, ntlpparam);
 	ntlp_starter->start_processing();
 
+	if ( gist_pinned ) {
+		pthread_setaffinity_np(pthread_self(), sizeof(saved_cpus), &saved_cpus);
+		LogInfo("GIST threads pinned to CPUs " << config.get_gist_cpus());
+	}
+
 
 	/*
 	 * Register our input queue with the queue manager.
@@ -213,6 +304,18 @@ void mnslp_daemon::startup() {
 	while ( ! success );
 	assert( success );
 
+	/*
+	 * Resume the sessions of the last run. This needs the timer module,
+	 * which is started together with the NTLP.
+	 */
+	if ( checkpoint != NULL ) {
+		dispatcher disp(&session_mgr, rule_installer, &config);
+		disp.set_session_checkpoint(checkpoint);
+
+		disp.restore_sessions(checkpoint);
+		checkpoint->sync();
+	}
+
 
 	LogDebug("MNSLP daemon startup complete");
 }
@@ -226,12 +329,21 @@ void mnslp_daemon::startup() {
 void mnslp_daemon::shutdown() {
 	LogDebug("MNSLP daemon shutting down ...");
 
-	try {
-		rule_installer->remove_all();
+	rule_installer->stop_teardown();
+
+	// The sessions in the checkpoint log still need their rules.
+	if ( checkpoint != NULL ) {
+		LogInfo("keeping the policy rules of "
+			<< checkpoint->get_num_sessions() << " checkpointed sessions");
 	}
-	catch ( policy_rule_installer_error &e ) {
-		LogError("unable to remove the installed policy rules: " << e);
-		LogError("You have to remove them manually!");
+	else {
+		try {
+			rule_installer->remove_all();
+		}
+		catch ( policy_rule_installer_error &e ) {
+			LogError("unable to remove the installed policy rules: " << e);
+			LogError("You have to remove them manually!");
+		}
 	}
 
 	// Shut down the NTLP threads.
@@ -242,10 +354,43 @@ void mnslp_daemon::shutdown() {
 
 	delete rule_installer;
 
+	delete refresh_sched;
+
+	delete refresh_bundles;
+
+	LogInfo("admission control: " << *admission);
+	delete admission;
+
+	LogInfo("NI sessions: "
+		<< session_mgr.get_memory_usage(session::st_initiator));
+	LogInfo("NF sessions: "
+		<< session_mgr.get_memory_usage(session::st_forwarder));
+	LogInfo("NR sessions: "
+		<< session_mgr.get_memory_usage(session::st_receiver));
+
+	delete checkpoint;	// writes the log to disk
+
+	if ( collector != NULL ) {
+		collector->stop();
+		LogInfo("IPFIX collector: " << collector->get_stats());
+		delete collector;
+	}
+
 	QueueManager::instance()->unregister_queue(
 			mnslp_config::INPUT_QUEUE_ADDRESS);
 
 	LogInfo("MNSLP deamon shutdown complete");
+
+	if ( config.get_trace_file() != "" ) {
+		std::ofstream trace_file(config.get_trace_file().c_str());
+		if ( trace_file )
+			trace::dump(trace_file);
+		else
+			LogError("unable to write trace file "
+				<< config.get_trace_file());
+	}
+
+	logging::stop_writer();
 }
 
 
@@ -254,6 +399,23 @@ void mnslp_daemon::shutdown() {
  */
 void mnslp_daemon::main_loop(uint32 thread_id) {
 
+	/*
+	 * Pin the thread first, so everything allocated below is placed on
+	 * the memory of its NUMA node.
+	 */
+	cpu_placement cpus(config.get_dispatcher_cpus());
+
+	if ( ! cpus.empty() ) {
+		int cpu = cpus.get_cpu(thread_id);
+
+		if ( cpus.pin_thread(thread_id) )
+			LogInfo("dispatcher thread #" << thread_id << " pinned to CPU "
+				<< cpu << ", node " << cpu_placement::get_node(cpu));
+		else
+			LogWarn("unable to pin dispatcher thread #" << thread_id
+				<< " to CPU " << cpu);
+	}
+
 	/* 
 	 * The dispatcher handles incoming messages. It is the top-level state
 	 * machine which delegates work to the state machines on session level.
@@ -261,6 +423,10 @@ void mnslp_daemon::main_loop(uint32 thread_id) {
 	 * For each main_loop, and thus POSIX thread, there is a dispatcher.
 	 */
 	dispatcher disp(&session_mgr, rule_installer, &config);
+	disp.set_refresh_scheduler(refresh_sched);
+	disp.set_refresh_bundler(refresh_bundles);
+	disp.set_admission_control(admission);
+	disp.set_session_checkpoint(checkpoint);
 	gistka_mapper mapper;
 
 
@@ -272,30 +438,72 @@ void mnslp_daemon::main_loop(uint32 thread_id) {
 
 	FastQueue *mnslp_input = get_fqueue();
 
+	const size_t batch_size = std::max<uint32>(
+			config.get_dispatcher_batch_size(), 1);
+	const long batch_timeout = config.get_dispatcher_batch_timeout();
+
+	// Events are taken from the queue ahead of time to sort them by priority.
+	const size_t lane_limit = std::max<size_t>(
+			config.get_dispatcher_lane_limit(), batch_size);
+
+	std::vector<message *> msgs;
+	msgs.reserve(batch_size);
+	event_batch batch(batch_size);
+	event_lanes lanes(config.get_dispatcher_lane_weights());
+
 	while ( get_state() == Thread::STATE_RUN ) {
-		// A timeout makes sure the loop condition is checked regularly.
-		message *msg = mnslp_input->dequeue_timedwait(1000);
+		/*
+		 * Only wait for messages if there is nothing left to dispatch.
+		 * A timeout makes sure the loop condition is checked regularly.
+		 */
+		if ( lanes.size() < lane_limit ) {
+			dequeue_batch(mnslp_input, msgs, lane_limit - lanes.size(),
+				lanes.empty() ? batch_timeout : 0);
+
+			// Analyze the messages and create events from them.
+			for ( size_t i = 0; i < msgs.size(); i++ ) {
+				lanes.add(mapper.map_to_event(msgs[i]));
+				delete msgs[i];
+			}
+			msgs.clear();
+		}
+
+		if ( lanes.empty() ) {
+			// Idle, a good time to drop outdated checkpoint records.
+			if ( checkpoint != NULL )
+				checkpoint->compact_if_needed();
 
-		if ( msg == NULL )
 			continue;	// no message in the queue
+		}
 
-		LogDebug("dispatcher thread #" << thread_id
-			<< " processing received message #" << msg->get_id());
+		admission->set_backlog(mnslp_input->size() + lanes.size());
 
 		MP(benchmark_journal::PRE_PROCESSING);
 
-		// Analyze message and create an event from it.
-		event *evt = mapper.map_to_event(msg);
+		while ( batch.size() < batch_size && ! lanes.empty() )
+			batch.add(lanes.next());
 
-		// Then feed the event to the dispatcher.
-		if ( evt != NULL ) {
-			MP(benchmark_journal::PRE_DISPATCHER);
-			disp.process(evt);
-			MP(benchmark_journal::POST_DISPATCHER);
-			delete evt;
-		}
+		LogDebug("dispatcher thread #" << thread_id
+			<< " processing " << batch.size() << " events, "
+			<< lanes.size() << " waiting");
+
+		batch.group_by_session();
+
+		/*
+		 * Then feed the events to the dispatcher. An event for a session
+		 * that another thread is busy with is left to that thread.
+		 */
+		MP(benchmark_journal::PRE_DISPATCHER);
+		for ( size_t i = 0; i < batch.size(); i++ )
+			disp.dispatch(batch.take(i));
+		MP(benchmark_journal::POST_DISPATCHER);
+
+		batch.clear();
+
+		disp.flush_refreshes();
 
-		delete msg;
+		if ( checkpoint != NULL )
+			checkpoint->sync();
 
 		MP(benchmark_journal::POST_PROCESSING);
 	}
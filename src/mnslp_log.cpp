@@ -0,0 +1,285 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file mnslp_log.cpp
+/// Per-thread log rings and the background log writer.
+/// ----------------------------------------------------------
+/// $Id: mnslp_log.cpp 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./src/mnslp_log.cpp $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "logfile.h"
+
+#include "mnslp_log.h"
+
+
+using namespace protlib::log;
+
+
+namespace mnslp {
+  namespace logging {
+
+volatile int runtime_level = MNSLP_LOG_LEVEL_DEBUG;
+
+const unsigned log_ring::RING_SIZE;
+
+
+bool log_ring::push(int level, const char *module, std::string &text) {
+
+	if ( head - tail >= RING_SIZE )
+		return false; // full
+
+	record &r = records[head % RING_SIZE];
+	r.level = level;
+	r.module = module;
+	r.text.swap(text);
+
+	// Publish the record before the new head.
+	__sync_synchronize();
+	head++;
+
+	return true;
+}
+
+
+bool log_ring::pop(int &level, const char *&module, std::string &text) {
+
+	if ( tail == head )
+		return false; // empty
+
+	__sync_synchronize();
+
+	record &r = records[tail % RING_SIZE];
+	level = r.level;
+	module = r.module;
+	text.swap(r.text);
+	r.text.clear();
+
+	// The slot may be reused once the new tail is visible.
+	__sync_synchronize();
+	tail++;
+
+	return true;
+}
+
+
+/*
+ * Rings are registered once per thread. When the thread exits, its ring
+ * is marked dead and freed by the consumer once it is empty.
+ */
+static pthread_mutex_t rings_mutex = PTHREAD_MUTEX_INITIALIZER;
+static log_ring *rings = NULL;
+static __thread log_ring *local_ring = NULL;
+
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ring_key;
+
+static pthread_t writer_thread;
+static volatile bool writer_running = false;
+static volatile bool writer_stop = false;
+
+
+/**
+ * Write a message to the protlib logfile.
+ */
+static void write_now(int level, const char *module, const std::string &text) {
+
+	if ( level <= MNSLP_LOG_LEVEL_ERROR )
+		Log(ERROR_LOG, LOG_NORMAL, module, text);
+	else if ( level == MNSLP_LOG_LEVEL_WARN )
+		Log(WARNING_LOG, LOG_NORMAL, module, text);
+	else if ( level == MNSLP_LOG_LEVEL_INFO )
+		Log(INFO_LOG, LOG_NORMAL, module, text);
+	else
+		Log(DEBUG_LOG, LOG_NORMAL, module, text);
+}
+
+
+static void release_ring(void *ring) {
+	static_cast<log_ring *>(ring)->dead = true;
+}
+
+
+static void create_ring_key() {
+	pthread_key_create(&ring_key, release_ring);
+}
+
+
+static log_ring *get_local_ring() {
+
+	if ( local_ring == NULL ) {
+		local_ring = new log_ring();
+
+		pthread_once(&ring_key_once, create_ring_key);
+		pthread_setspecific(ring_key, local_ring);
+
+		pthread_mutex_lock(&rings_mutex);
+		local_ring->next = rings;
+		rings = local_ring;
+		pthread_mutex_unlock(&rings_mutex);
+	}
+
+	return local_ring;
+}
+
+
+/**
+ * Write everything currently queued in all rings.
+ *
+ * @return the number of records written
+ */
+static unsigned drain_rings() {
+
+	unsigned written = 0;
+	int level;
+	const char *module;
+	std::string text;
+
+	pthread_mutex_lock(&rings_mutex);
+	log_ring *first = rings;
+	pthread_mutex_unlock(&rings_mutex);
+
+	for ( log_ring *r = first; r != NULL; r = r->next ) {
+		while ( r->pop(level, module, text) ) {
+			write_now(level, module, text);
+			written++;
+		}
+	}
+
+	// Free the rings of exited threads, they get no more records.
+	pthread_mutex_lock(&rings_mutex);
+
+	for ( log_ring **p = &rings; *p != NULL; ) {
+		log_ring *r = *p;
+
+		if ( r->dead && r->empty() ) {
+			*p = r->next;
+			delete r;
+		}
+		else
+			p = &r->next;
+	}
+
+	pthread_mutex_unlock(&rings_mutex);
+
+	return written;
+}
+
+
+static void *writer_main(void *) {
+
+	while ( ! writer_stop ) {
+		if ( drain_rings() == 0 )
+			usleep(10000);
+	}
+
+	drain_rings();
+
+	return NULL;
+}
+
+
+void set_level(int level) {
+	runtime_level = level;
+}
+
+
+int get_level() {
+	return runtime_level;
+}
+
+
+void write(int level, const char *module, std::string text) {
+
+	if ( writer_running && level > MNSLP_LOG_LEVEL_WARN ) {
+		log_ring *ring = get_local_ring();
+
+		// stop_writer() waits for busy rings before its last drain.
+		ring->busy = true;
+		__sync_synchronize();
+
+		bool queued = writer_running && ring->push(level, module, text);
+
+		__sync_synchronize();
+		ring->busy = false;
+
+		if ( queued )
+			return;
+	}
+
+	// Errors, warnings and overflow go out synchronously.
+	write_now(level, module, text);
+}
+
+
+void start_writer() {
+
+	if ( writer_running )
+		return;
+
+	writer_stop = false;
+
+	if ( pthread_create(&writer_thread, NULL, writer_main, NULL) != 0 ) {
+		ERRLog("mnslp_log", "unable to start the log writer thread, "
+			"logging synchronously");
+		return;
+	}
+
+	writer_running = true;
+}
+
+
+void stop_writer() {
+
+	if ( ! writer_running )
+		return;
+
+	// Threads still logging fall back to synchronous writes from now on.
+	writer_running = false;
+	__sync_synchronize();
+
+	writer_stop = true;
+	pthread_join(writer_thread, NULL);
+
+	// A thread that saw the writer running may still be pushing.
+	pthread_mutex_lock(&rings_mutex);
+	for ( log_ring *r = rings; r != NULL; r = r->next )
+		while ( r->busy )
+			sched_yield();
+	pthread_mutex_unlock(&rings_mutex);
+
+	// Pick up records queued while the writer shut down.
+	drain_rings();
+}
+
+
+bool is_writer_running() {
+	return writer_running;
+}
+
+  } // namespace logging
+} // namespace mnslp
+
+// EOF
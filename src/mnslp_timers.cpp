@@ -29,6 +29,7 @@
 #include "mnslp_timers.h"
 #include "dispatcher.h"
 #include <iostream>
+#include <time.h>
 
 
 using namespace mnslp;
@@ -38,7 +39,7 @@ using namespace mnslp;
  * Constructor.
  */
 timer::timer(session *s)
-		: id(0), owning_session(s) {
+		: id(0), expires(0), owning_session(s) {
 	// nothing to do
 }
 
@@ -46,15 +47,17 @@ timer::timer(session *s)
 void timer::start(dispatcher *d, int seconds) {
 
 	id = d->start_timer(owning_session, seconds);
-
+	expires = time(NULL) + seconds;
 }
 
 void timer::restart(dispatcher *d, int seconds) {
 	id = d->start_timer(owning_session, seconds);
+	expires = time(NULL) + seconds;
 }
 
 void timer::stop() {
 	id = 0;
+	expires = 0;
 }
 
 
@@ -40,7 +40,7 @@ using namespace protlib::log;
  *
  * Creates an empty ie_store.
  */
-ie_store::ie_store() : entries() {
+ie_store::ie_store() : entries(), max_sequences() {
 	// nothing to do
 }
 
@@ -52,7 +52,7 @@ ie_store::ie_store() : entries() {
  *
  * @param other the object to copy
  */
-ie_store::ie_store(const ie_store &other) {
+ie_store::ie_store(const ie_store &other) : entries(), max_sequences() {
 
 	// copy all entries
 	for (c_iter i = other.entries.begin(); i != other.entries.end(); i++) {
@@ -75,10 +75,44 @@ ie_store::ie_store(const ie_store &other) {
  */
 ie_store::~ie_store() {
 	
+	clear();
+}
+
+
+/**
+ * Assignment operator.
+ *
+ * Deletes all entries of this ie_store and makes a deep copy of the
+ * entries of the object passed as an argument.
+ *
+ * @param other the object to copy
+ */
+ie_store &ie_store::operator=(const ie_store &other) {
+
+	if ( this == &other )
+		return *this;
+
+	clear();
+
+	for (c_iter i = other.entries.begin(); i != other.entries.end(); i++) {
+		if ( i->second )
+			set(i->first, i->second->copy());
+	}
+
+	return *this;
+}
+
+
+/**
+ * Delete all entries and forget the cached sequence numbers.
+ */
+void ie_store::clear() throw() {
+
 	for ( c_iter i = entries.begin(); i != entries.end(); i++ )
 		delete i->second;
-	
-	
+
+	entries.clear();
+	max_sequences.clear();
 }
 
 
@@ -117,6 +151,41 @@ size_t ie_store::size() const throw() {
 }
 
 
+/**
+ * Binary search for the first entry whose key is not less than id.
+ *
+ * @return the position of that entry, or size() if there is none
+ */
+size_t ie_store::lower_bound(const ie_object_key &id) const throw() {
+
+	size_t first = 0;
+	size_t len = entries.size();
+
+	while ( len > 0 ) {
+		size_t half = len / 2;
+
+		if ( entries[first + half].first < id ) {
+			first = first + half + 1;
+			len = len - half - 1;
+		}
+		else
+			len = half;
+	}
+
+	return first;
+}
+
+
+/**
+ * Test if the entry at pos is registered under id, using the same
+ * equivalence a std::map would use.
+ */
+bool ie_store::matches(size_t pos, const ie_object_key &id) const throw() {
+
+	return ( pos < entries.size() ) && !( id < entries[pos].first );
+}
+
+
 /**
  * Returns the entry registered for a given ID.
  *
@@ -126,14 +195,10 @@ size_t ie_store::size() const throw() {
  */
 IE *ie_store::get(ie_object_key id) const throw() {
 
-	/*
-	 * Note: This is a true "const" implementation. Accessing the map
-	 *       via entries[id] would modify it, even if no entry is found!
-	 */
-	c_iter i = entries.find(id);
+	size_t pos = lower_bound(id);
 
-	if ( i != entries.end() )
-		return i->second;
+	if ( matches(pos, id) )
+		return entries[pos].second;
 	else
 		return NULL;
 }
@@ -157,12 +222,17 @@ void ie_store::set(ie_object_key id, IE *ie) throw () {
 	if ( ie == NULL )
 		return;
 
-	IE *old = entries[id];
+	size_t pos = lower_bound(id);
 
-	if ( old )
-		delete old;
-
-	entries[id] = ie;
+	if ( matches(pos, id) ) {
+		// The stored key is kept, as std::map::operator[] would do.
+		delete entries[pos].second;
+		entries[pos].second = ie;
+	}
+	else {
+		entries.insert(entries.begin() + pos, entry_type(id, ie));
+		update_max_sequence(id);
+	}
 }
 
 
@@ -178,12 +248,66 @@ void ie_store::set(ie_object_key id, IE *ie) throw () {
  * @return the entry with that ID or NULL if there is none
  */
 IE *ie_store::remove(ie_object_key id) throw () {
-	IE *ie = entries[id];
 
-	// Note: entries[id] created an entry, even if none existed before!
-	entries.erase(id);
+	size_t pos = lower_bound(id);
+
+	if ( ! matches(pos, id) )
+		return NULL;
+
+	IE *ie = entries[pos].second;
+	const ie_object_key stored = entries[pos].first;
+
+	entries.erase(entries.begin() + pos);
+
+	if ( stored.get_sequence_number() == getMaxSequence(stored.get_object_type()) )
+		recompute_max_sequence(stored.get_object_type());
+
+	return ie;
+}
+
+
+/**
+ * Register the sequence number of a newly inserted key.
+ */
+void ie_store::update_max_sequence(const ie_object_key &id) throw() {
+
+	typedef small_vector<max_seq_type, 4>::iterator iter;
+
+	for ( iter i = max_sequences.begin(); i != max_sequences.end(); i++ ) {
+		if ( i->first == id.get_object_type() ) {
+			if ( i->second < id.get_sequence_number() )
+				i->second = id.get_sequence_number();
+			return;
+		}
+	}
 
-	return ie; // either the IE or NULL
+	max_sequences.push_back(
+		max_seq_type(id.get_object_type(), id.get_sequence_number()));
+}
+
+
+/**
+ * Recalculate the max sequence number of an object type after the entry
+ * holding it was removed.
+ */
+void ie_store::recompute_max_sequence(uint32 object_type) throw() {
+
+	uint32 result = 0;
+
+	for ( c_iter i = entries.begin(); i != entries.end(); i++ ) {
+		if ( ( i->first.get_object_type() == object_type ) 
+			  && ( result < i->first.get_sequence_number() ) )
+			result = i->first.get_sequence_number();
+	}
+
+	typedef small_vector<max_seq_type, 4>::iterator iter;
+
+	for ( iter i = max_sequences.begin(); i != max_sequences.end(); i++ ) {
+		if ( i->first == object_type ) {
+			i->second = result;
+			return;
+		}
+	}
 }
 
 
@@ -196,20 +320,14 @@ IE *ie_store::remove(ie_object_key id) throw () {
 uint32 
 ie_store::getMaxSequence(uint32 id) const {
 
-	uint32 result = 0;
-	bool ingress = false;
+	typedef small_vector<max_seq_type, 4>::const_iterator iter;
 
-	// All entries have to be of the same type.
-	for ( c_iter i = entries.begin(); i != entries.end(); i++ ) {
-		const ie_object_key key = i->first;
-		if ( key.get_object_type() == id ){
-			if (result <= key.get_sequence_number())
-				result = key.get_sequence_number();
-				ingress = true;
-		}
+	for ( iter i = max_sequences.begin(); i != max_sequences.end(); i++ ) {
+		if ( i->first == id )
+			return i->second;
 	}
 	
-	return result;
+	return 0;
 }
 
 // EOF
@@ -182,6 +182,7 @@ uint8 information_code::get_severity_class() const {
  */
 void information_code::set_severity_class(uint8 severity) {
 	severity_class = severity;
+	invalidate_encoding();
 }
 
 
@@ -208,6 +209,7 @@ uint8 information_code::get_response_code() const {
  */
 void information_code::set_response_code(uint8 code) {
 	response_code = code;
+	invalidate_encoding();
 }
 
 
@@ -232,6 +234,7 @@ uint16 information_code::get_response_object_type() const {
  */
 void information_code::set_response_object_type(uint16 obj_type) {
 	response_object_type = obj_type;
+	invalidate_encoding();
 }
 
 
@@ -29,6 +29,7 @@
 
 
 #include "msg/ipfix_t.h"
+#include "msg/mnslp_trace.h"
 #include <iostream>
 
 namespace mnslp {
@@ -90,7 +91,7 @@ cs_header(NULL), count(0), sysuptime(0), unixtime(0), length(0), exporttime(0)
 ipfix_t::~ipfix_t()
 {
 	if (buffer != NULL)
-		delete buffer;
+		delete [] buffer;
 }
 
 ipfix_t &
@@ -141,12 +142,8 @@ ipfix_t::operator== (const ipfix_t& rhs)
 	   (buffer_lenght != rhs.buffer_lenght) ||
 	   (seqno != rhs.seqno)  
 	   ){
-		std::cout << "sourceid" << sourceid << "rhs.sourceid" << rhs.sourceid << std::endl;	
-		std::cout << "version" << version << "rhs.version" << rhs.version << std::endl;
-		std::cout << "nrecords" << nrecords << "rhs.nrecords" << rhs.nrecords << std::endl;
-		std::cout << "offset" << offset << "rhs.offset" << rhs.offset << std::endl;
-		std::cout << "buffer_lenght" << buffer_lenght << "rhs.buffer_lenght" << rhs.buffer_lenght << std::endl;
-		std::cout << "seqno" << seqno << "rhs.seqno" << rhs.seqno << std::endl;
+		MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_header_differs,
+					sourceid, rhs.sourceid, version);
 		return false;
 	}
 		
@@ -161,7 +158,8 @@ ipfix_t::operator== (const ipfix_t& rhs)
 	if (version == IPFIX_VERSION){
 		if ( (rhs.length != length) ||
 			 (rhs.exporttime != exporttime) ){
-			std::cout << "different lenght" << std::endl;
+			MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_header_differs,
+						sourceid, rhs.sourceid, version);
 			return false;
 		}
 	}
@@ -180,22 +178,20 @@ ipfix_t::operator!= (const ipfix_t& rhs)
 void
 ipfix_t::copy_raw_message(uchar * msg, size_t _offset)
 {
-	if (offset<= buffer_lenght){
-		// release the memory assigned to the buffer
-		delete buffer;
-		buffer = new uchar[buffer_lenght];
-		memcpy(buffer,msg,_offset);
-		offset = _offset;
-	}
-	else
-		throw mnslp_ipfix_bad_argument("buffer length not enough for the raw copy");
+	// release the memory assigned to the buffer
+	delete [] buffer;
+	if (_offset > buffer_lenght)
+		buffer_lenght = _offset;
+	buffer = new uchar[buffer_lenght];
+	memcpy(buffer,msg,_offset);
+	offset = _offset;
 }
 
 void 
 ipfix_t::reinitiate_buffer(void)
 {
    if (buffer != NULL) 
-	   delete buffer;
+	   delete [] buffer;
    
    buffer = new uchar[IPFIX_DEFAULT_BUFLEN];
    buffer_lenght = IPFIX_DEFAULT_BUFLEN;
@@ -139,6 +139,7 @@ uint32 message_hop_count::get_value() const {
  */
 void message_hop_count::set_value(uint32 mhc) {
 	value = mhc;
+	invalidate_encoding();
 }
 
 
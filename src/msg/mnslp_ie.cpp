@@ -132,6 +132,7 @@ void MNSLP_IEManager::register_known_ies() {
 	inst->register_ie(new message_hop_count());
 	inst->register_ie(new selection_metering_entities());
 	inst->register_ie(new msg_sequence_number());
+	inst->register_ie(new refresh_list());
 	inst->register_ie(new mnslp_ipfix_message());
 
 	// TODO: implement catch-all
@@ -294,7 +295,6 @@ IE *MNSLP_IEManager::deserialize_object(NetMsg &msg,
 	IE *ie = new_instance(cat_mnslp_object, object_type, 0);
 
 	if ( ie == NULL ) {
-		std::cout << "wrong object_type" << std::endl;
 		LogError("no mnslp_object registered for ID " << object_type);
 		errorlist.put(new IEError(IEError::ERROR_WRONG_SUBTYPE));
 		return NULL;
@@ -0,0 +1,178 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file mnslp_ipfix_byteorder.cpp
+/// Bulk byte order conversion for columns of IPFIX values.
+/// ----------------------------------------------------------
+/// $Id: mnslp_ipfix_byteorder.cpp 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./src/msg/mnslp_ipfix_byteorder.cpp $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+
+#include "msg/mnslp_ipfix_byteorder.h"
+
+#include <string.h>
+#include <netinet/in.h>
+
+/*
+ * Per-function target attributes with their intrinsics and 
+ * __builtin_cpu_supports need GCC 4.9; older compilers get the scalar loop.
+ */
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) ) \
+	&& ( __GNUC__ > 4 || ( __GNUC__ == 4 && __GNUC_MINOR__ >= 9 ) )
+#define MNSLP_BYTEORDER_X86
+#include <immintrin.h>
+#endif
+
+namespace mnslp {
+  namespace msg {
+
+namespace {
+
+/*
+ * Every kernel reverses the bytes of each width byte element of a buffer 
+ * of len bytes; len is a multiple of width.
+ */
+typedef void (*bswap_fn)( uint8_t *buf, size_t len, size_t width );
+
+void bswap_scalar( uint8_t *buf, size_t len, size_t width )
+{
+	for ( size_t i = 0; i < len; i += width ) {
+		uint8_t *lo = buf + i;
+		uint8_t *hi = buf + i + width - 1;
+		for ( ; lo < hi; lo++, hi-- ) {
+			uint8_t tmp = *lo;
+			*lo = *hi;
+			*hi = tmp;
+		}
+	}
+}
+
+void bswap_none( uint8_t * /* buf */, size_t /* len */, size_t /* width */ )
+{
+}
+
+#ifdef MNSLP_BYTEORDER_X86
+
+/*
+ * Shuffle mask that reverses each width byte element of a 16 byte lane.
+ */
+void make_mask( uint8_t *mask, size_t len, size_t width )
+{
+	for ( size_t i = 0; i < len; i++ ) {
+		size_t lane_pos = i % 16;
+		mask[i] = (uint8_t) ( (lane_pos / width) * width + (width - 1 - lane_pos % width) );
+	}
+}
+
+__attribute__((target("ssse3")))
+void bswap_ssse3( uint8_t *buf, size_t len, size_t width )
+{
+	uint8_t m[16];
+	make_mask(m, sizeof(m), width);
+	const __m128i mask = _mm_loadu_si128((const __m128i *) m);
+
+	size_t i = 0;
+	for ( ; i + 16 <= len; i += 16 ) {
+		__m128i x = _mm_loadu_si128((const __m128i *) (buf + i));
+		_mm_storeu_si128((__m128i *) (buf + i), _mm_shuffle_epi8(x, mask));
+	}
+	bswap_scalar(buf + i, len - i, width);
+}
+
+__attribute__((target("avx2")))
+void bswap_avx2( uint8_t *buf, size_t len, size_t width )
+{
+	uint8_t m[32];
+	make_mask(m, sizeof(m), width);
+	const __m256i mask = _mm256_loadu_si256((const __m256i *) m);
+
+	size_t i = 0;
+	for ( ; i + 32 <= len; i += 32 ) {
+		__m256i x = _mm256_loadu_si256((const __m256i *) (buf + i));
+		_mm256_storeu_si256((__m256i *) (buf + i), _mm256_shuffle_epi8(x, mask));
+	}
+	bswap_scalar(buf + i, len - i, width);
+}
+
+#endif // MNSLP_BYTEORDER_X86
+
+
+struct bswap_kernel {
+	bswap_fn fn;
+	const char *name;
+};
+
+bswap_kernel resolve_kernel()
+{
+	bswap_kernel kernel = { &bswap_scalar, "scalar" };
+
+	if ( htonl(1) == 1 ) {
+		kernel.fn = &bswap_none;
+		kernel.name = "none";
+		return kernel;
+	}
+
+#ifdef MNSLP_BYTEORDER_X86
+	__builtin_cpu_init();
+	if ( __builtin_cpu_supports("avx2") ) {
+		kernel.fn = &bswap_avx2;
+		kernel.name = "avx2";
+	}
+	else if ( __builtin_cpu_supports("ssse3") ) {
+		kernel.fn = &bswap_ssse3;
+		kernel.name = "ssse3";
+	}
+#endif
+	return kernel;
+}
+
+const bswap_kernel &get_kernel()
+{
+	static const bswap_kernel kernel = resolve_kernel();
+	return kernel;
+}
+
+} // anonymous namespace
+
+
+void ipfix_hton_n( uint16_t *values, size_t n )
+{
+	get_kernel().fn((uint8_t *) values, n * sizeof(uint16_t), sizeof(uint16_t));
+}
+
+void ipfix_hton_n( uint32_t *values, size_t n )
+{
+	get_kernel().fn((uint8_t *) values, n * sizeof(uint32_t), sizeof(uint32_t));
+}
+
+void ipfix_hton_n( uint64_t *values, size_t n )
+{
+	get_kernel().fn((uint8_t *) values, n * sizeof(uint64_t), sizeof(uint64_t));
+}
+
+const char *ipfix_byteorder_kernel( void )
+{
+	return get_kernel().name;
+}
+
+  } // namespace msg
+} // namespace mnslp
@@ -0,0 +1,303 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file mnslp_ipfix_codec.cpp
+/// Coding specialized encoders and decoders for IPFIX fields.
+/// ----------------------------------------------------------
+/// $Id: mnslp_ipfix_codec.cpp 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./src/msg/mnslp_ipfix_codec.cpp $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+
+#include "msg/mnslp_ipfix_codec.h"
+
+namespace mnslp {
+  namespace msg {
+
+namespace {
+
+/*
+ * Access to the value of a field according to its width. Floats share 
+ * the storage of the integers of the same width.
+ */
+template <typename T> struct value_traits;
+
+template <> struct value_traits<uint8_t>
+{
+	static uint8_t get(const mnslp_ipfix_value_field &v) { return v.get_value_int8(); }
+	static void set(mnslp_ipfix_value_field &v, uint8_t x) { v.set_value_int8(x); }
+	static uint8_t hton(uint8_t x) { return x; }
+	static uint8_t ntoh(uint8_t x) { return x; }
+};
+
+template <> struct value_traits<uint16_t>
+{
+	static uint16_t get(const mnslp_ipfix_value_field &v) { return v.get_value_int16(); }
+	static void set(mnslp_ipfix_value_field &v, uint16_t x) { v.set_value_int16(x); }
+	static uint16_t hton(uint16_t x) { return htons(x); }
+	static uint16_t ntoh(uint16_t x) { return ntohs(x); }
+};
+
+template <> struct value_traits<uint32_t>
+{
+	static uint32_t get(const mnslp_ipfix_value_field &v) { return v.get_value_int32(); }
+	static void set(mnslp_ipfix_value_field &v, uint32_t x) { v.set_value_int32(x); }
+	static uint32_t hton(uint32_t x) { return htonl(x); }
+	static uint32_t ntoh(uint32_t x) { return ntohl(x); }
+};
+
+template <> struct value_traits<uint64_t>
+{
+	static uint64_t get(const mnslp_ipfix_value_field &v) { return v.get_value_int64(); }
+	static void set(mnslp_ipfix_value_field &v, uint64_t x) { v.set_value_int64(x); }
+	static uint64_t hton(uint64_t x) { return HTONLL(x); }
+	static uint64_t ntoh(uint64_t x) { return NTOHLL(x); }
+};
+
+
+template <int relay_f>
+int encode_generic( const mnslp_ipfix_field &field, 
+					const mnslp_ipfix_value_field &in, uint8_t *out )
+{
+	return field.encode(in, out, relay_f);
+}
+
+template <int relay_f>
+mnslp_ipfix_value_field decode_generic( const mnslp_ipfix_field &field, 
+										const uint8_t *in, size_t len )
+{
+	return field.decode(const_cast<uint8_t *>(in), len, relay_f);
+}
+
+/*
+ * Fixed width numbers. A value whose length differs from the width of 
+ * the kernel is handed to the generic codec, which reports the error.
+ */
+template <typename T, int relay_f>
+int encode_fixed( const mnslp_ipfix_field &field, 
+				  const mnslp_ipfix_value_field &in, uint8_t *out )
+{
+	if ( in.get_length() != (int) sizeof(T) )
+		return field.encode(in, out, relay_f);
+
+	T tmp = value_traits<T>::get(in);
+	if ( !relay_f )
+		tmp = value_traits<T>::hton(tmp);
+	memcpy( out, &tmp, sizeof(T) );
+	return 0;
+}
+
+template <typename T, int relay_f>
+mnslp_ipfix_value_field decode_fixed( const mnslp_ipfix_field &field, 
+									  const uint8_t *in, size_t len )
+{
+	if ( len != sizeof(T) )
+		return field.decode(const_cast<uint8_t *>(in), len, relay_f);
+
+	T tmp;
+	memcpy( &tmp, in, sizeof(T) );
+	if ( !relay_f )
+		tmp = value_traits<T>::ntoh(tmp);
+
+	mnslp_ipfix_value_field value;
+	value_traits<T>::set(value, tmp);
+	return value;
+}
+
+/*
+ * Byte strings and addresses are copied as they are.
+ */
+int encode_bytes( const mnslp_ipfix_field &field, 
+				  const mnslp_ipfix_value_field &in, uint8_t *out )
+{
+	memcpy( out, in.get_value_byte(), in.get_length() );
+	return 0;
+}
+
+mnslp_ipfix_value_field decode_bytes( const mnslp_ipfix_field &field, 
+									  const uint8_t *in, size_t len )
+{
+	mnslp_ipfix_value_field value;
+	value.set_value_vunit8(const_cast<uint8_t *>(in), (int) len);
+	return value;
+}
+
+/*
+ * Character strings keep their value in the character buffer.
+ */
+int encode_string( const mnslp_ipfix_field &field, 
+				   const mnslp_ipfix_value_field &in, uint8_t *out )
+{
+	memcpy( out, in.get_value_string(), in.get_length() );
+	return 0;
+}
+
+mnslp_ipfix_value_field decode_string( const mnslp_ipfix_field &field, 
+									   const uint8_t *in, size_t len )
+{
+	mnslp_ipfix_value_field value;
+	value.set_value_vchar((char *) in, (int) len);
+	return value;
+}
+
+
+template <int relay_f>
+ipfix_encode_fn resolve_encoder( const ipfix_field_type_t &field_type, 
+								 uint16_t flength )
+{
+	switch ( field_type.coding )
+	{
+	  case IPFIX_CODING_INT:
+	  case IPFIX_CODING_UINT:
+	  case IPFIX_CODING_NTP:
+		  if ( flength != field_type.length )
+			  break;
+		  switch ( flength ) 
+		  {
+			case 1: return &encode_fixed<uint8_t, relay_f>;
+			case 2: return &encode_fixed<uint16_t, relay_f>;
+			case 4: return &encode_fixed<uint32_t, relay_f>;
+			case 8: return &encode_fixed<uint64_t, relay_f>;
+			default: break;
+		  }
+		  break;
+	  case IPFIX_CODING_FLOAT:
+		  if ( flength != field_type.length )
+			  break;
+		  switch ( flength ) 
+		  {
+			case 4: return &encode_fixed<uint32_t, relay_f>;
+			case 8: return &encode_fixed<uint64_t, relay_f>;
+			default: break;
+		  }
+		  break;
+	  case IPFIX_CODING_IPADDR:
+	  case IPFIX_CODING_BYTES:
+		  return &encode_bytes;
+	  case IPFIX_CODING_STRING:
+		  return &encode_string;
+	  default:
+		  break;
+	}
+	return &encode_generic<relay_f>;
+}
+
+template <int relay_f>
+ipfix_decode_fn resolve_decoder( const ipfix_field_type_t &field_type, 
+								 uint16_t flength )
+{
+	switch ( field_type.coding )
+	{
+	  case IPFIX_CODING_INT:
+	  case IPFIX_CODING_UINT:
+	  case IPFIX_CODING_NTP:
+		  if ( flength != field_type.length )
+			  break;
+		  switch ( flength ) 
+		  {
+			case 1: return &decode_fixed<uint8_t, relay_f>;
+			case 2: return &decode_fixed<uint16_t, relay_f>;
+			case 4: return &decode_fixed<uint32_t, relay_f>;
+			case 8: return &decode_fixed<uint64_t, relay_f>;
+			default: break;
+		  }
+		  break;
+	  case IPFIX_CODING_FLOAT:
+		  if ( flength != field_type.length )
+			  break;
+		  switch ( flength ) 
+		  {
+			case 4: return &decode_fixed<uint32_t, relay_f>;
+			case 8: return &decode_fixed<uint64_t, relay_f>;
+			default: break;
+		  }
+		  break;
+	  case IPFIX_CODING_IPADDR:
+		  // The generic decoder checks the length of the address.
+		  if ( flength == field_type.length )
+			  return &decode_bytes;
+		  break;
+	  case IPFIX_CODING_BYTES:
+		  if ( ( flength == field_type.length ) || ( field_type.length == 65535 ) )
+			  return &decode_bytes;
+		  break;
+	  case IPFIX_CODING_STRING:
+		  return &decode_string;
+	  default:
+		  break;
+	}
+	return &decode_generic<relay_f>;
+}
+
+} // anonymous namespace
+
+
+ipfix_encode_fn 
+ipfix_resolve_encoder( const ipfix_field_type_t &field_type, 
+					   uint16_t flength, int relay_f )
+{
+	if ( relay_f )
+		return resolve_encoder<1>(field_type, flength);
+	else
+		return resolve_encoder<0>(field_type, flength);
+}
+
+ipfix_decode_fn 
+ipfix_resolve_decoder( const ipfix_field_type_t &field_type, 
+					   uint16_t flength, int relay_f )
+{
+	if ( relay_f )
+		return resolve_decoder<1>(field_type, flength);
+	else
+		return resolve_decoder<0>(field_type, flength);
+}
+
+ipfix_column_t 
+ipfix_resolve_column( const ipfix_field_type_t &field_type, uint16_t flength )
+{
+	if ( flength != field_type.length )
+		return IPFIX_COLUMN_NONE;
+
+	switch ( field_type.coding )
+	{
+	  case IPFIX_CODING_INT:
+	  case IPFIX_CODING_UINT:
+	  case IPFIX_CODING_NTP:
+		  if ( (flength == 1) || (flength == 2) || (flength == 4) || (flength == 8) )
+			  return IPFIX_COLUMN_NUMBER;
+		  break;
+	  case IPFIX_CODING_FLOAT:
+		  if ( (flength == 4) || (flength == 8) )
+			  return IPFIX_COLUMN_NUMBER;
+		  break;
+	  case IPFIX_CODING_IPADDR:
+	  case IPFIX_CODING_BYTES:
+		  if ( flength != 65535 )
+			  return IPFIX_COLUMN_RAW;
+		  break;
+	  default:
+		  break;
+	}
+	return IPFIX_COLUMN_NONE;
+}
+
+  } // namespace msg
+} // namespace mnslp
@@ -110,6 +110,17 @@ mnslp_ipfix_data_record::get_field(const mnslp_ipfix_field_key &param) const
 		return it->second;
 }
 
+const mnslp_ipfix_value_field & 
+mnslp_ipfix_data_record::get_field_value(const mnslp_ipfix_field_key &param) const
+{
+	std::map<mnslp_ipfix_field_key, mnslp_ipfix_value_field>::const_iterator it;
+	it=field_data.find(param);
+	if (it == field_data.end())
+		throw mnslp_ipfix_bad_argument("Parameter field was not found");
+	else	
+		return it->second;
+}
+
 mnslp_ipfix_value_field 
 mnslp_ipfix_data_record::get_field(int eno, int ftype)
 {
@@ -128,8 +139,7 @@ mnslp_ipfix_data_record::get_field(int eno, int ftype) const
 uint16_t 
 mnslp_ipfix_data_record::get_length(mnslp_ipfix_field_key &param)
 {
-	mnslp_ipfix_value_field fieldvalue = get_field(param);
-	return fieldvalue.get_length();
+	return get_field_value(param).get_length();
 }
 
 uint16_t 
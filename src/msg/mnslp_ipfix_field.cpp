@@ -30,6 +30,8 @@
 #include "msg/mnslp_ipfix_field.h"
 #include <iostream>
 #include <sstream>
+#include <new>
+#include <stddef.h>
 
 
 namespace mnslp {
@@ -136,8 +138,8 @@ mnslp_ipfix_field& mnslp_ipfix_field::operator= (const mnslp_ipfix_field &param)
 /*
  * descr: encode,decode,print funcs
  */
-int mnslp_ipfix_field::ipfix_encode_int( mnslp_ipfix_value_field &in, 
-										 uint8_t *out, int relay_f )
+int mnslp_ipfix_field::ipfix_encode_int( const mnslp_ipfix_value_field &in, 
+										 uint8_t *out, int relay_f ) const
 {
 
     uint16_t      tmp16;
@@ -200,7 +202,7 @@ int mnslp_ipfix_field::ipfix_encode_int( mnslp_ipfix_value_field &in,
 }
 
 mnslp_ipfix_value_field 
-mnslp_ipfix_field::ipfix_decode_int( uint8_t *in, size_t len, int relay_f )
+mnslp_ipfix_field::ipfix_decode_int( uint8_t *in, size_t len, int relay_f ) const
 {
     unsigned char *i = (unsigned char*) in;
     uint16_t      tmp16;
@@ -350,16 +352,16 @@ int mnslp_ipfix_field::ipfix_snprint_uint( char *str, size_t size, mnslp_ipfix_v
 }
 
 
-int mnslp_ipfix_field::ipfix_encode_bytes( mnslp_ipfix_value_field in, 
+int mnslp_ipfix_field::ipfix_encode_bytes( const mnslp_ipfix_value_field &in, 
 										   uint8_t *out, 
-										   int relay_f  )
+										   int relay_f  ) const
 {
     memcpy( out, in.get_value_byte(), in.get_length() );
     return 0;
 }
 
 mnslp_ipfix_value_field 
-mnslp_ipfix_field::ipfix_decode_bytes( uint8_t *in, size_t len, int relay_f )
+mnslp_ipfix_field::ipfix_decode_bytes( uint8_t *in, size_t len, int relay_f ) const
 {
     mnslp_ipfix_value_field value;
     value = get_ipfix_value_field(in, (int) len);      
@@ -371,7 +373,7 @@ mnslp_ipfix_field::ipfix_snprint_bytes( char * str, size_t size,
 										mnslp_ipfix_value_field &in_field )
 {
     size_t  i, n = 0;
-    uint8_t *in = in_field.get_value_byte();
+    const uint8_t *in = in_field.get_value_byte();
 
 	int len = in_field.get_length();
     if ( size < 4 )
@@ -395,7 +397,7 @@ mnslp_ipfix_field::ipfix_snprint_bytes( char * str, size_t size,
 										mnslp_ipfix_value_field &in_field ) const
 {
     size_t  i, n = 0;
-    uint8_t *in = in_field.get_value_byte();
+    const uint8_t *in = in_field.get_value_byte();
 
 	int len = in_field.get_length();
     if ( size < 4 )
@@ -419,7 +421,7 @@ mnslp_ipfix_field::ipfix_snprint_string( char * str, size_t size,
 										 mnslp_ipfix_value_field &in_field )
 {
     ssize_t  i;
-    char *in = in_field.get_value_string();
+    const char *in = in_field.get_value_string();
     int len = in_field.get_length();
 
     for( i=len-1; i>=0; i-- ) {
@@ -442,7 +444,7 @@ mnslp_ipfix_field::ipfix_snprint_string( char * str, size_t size,
 										 mnslp_ipfix_value_field &in_field ) const
 {
     ssize_t  i;
-    char *in = in_field.get_value_string();
+    const char *in = in_field.get_value_string();
     int len = in_field.get_length();
 
     for( i=len-1; i>=0; i-- ) {
@@ -465,7 +467,7 @@ int
 mnslp_ipfix_field::ipfix_snprint_ipaddr( char * str, size_t size, 
 										 mnslp_ipfix_value_field &in_field)
 {
-    uint8_t *in = in_field.get_value_address();
+    const uint8_t *in = in_field.get_value_address();
     char    tmpbuf[100];
     int len = in_field.get_length();
     
@@ -497,7 +499,7 @@ int
 mnslp_ipfix_field::ipfix_snprint_ipaddr( char * str, size_t size, 
 										 mnslp_ipfix_value_field &in_field) const
 {
-    uint8_t *in = in_field.get_value_address();
+    const uint8_t *in = in_field.get_value_address();
     char    tmpbuf[100];
     int len = in_field.get_length();
     
@@ -526,9 +528,9 @@ mnslp_ipfix_field::ipfix_snprint_ipaddr( char * str, size_t size,
 }
 
 int 
-mnslp_ipfix_field::ipfix_encode_float( mnslp_ipfix_value_field in, 
+mnslp_ipfix_field::ipfix_encode_float( const mnslp_ipfix_value_field &in, 
 									   uint8_t *out, 
-									   int relay_f )
+									   int relay_f ) const
 {
     uint32_t      tmp32;
     uint64_t      tmp64;
@@ -572,7 +574,7 @@ mnslp_ipfix_field::ipfix_encode_float( mnslp_ipfix_value_field in,
 }
 
 mnslp_ipfix_value_field 
-mnslp_ipfix_field::ipfix_decode_float( uint8_t *in,  size_t len, int relay_f )
+mnslp_ipfix_field::ipfix_decode_float( uint8_t *in,  size_t len, int relay_f ) const
 {
     uint32_t      tmp32;
     uint64_t      tmp64;
@@ -649,36 +651,38 @@ mnslp_ipfix_field::ipfix_snprint_float( char * str, size_t size,
 }
 
 
-int mnslp_ipfix_field::encode( mnslp_ipfix_value_field in, 
-							   uint8_t *out, int relay_f)
+int mnslp_ipfix_field::encode( const mnslp_ipfix_value_field &in, 
+							   uint8_t *out, int relay_f) const
 {
 	 if ( field_type.coding == IPFIX_CODING_INT ) {
-         ipfix_encode_int(in, out, relay_f);
+         return ipfix_encode_int(in, out, relay_f);
      }
      else if ( field_type.coding == IPFIX_CODING_UINT ) {
-         ipfix_encode_int(in, out, relay_f);
+         return ipfix_encode_int(in, out, relay_f);
      }
      else if ( field_type.coding == IPFIX_CODING_NTP ) {
-         ipfix_encode_int(in, out, relay_f);
+         return ipfix_encode_int(in, out, relay_f);
      }
      else if ( field_type.coding == IPFIX_CODING_FLOAT ) {
-         ipfix_encode_float(in, out, relay_f);
+         return ipfix_encode_float(in, out, relay_f);
      }
      else if ( field_type.coding == IPFIX_CODING_IPADDR ) {
-         ipfix_encode_bytes(in, out, relay_f);
+         return ipfix_encode_bytes(in, out, relay_f);
      }
      else if ( field_type.coding == IPFIX_CODING_STRING ) {
-         ipfix_encode_bytes(in, out, relay_f);
+         // string values are kept in the character buffer.
+         memcpy( out, in.get_value_string(), in.get_length() );
+         return 0;
      }
      else {
-         ipfix_encode_bytes(in, out, relay_f);
+         return ipfix_encode_bytes(in, out, relay_f);
      }
 
 }
 
 mnslp_ipfix_value_field 
 mnslp_ipfix_field::decode( uint8_t *in, 
-						   size_t len, int relay_f)
+						   size_t len, int relay_f) const
 {
 	    if ( field_type.coding == IPFIX_CODING_INT ) {
             return ipfix_decode_int(in, len, relay_f);
@@ -696,7 +700,7 @@ mnslp_ipfix_field::decode( uint8_t *in,
             return ipfix_decode_bytes(in, len, relay_f);
         }
         else if ( field_type.coding == IPFIX_CODING_STRING ) {
-            return ipfix_decode_bytes(in, len, relay_f);
+            return get_ipfix_value_field((char *) in, (int) len);
         }
         else {
             return ipfix_decode_bytes(in, len, relay_f);
@@ -782,7 +786,7 @@ std::string mnslp_ipfix_field::print_value(mnslp_ipfix_value_field &in) const
 }
 	
 mnslp_ipfix_value_field
-mnslp_ipfix_field::get_ipfix_value_field(uint8_t &_value8)
+mnslp_ipfix_field::get_ipfix_value_field(uint8_t &_value8) const
 { 
 	mnslp_ipfix_value_field field;
 	if (field_type.length == 1)
@@ -794,7 +798,7 @@ mnslp_ipfix_field::get_ipfix_value_field(uint8_t &_value8)
 }
 
 mnslp_ipfix_value_field
-mnslp_ipfix_field::get_ipfix_value_field(uint16_t &_value16)
+mnslp_ipfix_field::get_ipfix_value_field(uint16_t &_value16) const
 { 
 	mnslp_ipfix_value_field field;
 	if (field_type.length == 2)
@@ -807,7 +811,7 @@ mnslp_ipfix_field::get_ipfix_value_field(uint16_t &_value16)
 }
 
 mnslp_ipfix_value_field
-mnslp_ipfix_field::get_ipfix_value_field(uint32_t &_value32)
+mnslp_ipfix_field::get_ipfix_value_field(uint32_t &_value32) const
 { 
 	mnslp_ipfix_value_field field;
 	if (field_type.length == 4)
@@ -819,7 +823,7 @@ mnslp_ipfix_field::get_ipfix_value_field(uint32_t &_value32)
 }
 
 mnslp_ipfix_value_field
-mnslp_ipfix_field::get_ipfix_value_field(uint64_t &_value64)
+mnslp_ipfix_field::get_ipfix_value_field(uint64_t &_value64) const
 { 
 	mnslp_ipfix_value_field field;
 	if (field_type.length == 8)
@@ -832,7 +836,7 @@ mnslp_ipfix_field::get_ipfix_value_field(uint64_t &_value64)
 }
 
 mnslp_ipfix_value_field
-mnslp_ipfix_field::get_ipfix_value_field(uint8_t * _valuebyte, int _length)
+mnslp_ipfix_field::get_ipfix_value_field(uint8_t * _valuebyte, int _length) const
 {	
         
     mnslp_ipfix_value_field field;
@@ -869,7 +873,7 @@ mnslp_ipfix_field::get_ipfix_value_field(uint8_t * _valuebyte, int _length)
 }
 
 mnslp_ipfix_value_field
-mnslp_ipfix_field::get_ipfix_value_field(char * _valuechar, int _length)
+mnslp_ipfix_field::get_ipfix_value_field(char * _valuechar, int _length) const
 {
 		
     mnslp_ipfix_value_field field;
@@ -884,171 +888,104 @@ mnslp_ipfix_field::get_ipfix_value_field(char * _valuechar, int _length)
 	return field;
 }
 
-mnslp_ipfix_value_field::~mnslp_ipfix_value_field()
-{
-	if (valuechar != NULL)
-		free( valuechar );
-	
-	if ( valuebyte != NULL )
-		free( valuebyte );
-
-}
-
 void
-mnslp_ipfix_value_field::set_value_vunit8(uint8_t * _valuebyte, int _length)
+mnslp_ipfix_value_field::release()
 {
+	if ( is_shared() && (__sync_sub_and_fetch(&shared->refs, 1) == 0) )
+		free( shared );
 
-	valuebyte = (uint8_t*) malloc(sizeof(uint8_t) * _length);
-	for (int i=0; i< _length; i++)
-		valuebyte[i] = _valuebyte[i];
-	length = _length;
-	
+	value64 = 0;
+	length = 0;
+	kind = KIND_EMPTY;
 }
 
 void
-mnslp_ipfix_value_field::set_value_vchar(char * _valuechar, int _length)
+mnslp_ipfix_value_field::set_data(uint8_t _kind, const uint8_t *_data, int _length)
 {
+	release();
 
-	valuechar = (char *)malloc(sizeof(char *) * _length);
-	memcpy ( valuechar, _valuechar, _length );
-	length = _length;
-}
-
-mnslp_ipfix_value_field::mnslp_ipfix_value_field(const mnslp_ipfix_value_field &param)
-{
-	
-	value8 = param.value8;
-	value16 = param.value16;
-	value32 = param.value32;
-	value64 = param.value64;
-	length = param.length;
-	
-	if ((param.valuechar != NULL) && (param.length > 0))
+	if (_length > INLINE_LENGTH)
 	{
-		valuechar = (char *)malloc(sizeof(char *) * param.length);
-		length = param.length;
-		for (int i=0; i < param.length; i++)
-			valuechar[i] = param.valuechar[i];
+		shared_buffer *block = (shared_buffer *) 
+				malloc(offsetof(shared_buffer, data) + _length);
+		if (block == NULL)
+			throw std::bad_alloc();
+		
+		block->refs = 1;
+		memcpy( block->data, _data, _length );
+		shared = block;
 	}
-	else
+	else if (_length > 0)
 	{
-		valuechar = NULL;
+		memcpy( inline_data, _data, _length );
 	}
 	
-	if ((param.valuebyte != NULL) && (param.length > 0) )
+	kind = _kind;
+	length = _length;
+}
+
+void
+mnslp_ipfix_value_field::copy_from(const mnslp_ipfix_value_field &param)
+{
+	if ( param.is_shared() )
 	{
-		valuebyte = (uint8_t*)malloc(sizeof(uint8_t) * param.length);
-		length = param.length;
-		for (int i=0; i < param.length; i++)
-			valuebyte[i] = param.valuebyte[i];
+		__sync_fetch_and_add(&param.shared->refs, 1);
+		shared = param.shared;
 	}
 	else
 	{
-		valuebyte = NULL;
+		memcpy( inline_data, param.inline_data, INLINE_LENGTH );
 	}
+	
+	length = param.length;
+	kind = param.kind;
+}
 
+mnslp_ipfix_value_field::mnslp_ipfix_value_field(const mnslp_ipfix_value_field &param)
+{
+	copy_from(param);
 }
 
 mnslp_ipfix_value_field& 
 mnslp_ipfix_value_field::operator= (const mnslp_ipfix_value_field &param)
 {
-		
-	value8 = param.value8;
-	value16 = param.value16;
-	value32 = param.value32;
-	value64 = param.value64;
-	length = param.length;
-	
-	if ((param.valuechar != NULL) && (param.length > 0))
-	{
-		valuechar = (char *)malloc(sizeof(char *) * param.length);
-		length = param.length;
-		for (int i=0; i < param.length; i++)
-			valuechar[i] = param.valuechar[i];
-	}
-	else
-	{
-		valuechar = NULL;
-	}
-	
-	if ((param.valuebyte != NULL) && (param.length > 0))
-	{
-		valuebyte = (uint8_t*)malloc(sizeof(uint8_t) * param.length);
-		length = param.length;
-		for (int i=0; i < param.length; i++)
-			valuebyte[i] = param.valuebyte[i];
-	}
-	else
+	if (this != &param)
 	{
-		valuebyte = NULL;
+		release();
+		copy_from(param);
 	}
+	return *this;
 }
 
-
 bool
 mnslp_ipfix_value_field::operator==( const mnslp_ipfix_value_field &param) const
 {
 
-	if ( ((param.valuechar == NULL ) and (valuechar == NULL)) 
-	    and ((param.valuebyte == NULL ) and (valuebyte == NULL)) ) {
-			
-		if (length != param.length)
-			return false;
-				
-		if ( (value8 != param.value8) and (length == 1))
-			return false;
-		
-		if ((value16 != param.value16) and (length == 2))
-			return false;
-		
-		if ((value32 != param.value32) and (length == 4))
-			return false;
-
-		if ((value64 != param.value64) and (length == 8))
-			return false;	
-	}
-	else
-	{
+	if ((kind != param.kind) || (length != param.length))
+		return false;
 	
-		/* It is different it they have the valuechar different */
-		if ((param.valuechar == NULL ) and (valuechar != NULL))
-			return false;
-			
-		else if ((param.valuechar != NULL ) and (valuechar == NULL))
-			return false;
+	switch (kind)
+	{
+		case KIND_NUMBER:
+			switch (length)
+			{
+				case 1: 
+					return value8 == param.value8;
+				case 2: 
+					return value16 == param.value16;
+				case 4: 
+					return value32 == param.value32;
+				default: 
+					return value64 == param.value64;
+			}
 			
-		else if ((param.valuechar != NULL ) 
-				  and (valuechar != NULL) 
-				  and (param.length != length))
-			return false;
-		
-		if ((param.valuechar != NULL) && (param.length > 0))
-		{
-			for (int i=0; i < param.length; i++)
-				if ( valuechar[i] != param.valuechar[i])
-					return false;
-		}
+		case KIND_STRING:
+		case KIND_BYTES:
+			return (length == 0) || (memcmp( data(), param.data(), length ) == 0);
 		
-		/* It is different it they have the valuebyte different */
-		if ((param.valuebyte == NULL ) and (valuebyte != NULL))
-			return false;
-		else if ((param.valuebyte != NULL ) and (valuebyte == NULL))
-			return false;
-		else if ((param.valuebyte != NULL ) 
-				  and (valuebyte != NULL) 
-				  and (param.length != length))
-			return false;
-			
-		if ((param.valuebyte != NULL) && (param.length > 0) )
-		{
-			for (int i=0; i < param.length; i++)
-				if ( valuebyte[i] != param.valuebyte[i])
-					return false;
-		}
-
+		default:
+			return true;
 	}
-	
-	return true;
 }
 
 bool
@@ -1057,64 +994,62 @@ mnslp_ipfix_value_field::operator!=( const mnslp_ipfix_value_field &param) const
 	return !(operator==(param));
 }
 
-void mnslp_ipfix_value_field::print(void)
+void mnslp_ipfix_value_field::print(void) const
 {
 	
-	if (valuechar != NULL )
-	{
-		for (int i=0; i < length; i++)
-			std::cout << valuechar[i];
-	}
-	
-	if (valuebyte != NULL )
+	if ((kind == KIND_STRING) || (kind == KIND_BYTES))
 	{
-		
+		const uint8_t *value = data();
 		for (int i=0; i < length; i++)
-			std::cout << valuebyte[i];
+			std::cout << (char) value[i];
 	}
 	
 }
 
-std::string mnslp_ipfix_value_field::to_string(void)
+std::string mnslp_ipfix_value_field::to_string(void) const
 {
 	
 	std::ostringstream o1;
 	o1 << "legth:";
 	o1 << length;
 
-	if (length == 1){
-		o1 << "Value8:";
-		o1 << value8;
-	}
-	
-	if (length == 2){
-		o1 << "Value16:";
-		o1 << value16;
-	}
-	
-	if (length == 4){
-		o1 << "Value32:";
-		o1 << value32;
-	}
+	if (kind == KIND_NUMBER)
+	{
+		if (length == 1){
+			o1 << "Value8:";
+			o1 << value8;
+		}
+		
+		if (length == 2){
+			o1 << "Value16:";
+			o1 << value16;
+		}
+		
+		if (length == 4){
+			o1 << "Value32:";
+			o1 << value32;
+		}
 
-	if (length == 8){
-		o1 << "Value64:";
-		o1 << value64;
+		if (length == 8){
+			o1 << "Value64:";
+			o1 << value64;
+		}
 	}
 	
-	if (valuechar != NULL )
+	if (kind == KIND_STRING)
 	{
+		const uint8_t *value = data();
 		o1 << "valueChar:"; 
 		for (int i=0; i < length; i++)
-			o1 << valuechar[i];
+			o1 << (char) value[i];
 	}
 	
-	if (valuebyte != NULL )
+	if (kind == KIND_BYTES)
 	{
-		
+		const uint8_t *value = data();
 		o1 << "valueByte:"; 
 		for (int i=0; i < length; i++)
-			o1 << valuebyte[i];
+			o1 << value[i];
 	}
 	
 	return o1.str();
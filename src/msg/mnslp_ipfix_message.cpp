@@ -55,8 +55,10 @@
 #include "msg/mnslp_ipfix_data_record.h"
 #include "msg/mnslp_ipfix_exception.h"
 #include "msg/mnslp_ipfix_template.h"
+#include "msg/mnslp_ipfix_byteorder.h"
 
 #include "msg/ipfix_t.h"
+#include "msg/mnslp_trace.h"
 
 
 namespace mnslp {
@@ -94,10 +96,84 @@ namespace mnslp {
 
 const char *const mnslp_ipfix_message::ie_name = "mnslp_ipfix_mspec";
 
+size_t mnslp_ipfix_message::bulk_min_records = 8;
+
+
+namespace {
+
+/*
+ * Width specific access to the values of a number column. Floats share
+ * the storage of the integers of the same width.
+ */
+inline void get_column_value( const mnslp_ipfix_value_field &v, uint8_t &x ) { x = v.get_value_int8(); }
+inline void get_column_value( const mnslp_ipfix_value_field &v, uint16_t &x ) { x = v.get_value_int16(); }
+inline void get_column_value( const mnslp_ipfix_value_field &v, uint32_t &x ) { x = v.get_value_int32(); }
+inline void get_column_value( const mnslp_ipfix_value_field &v, uint64_t &x ) { x = v.get_value_int64(); }
+
+inline void set_column_value( mnslp_ipfix_value_field &v, uint8_t &x ) { v.set_value_int8(x); }
+inline void set_column_value( mnslp_ipfix_value_field &v, uint16_t &x ) { v.set_value_int16(x); }
+inline void set_column_value( mnslp_ipfix_value_field &v, uint32_t &x ) { v.set_value_int32(x); }
+inline void set_column_value( mnslp_ipfix_value_field &v, uint64_t &x ) { v.set_value_int64(x); }
+
+inline void swap_column( uint8_t *column, size_t n ) { }
+inline void swap_column( uint16_t *column, size_t n ) { ipfix_hton_n(column, n); }
+inline void swap_column( uint32_t *column, size_t n ) { ipfix_hton_n(column, n); }
+inline void swap_column( uint64_t *column, size_t n ) { ipfix_hton_n(column, n); }
+
+/*
+ * Gather the values of one field, convert the byte order of the whole 
+ * column and scatter it to the records in out, stride bytes apart.
+ */
+template <typename T>
+void write_number_column( const std::vector<const mnslp_ipfix_value_field *> &values,
+						  size_t field, size_t nfields, bool swap,
+						  uint8_t *out, size_t stride )
+{
+	size_t nrecords = values.size() / nfields;
+	std::vector<T> column(nrecords);
+
+	for ( size_t r = 0; r < nrecords; r++ )
+		get_column_value(*values[r * nfields + field], column[r]);
+
+	if ( swap )
+		swap_column(&column[0], nrecords);
+
+	for ( size_t r = 0; r < nrecords; r++ )
+		memcpy( out + r * stride, &column[r], sizeof(T) );
+}
+
+/*
+ * The inverse of write_number_column: the values are appended to the 
+ * nrecords records starting at first.
+ */
+template <typename T>
+void read_number_column( const ipfix_field_descriptor_t &field,
+						 const uint8_t *in, size_t stride, bool swap,
+						 std::vector<mnslp_ipfix_data_record> &records, 
+						 size_t first, size_t nrecords )
+{
+	std::vector<T> column(nrecords);
+
+	for ( size_t r = 0; r < nrecords; r++ )
+		memcpy( &column[r], in + r * stride, sizeof(T) );
+
+	if ( swap )
+		swap_column(&column[0], nrecords);
+
+	for ( size_t r = 0; r < nrecords; r++ ) {
+		mnslp_ipfix_value_field value;
+		set_column_value(value, column[r]);
+		records[first + r].insert_field(field.eno, field.ftype, value);
+	}
+}
+
+} // anonymous namespace
+
+
 
 mnslp_ipfix_message::mnslp_ipfix_message( ):
 		mnslp_mspec_object(OBJECT_TYPE, tr_mandatory, false),
-		message(NULL), g_tstart(0), encode_network(true)
+		message(NULL), g_tstart(0), encode_network(true), require_output(true)
 {    
     init( 0, IPFIX_VERSION );
 }
@@ -152,6 +228,10 @@ size_t
 mnslp_ipfix_message::get_serialized_size(coding_t coding) const 
 {
 	size_t val_return;
+	
+	// The size depends on the output buffer, so it has to be current.
+	flush_output();
+	
 	val_return = HEADER_LENGTH;
 	val_return = val_return + get_offset();
 	
@@ -170,11 +250,11 @@ bool
 mnslp_ipfix_message::deserialize_body(NetMsg &msg, uint16 body_length,
 		IEErrorList &err, bool skip) {
 
-	std::cout << "deserialize body:" << body_length << std::endl;
+	MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_deserialize_body,
+				body_length, 0, 0);
 
 	uchar *messdef;
 	int num_read=0;
-	uchar *padding = new uchar[4];
 	int num_padding = 0;
 
 	messdef = (uchar *) malloc(sizeof(uchar) * body_length);
@@ -185,18 +265,19 @@ mnslp_ipfix_message::deserialize_body(NetMsg &msg, uint16 body_length,
 	
 	num_read = mnslp_ipfix_import(messdef, body_length );
 
-	std::cout << "after import message - bytes read:" << num_read 
-			  << "body lenght:" << body_length << std::endl;
+	MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_deserialize_done,
+				num_read, body_length, 0);
 
 	// Manage the possible padding added in the origin.
 	num_padding = body_length - num_read;	
 	for (int i = 0 ; i < num_padding; i++ )
 	{
 		if (messdef[num_read + i] != 0){
+			free(messdef);
 			return false;
 		}
 	}
-	std::cout << "here I am" << std::endl;
+	free(messdef);
 	msg.set_pos(start_pos + body_length);
 	return true;	
 }
@@ -204,6 +285,8 @@ mnslp_ipfix_message::deserialize_body(NetMsg &msg, uint16 body_length,
 bool 
 mnslp_ipfix_message::check_body() const
 {
+    flush_output();
+    
     if (get_offset() > 0 ){
 		return true;
     }
@@ -239,41 +322,84 @@ ostream &mnslp_ipfix_message::print_attributes(ostream &os) const
 void 
 mnslp_ipfix_message::serialize_body(NetMsg &msg) const 
 {
-	uchar *padding;
+	static const uchar padding[4] = { 0, 0, 0, 0 };
 	int num_padding = 0;
-	int offset = 0;
+	
+	flush_output();
+	
+	int offset = get_offset();
 	uint32 start_pos = msg.get_pos();	
-	msg.copy_from(get_message(),start_pos, get_offset());	
-	msg.set_pos(start_pos + get_offset());
+	msg.copy_from(get_message(), start_pos, offset);
+	msg.set_pos(start_pos + offset);
 	
 	// For GIST it is required to add padding if the message is not multiple
 	// of 4.
-	offset = get_offset();
 	num_padding = offset % 4;
 
 	if ( num_padding != 0 ){
 		num_padding = 4 - num_padding; // How many additional bytes are required.
-		std::cout << "get offset:" << offset << "Num padding:" << num_padding << std::endl;
-		padding = new uchar[4];
-		std::cout << "voy aqui" << std::endl;
-		for (int i = 0 ; i < num_padding; i++ ){
-			padding[i] = 0;
-		}
-		uint32 start_pos2 = msg.get_pos();
-		std::cout << "voy aqui 1" << std::endl;
-		msg.copy_from(padding,start_pos2, num_padding);
-		msg.set_pos(start_pos2 + num_padding);
-		std::cout << "voy aqui 3" << std::endl;
+		msg.copy_from(padding, start_pos + offset, num_padding);
+		msg.set_pos(start_pos + offset + num_padding);
 	}
+}
+
+/**
+ * Bring the output buffer up to date with the templates and data records,
+ * so get_offset() and get_message() reflect the current content. Readers
+ * in other threads may be doing the same, so it's done under the cache lock.
+ */
+void
+mnslp_ipfix_message::flush_output(void) const
+{
+	cache_lock lock(this);
+
+	if ( (message != NULL) && (require_output == true) )
+		const_cast<mnslp_ipfix_message *>(this)->output();
+}
+
+object_fingerprint
+mnslp_ipfix_message::compute_fingerprint(void) const throw (IEError)
+{
+	flush_output();
+	
+	if ( message == NULL )
+		return object_fingerprint::compute(NULL, 0);
 	
-	std::cout << "Num bytes copied:" << msg.get_pos() - start_pos << std::endl;
+	return fingerprint_content(get_message(), get_offset());
+}
 
+size_t
+mnslp_ipfix_message::get_header_length(void) const
+{
+	if ( (message != NULL) && (message->version == IPFIX_VERSION_NF9) )
+		return IPFIX_HDR_BYTES_NF9;
+	else
+		return IPFIX_HDR_BYTES;
+}
+
+object_fingerprint
+mnslp_ipfix_message::fingerprint_content(const uchar *buf, size_t len) const
+{
+	size_t hsize = get_header_length();
+	if ( len < hsize )
+		hsize = len;
+
+	object_fingerprint sets = object_fingerprint::compute(buf + hsize, len - hsize);
+
+	uint64_t mix[3] = { sets.high, sets.low, 
+		((uint64_t) (uint32_t) message->version << 32) | (uint32_t) message->sourceid };
+
+	return object_fingerprint::compute(mix, sizeof(mix));
 }
 
 void 
 mnslp_ipfix_message::set_encode_mode(bool _encode_network)
 {
-	encode_network = _encode_network;
+	if ( encode_network != _encode_network ){
+		encode_network = _encode_network;
+		require_output = true;
+		invalidate_encoding();
+	}
 }
 
 /*
@@ -317,13 +443,18 @@ void mnslp_ipfix_message::allocate_additional_memory(size_t additional)
 {
 	if (message)
 	{
-		if ((message->offset + additional) > message->buffer_lenght)
+		if (additional > 0)
 		{
-			message->buffer=(uchar *)realloc(message->buffer, message->offset + additional + 1);
-			if (message->buffer == NULL)
-				message->buffer_lenght = message->offset + additional + 1;
-			else
-				throw mnslp_ipfix_bad_argument("Could not increse the memory of the final char pointer");
+			// The buffer is allocated with new[], so it can not be realloc'ed.
+			size_t length = message->buffer_lenght + additional;
+			uchar *buffer = new uchar[length];
+			memcpy(buffer, message->buffer, message->buffer_lenght);
+			delete [] message->buffer;
+			
+			message->buffer = buffer;
+			message->buffer_lenght = length;
+			if (message->cs_header != NULL)
+				message->cs_header = buffer + message->cs_offset;
 		}
 	}
 	else
@@ -403,6 +534,7 @@ mnslp_ipfix_message::new_template( int nfields )
 		/** The message change, so it requires a new output 
 		 */
 		require_output = true;
+		invalidate_encoding();
 		
 		return t->get_template_id();
 	
@@ -430,6 +562,7 @@ mnslp_ipfix_message::new_data_template( int nfields )
 	/** The message changed, so it requires a new output 
 	 */
 	require_output = true;
+	invalidate_encoding();
 
     templid = new_template( nfields );
     templ = message->templates.get_template(templid);
@@ -452,6 +585,7 @@ mnslp_ipfix_message::new_option_template( int nfields )
 	/** The message changed, so it requires a new output 
 	 */
 	require_output = true;
+	invalidate_encoding();
 
     templid =  new_template( nfields );
     templ = message->templates.get_template(templid);
@@ -500,6 +634,7 @@ mnslp_ipfix_message::add_field(  uint16_t templid,
 		/** The message changed, so it requires a new output 
 		*/
 		require_output = true;
+		invalidate_encoding();
 
     }
     else 
@@ -541,6 +676,7 @@ mnslp_ipfix_message::add_scope_field( uint16_t templid,
 		/** The message changed, so it requires a new output 
 		*/
 		require_output = true;
+		invalidate_encoding();
 			
     }
     else 
@@ -562,6 +698,7 @@ void mnslp_ipfix_message::delete_template( uint16_t templid )
 	/** The message changed, so it requires a new output 
 	 */
 	require_output = true;
+	invalidate_encoding();
     
 }
 
@@ -579,6 +716,7 @@ void mnslp_ipfix_message::delete_all_templates( void )
 	/** The message changed, so it requires a new output 
 	 */
 	require_output = true;
+	invalidate_encoding();
 
 }
 
@@ -607,6 +745,7 @@ mnslp_ipfix_message::make_template( export_fields_t *fields,
 		/** The message changed, so it requires a new output 
 		*/
 		require_output = true;
+		invalidate_encoding();
 		
 		return templid;
 				
@@ -691,8 +830,8 @@ mnslp_ipfix_message::_write_hdr( void )
     else 
     {
         hsize = IPFIX_HDR_BYTES;
-        std::cout << "buffer offset:" << message->offset 
-				  << "hdr bytes:" << IPFIX_HDR_BYTES << std::endl;
+        MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_write_hdr,
+					message->offset, message->nrecords, 0);
         if ( hsize + message->offset > message->buffer_lenght ) 
 			allocate_additional_memory(hsize + message->offset - message->buffer_lenght );
 
@@ -718,8 +857,8 @@ mnslp_ipfix_message::_write_hdr( void )
 		message->exporttime = now;
 		message->offset += hsize;		
     }
-    std::cout << "final message size:" << message->offset
-		      << "message lenght:" << message->length << std::endl;
+    MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_hdr_written,
+				message->offset, 0, 0);
 }
 
 
@@ -773,19 +912,19 @@ mnslp_ipfix_message::_write_template( mnslp_ipfix_template  *templ )
     uchar             *buf;
     uint16_t          tmp16;
     int               i, n;
+    const std::vector<ipfix_field_descriptor_t> &fields = templ->get_field_descriptors();
 
     /** calc template size
      */
     if ( templ->get_type() == OPTION_TEMPLATE ) {
         for ( i=0, ssize=0; i<templ->get_number_scopefields(); i++ ) {
             ssize += 4;
-            if ((templ->get_field(i).elem).get_field_type().eno != IPFIX_FT_NOENO)
+            if (fields[i].eno != IPFIX_FT_NOENO)
                 ssize += 4;
         }
-        std::cout << "Option Template - number of fields:" << templ->get_numfields() << std::endl;
         for ( osize=0; i<templ->get_numfields(); i++ ) {
             osize += 4;
-            if ((templ->get_field(i).elem).get_field_type().eno != IPFIX_FT_NOENO)
+            if (fields[i].eno != IPFIX_FT_NOENO)
                 osize += 4;
         }
         tsize = 10 + osize + ssize;
@@ -793,12 +932,14 @@ mnslp_ipfix_message::_write_template( mnslp_ipfix_template  *templ )
     else {
         for ( tsize=8,i=0; i < templ->get_numfields(); i++ ) {
             tsize += 4;
-            if ((templ->get_field(i).elem).get_field_type().eno != IPFIX_FT_NOENO)
+            if (fields[i].eno != IPFIX_FT_NOENO)
                 tsize += 4;
         }
     }
     
-    std::cout << "template size:" << tsize << std::endl;
+    MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_write_template,
+				templ->get_template_id(), templ->get_numfields(), 
+				templ->get_number_scopefields());
 
     /* check space */
     if ( tsize + message->offset > message->buffer_lenght ) 
@@ -889,29 +1030,28 @@ mnslp_ipfix_message::_write_template( mnslp_ipfix_template  *templ )
     if ( templ->get_type() == OPTION_TEMPLATE ) 
     {
         n = templ->get_numfields();
-        std::cout << "num scope fields:" << templ->get_number_scopefields() << std::endl;
         for ( i=0; i<templ->get_number_scopefields(); i++ ) {
-            if ( (templ->get_field(i).elem).get_field_type().eno == IPFIX_FT_NOENO ) {
+            if ( fields[i].eno == IPFIX_FT_NOENO ) {
 				if (encode_network == true){
-					INSERTU16( buf+buflen, buflen, (templ->get_field(i).elem).get_field_type().ftype );
-					INSERTU16( buf+buflen, buflen, templ->get_field(i).flength );
+					INSERTU16( buf+buflen, buflen, fields[i].ftype );
+					INSERTU16( buf+buflen, buflen, fields[i].flength );
 				}
 				else{
-					INSERT_U16_NOENCODE( buf+buflen, buflen, (templ->get_field(i).elem).get_field_type().ftype );
-					INSERT_U16_NOENCODE( buf+buflen, buflen, templ->get_field(i).flength );
+					INSERT_U16_NOENCODE( buf+buflen, buflen, fields[i].ftype );
+					INSERT_U16_NOENCODE( buf+buflen, buflen, fields[i].flength );
 				}
             } 
             else {
-                tmp16 = (templ->get_field(i).elem).get_field_type().ftype|IPFIX_EFT_VENDOR_BIT;
+                tmp16 = fields[i].ftype|IPFIX_EFT_VENDOR_BIT;
                 if (encode_network == true){
 					INSERTU16( buf+buflen, buflen, tmp16 );
-					INSERTU16( buf+buflen, buflen, templ->get_field(i).flength );
-					INSERTU32( buf+buflen, buflen, (templ->get_field(i).elem).get_field_type().eno );
+					INSERTU16( buf+buflen, buflen, fields[i].flength );
+					INSERTU32( buf+buflen, buflen, fields[i].eno );
 				}
 				else{
 					INSERT_U16_NOENCODE( buf+buflen, buflen, tmp16 );
-					INSERT_U16_NOENCODE( buf+buflen, buflen, templ->get_field(i).flength );
-					INSERT_U32_NOENCODE( buf+buflen, buflen, (templ->get_field(i).elem).get_field_type().eno );					
+					INSERT_U16_NOENCODE( buf+buflen, buflen, fields[i].flength );
+					INSERT_U32_NOENCODE( buf+buflen, buflen, fields[i].eno );					
 				}
             }
         }
@@ -923,33 +1063,35 @@ mnslp_ipfix_message::_write_template( mnslp_ipfix_template  *templ )
 
     for ( ; i<templ->get_numfields(); i++ )
     {
-        std::cout << "entro field:" << i << std::endl;
-        if ( (templ->get_field(i).elem).get_field_type().eno == IPFIX_FT_NOENO ) {
+        MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_template_field,
+					templ->get_template_id(), i, 0);
+        if ( fields[i].eno == IPFIX_FT_NOENO ) {
 			if (encode_network == true){
-				INSERTU16( buf+buflen, buflen, (templ->get_field(i).elem).get_field_type().ftype );
-				INSERTU16( buf+buflen, buflen, templ->get_field(i).flength );
+				INSERTU16( buf+buflen, buflen, fields[i].ftype );
+				INSERTU16( buf+buflen, buflen, fields[i].flength );
 			}
 			else{
-				INSERT_U16_NOENCODE( buf+buflen, buflen, (templ->get_field(i).elem).get_field_type().ftype );
-				INSERT_U16_NOENCODE( buf+buflen, buflen, templ->get_field(i).flength );				
+				INSERT_U16_NOENCODE( buf+buflen, buflen, fields[i].ftype );
+				INSERT_U16_NOENCODE( buf+buflen, buflen, fields[i].flength );				
 			}
         } 
         else {
-            tmp16 = (templ->get_field(i).elem).get_field_type().ftype|IPFIX_EFT_VENDOR_BIT;
+            tmp16 = fields[i].ftype|IPFIX_EFT_VENDOR_BIT;
             if (encode_network == true){
 				INSERTU16( buf+buflen, buflen, tmp16 );
-				INSERTU16( buf+buflen, buflen, templ->get_field(i).flength );
-				INSERTU32( buf+buflen, buflen, (templ->get_field(i).elem).get_field_type().eno );
+				INSERTU16( buf+buflen, buflen, fields[i].flength );
+				INSERTU32( buf+buflen, buflen, fields[i].eno );
 			}
 			else{
 				INSERT_U16_NOENCODE( buf+buflen, buflen, tmp16 );
-				INSERT_U16_NOENCODE( buf+buflen, buflen, templ->get_field(i).flength );
-				INSERT_U32_NOENCODE( buf+buflen, buflen, (templ->get_field(i).elem).get_field_type().eno );				
+				INSERT_U16_NOENCODE( buf+buflen, buflen, fields[i].flength );
+				INSERT_U32_NOENCODE( buf+buflen, buflen, fields[i].eno );				
 			}
         }
     }
     templ->set_time_send( time(NULL) );
-	std::cout << "buffer len:" << buflen << std::endl;
+	MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_template_written,
+				templ->get_template_id(), buflen, 0);
     message->offset += buflen;
     if ( message->version == IPFIX_VERSION_NF9 )
          message->nrecords++;
@@ -1040,7 +1182,19 @@ mnslp_ipfix_message::output_set( uint16_t templid )
         newset_f = 1;
         datasetlen = 4;
     }
+    
+    /** fixed length records go column by column when there are enough
+     */
+    if ( newset_f && (templ->get_record_length() > 0) 
+		 && output_fixed_records( templ ) ) {
+		_output_flush( );
+		return;
+	}
         	
+    const std::vector<ipfix_field_descriptor_t> &fields = templ->get_field_descriptors();
+    std::vector<const mnslp_ipfix_value_field *> values;
+    values.reserve(fields.size());
+
     // insert the data records associated with the template.
     for ( int data_index= 0; data_index < data_list.size(); data_index++)
 	{
@@ -1048,23 +1202,30 @@ mnslp_ipfix_message::output_set( uint16_t templid )
 		if (data_list[data_index].get_template_id() == templ->get_template_id())
 		{
 			
-			mnslp_ipfix_data_record g_data = data_list[data_index];
+			const mnslp_ipfix_data_record &g_data = data_list[data_index];
+			
+			// look up every value once; the pointers stay valid while the
+			// record is written.
+			values.clear();
 			for ( i=0; i < templ->get_numfields(); i++ )
 			{
-				mnslp_ipfix_field_key field_key = mnslp_ipfix_field_key((templ->get_field(i).elem).get_field_type().eno, 
-																		(templ->get_field(i).elem).get_field_type().ftype);
-				if ( templ->get_field(i).flength == IPFIX_FT_VARLEN ) {
+				const mnslp_ipfix_value_field &value = 
+					g_data.get_field_value(mnslp_ipfix_field_key(fields[i].eno, 
+																 fields[i].ftype));
+				values.push_back(&value);
+				
+				if ( fields[i].varlen ) {
 					
-					if ( g_data.get_length(field_key) > 254 )
+					if ( value.get_length() > 254 )
 						datasetlen += 3;
 					else
 						datasetlen += 1;
 				} 
 				else 
-					if ( g_data.get_length(field_key) > templ->get_field(i).flength )
+					if ( value.get_length() > fields[i].flength )
 						throw mnslp_ipfix_bad_argument("Data length greater than field definition lenght");
 						
-				datasetlen += g_data.get_length(field_key);
+				datasetlen += value.get_length();
 			}
 
 
@@ -1096,31 +1257,28 @@ mnslp_ipfix_message::output_set( uint16_t templid )
 			
 			for ( i=0; i < templ->get_numfields(); i++ ) {
 								
-				mnslp_ipfix_field_key field_key = mnslp_ipfix_field_key((templ->get_field(i).elem).get_field_type().eno, 
-																		(templ->get_field(i).elem).get_field_type().ftype);
+				const mnslp_ipfix_value_field &value = *values[i];
 				
-				if ( templ->get_field(i).flength == IPFIX_FT_VARLEN ) {
-					if ( g_data.get_length(field_key) > 254 ) {
+				if ( fields[i].varlen ) {
+					if ( value.get_length() > 254 ) {
 						*(buf+buflen) = 0xFF;
 						buflen++;
 						if (encode_network == true){
-							INSERTU16( buf+buflen, buflen, g_data.get_length(field_key) );
+							INSERTU16( buf+buflen, buflen, value.get_length() );
 						}
 						else{
-							INSERT_U16_NOENCODE( buf+buflen, buflen, g_data.get_length(field_key) );
+							INSERT_U16_NOENCODE( buf+buflen, buflen, value.get_length() );
 						}
 					}
 					else {
-						*(buf+buflen) = g_data.get_length(field_key);
+						*(buf+buflen) = value.get_length();
 						buflen++;
 					}
 				}
 				
-				(templ->get_field(i).elem).encode( g_data.get_field(field_key), 
-												   buf+buflen, 
-												   templ->get_field(i).relay_f );
+				fields[i].encode( *fields[i].elem, value, buf+buflen );
 
-				buflen += g_data.get_length(field_key);
+				buflen += value.get_length();
 			}
 			message->nrecords ++;
 			message->offset += buflen;
@@ -1129,13 +1287,118 @@ mnslp_ipfix_message::output_set( uint16_t templid )
 		    if ( message->version == IPFIX_VERSION )
 				message->seqno ++;
 		}
-		std::cout << "data len:" << data_index << std::endl;
+		MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_output_set,
+					templid, data_index, 0);
 	}
     _output_flush( );
 		        
 }
 
 
+bool 
+mnslp_ipfix_message::output_fixed_records( mnslp_ipfix_template *templ )
+{
+	const std::vector<ipfix_field_descriptor_t> &fields = templ->get_field_descriptors();
+	size_t nfields = fields.size();
+	size_t stride = 4 + templ->get_record_length();
+	std::vector<const mnslp_ipfix_value_field *> values;
+	
+	if ( bulk_min_records == 0 )
+		return false;
+	
+	/** look up every value once and check that it fills its field; 
+	 *  otherwise the records go field by field.
+	 */
+	for ( size_t data_index = 0; data_index < data_list.size(); data_index++ )
+	{
+		const mnslp_ipfix_data_record &g_data = data_list[data_index];
+		if ( g_data.get_template_id() != templ->get_template_id() )
+			continue;
+		
+		for ( size_t i = 0; i < nfields; i++ )
+		{
+			const mnslp_ipfix_value_field &value = 
+				g_data.get_field_value(mnslp_ipfix_field_key(fields[i].eno, 
+															 fields[i].ftype));
+			if ( value.get_length() != fields[i].flength )
+				return false;
+			values.push_back(&value);
+		}
+	}
+	
+	size_t nrecords = values.size() / nfields;
+	if ( nrecords < bulk_min_records )
+		return false;
+	
+	if ( (message->offset + nrecords * stride) > message->buffer_lenght )
+		allocate_additional_memory( nrecords * stride + message->offset 
+										- message->buffer_lenght );
+	
+	uint8_t *buf = (uint8_t*)(message->buffer) + message->offset;
+	
+	/** every record goes in its own set, as in output_set.
+	 */
+	for ( size_t r = 0; r < nrecords; r++ )
+	{
+		uint8_t *p = buf + r * stride;
+		size_t  buflen = 0;
+		if (encode_network == true){
+			INSERTU16( p+buflen, buflen, templ->get_template_id() );
+			INSERTU16( p+buflen, buflen, stride );
+		}
+		else{
+			INSERT_U16_NOENCODE( p+buflen, buflen, templ->get_template_id() );
+			INSERT_U16_NOENCODE( p+buflen, buflen, stride );
+		}
+	}
+	
+	for ( size_t i = 0; i < nfields; i++ )
+	{
+		uint8_t *out = buf + 4 + fields[i].offset;
+		bool swap = ( fields[i].relay_f == 0 );
+		
+		if ( fields[i].column == IPFIX_COLUMN_RAW ) {
+			for ( size_t r = 0; r < nrecords; r++ )
+				memcpy( out + r * stride, values[r * nfields + i]->get_value_byte(), 
+						fields[i].flength );
+			continue;
+		}
+		
+		switch ( fields[i].flength )
+		{
+		  case 1:
+			  write_number_column<uint8_t>(values, i, nfields, swap, out, stride);
+			  break;
+		  case 2:
+			  write_number_column<uint16_t>(values, i, nfields, swap, out, stride);
+			  break;
+		  case 4:
+			  write_number_column<uint32_t>(values, i, nfields, swap, out, stride);
+			  break;
+		  case 8:
+			  write_number_column<uint64_t>(values, i, nfields, swap, out, stride);
+			  break;
+		}
+	}
+	
+	message->nrecords += nrecords;
+	message->offset += nrecords * stride;
+	if ( message->version == IPFIX_VERSION )
+		message->seqno += nrecords;
+	
+	/** all the sets are complete, as after finish_cs.
+	 */
+	message->cs_bytes = 0;
+	message->cs_offset = 0;
+	message->cs_header = NULL;
+	message->cs_tid = 0;
+	
+	MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_output_records,
+				templ->get_template_id(), nrecords, 0);
+	return true;
+}
+
+
 void 
 mnslp_ipfix_message::include_data( uint16_t templid, 
 								   mnslp_ipfix_data_record &data )
@@ -1158,6 +1421,7 @@ mnslp_ipfix_message::include_data( uint16_t templid,
 	/** The message changed, so it requires a new output 
 	*/
 	require_output = true;
+	invalidate_encoding();
     
 }
 
@@ -1224,8 +1488,8 @@ mnslp_ipfix_message::mnslp_ipfix_parse_hdr( uchar *mes, int offset )
     switch ( _version ) {
       case IPFIX_VERSION_NF9:
 
-		  std::cout << " Arrive 1.3" << std::endl;
-		  fflush( stdout) ;
+		  MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_parse_hdr,
+					  _version, offset, 0);
 
           if ( (offset) < IPFIX_HDR_BYTES_NF9 )
               throw mnslp_ipfix_bad_argument("Invalid message given");
@@ -1259,7 +1523,8 @@ mnslp_ipfix_message::mnslp_ipfix_parse_hdr( uchar *mes, int offset )
 
       case IPFIX_VERSION:
 
-		  std::cout << " Arrive 1.4" << std::endl;
+		  MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_parse_hdr,
+					  _version, offset, 0);
 
           if ( (offset) < IPFIX_HDR_BYTES )
               throw mnslp_ipfix_bad_argument("Length of the message header is less than required");
@@ -1276,12 +1541,6 @@ mnslp_ipfix_message::mnslp_ipfix_parse_hdr( uchar *mes, int offset )
 			  READ32_NOENCODE(_seqno,mes+8);
 			  READ32_NOENCODE(_sourceid,mes+12);
 		  }
-          std::cout << "header received" << _version 
-					<< "length:"         << _length
-					<< "exporttime:"	 << _exporttime
-					<< "seqno:"			 << _seqno
-					<< "sourceid:"		 << _sourceid << std::endl;
-
 		  /* Initialize the message object */
 		  init(_sourceid, _version); 
           message->version = _version;
@@ -1292,12 +1551,11 @@ mnslp_ipfix_message::mnslp_ipfix_parse_hdr( uchar *mes, int offset )
           break;
 
       default:
-		  std::cout << " Arrive 1.5" << std::endl;
+		  MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_parse_hdr,
+					  _version, offset, 0);
           message->version = -1;
           throw mnslp_ipfix_bad_argument("Invalid Message Version");
     }
-	std::cout << " Arrive 1.2" << std::endl;
-	
 }
 
 
@@ -1323,10 +1581,10 @@ mnslp_ipfix_message::mnslp_ipfix_decode_trecord( int setid,
 
     /** read template header
      */
-    std::cout << "Reading template - setid::" << setid << std::endl;
+    MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_decode_template,
+				setid, len, 0);
     switch( setid ) {
       case IPFIX_SETID_OPTTEMPLATE:
-		  std::cout << "read option template" << std::endl;
           if ( len<6 )
               throw mnslp_ipfix_bad_argument("invalid message lenght");
           if (encode_network == true){    
@@ -1344,7 +1602,6 @@ mnslp_ipfix_message::mnslp_ipfix_decode_trecord( int setid,
           break;
       case IPFIX_SETID_OPTTEMPLATE_NF9:
       {          
-          std::cout << "read option template 2" << std::endl;
           size_t scopelen, optionlen;
           if ( len<6 )
               throw mnslp_ipfix_bad_argument("invalid message lenght");
@@ -1371,7 +1628,6 @@ mnslp_ipfix_message::mnslp_ipfix_decode_trecord( int setid,
       }
       case IPFIX_SETID_TEMPLATE:
       case IPFIX_SETID_TEMPLATE_NF9:
-          std::cout << "data template" << std::endl;
           if ( len<4 )
              throw mnslp_ipfix_bad_argument("invalid message lenght");
           if (encode_network == true){
@@ -1456,7 +1712,8 @@ mnslp_ipfix_message::mnslp_ipfix_decode_trecord( int setid,
 		throw mnslp_ipfix_bad_argument("Could not read the template information"); 
 	}
 	
-	std::cout << "Finish Ok reading template" << std::endl;
+	MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_template_decoded,
+				setid, *nread, 0);
 }
 
 
@@ -1568,9 +1825,10 @@ void mnslp_ipfix_message::mnslp_ipfix_decode_datarecord( mnslp_ipfix_template *t
     int           i, len, bytesleft;
     std::string   func = "mnslp_ipfix_decode_datarecord";
     mnslp_ipfix_data_record g_data(templ->get_template_id());
-    char salida[30];
+    const std::vector<ipfix_field_descriptor_t> &fields = templ->get_field_descriptors();
     
-    std::cout << "Reading datarecord" << std::endl;
+    MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_decode_datarecord,
+				templ->get_template_id(), buflen, 0);
     
     /** parse message
      */
@@ -1580,7 +1838,7 @@ void mnslp_ipfix_message::mnslp_ipfix_decode_datarecord( mnslp_ipfix_template *t
         
     for ( i=0; i < templ->get_numfields(); i++ ) {
 
-        len = templ->get_field(i).flength;
+        len = fields[i].flength;
         if ( len == IPFIX_FT_VARLEN ) {
             len =*p;
             p++;
@@ -1604,18 +1862,11 @@ void mnslp_ipfix_message::mnslp_ipfix_decode_datarecord( mnslp_ipfix_template *t
 		
 		
 		
-        mnslp_ipfix_value_field value;
-        if (encode_network){
-			value = (templ->get_field(i).elem).decode(p,len, 1);
-		}
-		else{
-			value = (templ->get_field(i).elem).decode(p,len, 0);
-		}
+        mnslp_ipfix_value_field value = 
+				fields[i].decode[encode_network ? 1 : 0](*fields[i].elem, p, len);
 
-		(templ->get_field(i).elem).snprint(salida, 30, value);
-				
-        g_data.insert_field((templ->get_field(i).elem).get_field_type().eno, 
-						    (templ->get_field(i).elem).get_field_type().ftype, value); 
+        g_data.insert_field(fields[i].eno, 
+						    fields[i].ftype, value); 
 						    
         p        += len;
         (*nread) += len;
@@ -1623,10 +1874,64 @@ void mnslp_ipfix_message::mnslp_ipfix_decode_datarecord( mnslp_ipfix_template *t
     
     data_list.push_back(g_data);
     
-    std::cout << "Finish Reading datarecord" << std::endl;
+    MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_datarecord_decoded,
+				templ->get_template_id(), *nread, 0);
 
 }
 
+void 
+mnslp_ipfix_message::decode_fixed_records( mnslp_ipfix_template *templ,
+										   uchar *buf, size_t nrecords )
+{
+	const std::vector<ipfix_field_descriptor_t> &fields = templ->get_field_descriptors();
+	size_t stride = templ->get_record_length();
+	const uint8_t *p = reinterpret_cast<const uint8_t *>(buf);
+	bool swap = !encode_network;
+	size_t first = data_list.size();
+	
+	data_list.resize( first + nrecords, 
+					  mnslp_ipfix_data_record(templ->get_template_id()) );
+	
+	for ( size_t i = 0; i < fields.size(); i++ )
+	{
+		const uint8_t *in = p + fields[i].offset;
+		
+		if ( fields[i].column == IPFIX_COLUMN_RAW ) {
+			for ( size_t r = 0; r < nrecords; r++ ) {
+				mnslp_ipfix_value_field value;
+				value.set_value_vunit8( const_cast<uint8_t *>(in + r * stride), 
+										fields[i].flength );
+				data_list[first + r].insert_field(fields[i].eno, 
+												  fields[i].ftype, value);
+			}
+			continue;
+		}
+		
+		switch ( fields[i].flength )
+		{
+		  case 1:
+			  read_number_column<uint8_t>(fields[i], in, stride, swap, 
+										  data_list, first, nrecords);
+			  break;
+		  case 2:
+			  read_number_column<uint16_t>(fields[i], in, stride, swap, 
+										   data_list, first, nrecords);
+			  break;
+		  case 4:
+			  read_number_column<uint32_t>(fields[i], in, stride, swap, 
+										   data_list, first, nrecords);
+			  break;
+		  case 8:
+			  read_number_column<uint64_t>(fields[i], in, stride, swap, 
+										   data_list, first, nrecords);
+			  break;
+		}
+	}
+	
+	MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_decode_records,
+				templ->get_template_id(), nrecords, 0);
+}
+
 mnslp_ipfix_template * 
 mnslp_ipfix_message::get_template(uint16_t templid)
 {
@@ -1638,6 +1943,18 @@ mnslp_ipfix_message::get_template(uint16_t templid)
 	}
 }
 
+void 
+mnslp_ipfix_message::set_bulk_min_records( size_t min_records )
+{
+	bulk_min_records = min_records;
+}
+
+size_t 
+mnslp_ipfix_message::get_bulk_min_records( void )
+{
+	return bulk_min_records;
+}
+
 mnslp_ipfix_template * 
 mnslp_ipfix_message::get_template(uint16_t templid) const
 {
@@ -1659,7 +1976,8 @@ mnslp_ipfix_message::mnslp_ipfix_import( uchar  *buffer,
     int                  err_flag = 0;
     std::string          func = "mnslp_ipfix_import";
 
-	std::cout << "mnslp_ipfix_import" << message_length << std::endl;
+	MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_import,
+				message_length, 0, 0);
 
     if (message_length < 2)
 		throw mnslp_ipfix_bad_argument("Invalid Message");
@@ -1700,24 +2018,15 @@ mnslp_ipfix_message::mnslp_ipfix_import( uchar  *buffer,
 			READ16_NOENCODE(setid, buf+nread);
 			READ16_NOENCODE(setlen, buf+nread+2);
 		}
-		std::cout << "read setid:" << setid << std::endl;
-		std::cout << "setlen:" << setlen << std::endl;	
+		MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_import_set,
+					setid, setlen, nread);
         nread  += 4;
         if ( setlen < 4 ) {
             // std::string err1 = func + "set" + std::to_string(i+1) + ": invalid set length " + std::to_string(setlen);
             continue;
         }
         setlen -= 4;  // this corresponds to the record's header.
-        std::cout << "message_length:" << 	message_length << std::endl;	
-        std::cout << "nread:" << nread << std::endl;	
-        std::cout << "setlen:" << setlen << std::endl;		
         if (setlen > (message_length - nread)) {
-			int ii;
-
-			for (ii = 0; ii < message_length; ii++)
-				fprintf(stderr, "[%02x]", ((buffer)[ii] & 0xFF));
-			fprintf(stderr, "\n");
-
 			//std::string err2 = func + "set" + std::to_string(i+1) + ": message too short (" + std::to_string(setlen+nread) + ">" + std::to_string(offset)+ ")";
 			goto end;
 		}
@@ -1753,15 +2062,22 @@ mnslp_ipfix_message::mnslp_ipfix_import( uchar  *buffer,
             else {
                 /** read data records
                  */
+                size_t reclen = templ->get_record_length();
                 for ( offset=nread, bytesleft=setlen; bytesleft>0; ) {
-                    mnslp_ipfix_decode_datarecord( templ, buf+offset, bytesleft,
-                                                  &bytes );
+                    if ( (reclen > 0) && (bulk_min_records > 0)
+						 && ((size_t) bytesleft >= reclen * bulk_min_records) ) {
+						size_t nrecords = bytesleft / reclen;
+						decode_fixed_records( templ, buf+offset, nrecords );
+						bytes = nrecords * reclen;
+					}
+					else {
+						mnslp_ipfix_decode_datarecord( templ, buf+offset, bytesleft,
+													  &bytes );
+					}
                     
                     bytesleft -= bytes;
                     offset    += bytes;
-                    
-                    std::cout << "bytes left" << bytesleft << std::endl;
-                    
+
                 }
                 if ( bytesleft ) {
                     // mlogf( 3, "[%s] set%d: skip %d bytes padding\n",
@@ -1782,7 +2098,8 @@ mnslp_ipfix_message::mnslp_ipfix_import( uchar  *buffer,
 
 end:
 
-	std::cout << "import finish ok" << std::endl;
+	MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_import_done,
+				1, nread, 0);
     message->copy_raw_message(buffer, nread);
     
     // Establishes correct values for the current data set.
@@ -1798,11 +2115,17 @@ end:
      */
     require_output = false;
     
+    /** The buffer is what we received, so it gives the fingerprint.
+     */
+    set_fingerprint(fingerprint_content(message->buffer, nread));
+    
     return nread;
 
  errend:
-	std::cout << "import not finish ok" << std::endl;
+	MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_import_done,
+				0, nread, 0);
     data_list.clear();
+    invalidate_encoding();
     return -1;
 	
 }
@@ -1823,28 +2146,34 @@ mnslp_ipfix_message::isEqual (const mnslp_mspec_object &rhs) const
 		if ((obj->message == NULL) and (message != NULL))
 			return false;
 		
-		// compare message header information.
-		if ((obj->message != NULL) and (message != NULL)){
+		try
+		{
+			// Bring both buffers up to date and compare their hashes.
+			const object_fingerprint &fp = get_fingerprint();
+			const object_fingerprint &other_fp = obj->get_fingerprint();
 			
-			if (*(obj->message) != *message){
-				std::cout << "Different header" << std::endl;
-				return false;
-			}							
-			try
-			{
-				for (int i = 0; i < data_list.size(); i++){
-					if ( data_list[i] != obj->data_list[i] ){
-						std::cout << "Different data list" << std::endl;
-						return false;
-					}
-				}
-			}
-			catch(const std::out_of_range& oor)
-			{
+			if (fp != other_fp){
+				MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_fingerprint_differs,
+							fp.high, other_fp.high, 0);
 				return false;
 			}
 		}
-		return true;
+		catch (IEError &)
+		{
+			return false;
+		}
+		
+		// Same fingerprint, the buffers only differ on a collision. The
+		// headers differ in their export time, so compare from the sets on.
+		size_t hsize = get_header_length();
+		if ( (size_t) get_offset() < hsize )
+			hsize = get_offset();
+
+		return (get_offset() == obj->get_offset())
+				&& (message->version == obj->message->version)
+				&& (message->sourceid == obj->message->sourceid)
+				&& (memcmp(get_message() + hsize, obj->get_message() + hsize, 
+						   get_offset() - hsize) == 0);
 	}
 	else{
 		return false;
@@ -1863,7 +2192,14 @@ mnslp_ipfix_message::notEqual (const mnslp_mspec_object &rhs) const
 mnslp_ipfix_message &
 mnslp_ipfix_message::operator=(const mnslp_ipfix_message &other)
 {
+	if (this == &other)
+		return *this;
+	
+	// The output buffer of other may be being flushed.
+	cache_lock lock(&other);
 	
+	delete message;
+	message = NULL;
 	if (other.message != NULL)
 	   message = new ipfix_t(*(other.message));
 	g_ipfix_fields = other.g_ipfix_fields;
@@ -1875,6 +2211,7 @@ mnslp_ipfix_message::operator=(const mnslp_ipfix_message &other)
 	/** The message changed, so it requires a new output 
 	*/
 	require_output = true;
+	invalidate_encoding();
 	
 	return *this;
 	
@@ -1884,6 +2221,8 @@ mnslp_ipfix_message::mnslp_ipfix_message(const mnslp_ipfix_message &other):
 mnslp_mspec_object(OBJECT_TYPE, tr_mandatory, false),
 message(NULL), g_tstart(0), encode_network(true), require_output(true)
 {
+	// The output buffer of other may be being flushed.
+	cache_lock lock(&other);
 	
 	if (other.message != NULL)
 	   message = new ipfix_t(*(other.message));
@@ -1930,10 +2269,11 @@ mnslp_ipfix_message::include_all_data_fields(mnslp_ipfix_template *templ) const
 			// Verify that both have the same field keys.
 			try
 			{
+				const std::vector<ipfix_field_descriptor_t> &fields = 
+										templ->get_field_descriptors();
 				for (int j = 0; j < templ->get_numfields(); j++ ){
-					mnslp_ipfix_field field = templ->get_field(j).elem;
-					mnslp_ipfix_value_field value = (*i).get_field(field.get_field_type().eno, 
-														field.get_field_type().ftype);
+					mnslp_ipfix_value_field value = (*i).get_field(fields[j].eno, 
+														fields[j].ftype);
 				}
 			}
 			catch (msg::mnslp_ipfix_bad_argument &e)
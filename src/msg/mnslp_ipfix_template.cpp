@@ -28,6 +28,7 @@
 // ===========================================================
 
 #include "msg/mnslp_ipfix_template.h"
+#include "msg/mnslp_ipfix_message.h"
 #include "msg/mnslp_ipfix_exception.h"
 #include <iostream>
 #include <stdexcept>      // std::out_of_range
@@ -36,7 +37,7 @@ namespace mnslp {
   namespace msg {
 
 mnslp_ipfix_template::mnslp_ipfix_template(const mnslp_ipfix_template &rhs):
-tsend(0)
+tsend(0), compiled(false), record_length(0)
 {
 	type = rhs.type;
 	tid = rhs.tid;
@@ -45,7 +46,7 @@ tsend(0)
 	templateFieldConstIterList_t it;
 	for( it = rhs.datafields.begin(); it != rhs.datafields.end(); ++it)
 	{
-		ipap_template_field_t ftmp;
+		ipfix_template_field_t ftmp;
 		ftmp.flength = it->flength;
 		ftmp.unknown_f = it->unknown_f;
 		ftmp.relay_f = it->relay_f;
@@ -55,7 +56,7 @@ tsend(0)
 
 	for( it = rhs.scopefields.begin(); it != rhs.scopefields.end(); ++it)
 	{
-		ipap_template_field_t ftmp;
+		ipfix_template_field_t ftmp;
 		ftmp.flength = it->flength;
 		ftmp.unknown_f = it->unknown_f;
 		ftmp.relay_f = it->relay_f;
@@ -64,18 +65,70 @@ tsend(0)
 	}
 }
 
-ipfix_template_field_t mnslp_ipfix_template::get_field(int i)
+const ipfix_template_field_t & 
+mnslp_ipfix_template::get_field(int i) const
 {
-	if ( (i >= get_numfields()) || (i < 0) ){
+	if ( (i >= (int) (datafields.size() + scopefields.size())) || (i < 0) ){
 		throw mnslp_ipfix_bad_argument("Invalid field number");
 	}
 	else
 	{				
-		if (i < get_number_scopefields())
+		if (i < (int) scopefields.size())
 			return scopefields[i];
 		else
-			return datafields[i];
+			return datafields[i - scopefields.size()];
+	}
+}
+
+const ipfix_field_descriptor_t &
+mnslp_ipfix_template::get_field_descriptor(int i)
+{
+	if ( (i >= get_numfields()) || (i < 0) ){
+		throw mnslp_ipfix_bad_argument("Invalid field number");
 	}
+	
+	return get_field_descriptors()[i];
+}
+
+void
+mnslp_ipfix_template::compile()
+{
+	bool fixed = true;
+	size_t length = 0;
+	
+	descriptors.clear();
+	descriptors.reserve(scopefields.size() + datafields.size());
+	
+	for (size_t i = 0; i < scopefields.size() + datafields.size(); i++)
+	{
+		ipfix_template_field_t &field = (i < scopefields.size()) ? 
+					scopefields[i] : datafields[i - scopefields.size()];
+		const ipfix_field_type_t &field_type = field.elem.get_field_type();
+		
+		ipfix_field_descriptor_t desc;
+		desc.eno = field_type.eno;
+		desc.ftype = field_type.ftype;
+		desc.flength = field.flength;
+		desc.varlen = (field.flength == IPFIX_FT_VARLEN);
+		desc.coding = field_type.coding;
+		desc.relay_f = field.relay_f;
+		desc.unknown_f = field.unknown_f;
+		desc.elem = &field.elem;
+		desc.encode = ipfix_resolve_encoder(field_type, field.flength, field.relay_f);
+		desc.decode[0] = ipfix_resolve_decoder(field_type, field.flength, 0);
+		desc.decode[1] = ipfix_resolve_decoder(field_type, field.flength, 1);
+		desc.column = ipfix_resolve_column(field_type, field.flength);
+		desc.offset = length;
+		descriptors.push_back(desc);
+		
+		if (desc.column == IPFIX_COLUMN_NONE)
+			fixed = false;
+		length += field.flength;
+	}
+	
+	// records travel in sets with a four byte header and a 16 bit length.
+	record_length = ( fixed && !descriptors.empty() && (length + 4 <= 65535) ) ? length : 0;
+	compiled = true;
 }
 
 void
@@ -99,6 +152,7 @@ mnslp_ipfix_template::remove_unknown_fields()
 			++iter2;
 	}
 	
+	compiled = false;
 }
 
 /** If type == 0 Then data Field
@@ -117,6 +171,7 @@ void mnslp_ipfix_template::add_data_field(uint16_t _flength,
 	t.elem = _field;
 			
 	datafields.push_back(t);
+	compiled = false;
 }
 
 /** 
@@ -135,6 +190,7 @@ void mnslp_ipfix_template::add_scope_field(uint16_t _flength,
 	t.elem = _field;
 
 	scopefields.push_back(t);
+	compiled = false;
 }
 
 
@@ -197,11 +253,14 @@ mnslp_ipfix_template::operator=(const mnslp_ipfix_template &rhs)
 	tsend = rhs.tsend;
 	tid = rhs.tid;
 	maxfields = rhs.maxfields;
+	datafields.clear();
+	scopefields.clear();
+	compiled = false;
 
 	templateFieldConstIterList_t it;
 	for( it = rhs.datafields.begin(); it != rhs.datafields.end(); ++it)
 	{
-		ipap_template_field_t ftmp;
+		ipfix_template_field_t ftmp;
 		ftmp.flength = it->flength;
 		ftmp.unknown_f = it->unknown_f;
 		ftmp.relay_f = it->relay_f;
@@ -211,7 +270,7 @@ mnslp_ipfix_template::operator=(const mnslp_ipfix_template &rhs)
 
 	for( it = rhs.scopefields.begin(); it != rhs.scopefields.end(); ++it)
 	{
-		ipap_template_field_t ftmp;
+		ipfix_template_field_t ftmp;
 		ftmp.flength = it->flength;
 		ftmp.unknown_f = it->unknown_f;
 		ftmp.relay_f = it->relay_f;
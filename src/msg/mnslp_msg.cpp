@@ -48,6 +48,13 @@ const uint16 mnslp_msg::HEADER_LENGTH = 4;
 
 const char *const mnslp_msg::ie_name = "mnslp_msg";
 
+const uint32 mnslp_msg::FLAG_REFRESH_BUNDLING;
+
+/**
+ * Header flags of the messages this node creates.
+ */
+static const uint32 LOCAL_FLAGS = mnslp_msg::FLAG_REFRESH_BUNDLING;
+
 
 /**
  * Standard constructor.
@@ -55,7 +62,7 @@ const char *const mnslp_msg::ie_name = "mnslp_msg";
  * Creates an empty MNSLP Message.
  */
 mnslp_msg::mnslp_msg()
-		: IE(cat_mnslp_msg), msg_type(0) {
+		: IE(cat_mnslp_msg), msg_type(0), flags(LOCAL_FLAGS) {
 
 	// nothing to do
 }
@@ -71,7 +78,7 @@ mnslp_msg::mnslp_msg()
  * @param type the MNSLP Message Type (8 bit)
  */
 mnslp_msg::mnslp_msg(uint8 type)
-		: IE(cat_mnslp_msg), msg_type(type) {
+		: IE(cat_mnslp_msg), msg_type(type), flags(LOCAL_FLAGS) {
 
 	// nothing to do
 }
@@ -86,7 +93,7 @@ mnslp_msg::mnslp_msg(uint8 type)
  */
 mnslp_msg::mnslp_msg(const mnslp_msg &other)
 		: IE(other.category), msg_type(other.get_msg_type()),
-		  objects(other.objects) {
+		  objects(other.objects), flags(other.get_flags()) {
 	
 	// nothing else to do
 }
@@ -130,6 +137,19 @@ uint8 mnslp_msg::extract_msg_type(uint32 header_raw) throw () {
 }
 
 
+/**
+ * Extract the flags from a raw header in host byte order.
+ *
+ * Nodes that don't know about flags leave these bits zero.
+ *
+ * @param header_raw 32 bits from a NetMsg
+ * @return the 24 flag bits
+ */
+uint32 mnslp_msg::extract_flags(uint32 header_raw) throw () {
+	return (header_raw & 0xFFFFFF);
+}
+
+
 /**
  * Return the message sequence number.
  *
@@ -202,6 +222,7 @@ mnslp_msg *mnslp_msg::deserialize(NetMsg &msg, coding_t coding,
 	}
 
 	set_msg_type( extract_msg_type(header_raw) );
+	set_flags( extract_flags(header_raw) );
 
 	bytes_read += 4;
 
@@ -304,7 +325,7 @@ void mnslp_msg::serialize(NetMsg &msg, coding_t coding,
 	 * Write the header.
 	 */
 	 
-	uint32 header_raw = (get_msg_type() << 24);
+	uint32 header_raw = (get_msg_type() << 24) | get_flags();
 	try {
 		msg.encode32(header_raw);
 		bytes_written += 4;
@@ -352,10 +373,12 @@ bool mnslp_msg::supports_coding(coding_t c) const {
 size_t mnslp_msg::get_serialized_size(coding_t coding) const {
 	size_t size = HEADER_LENGTH;
 
+	// Objects keep their encoded form, so the following serialize()
+	// only copies the cached segments.
 	for ( obj_iter i = objects.begin(); i != objects.end(); i++ ) {
-		const IE *obj = i->second;
+		const mnslp_object *obj = static_cast<const mnslp_object *>(i->second);
 
-		size += obj->get_serialized_size(coding);
+		size += obj->get_encoded_size();
 	}
 
 	return size;
@@ -429,6 +452,29 @@ void mnslp_msg::set_msg_type(uint8 msg_type) {
 }
 
 
+/**
+ * Return the header flags.
+ *
+ * Messages created locally carry the flags of this node, received ones
+ * those of the sender.
+ *
+ * @return the flags (24 bit)
+ */
+uint32 mnslp_msg::get_flags() const {
+	return flags;
+}
+
+
+/**
+ * Set the header flags.
+ *
+ * @param flags the flags (24 bit)
+ */
+void mnslp_msg::set_flags(uint32 flags) {
+	this->flags = flags & 0xFFFFFF;
+}
+
+
 /**
  * Return the number of contained objects.
  *
@@ -49,9 +49,10 @@ using namespace protlib::log;
  * The treatment is set to mandatory.
  */
 mnslp_object::mnslp_object()
-		: IE(cat_mnslp_object), treatment(tr_mandatory), unique(true) {
+		: IE(cat_mnslp_object), treatment(tr_mandatory), unique(true),
+		  encoded(NULL), encoded_length(0), has_fingerprint(false) {
 
-	// nothing to do
+	init_cache_mutex();
 }
 
 
@@ -64,14 +65,214 @@ mnslp_object::mnslp_object()
  * @param object_type the MNSLP Object Type (12 bit)
  */
 mnslp_object::mnslp_object(uint16 obj_type, treatment_t tr, bool _unique)
-		: IE(cat_mnslp_object), object_type(obj_type), treatment(tr), unique(_unique) {
+		: IE(cat_mnslp_object), object_type(obj_type), treatment(tr), unique(_unique),
+		  encoded(NULL), encoded_length(0), has_fingerprint(false) {
 
-	// nothing to do
+	init_cache_mutex();
+}
+
+
+/**
+ * Copy constructor.
+ *
+ * The cached wire format is copied too, so a copy can be serialized
+ * without encoding it again.
+ *
+ * @param other the object to copy
+ */
+mnslp_object::mnslp_object(const mnslp_object &other)
+		: IE(other.category), object_type(other.object_type), unique(other.unique),
+		  treatment(other.treatment), encoded(NULL), encoded_length(0),
+		  has_fingerprint(false) {
+
+	init_cache_mutex();
+
+	// Another thread may be filling the caches of the original.
+	cache_lock lock(&other);
+
+	if ( other.encoded != NULL ) {
+		encoded = new uchar[other.encoded_length];
+		memcpy(encoded, other.encoded, other.encoded_length);
+		encoded_length = other.encoded_length;
+	}
+	fingerprint = other.fingerprint;
+	has_fingerprint = other.has_fingerprint;
 }
 
 
 mnslp_object::~mnslp_object() {
-	// nothing to do
+	invalidate_encoding();
+	pthread_mutex_destroy(&cache_mutex);
+}
+
+
+void mnslp_object::init_cache_mutex() {
+	pthread_mutexattr_t attr;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&cache_mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
+
+mnslp_object::cache_lock::cache_lock(const mnslp_object *obj) : obj(obj) {
+	pthread_mutex_lock(&obj->cache_mutex);
+}
+
+
+mnslp_object::cache_lock::~cache_lock() {
+	pthread_mutex_unlock(&obj->cache_mutex);
+}
+
+
+mnslp_object &mnslp_object::operator=(const mnslp_object &other) {
+
+	if ( this == &other )
+		return *this;
+
+	object_type = other.object_type;
+	unique = other.unique;
+	treatment = other.treatment;
+
+	invalidate_encoding();
+
+	cache_lock lock(&other);
+
+	if ( other.encoded != NULL ) {
+		encoded = new uchar[other.encoded_length];
+		memcpy(encoded, other.encoded, other.encoded_length);
+		encoded_length = other.encoded_length;
+	}
+	fingerprint = other.fingerprint;
+	has_fingerprint = other.has_fingerprint;
+
+	return *this;
+}
+
+
+/**
+ * Drop the cached wire format.
+ *
+ * Child classes have to call this from every method that changes a value
+ * written by serialize_body().
+ */
+void mnslp_object::invalidate_encoding() const {
+	delete [] encoded;
+	encoded = NULL;
+	encoded_length = 0;
+	has_fingerprint = false;
+}
+
+
+/**
+ * Build the cached wire format of this object.
+ */
+void mnslp_object::encode() const throw (IEError) {
+
+	uint32 length = get_serialized_size(CODING);
+	NetMsg buffer(length);
+
+	try {
+		serialize_header(buffer, length - HEADER_LENGTH);
+		serialize_body(buffer);
+	}
+	catch (NetMsgError) {
+		throw IEMsgTooShort(CODING, get_category(), buffer.get_pos());
+	}
+
+	// this would be an implementation error
+	if ( buffer.get_pos() != length )
+		Log(ERROR_LOG, LOG_CRIT, "mnslp_object",
+			get_ie_name() << ": serialize_body() wrote " << buffer.get_pos()
+			<< " bytes, expected " << length);
+
+	encoded = new uchar[length];
+	buffer.copy_to(encoded, 0, length);
+	encoded_length = length;
+}
+
+
+/**
+ * Return the number of bytes serialize() writes.
+ *
+ * Unlike get_serialized_size(), the size is taken from the cached wire
+ * format, which is built if necessary.
+ */
+uint32 mnslp_object::get_encoded_size() const throw (IEError) {
+
+	cache_lock lock(this);
+
+	if ( encoded == NULL )
+		encode();
+
+	return encoded_length;
+}
+
+
+/**
+ * Return the cached wire format of this object.
+ *
+ * The buffer belongs to this object and is only valid until it changes.
+ *
+ * @param length returns the number of bytes in the buffer
+ */
+const uchar *mnslp_object::get_encoded(uint32 &length) const throw (IEError) {
+
+	cache_lock lock(this);
+
+	if ( encoded == NULL )
+		encode();
+
+	length = encoded_length;
+	return encoded;
+}
+
+
+/**
+ * Return the fingerprint of this object's body.
+ *
+ * It is computed on first use, unless deserialize_body() already set it,
+ * and kept until the object changes. Objects with different fingerprints
+ * are different; equal fingerprints still need a full comparison to rule
+ * out a collision.
+ */
+const object_fingerprint &mnslp_object::get_fingerprint() const throw (IEError) {
+
+	cache_lock lock(this);
+
+	if ( ! has_fingerprint )
+		set_fingerprint(compute_fingerprint());
+
+	return fingerprint;
+}
+
+
+/**
+ * Compute the fingerprint of this object.
+ *
+ * This implementation hashes the body of the cached wire format. Child
+ * classes with a cheaper canonical form may override it.
+ */
+object_fingerprint mnslp_object::compute_fingerprint() const throw (IEError) {
+
+	uint32 length;
+	const uchar *buffer = get_encoded(length);
+
+	return object_fingerprint::compute(buffer + HEADER_LENGTH,
+			length - HEADER_LENGTH);
+}
+
+
+/**
+ * Cache the fingerprint of this object, as computed by a child class
+ * while encoding or decoding it.
+ */
+void mnslp_object::set_fingerprint(const object_fingerprint &fp) const {
+	cache_lock lock(this);
+
+	fingerprint = fp;
+	has_fingerprint = true;
 }
 
 
@@ -82,6 +283,7 @@ mnslp_object::get_treatment() const {
 
 void mnslp_object::set_treatment(treatment_t tr) {
 	treatment = tr;
+	invalidate_encoding();
 }
 
 uint16 mnslp_object::get_object_type() const {
@@ -90,6 +292,7 @@ uint16 mnslp_object::get_object_type() const {
 
 void mnslp_object::set_object_type(uint16 obj_type) {
 	object_type = obj_type;
+	invalidate_encoding();
 }
 
 bool mnslp_object::is_unique() const {
@@ -171,6 +374,8 @@ IE *mnslp_object::deserialize(NetMsg &msg, coding_t coding,
 	bytes_read = 0;
 	uint32 start_pos = msg.get_pos();
 
+	invalidate_encoding();
+
 	// check if coding is supported
 	uint32 tmp;
 	if ( ! check_deser_args(CODING, err, tmp) )
@@ -222,29 +427,18 @@ void mnslp_object::serialize(NetMsg &msg, coding_t coding,
 	check_ser_args(coding, tmp);
 		
 	/*
-	 * Write header
+	 * Write header and body from the cached wire format.
 	 */
-	uint16 body_length = get_serialized_size(CODING) - HEADER_LENGTH;
-
-	try {
-		serialize_header(msg, body_length);
-	}
-	catch (NetMsgError) {
-		throw IEMsgTooShort(CODING, get_category(), msg.get_pos());
-	}
+	uint32 length;
+	const uchar *buffer = get_encoded(length);
 
+	if ( msg.get_bytes_left() < length )
+		throw IEMsgTooShort(CODING, get_category(), start_pos);
 
-	/*
-	 * Write body
-	 */
-	try {
-		serialize_body(msg);
-	}
-	catch (NetMsgError) {
-		throw IEMsgTooShort(CODING, get_category(), msg.get_pos());
-	}
+	msg.copy_from(buffer, start_pos, length);
+	msg.set_pos(start_pos + length);
 
-	bytes_written = msg.get_pos() - start_pos;
+	bytes_written = length;
 }
 
 
@@ -112,6 +112,11 @@ void mnslp_refresh::serialize(NetMsg &msg, coding_t coding,
 	bytes_written += serialize_object(key_msn, msg, coding);
 	ie_object_key key_slf(session_lifetime::OBJECT_TYPE, 1);
 	bytes_written += serialize_object(key_slf, msg, coding);
+
+	if ( get_refresh_list() != NULL ) {
+		ie_object_key key_list(refresh_list::OBJECT_TYPE, 1);
+		bytes_written += serialize_object(key_list, msg, coding);
+	}
 	
 	// this would be an implementation error
 	if ( bytes_written != msg.get_pos() - start_pos )
@@ -139,8 +144,12 @@ mnslp_refresh::serialize_object(ie_object_key &key, NetMsg &msg, coding_t coding
 bool mnslp_refresh::check() const {
 	
 	mnslp_object *obj;
+
+	// The refresh list is optional.
+	size_t expected = ( get_refresh_list() != NULL ) ? 3 : 2;
+
 	// Error: no objects available
-	if ( get_num_objects() != 2 )
+	if ( get_num_objects() != expected )
 		return false;
 
 	// Verifies that message sequence number exists.
@@ -223,4 +232,29 @@ uint32 mnslp_refresh::get_msg_sequence_number() const {
 
 
 
+/**
+ * Set the further sessions this REFRESH refreshes.
+ *
+ * A REFRESH with a refresh list is only sent to peers which set
+ * FLAG_REFRESH_BUNDLING.
+ *
+ * @param list the sessions to refresh along with this one
+ */
+void mnslp_refresh::set_refresh_list(refresh_list *list) {
+	set_object(list);
+}
+
+
+/**
+ * Return the further sessions this REFRESH refreshes.
+ *
+ * @return the list or NULL if this is a plain REFRESH
+ */
+refresh_list *mnslp_refresh::get_refresh_list() const {
+	ie_object_key key(refresh_list::OBJECT_TYPE, 1);
+	return dynamic_cast<refresh_list *>(get_object(key));
+}
+
+
+
 // EOF
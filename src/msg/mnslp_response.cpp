@@ -125,6 +125,11 @@ void mnslp_response::serialize(NetMsg &msg, coding_t coding,
 		ie_object_key key_ipfix(mnslp_ipfix_message::OBJECT_TYPE, i);
 		bytes_written += serialize_object(key_ipfix, msg, coding);
 	}
+
+	if ( get_refresh_list() != NULL ) {
+		ie_object_key key_list(refresh_list::OBJECT_TYPE, 1);
+		bytes_written += serialize_object(key_list, msg, coding);
+	}
 	
 	// this would be an implementation error
 	if ( bytes_written != msg.get_pos() - start_pos )
@@ -159,7 +164,8 @@ bool mnslp_response::check() const {
 		if ( (key.get_object_type() != msg_sequence_number::OBJECT_TYPE ) 
 		    and (key.get_object_type() != information_code::OBJECT_TYPE )
 		    and (key.get_object_type() != session_lifetime::OBJECT_TYPE ) 
-		    and (key.get_object_type() != mnslp_ipfix_message::OBJECT_TYPE ) )
+		    and (key.get_object_type() != mnslp_ipfix_message::OBJECT_TYPE )
+		    and (key.get_object_type() != refresh_list::OBJECT_TYPE ) )
 			return false;
 	}
 
@@ -380,4 +386,30 @@ bool mnslp_response::is_response_to(const mnslp_refresh *msg) const
 }
 
 
+/**
+ * Set the sessions of a bundled REFRESH that were rejected.
+ *
+ * Such a RESPONSE is not meant for the session it is sent in, but for the
+ * listed ones.
+ *
+ * @param list the rejected sessions
+ */
+void mnslp_response::set_refresh_list(refresh_list *list)
+{
+	set_object(list);
+}
+
+
+/**
+ * Return the rejected sessions of a bundled REFRESH.
+ *
+ * @return the list or NULL if this RESPONSE has none
+ */
+refresh_list *mnslp_response::get_refresh_list() const
+{
+	ie_object_key key(refresh_list::OBJECT_TYPE, 1);
+	return dynamic_cast<refresh_list *>(get_object(key));
+}
+
+
 // EOF
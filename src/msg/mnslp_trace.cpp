@@ -0,0 +1,246 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file mnslp_trace.cpp
+/// Per-thread binary trace rings.
+/// ----------------------------------------------------------
+/// $Id: mnslp_trace.cpp 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./src/msg/mnslp_trace.cpp $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#include <pthread.h>
+#include <time.h>
+#include <sstream>
+
+#include "msg/mnslp_trace.h"
+
+
+namespace mnslp {
+  namespace msg {
+    namespace trace {
+
+volatile uint32_t enabled_mask = 0;
+
+
+static const char *const component_names[tc_max] = {
+	"ipfix",
+	"events",
+	"session",
+	"installer",
+	"config",
+	"admission"
+};
+
+static const char *const event_names[ev_max] = {
+	"ipfix_deserialize_body",
+	"ipfix_deserialize_done",
+	"ipfix_write_hdr",
+	"ipfix_hdr_written",
+	"ipfix_write_template",
+	"ipfix_template_field",
+	"ipfix_template_written",
+	"ipfix_output_set",
+	"ipfix_parse_hdr",
+	"ipfix_decode_template",
+	"ipfix_template_decoded",
+	"ipfix_decode_datarecord",
+	"ipfix_datarecord_decoded",
+	"ipfix_import",
+	"ipfix_import_set",
+	"ipfix_import_done",
+	"ipfix_header_differs",
+	"ipfix_fingerprint_differs",
+	"ipfix_output_records",
+	"ipfix_decode_records",
+	"response_msn",
+	"session_participating",
+	"session_process_event",
+	"install",
+	"install_failed",
+	"install_template_missing",
+	"install_command",
+	"install_shared",
+	"remove_shared",
+	"update",
+	"command_compiled",
+	"teardown",
+	"config_loaded",
+	"config_parse_error",
+	"admission_rejected"
+};
+
+
+/**
+ * A fixed size binary record.
+ */
+struct trace_record {
+	uint64_t timestamp;		///< CLOCK_MONOTONIC in nanoseconds
+	uint16_t component;
+	uint16_t event;
+	int64_t args[3];
+};
+
+
+/**
+ * The records of one thread. Only the owning thread writes to it.
+ */
+struct trace_ring {
+	static const uint32_t RING_SIZE = 4096;
+
+	trace_record records[RING_SIZE];
+	uint32_t next;				///< total number of records written
+	pthread_t owner;
+	trace_ring *link;
+};
+
+
+static pthread_mutex_t rings_mutex = PTHREAD_MUTEX_INITIALIZER;
+static trace_ring *rings = NULL;
+static __thread trace_ring *local_ring = NULL;
+
+
+static trace_ring *get_local_ring() {
+
+	if ( local_ring == NULL ) {
+		local_ring = new trace_ring();
+		local_ring->next = 0;
+		local_ring->owner = pthread_self();
+
+		pthread_mutex_lock(&rings_mutex);
+		local_ring->link = rings;
+		rings = local_ring;
+		pthread_mutex_unlock(&rings_mutex);
+	}
+
+	return local_ring;
+}
+
+
+void enable(component_t c) {
+	__sync_fetch_and_or(&enabled_mask, 1u << c);
+}
+
+
+void disable(component_t c) {
+	__sync_fetch_and_and(&enabled_mask, ~(1u << c));
+}
+
+
+void set_mask(uint32_t mask) {
+	enabled_mask = mask;
+}
+
+
+uint32_t parse_components(const std::string &names) {
+
+	uint32_t mask = 0;
+	std::istringstream in(names);
+	std::string name;
+
+	while ( std::getline(in, name, ',') ) {
+		if ( name == "all" )
+			mask = (1u << tc_max) - 1;
+		else if ( name == "none" )
+			mask = 0;
+
+		for ( int c = 0; c < tc_max; c++ ) {
+			if ( name == component_names[c] )
+				mask |= (1u << c);
+		}
+	}
+
+	return mask;
+}
+
+
+const char *get_component_name(component_t c) {
+	return ( c < tc_max ) ? component_names[c] : "unknown";
+}
+
+
+const char *get_event_name(event_t e) {
+	return ( e < ev_max ) ? event_names[e] : "unknown";
+}
+
+
+void record(component_t c, event_t e, int64_t a0, int64_t a1, int64_t a2) {
+
+	trace_ring *ring = get_local_ring();
+	trace_record &r = ring->records[ring->next % trace_ring::RING_SIZE];
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	r.timestamp = uint64_t(now.tv_sec) * 1000000000ull + now.tv_nsec;
+	r.component = c;
+	r.event = e;
+	r.args[0] = a0;
+	r.args[1] = a1;
+	r.args[2] = a2;
+
+	ring->next++;
+}
+
+
+void dump(std::ostream &os) {
+
+	pthread_mutex_lock(&rings_mutex);
+
+	for ( trace_ring *ring = rings; ring != NULL; ring = ring->link ) {
+		uint32_t count = ring->next;
+		uint32_t first = 0;
+
+		if ( count > trace_ring::RING_SIZE )
+			first = count - trace_ring::RING_SIZE;
+
+		os << "thread " << ring->owner << ": " << count
+		   << " records" << std::endl;
+
+		for ( uint32_t i = first; i < count; i++ ) {
+			const trace_record &r = ring->records[i % trace_ring::RING_SIZE];
+
+			os << r.timestamp << " "
+			   << get_component_name(component_t(r.component)) << " "
+			   << get_event_name(event_t(r.event)) << " "
+			   << r.args[0] << " " << r.args[1] << " " << r.args[2]
+			   << std::endl;
+		}
+	}
+
+	pthread_mutex_unlock(&rings_mutex);
+}
+
+
+void clear() {
+
+	pthread_mutex_lock(&rings_mutex);
+
+	for ( trace_ring *ring = rings; ring != NULL; ring = ring->link )
+		ring->next = 0;
+
+	pthread_mutex_unlock(&rings_mutex);
+}
+
+    } // namespace trace
+  } // namespace msg
+} // namespace mnslp
+
+// EOF
@@ -139,6 +139,7 @@ uint32 msg_sequence_number::get_value() const {
  */
 void msg_sequence_number::set_value(uint32 msn) {
 	value = msn;
+	invalidate_encoding();
 }
 
 
@@ -26,6 +26,9 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 //
 // ===========================================================
+#include <cstring>
+#include <netinet/in.h>
+
 #include "msg/ntlp_msg.h"
 
 using namespace mnslp::msg;
@@ -35,12 +38,31 @@ using namespace protlib::log;
 /**
  * Constructor.
  */
-ntlp_msg::ntlp_msg(const session_id &id, mnslp_msg *body,
+ntlp_msg::ntlp_msg(const session_id &id, mnslp_msg *msg,
 		ntlp::mri *m, uint32 sii)
-		: sid(id), routing_info(m), sii_handle(sii), msg(body) {
+		: sid(id), routing_info(m), sii_handle(sii), body(new shared_body) {
 
 	assert( routing_info != NULL );
-	// Note: body may be NULL if deserialize() failed!
+	// Note: msg may be NULL if deserialize() failed!
+
+	body->msg = msg;
+	body->wire = NULL;
+	body->wire_length = 0;
+	body->refs = 1;
+	pthread_mutex_init(&body->lock, NULL);
+}
+
+
+/**
+ * Constructor for copies, which take a reference to the given body.
+ */
+ntlp_msg::ntlp_msg(const session_id &id, shared_body *b,
+		ntlp::mri *m, uint32 sii)
+		: sid(id), routing_info(m), sii_handle(sii), body(b) {
+
+	assert( routing_info != NULL );
+
+	__sync_fetch_and_add(&body->refs, 1);
 }
 
 
@@ -49,18 +71,25 @@ ntlp_msg::ntlp_msg(const session_id &id, mnslp_msg *body,
  */
 ntlp_msg::~ntlp_msg() {
 	delete routing_info;
-	delete msg;
+
+	if ( __sync_sub_and_fetch(&body->refs, 1) == 0 ) {
+		delete body->msg;
+		delete [] body->wire;
+		pthread_mutex_destroy(&body->lock);
+		delete body;
+	}
 }
 
 
 /**
  * Create an exact copy of an ntlp_msg.
+ *
+ * The copy shares the MNSLP message with this one, so retransmitting a
+ * message does not copy its objects.
  */
 ntlp_msg *ntlp_msg::copy() const {
 	return new ntlp_msg(
-		get_session_id(), get_mnslp_msg()->copy(),
-		get_mri()->copy(), get_sii_handle()
-	);
+		get_session_id(), body, get_mri()->copy(), get_sii_handle());
 }
 
 
@@ -79,8 +108,163 @@ ntlp_msg *ntlp_msg::copy_for_forwarding(ntlp::mri *new_mri) const {
 	if ( new_mri == NULL )
 		new_mri = get_mri()->copy();
 
-	return new ntlp_msg(
-		get_session_id(), get_mnslp_msg()->copy(), new_mri, 0);
+	return new ntlp_msg(get_session_id(), body, new_mri, 0);
+}
+
+
+/**
+ * Create the next REFRESH from this REFRESH message.
+ *
+ * Only the MSN and the session lifetime change in the MNSLP message. If
+ * this message has been serialized already, the copy gets the same wire
+ * format with these two values patched in. The MRI and the SII handle are
+ * taken from the session, which may have changed them since this message
+ * was built. The copy takes ownership of new_mri.
+ */
+ntlp_msg *ntlp_msg::copy_for_refresh(uint32 msn, uint32 session_lifetime,
+		ntlp::mri *new_mri, uint32 sii) const {
+
+	assert( new_mri != NULL );
+
+
+	mnslp_refresh *refresh = get_mnslp_refresh();
+	assert( refresh != NULL );
+
+	mnslp_refresh *next = refresh->copy();
+	next->set_msg_sequence_number(msn);
+	next->set_session_lifetime(session_lifetime);
+
+	ntlp_msg *ret = new ntlp_msg(get_session_id(), next, new_mri, sii);
+
+	pthread_mutex_lock(&body->lock);
+
+	if ( body->wire != NULL ) {
+		uchar *wire = new uchar[body->wire_length];
+		memcpy(wire, body->wire, body->wire_length);
+
+		if ( patch_object(wire, body->wire_length, 
+					msg_sequence_number::OBJECT_TYPE, msn)
+				&& patch_object(wire, body->wire_length, 
+					session_lifetime::OBJECT_TYPE, session_lifetime) ) {
+			ret->body->wire = wire;
+			ret->body->wire_length = body->wire_length;
+		}
+		else
+			delete [] wire;
+	}
+
+	pthread_mutex_unlock(&body->lock);
+
+	return ret;
+}
+
+
+/**
+ * Return the MNSLP message in wire format.
+ *
+ * The message is serialized on the first call only, copies of this
+ * message share the result. Once created, the wire format doesn't change
+ * until the last copy is deleted.
+ */
+const uchar *ntlp_msg::get_serialized(uint32 &length) const throw (IEError) {
+
+	pthread_mutex_lock(&body->lock);
+
+	try {
+		if ( body->wire == NULL ) {
+			const mnslp_msg *m = get_mnslp_msg();
+			assert( m != NULL );
+
+			NetMsg payload( m->get_serialized_size(IE::protocol_v1) );
+
+			uint32 bytes_written;
+			m->serialize(payload, IE::protocol_v1, bytes_written);
+
+			uchar *wire = new uchar[bytes_written];
+			memcpy(wire, payload.get_buffer(), bytes_written);
+
+			body->wire_length = bytes_written;
+			body->wire = wire;
+		}
+	}
+	catch ( ... ) {
+		pthread_mutex_unlock(&body->lock);
+		throw;
+	}
+
+	length = body->wire_length;
+	const uchar *wire = body->wire;
+
+	pthread_mutex_unlock(&body->lock);
+
+	return wire;
+}
+
+
+/**
+ * Estimate the memory held by this message.
+ *
+ * The body is split evenly among the copies sharing it. The MNSLP message
+ * and the MRI are estimated by their serialized size.
+ */
+size_t ntlp_msg::get_memory_usage() const {
+	size_t shared = sizeof(shared_body) + body->wire_length;
+
+	if ( body->msg != NULL )
+		shared += body->msg->get_serialized_size(IE::protocol_v1);
+
+	int refs = body->refs;
+
+	return sizeof(ntlp_msg) + routing_info->get_serialized_size(IE::protocol_v1)
+		+ shared / ( refs > 0 ? refs : 1 );
+}
+
+
+/**
+ * Set the wire format of a message that has just been deserialized.
+ *
+ * Forwarding the message then sends the bytes received.
+ */
+void ntlp_msg::set_serialized(const uchar *buffer, uint32 length) {
+
+	assert( body->wire == NULL );
+
+	body->wire = new uchar[length];
+	memcpy(body->wire, buffer, length);
+	body->wire_length = length;
+}
+
+
+/**
+ * Overwrite the 32 bit body of an object in a serialized message.
+ *
+ * @return false if there is no such object with a 32 bit body
+ */
+bool ntlp_msg::patch_object(uchar *wire, uint32 length, 
+							uint16 object_type, uint32 value) {
+
+	uint32 pos = 4; // skip the MNSLP message header
+
+	while ( pos + 4 <= length ) {
+		uint32 header;
+		memcpy(&header, wire + pos, 4);
+		header = ntohl(header);
+
+		uint32 body_length = (header & 0xFFF) * 4u;
+
+		if ( mnslp_object::extract_object_type(header) == object_type ) {
+			if ( body_length != 4 || pos + 8 > length )
+				return false;
+
+			value = htonl(value);
+			memcpy(wire + pos + 4, &value, 4);
+			return true;
+		}
+
+		pos += 4 + body_length;
+	}
+
+	return false;
 }
 
 
@@ -0,0 +1,131 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file object_fingerprint.cpp
+/// Content hash of MNSLP objects.
+/// ----------------------------------------------------------
+/// $Id: object_fingerprint.cpp 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./src/msg/object_fingerprint.cpp $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+
+#include <string.h>
+
+#include "msg/object_fingerprint.h"
+
+namespace mnslp {
+  namespace msg {
+
+namespace {
+
+/*
+ * The hash is MurmurHash3 (x64, 128 bit variant), which is fast on the 
+ * short buffers we feed it and mixes well enough for equality checks.
+ */
+const uint64_t c1 = 0x87c37b91114253d5ULL;
+const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+inline uint64_t rotl64(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t fmix64(uint64_t k)
+{
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+	return k;
+}
+
+/// Read 8 bytes as a little endian number, whatever the host order is.
+inline uint64_t load64(const uint8_t *p)
+{
+	uint64_t v = 0;
+	for ( int i = 7; i >= 0; i-- )
+		v = (v << 8) | p[i];
+	return v;
+}
+
+} // namespace
+
+
+object_fingerprint 
+object_fingerprint::compute(const void *data, size_t len)
+{
+	const uint8_t *p = (const uint8_t *) data;
+	const size_t nblocks = len / 16;
+	
+	uint64_t h1 = 0;
+	uint64_t h2 = 0;
+
+	for ( size_t i = 0; i < nblocks; i++ ) {
+		uint64_t k1 = load64(p + i * 16);
+		uint64_t k2 = load64(p + i * 16 + 8);
+
+		k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+		h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+		k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+		h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+	}
+
+	// The last 0 to 15 bytes.
+	const uint8_t *tail = p + nblocks * 16;
+	size_t rest = len & 15;
+	uint64_t k1 = 0;
+	uint64_t k2 = 0;
+
+	for ( size_t i = rest; i > 8; i-- )
+		k2 = (k2 << 8) | tail[i - 1];
+
+	for ( size_t i = (rest < 8) ? rest : 8; i > 0; i-- )
+		k1 = (k1 << 8) | tail[i - 1];
+
+	if ( rest > 8 ) {
+		k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+	}
+
+	if ( rest > 0 ) {
+		k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+	}
+
+	h1 ^= len; 
+	h2 ^= len;
+
+	h1 += h2;
+	h2 += h1;
+
+	h1 = fmix64(h1);
+	h2 = fmix64(h2);
+
+	h1 += h2;
+	h2 += h1;
+
+	return object_fingerprint(h1, h2);
+}
+
+  } // namespace msg
+} // namespace mnslp
+
+// EOF
@@ -0,0 +1,172 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file refresh_list.cpp
+/// The Refresh List Object.
+/// ----------------------------------------------------------
+/// $Id: refresh_list.cpp 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./src/msg/refresh_list.cpp $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#include "logfile.h"
+
+#include "msg/refresh_list.h"
+
+
+using namespace mnslp::msg;
+
+
+const char *const refresh_list::ie_name = "refresh_list";
+
+const size_t refresh_list::MAX_ENTRIES;
+
+
+/**
+ * Constructor.
+ *
+ * Creates an empty list.
+ */
+refresh_list::refresh_list(treatment_t treatment, bool _unique)
+		: mnslp_object(OBJECT_TYPE, treatment, _unique) {
+
+	// nothing to do
+}
+
+
+refresh_list::~refresh_list() {
+	// nothing to do
+}
+
+
+refresh_list *refresh_list::new_instance() const {
+	refresh_list *q = NULL;
+	catch_bad_alloc( q = new refresh_list() );
+	return q;
+}
+
+
+refresh_list *refresh_list::copy() const {
+	refresh_list *q = NULL;
+	catch_bad_alloc( q = new refresh_list(*this) );
+	return q;
+}
+
+
+bool refresh_list::deserialize_body(NetMsg &msg, uint16 body_length,
+		IEErrorList &err, bool skip) {
+
+	if ( body_length % ENTRY_LENGTH != 0 ) {
+		catch_bad_alloc( err.put( 
+			new PDUSyntaxError(CODING, get_category(),
+				get_object_type(), 0, msg.get_pos())) );
+
+		if ( ! skip )
+			return false;
+	}
+
+	entries.clear();
+
+	for ( uint16 i = 0; i + ENTRY_LENGTH <= body_length; i += ENTRY_LENGTH ) {
+		uint32 w1 = msg.decode32();
+		uint32 w2 = msg.decode32();
+		uint32 w3 = msg.decode32();
+		uint32 w4 = msg.decode32();
+		uint32 msn = msg.decode32();
+		uint32 lifetime = msg.decode32();
+
+		entries.push_back(entry(uint128(w1, w2, w3, w4), msn, lifetime));
+	}
+
+	invalidate_encoding();
+
+	return true; // success, all values are syntactically valid
+}
+
+
+void refresh_list::serialize_body(NetMsg &msg) const {
+	for ( const_iterator i = begin(); i != end(); i++ ) {
+		msg.encode32(i->session.w1);
+		msg.encode32(i->session.w2);
+		msg.encode32(i->session.w3);
+		msg.encode32(i->session.w4);
+		msg.encode32(i->msn);
+		msg.encode32(i->lifetime);
+	}
+}
+
+
+size_t refresh_list::get_serialized_size(coding_t coding) const {
+	return HEADER_LENGTH + entries.size() * ENTRY_LENGTH;
+}
+
+
+bool refresh_list::check_body() const {
+	return entries.size() <= MAX_ENTRIES;
+}
+
+
+bool refresh_list::equals_body(const mnslp_object &obj) const {
+
+	const refresh_list *other = dynamic_cast<const refresh_list *>(&obj);
+
+	if ( other == NULL || size() != other->size() )
+		return false;
+
+	for ( const_iterator i = begin(), j = other->begin(); i != end();
+			i++, j++ ) {
+		if ( i->session.w1 != j->session.w1 || i->session.w2 != j->session.w2
+				|| i->session.w3 != j->session.w3
+				|| i->session.w4 != j->session.w4
+				|| i->msn != j->msn || i->lifetime != j->lifetime )
+			return false;
+	}
+
+	return true;
+}
+
+
+const char *refresh_list::get_ie_name() const {
+	return ie_name;
+}
+
+
+ostream &refresh_list::print_attributes(ostream &os) const {
+	return os << ", entries=" << size();
+}
+
+
+/**
+ * Append an entry.
+ *
+ * @return false if the list is full already
+ */
+bool refresh_list::add(const uint128 &session, uint32 msn, uint32 lifetime) {
+	if ( is_full() )
+		return false;
+
+	entries.push_back(entry(session, msn, lifetime));
+	invalidate_encoding();
+
+	return true;
+}
+
+
+// EOF
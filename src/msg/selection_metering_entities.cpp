@@ -141,6 +141,7 @@ uint32 selection_metering_entities::get_value() const {
  */
 void selection_metering_entities::set_value(uint32 _sme) {
 	sme = _sme;
+	invalidate_encoding();
 }
 
 
@@ -141,6 +141,7 @@ uint32 session_lifetime::get_value() const {
  */
 void session_lifetime::set_value(uint32 _slt) {
 	slt = _slt;
+	invalidate_encoding();
 }
 
 
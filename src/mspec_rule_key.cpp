@@ -97,5 +97,19 @@ mspec_rule_key::to_string() const
 	return val_return;
 }	
 
+/**
+ * Set the key from its string representation.
+ */
+bool
+mspec_rule_key::from_string(const std::string &str)
+{
+	uuid_t parsed;
+	if ( uuid_parse(str.c_str(), parsed) != 0 )
+		return false;
+	
+	uuid_copy(uuid, parsed);
+	return true;
+}
+
 
 }
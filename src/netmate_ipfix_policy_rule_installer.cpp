@@ -32,12 +32,18 @@
 #include <unistd.h>
 #include <assert.h>
 #include <set>
+#include <algorithm>
+#include <iterator>
+#include <cctype>
 
 #include "address.h"
 #include "logfile.h"
+#include "mnslp_log.h"
+#include "msg/mnslp_trace.h"
 
 #include "policy_rule_installer.h"
 #include "netmate_ipfix_metering_config.h"
+#include "ipfix_collector.h"
 
 // curl includes
 #include <curl/curl.h>
@@ -57,9 +63,9 @@ using namespace protlib::log;
 	"netmate_ipfix_policy_rule_installer", msg)
 #define LogWarn(msg) Log(WARNING_LOG, LOG_NORMAL, \
 	"netmate_ipfix_policy_rule_installer", msg)
-#define LogInfo(msg) Log(INFO_LOG, LOG_NORMAL, \
+#define LogInfo(msg) MNSLP_LOG_INFO( \
 	"netmate_ipfix_policy_rule_installer", msg)
-#define LogDebug(msg) Log(DEBUG_LOG, LOG_NORMAL, \
+#define LogDebug(msg) MNSLP_LOG_DEBUG( \
 	"netmate_ipfix_policy_rule_installer", msg)
 #define LogUnimp(msg) Log(ERROR_LOG, LOG_UNIMP, \
 	"netmate_ipfix_policy_rule_installer", \
@@ -68,16 +74,22 @@ using namespace protlib::log;
 
 std::string netmate_ipfix_policy_rule_installer::rule_group = "NETMATE_IPFIX";
 
+const size_t netmate_ipfix_policy_rule_installer::MAX_TASKS_PER_REQUEST;
+const size_t netmate_ipfix_policy_rule_installer::DEFAULT_COMMAND_CACHE_SIZE;
+
 netmate_ipfix_policy_rule_installer::netmate_ipfix_policy_rule_installer(
 		mnslp_config *conf) throw () 
-		: policy_rule_installer(conf) {
+		: policy_rule_installer(conf), 
+		  command_cache_size(DEFAULT_COMMAND_CACHE_SIZE) {
 
-	// nothing to do
+	pthread_mutex_init(&tasks_mutex, NULL);
+	pthread_mutex_init(&command_mutex, NULL);
 }
 
 
 netmate_ipfix_policy_rule_installer::~netmate_ipfix_policy_rule_installer() throw () {
-	// nothing to do
+	pthread_mutex_destroy(&command_mutex);
+	pthread_mutex_destroy(&tasks_mutex);
 }
 
 
@@ -91,6 +103,9 @@ void netmate_ipfix_policy_rule_installer::setup()
 	 * configuration as not posible to do metering. 
 	 */
 	policy_rule_installer::setup();
+	
+	// Compiled commands depend on the configuration just loaded.
+	clear_command_cache();
     
 }
 
@@ -165,7 +180,8 @@ mt_policy_rule * netmate_ipfix_policy_rule_installer::install(const mt_policy_ru
 	std::map<std::string, std::string>::iterator it_commands;
 	
 	
-	std::cout << "before exec command" << std::endl;
+	MNSLP_TRACE(msg::trace::tc_installer, msg::trace::ev_install,
+				std::distance(rule->begin(), rule->end()), 0, 0);
 	
 	for ( i = rule->begin(); i != rule->end(); i++){
 		
@@ -177,13 +193,26 @@ mt_policy_rule * netmate_ipfix_policy_rule_installer::install(const mt_policy_ru
 		commands = create_postfield_command(i->first, mess);
 		
 		for (it_commands = commands.begin(); it_commands != commands.end(); ++it_commands){
+			
+			// Share the task of another session with the same command.
+			msg::object_fingerprint fp = command_fingerprint(i->first, it_commands->second);
+			std::string shared_name;
+			if ( acquire_task(fp, shared_name) ){
+				rule_keys.push_back(shared_name);
+				bind_task(i->first, shared_name, it_commands->second);
+				continue;
+			}
+			
 			// Create the http command to send for configuration
 			try{
 				execute_command(action, it_commands->second);
+				register_task(fp, it_commands->first);
 				rule_keys.push_back(it_commands->first);
+				bind_task(i->first, it_commands->first, it_commands->second);
 			}
 			catch(policy_rule_installer_error &e){
-				std::cout << "It cannot install the object" << std::endl;
+				MNSLP_TRACE(msg::trace::tc_installer, msg::trace::ev_install_failed,
+							i->second->get_object_type(), 0, 0);
 			}
 		}
 		// If we can install at least a rule, we insert the metering object in the policy
@@ -208,6 +237,9 @@ netmate_ipfix_policy_rule_installer::remove(const mt_policy_rule *rule) {
 
 	mt_policy_rule::const_iterator_commands i;
 	for ( i = rule->begin_commands(); i != rule->end_commands(); i++){
+		if ( get_collector() != NULL )
+			get_collector()->unbind_rule(i->first);
+		
 		std::vector<std::string> keys = i->second;
 		for ( int index = 0; index < keys.size(); index ++ ) {
 			try
@@ -216,7 +248,21 @@ netmate_ipfix_policy_rule_installer::remove(const mt_policy_rule *rule) {
 				postfields.append(netmate_ipfix_policy_rule_installer::rule_group);
 				postfields.append(".");
 				postfields.append(keys[index]);
-				execute_command(action, postfields);
+				
+				// Other sessions still use the task.
+				if ( release_task(keys[index]) ){
+					try
+					{
+						execute_command(action, postfields);
+					}
+					catch (policy_rule_installer_error &e)
+					{
+						finish_release(keys[index], false);
+						throw;
+					}
+					finish_release(keys[index], true);
+				}
+				
 				return_keys.push_back(postfields);
 			}
 			catch (policy_rule_installer_error &e)
@@ -231,6 +277,84 @@ netmate_ipfix_policy_rule_installer::remove(const mt_policy_rule *rule) {
 }
 
 
+void
+netmate_ipfix_policy_rule_installer::remove_bulk(
+		const std::vector<const mt_policy_rule *> &rules) {
+
+	LogDebug("remove_bulk(): " << rules.size());
+	std::string action = "/rm_task";
+	std::vector<std::string> names;
+	size_t requests = 0;
+	
+	for ( size_t i = 0; i < rules.size(); i++ ){
+		mt_policy_rule::const_iterator_commands it;
+		for ( it = rules[i]->begin_commands(); it != rules[i]->end_commands(); it++ ){
+			if ( get_collector() != NULL )
+				get_collector()->unbind_rule(it->first);
+			
+			for ( size_t index = 0; index < it->second.size(); index++ ){
+				// Other sessions still use the task.
+				if ( release_task(it->second[index]) )
+					names.push_back(it->second[index]);
+			}
+		}
+	}
+	
+	// The RuleID parameter takes a comma separated list of tasks.
+	for ( size_t i = 0; i < names.size(); i += MAX_TASKS_PER_REQUEST ){
+		size_t end = std::min(names.size(), i + MAX_TASKS_PER_REQUEST);
+		std::string postfields = "RuleID=";
+		
+		for ( size_t index = i; index < end; index++ ){
+			if ( index > i )
+				postfields.append(",");
+			postfields.append(netmate_ipfix_policy_rule_installer::rule_group);
+			postfields.append(".");
+			postfields.append(names[index]);
+		}
+		
+		try
+		{
+			execute_command(action, postfields);
+			requests++;
+			
+			for ( size_t index = i; index < end; index++ )
+				finish_release(names[index], true);
+			continue;
+		}
+		catch (policy_rule_installer_error &e)
+		{
+			LogWarn("unable to remove " << end - i << " tasks at once: " << e);
+			requests++;
+		}
+		
+		// Not every metering application takes a list, remove one by one.
+		for ( size_t index = i; index < end; index++ ){
+			std::string single = "RuleID=";
+			single.append(netmate_ipfix_policy_rule_installer::rule_group);
+			single.append(".");
+			single.append(names[index]);
+			
+			bool removed = true;
+			try
+			{
+				execute_command(action, single);
+			}
+			catch (policy_rule_installer_error &e)
+			{
+				LogError("unable to remove task " << names[index] << ": " << e);
+				removed = false;
+			}
+			requests++;
+			finish_release(names[index], removed);
+		}
+	}
+	
+	MNSLP_TRACE(msg::trace::tc_installer, msg::trace::ev_teardown, 
+				rules.size(), names.size(), requests);
+}
+
+
 bool netmate_ipfix_policy_rule_installer::remove_all() {
 
 	LogDebug("NOP: removing all metering policy rules ");
@@ -240,13 +364,259 @@ bool netmate_ipfix_policy_rule_installer::remove_all() {
 	try
 	{
 		execute_command(action, postfields);
-		return true;
 	}
 	catch (policy_rule_installer_error &e) 
 	{
 		return false;
 	}
 
+	pthread_mutex_lock(&tasks_mutex);
+	installed_tasks.clear();
+	shared_tasks.clear();
+	pthread_mutex_unlock(&tasks_mutex);
+	return true;
+}
+
+
+void
+netmate_ipfix_policy_rule_installer::adopt(const mt_policy_rule *rule)
+{
+	mt_policy_rule::const_iterator i;
+	for ( i = rule->begin(); i != rule->end(); i++ ){
+		
+		mt_policy_rule::const_iterator_commands names = rule->find_commands(i->first);
+		if ( names == rule->end_commands() )
+			continue;
+		
+		// The commands are named after the key, like in install().
+		const msg::mnslp_ipfix_message *mess = get_ipfix_message(i->second);
+		std::map<std::string, std::string> commands = 
+				create_postfield_command(i->first, mess);
+		
+		pthread_mutex_lock(&tasks_mutex);
+		
+		for ( size_t index = 0; index < names->second.size(); index++ ){
+			const std::string &name = names->second[index];
+			installed_task &task = installed_tasks[name];
+			task.refs++;
+			
+			// Tasks shared from another session get their fingerprint 
+			// when the session that installed them is adopted.
+			std::map<std::string, std::string>::const_iterator it_command = 
+					commands.find(name);
+			if ( it_command != commands.end() ){
+				task.fingerprint = command_fingerprint(i->first, it_command->second);
+				if ( shared_tasks.find(task.fingerprint) == shared_tasks.end() )
+					shared_tasks[task.fingerprint] = name;
+			}
+		}
+		
+		pthread_mutex_unlock(&tasks_mutex);
+		
+		// Shared tasks end in the same number as our own command for them.
+		for ( size_t index = 0; index < names->second.size(); index++ ){
+			const std::string &name = names->second[index];
+			std::string::size_type sep = name.rfind('_');
+			if ( sep == std::string::npos )
+				continue;
+			
+			std::map<std::string, std::string>::const_iterator it_command = 
+					commands.find(i->first.to_string() + name.substr(sep));
+			if ( it_command != commands.end() )
+				bind_task(i->first, name, it_command->second);
+		}
+	}
+}
+
+
+void
+netmate_ipfix_policy_rule_installer::reconcile()
+{
+	std::set<std::string> present;
+	bool listed = true;
+	size_t dropped = 0;
+	
+	try
+	{
+		list_tasks(present);
+	}
+	catch (policy_rule_installer_error &e)
+	{
+		LogWarn("unable to list the tasks of the metering application: " << e);
+		listed = false;
+	}
+	
+	pthread_mutex_lock(&tasks_mutex);
+	
+	if ( ! listed ){
+		// Some of them may be gone, install new tasks instead.
+		shared_tasks.clear();
+	}
+	else {
+		std::map<std::string, installed_task>::iterator it = installed_tasks.begin();
+		while ( it != installed_tasks.end() ){
+			if ( present.find(it->first) != present.end() ){
+				++it;
+				continue;
+			}
+			
+			std::map<msg::object_fingerprint, std::string>::iterator it_shared = 
+					shared_tasks.find(it->second.fingerprint);
+			if ( (it_shared != shared_tasks.end()) && (it_shared->second == it->first) )
+				shared_tasks.erase(it_shared);
+			
+			installed_tasks.erase(it++);
+			dropped++;
+		}
+	}
+	
+	pthread_mutex_unlock(&tasks_mutex);
+	
+	if ( dropped > 0 )
+		LogWarn(dropped << " adopted tasks are gone from the metering application");
+}
+
+
+msg::object_fingerprint
+netmate_ipfix_policy_rule_installer::command_fingerprint(const mspec_rule_key &key,
+										const std::string &command) const
+{
+	// The key names the rule and the export file, drop it wherever it appears.
+	std::string canonical = command;
+	std::string key_str = key.to_string();
+	std::string::size_type pos;
+	
+	while ( (pos = canonical.find(key_str)) != std::string::npos )
+		canonical.erase(pos, key_str.length());
+	
+	// So is the domain ID of ipfix targets, which depends on the key.
+	const std::string odid = ";odid=";
+	if ( (pos = canonical.find(odid)) != std::string::npos ){
+		std::string::size_type end = 
+				canonical.find_first_not_of("0123456789", pos + odid.length());
+		canonical.erase(pos, end == std::string::npos ? end : end - pos);
+	}
+	
+	return msg::object_fingerprint::compute(canonical.data(), canonical.length());
+}
+
+
+uint32
+netmate_ipfix_policy_rule_installer::task_domain(const std::string &name)
+{
+	// FNV-1a, 0 is left to exporters that don't set an ID.
+	uint32 hash = 2166136261u;
+	for ( size_t i = 0; i < name.length(); i++ )
+		hash = (hash ^ (unsigned char) name[i]) * 16777619u;
+	
+	return hash != 0 ? hash : 1;
+}
+
+
+void
+netmate_ipfix_policy_rule_installer::bind_task(const mspec_rule_key &key,
+		const std::string &name, const std::string &command)
+{
+	if ( get_collector() != NULL 
+			&& command.find("target=ipfix:") != std::string::npos )
+		get_collector()->bind_rule(task_domain(name), key);
+}
+
+
+bool
+netmate_ipfix_policy_rule_installer::acquire_task(const msg::object_fingerprint &fp,
+												  std::string &name)
+{
+	bool found = false;
+	
+	pthread_mutex_lock(&tasks_mutex);
+	
+	std::map<msg::object_fingerprint, std::string>::iterator it = shared_tasks.find(fp);
+	if ( it != shared_tasks.end() ){
+		installed_task &task = installed_tasks[it->second];
+		task.refs++;
+		name = it->second;
+		found = true;
+		
+		MNSLP_TRACE(msg::trace::tc_installer, msg::trace::ev_install_shared,
+					task.refs, 0, 0);
+	}
+	
+	pthread_mutex_unlock(&tasks_mutex);
+	return found;
+}
+
+
+void
+netmate_ipfix_policy_rule_installer::register_task(const msg::object_fingerprint &fp,
+												   const std::string &name)
+{
+	pthread_mutex_lock(&tasks_mutex);
+	
+	installed_task &task = installed_tasks[name];
+	task.fingerprint = fp;
+	task.refs = 1;
+	
+	// If another session installed the same command meanwhile, keep sharing
+	// its task; this one is removed with its only reference.
+	if ( shared_tasks.find(fp) == shared_tasks.end() )
+		shared_tasks[fp] = name;
+	
+	pthread_mutex_unlock(&tasks_mutex);
+}
+
+
+bool
+netmate_ipfix_policy_rule_installer::release_task(const std::string &name)
+{
+	bool remove = true;
+	
+	pthread_mutex_lock(&tasks_mutex);
+	
+	std::map<std::string, installed_task>::iterator it = installed_tasks.find(name);
+	if ( it != installed_tasks.end() ){
+		
+		if ( it->second.refs > 1 ){
+			it->second.refs--;
+			remove = false;
+			MNSLP_TRACE(msg::trace::tc_installer, msg::trace::ev_remove_shared,
+						it->second.refs, 0, 0);
+		}
+		else {
+			// No other session may pick up a task that is being removed.
+			std::map<msg::object_fingerprint, std::string>::iterator it_shared = 
+					shared_tasks.find(it->second.fingerprint);
+			if ( (it_shared != shared_tasks.end()) && (it_shared->second == name) )
+				shared_tasks.erase(it_shared);
+		}
+	}
+	
+	pthread_mutex_unlock(&tasks_mutex);
+	return remove;
+}
+
+
+void
+netmate_ipfix_policy_rule_installer::finish_release(const std::string &name, 
+													bool removed)
+{
+	pthread_mutex_lock(&tasks_mutex);
+	
+	std::map<std::string, installed_task>::iterator it = installed_tasks.find(name);
+	if ( it != installed_tasks.end() ){
+		
+		if ( removed )
+			installed_tasks.erase(it);
+		else {
+			// The task is still installed but unused, the next session 
+			// sharing it takes it over.
+			it->second.refs = 0;
+			if ( shared_tasks.find(it->second.fingerprint) == shared_tasks.end() )
+				shared_tasks[it->second.fingerprint] = name;
+		}
+	}
+	
+	pthread_mutex_unlock(&tasks_mutex);
 }
 
 
@@ -309,37 +679,178 @@ netmate_ipfix_policy_rule_installer::create_postfield_command(
 					const mspec_rule_key &key, 
 					const msg::mnslp_ipfix_message *message) const throw () 
 {
+	LogDebug("create_filter_command(): ");
+	compiled_command compiled;
+	
+	try
+	{
+		const msg::object_fingerprint &fp = message->get_fingerprint();
+		if ( ! find_command(fp, compiled) ){
+			compiled = compile_command(message);
+			cache_command(fp, compiled);
+		}
+	}
+	catch (msg::IEError &e)
+	{
+		// Without a fingerprint the command cannot be cached.
+		compiled = compile_command(message);
+	}
+	
+	return build_commands(key, compiled);
+}
 
+
+netmate_ipfix_policy_rule_installer::compiled_command
+netmate_ipfix_policy_rule_installer::compile_command(
+					const msg::mnslp_ipfix_message *message) const
+{
 	msg::mnslp_ipfix_template *templ = NULL;
-	LogDebug("create_filter_command(): ");
-	std::string postfields;
-	std::map<std::string, std::string> val_return;
+	compiled_command compiled;
 	
-	std::cout << "create string with filter fields" << std::endl;
 	// Add all filters specified. 
 	templ = get_filter_template(message);
 	if (templ!= NULL){
-		postfields.append(" ");	
-		postfields.append( build_command_filter_fields(message, templ) );
+		compiled.filter.append(" ");	
+		compiled.filter.append( build_command_filter_fields(message, templ) );
 	}
 	else{
-		// TODO AM: Put in log.
-		std::cout << "Option template not found" << std::endl;
+		MNSLP_TRACE(msg::trace::tc_installer, msg::trace::ev_install_template_missing,
+					msg::OPTION_TEMPLATE, 0, 0);
 	}
 	
-	std::cout << "create string with export fields" << std::endl;
 	
 	// Add all export fields ( for now it just add the package for metering )
 	templ = get_export_template(message);
 	if (templ!= NULL){
-		val_return = build_command_export_fields(key, message, templ, postfields);
+		build_command_export_fields(message, templ, compiled);
 	}
 	else{
-		// TODO AM: Put in log.
-		std::cout << "Export template not found" << std::endl;
+		MNSLP_TRACE(msg::trace::tc_installer, msg::trace::ev_install_template_missing,
+					msg::DATA_TEMPLATE, 0, 0);
 	}
 	
-	return val_return;
+	return compiled;
+}
+
+
+std::map<std::string, std::string>
+netmate_ipfix_policy_rule_installer::build_commands(const mspec_rule_key &key, 
+					const compiled_command &compiled) const
+{
+	std::map<std::string, std::string> list_commands;
+	const std::string key_str = key.to_string();
+	int sequence = 1;
+	
+	compiled_command::exports_t::const_iterator it_export;
+	for (it_export = compiled.exports.begin(); 
+			it_export != compiled.exports.end(); ++it_export){
+		ostringstream command;
+		ostringstream comp_key;
+		comp_key << key_str << "_" << sequence;
+		command << "Rule=" << netmate_ipfix_policy_rule_installer::rule_group 
+						   << "." << key_str << "_" 
+					       << sequence << " " <<  compiled.filter << " -a "
+					       << it_export->second << "-e target=" << it_export->first;
+		
+		// Files are named after the rule. The collector tells the results
+		// of the tasks apart by their domain ID.
+		if ( it_export->first.compare(0, 5, "file:") == 0 )
+			command << key_str;
+		else if ( get_collector() != NULL 
+					&& it_export->first.compare(0, 6, "ipfix:") == 0 )
+			command << ";odid=" << task_domain(comp_key.str());
+		
+		list_commands.insert(std::pair<std::string, std::string>(comp_key.str(), command.str()));
+		sequence = sequence + 1;
+	}
+	
+	return list_commands;
+}
+
+
+bool
+netmate_ipfix_policy_rule_installer::find_command(const msg::object_fingerprint &fp, 
+					compiled_command &compiled) const
+{
+	bool found = false;
+	
+	pthread_mutex_lock(&command_mutex);
+	
+	std::map<msg::object_fingerprint, command_lru_t::iterator>::iterator it = 
+			command_index.find(fp);
+	if ( it != command_index.end() ){
+		// Move it to the front, iterators into the list stay valid.
+		command_lru.splice(command_lru.begin(), command_lru, it->second);
+		compiled = it->second->second;
+		found = true;
+	}
+	
+	pthread_mutex_unlock(&command_mutex);
+	
+	return found;
+}
+
+
+void
+netmate_ipfix_policy_rule_installer::cache_command(const msg::object_fingerprint &fp, 
+					const compiled_command &compiled) const
+{
+	size_t evicted = 0;
+	
+	pthread_mutex_lock(&command_mutex);
+	
+	// Another thread may have compiled the same object meanwhile.
+	if ( command_index.find(fp) == command_index.end() ){
+		command_lru.push_front(std::make_pair(fp, compiled));
+		command_index[fp] = command_lru.begin();
+	}
+	
+	while ( command_lru.size() > command_cache_size ){
+		command_index.erase(command_lru.back().first);
+		command_lru.pop_back();
+		evicted++;
+	}
+	
+	MNSLP_TRACE(msg::trace::tc_installer, msg::trace::ev_command_compiled,
+				command_lru.size(), evicted, 0);
+	
+	pthread_mutex_unlock(&command_mutex);
+}
+
+
+void
+netmate_ipfix_policy_rule_installer::clear_command_cache()
+{
+	pthread_mutex_lock(&command_mutex);
+	command_index.clear();
+	command_lru.clear();
+	pthread_mutex_unlock(&command_mutex);
+}
+
+
+void
+netmate_ipfix_policy_rule_installer::set_command_cache_size(size_t size)
+{
+	pthread_mutex_lock(&command_mutex);
+	
+	command_cache_size = size;
+	while ( command_lru.size() > command_cache_size ){
+		command_index.erase(command_lru.back().first);
+		command_lru.pop_back();
+	}
+	
+	pthread_mutex_unlock(&command_mutex);
+}
+
+
+size_t
+netmate_ipfix_policy_rule_installer::get_number_cached_commands() const
+{
+	pthread_mutex_lock(&command_mutex);
+	size_t size = command_lru.size();
+	pthread_mutex_unlock(&command_mutex);
+	
+	return size;
 }
 
 bool
@@ -357,8 +868,11 @@ bool
 netmate_ipfix_policy_rule_installer::handle_export_fields(const msg::mnslp_ipfix_message *mess, 
 									msg::mnslp_ipfix_template *templ)
 {
+	const std::vector<msg::ipfix_field_descriptor_t> &fields = 
+						templ->get_field_descriptors();
+
 	for (int i = 0; i < templ->get_numfields(); i++ ){
-		msg::mnslp_ipfix_field field = templ->get_field(i).elem;
+		msg::mnslp_ipfix_field &field = *fields[i].elem;
 		
 		// Verify  the field as export configured.
 		if ( get_application_configuration_container()->is_export_field( 
@@ -375,27 +889,25 @@ netmate_ipfix_policy_rule_installer::handle_export_fields(const msg::mnslp_ipfix
 	return true;
 }	
 
-std::map<std::string, std::string>
-netmate_ipfix_policy_rule_installer::build_command_export_fields( const mspec_rule_key &key, 
+void
+netmate_ipfix_policy_rule_installer::build_command_export_fields(
 									const msg::mnslp_ipfix_message *mess, 
 									msg::mnslp_ipfix_template *templ, 
-									std::string filter_def) const
+									compiled_command &compiled) const
 {
-	std::set<std::string> export_fields;
-	
 	std::map<std::string, std::set<string> > exports;
 	std::map<std::string, std::set<string> >::iterator it_export;
 	const netmate_ipfix_metering_config * met_conf;
 		
+	const std::vector<msg::ipfix_field_descriptor_t> &fields = 
+						templ->get_field_descriptors();
+
 	for (int i = 0; i < templ->get_numfields(); i++ )
 	{
-		msg::mnslp_ipfix_field field = templ->get_field(i).elem;
+		msg::mnslp_ipfix_field &field = *fields[i].elem;
 		if ( get_application_configuration_container()->
 				is_export_field( get_metering_application(), field) )
 		{
-			export_fields.insert( get_action_container()->get_field_traslate( 
-									get_metering_application(), field) );
-																		
 			met_conf = dynamic_cast< const netmate_ipfix_metering_config* >( get_action_container()->get_package( 
 									get_metering_application(), field) );
 			
@@ -403,56 +915,47 @@ netmate_ipfix_policy_rule_installer::build_command_export_fields( const mspec_ru
 			{
 				
 				std::string export_str;
-				// Establish the target for the export process.
+				// Establish the target for the export process, the rule key
+				// is appended to file targets when the command is built.
 				if (met_conf->get_export_procedure().compare("file") == 0){
 					export_str.append("file:");
 					export_str.append(met_conf->get_export_directory());
-					export_str.append(key.to_string());
 				}
 				else if (met_conf->get_export_procedure().compare("ipfix") == 0){					
 					export_str.append("ipfix:");
+					
+					// Send the results to our own collector if it runs.
+					if ( get_collector() != NULL ){
+						const std::string &address = get_collector()->get_address();
+						ostringstream target;
+						if ( address.find(':') != std::string::npos )
+							target << "[" << address << "]";
+						else
+							target << address;
+						target << ":" << get_collector()->get_port();
+						export_str.append(target.str());
+					}
 				}					
 				else{
 					export_str.append("file:");
 					export_str.append(get_export_directory());
-					export_str.append(key.to_string());					
 				}
 				
-				it_export = exports.find(export_str);
-				if (it_export == exports.end()){
-					std::set<std::string> export_commands;
-					export_commands.insert(met_conf->get_metering_procedure());
-					exports[export_str] = export_commands;
-				}
-				else{
-					(it_export->second).insert( met_conf->get_metering_procedure());
-				}
+				exports[export_str].insert( met_conf->get_metering_procedure() );
 			}	
 		}
 	}
 	
-	std::map<std::string, std::string> list_commands;
-	int sequence = 1;
 	for (it_export=exports.begin(); it_export!= exports.end(); ++it_export){
-		ostringstream command;
-		ostringstream comp_key;
-		comp_key << key.to_string() << "_" << sequence;
-		command << "Rule=" << netmate_ipfix_policy_rule_installer::rule_group 
-						   << "." << key.to_string() << "_" 
-					       << sequence << " " <<  filter_def << " -a ";
+		std::string &packages = compiled.exports[it_export->first];
 		
 		std::set<string>::iterator it_packages;
 		for (it_packages = (it_export->second).begin(); 
 				it_packages != (it_export->second).end(); ++it_packages){
-			command << *it_packages << " ";
+			packages.append(*it_packages);
+			packages.append(" ");
 		}	
-
-		command << "-e target=" << it_export->first; 
-		list_commands.insert(std::pair<std::string, std::string>(comp_key.str(), command.str()));
-		sequence = sequence + 1;
 	}	
-  
-	return list_commands;
 }	
 
 std::string
@@ -463,9 +966,12 @@ netmate_ipfix_policy_rule_installer::build_command_filter_fields( const msg::mns
 	std::string val_return = "-r";
 	
 	
+	const std::vector<msg::ipfix_field_descriptor_t> &fields = 
+						templ->get_field_descriptors();
+
 	for (int i = 0; i < templ->get_numfields(); i++ ){
 		
-		msg::mnslp_ipfix_field field = templ->get_field(i).elem;
+		msg::mnslp_ipfix_field &field = *fields[i].elem;
 		if ( get_application_configuration_container()->
 				is_filter_field( get_metering_application(), field) )
 		{
@@ -515,8 +1021,11 @@ bool
 netmate_ipfix_policy_rule_installer::handle_filter_fields(const msg::mnslp_ipfix_message *mess, 
 									msg::mnslp_ipfix_template *templ)
 {
+	const std::vector<msg::ipfix_field_descriptor_t> &fields = 
+						templ->get_field_descriptors();
+
 	for (int i = 0; i < templ->get_numfields(); i++ ){
-		msg::mnslp_ipfix_field field = templ->get_field(i).elem;
+		msg::mnslp_ipfix_field &field = *fields[i].elem;
 		if (!(get_application_configuration_container()->check_field_availability(
 					get_metering_application(),field)))
 			return false;
@@ -552,6 +1061,52 @@ std::string netmate_ipfix_policy_rule_installer::getErr(char *e)
 
 bool 
 netmate_ipfix_policy_rule_installer::execute_command(std::string action, std::string post_fields)
+{
+	std::string reply;
+	return send_command(action, post_fields, reply);
+}
+
+
+void
+netmate_ipfix_policy_rule_installer::list_tasks(std::set<std::string> &names)
+		throw (policy_rule_installer_error)
+{
+	std::string reply;
+	send_command("/get_info", "IType=tasklist", reply);
+	parse_task_list(reply, names);
+}
+
+
+void
+netmate_ipfix_policy_rule_installer::parse_task_list(const std::string &reply,
+										std::set<std::string> &names)
+{
+	const std::string prefix = netmate_ipfix_policy_rule_installer::rule_group + ".";
+	const char *delimiters = " \t\r\n,;<>\"'";
+	std::string::size_type pos = 0;
+	
+	while ( (pos = reply.find(prefix, pos)) != std::string::npos ){
+		// Skip longer group names ending in ours.
+		if ( pos > 0 && reply.find_first_of(delimiters, pos - 1) != pos - 1 ){
+			pos += prefix.length();
+			continue;
+		}
+		
+		pos += prefix.length();
+		std::string::size_type end = reply.find_first_of(delimiters, pos);
+		if ( end == std::string::npos )
+			end = reply.length();
+		
+		if ( end > pos )
+			names.insert(reply.substr(pos, end - pos));
+		pos = end;
+	}
+}
+
+
+bool 
+netmate_ipfix_policy_rule_installer::send_command(std::string action, 
+						std::string post_fields, std::string &reply)
 {
 
     char cebuf[CURL_ERROR_SIZE], *ctype;
@@ -572,7 +1127,7 @@ netmate_ipfix_policy_rule_installer::execute_command(std::string action, std::st
 	xsltStylesheetPtr cur = NULL;
 	xmlDocPtr doc, out;
     
-    std::cout << "The action given is:" << action << std::endl;
+    LogDebug("execute_command(): action " << action);
 	// initialize libcurl
 	curl = curl_easy_init();
 	if (curl == NULL) {
@@ -638,7 +1193,7 @@ netmate_ipfix_policy_rule_installer::execute_command(std::string action, std::st
 #else
        free(post_body);
 #endif
-       std::cout << "Here 0" << std::endl;
+       MNSLP_TRACE(msg::trace::tc_installer, msg::trace::ev_install_command, 0, 0, 0);
 	   curl_easy_cleanup(curl);
 	   xsltFreeStylesheet(cur);
 	   xsltCleanupGlobals();
@@ -658,7 +1213,7 @@ netmate_ipfix_policy_rule_installer::execute_command(std::string action, std::st
        free(post_body);
 #endif
 
-	   std::cout << "Here 4 " << std::endl;
+	   MNSLP_TRACE(msg::trace::tc_installer, msg::trace::ev_install_command, 1, 0, 0);
       
 	   curl_easy_cleanup(curl);
 	   xsltFreeStylesheet(cur);
@@ -680,7 +1235,7 @@ netmate_ipfix_policy_rule_installer::execute_command(std::string action, std::st
        free(post_body);
 #endif
 
-	   std::cout << "Here 5 " << std::endl;
+	   MNSLP_TRACE(msg::trace::tc_installer, msg::trace::ev_install_command, 2, 0, 0);
       
 	   curl_easy_cleanup(curl);
 	   xsltFreeStylesheet(cur);
@@ -691,19 +1246,29 @@ netmate_ipfix_policy_rule_installer::execute_command(std::string action, std::st
 			msg::information_code::sigfail_metering_connection_broken);
     }
 
-    if (!strcmp(ctype, "text/xml")) {
+    if (ctype != NULL && !strcmp(ctype, "text/xml") && cur != NULL) {
        // translate
+       xmlChar *text = NULL;
+       int text_len = 0;
        doc = xmlParseMemory(response.c_str(), response.length());
-       out = xsltApplyStylesheet(cur, doc, NULL);
-       xsltSaveResultToFile(stdout, out, cur);         
-       xmlFreeDoc(out);
-       xmlFreeDoc(doc);
+       out = (doc != NULL) ? xsltApplyStylesheet(cur, doc, NULL) : NULL;
+       if (out != NULL && xsltSaveResultToString(&text, &text_len, out, cur) == 0
+              && text != NULL) {
+          LogDebug("execute_command(): response " 
+                      << std::string((const char *) text, text_len));
+          xmlFree(text);
+       }
+       if (out != NULL)
+          xmlFreeDoc(out);
+       if (doc != NULL)
+          xmlFreeDoc(doc);
     } 
     else {
        // just dump
-       cout << response << endl;
+       LogDebug("execute_command(): response " << response);
     }
 
+    reply = response;
     response = "";
     free(_url);
 #ifdef HAVE_CURL_FREE
@@ -712,13 +1277,37 @@ netmate_ipfix_policy_rule_installer::execute_command(std::string action, std::st
     free(post_body);
 #endif
 
-    std::cout << "Here 6 " << std::endl;
+    MNSLP_TRACE(msg::trace::tc_installer, msg::trace::ev_install_command, 3, rcode, 0);
      
     curl_easy_cleanup(curl);
 	xsltFreeStylesheet(cur);
 	xsltCleanupGlobals();
 	xmlCleanupParser();
 
+	check_reply(action, rcode, reply);
+
+	return val_return;
+}
+
+
+void
+netmate_ipfix_policy_rule_installer::check_reply(const std::string &action,
+						unsigned long rcode, const std::string &reply)
+{
+	// NetMate answers commands it can't carry out with an error status.
+	std::string lower(reply);
+	std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+	
+	if ( rcode >= 200 && rcode < 300
+			&& lower.find("status=\"error\"") == std::string::npos 
+			&& lower.find("status='error'") == std::string::npos )
+		return;
+	
+	LogError("metering application rejected " << action 
+			<< ", HTTP status " << rcode);
+	throw policy_rule_installer_error("Metering application rejected the command",
+		msg::information_code::sc_signaling_session_failures,
+		msg::information_code::sigfail_policy_rule_denied);
 }
 
 
@@ -26,7 +26,10 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 //
 // ===========================================================
+#include <time.h>
+
 #include "logfile.h"
+#include "mnslp_log.h"
 
 #include "mri.h"	// from NTLP
 
@@ -46,24 +49,27 @@ using protlib::uint32;
 
 #define LogError(msg) ERRLog("nf_session", msg)
 #define LogWarn(msg) WLog("nf_session", msg)
-#define LogInfo(msg) ILog("nf_session", msg)
-#define LogDebug(msg) DLog("nf_session", msg)
+#define LogInfo(msg) MNSLP_LOG_INFO("nf_session", msg)
+#define LogDebug(msg) MNSLP_LOG_DEBUG("nf_session", msg)
 
 #define LogUnimp(msg) Log(ERROR_LOG, LOG_UNIMP, "nf_session", \
 	msg << " at " << __FILE__ << ":" << __LINE__)
 
 
+session_slab nf_session::slab(sizeof(nf_session));
+
+
 /**
  * Constructor.
  *
  * Use this if the session ID is known in advance.
  */
 nf_session::nf_session(const session_id &id, const mnslp_config *conf)
-		: session(id), state(nf_session::STATE_CLOSE), config(conf),
-		  proxy_mode(false), lifetime(0), max_lifetime(0),
-		  response_timeout(0), state_timer(this), response_timer(this),
+		: session(id), state(nf_session::STATE_CLOSE), lifetime(0),
+		  max_lifetime(0), response_timeout(0), proxy_mode(false),
+		  state_timer(this), response_timer(this), config(conf),
 		  ni_mri(NULL), nr_mri(NULL), configure_message(NULL), 
-		  refresh_message(NULL)
+		  refresh_message(NULL), requested_rule(NULL)
 {
 	set_session_type(st_forwarder);
 	assert( config != NULL );
@@ -76,11 +82,11 @@ nf_session::nf_session(const session_id &id, const mnslp_config *conf)
  * @param s the state to start in
  */
 nf_session::nf_session(nf_session::state_t s, const mnslp_config *conf)
-		: session(), state(s), config(conf),
-		  proxy_mode(false), lifetime(0), max_lifetime(60),
-		  response_timeout(0), state_timer(this), response_timer(this),
+		: session(), state(s), lifetime(0), max_lifetime(60),
+		  response_timeout(0), proxy_mode(false),
+		  state_timer(this), response_timer(this), config(conf),
 		  ni_mri(NULL), nr_mri(NULL), configure_message(NULL),
-		  refresh_message(NULL)
+		  refresh_message(NULL), requested_rule(NULL)
 {
 	set_session_type(st_forwarder);
 }
@@ -103,6 +109,9 @@ nf_session::~nf_session()
 	
 	if (refresh_message != NULL)
 		delete refresh_message;
+	
+	if (requested_rule != NULL)
+		delete requested_rule;
 		
 }
 
@@ -411,6 +420,7 @@ nf_session::handle_state_close(dispatcher *d, event *evt)
 
 		set_lifetime(lifetime);
 		set_msg_sequence_number(msn);
+		set_upstream_peer(e->get_sii_handle());
 		
 		return process_state_close(d, evt);
 
@@ -533,6 +543,8 @@ nf_session::handle_state_pending(dispatcher *d, event *evt) {
 		if ( resp->is_success() ) {
 			LogDebug("initiated session " << get_id());
 
+			set_downstream_peer(e->get_sii_handle());
+
 			mt_policy_rule * result = d->install_policy_rules(rule);
 						// Verify that every rule that passed the checking process could be installed.
 			if (result->get_number_mspec_objects() == rule->get_number_mspec_objects() )
@@ -602,10 +614,161 @@ nf_session::state_t nf_session::handle_state_metering(
   
 	LogDebug("Begining handle_state_metering(): " << *this);
   
+	/*
+	 * A msg_event arrived which contains a MNSLP CONFIGURE message that
+	 * changes what this session meters. It is passed on, and the change
+	 * is applied once the downstream peer accepted it.
+	 */
+	if ( is_mnslp_configure(evt) ) 
+	{
+		msg_event *e = dynamic_cast<msg_event *>(evt);
+		ntlp_msg *msg = e->get_ntlp_msg();
+		mnslp_configure *c = e->get_configure();
+
+		uint32 lifetime = c->get_session_lifetime();
+		uint32 msn = c->get_msg_sequence_number();
+
+		/*
+		 * Before proceeding check several preconditions.
+		 */
+		try {
+			check_lifetime(lifetime, get_max_lifetime());
+			check_authorization(d, e);
+		}
+		catch ( override_lifetime &e) {
+			lifetime = get_max_lifetime();
+		}
+		catch ( request_error &e ) {
+			LogError(e);
+			d->send_message( msg->create_error_response(e) );
+			return STATE_METERING; // no change
+		}
+
+		if ( ! is_greater_than(msn, get_msg_sequence_number()) ) {
+			LogWarn("duplicate configure received.");
+			return STATE_METERING; // no change
+		}
+		else if ( lifetime == 0 ) {
+			LogWarn("invalid lifetime.");
+			d->send_message( msg->create_response(
+								 information_code::sc_permanent_failure, 
+								 information_code::fail_configuration_failed) );
+			return STATE_METERING; // no change
+		}
+
+		// Build the requested rule next to the installed one.
+		mt_policy_rule *installed = rule;
+		std::vector<msg::mnslp_mspec_object *> missing_objects;
+		rule = new mt_policy_rule();
+
+		try {
+			set_mt_policy_rule(d, e, missing_objects);
+		}
+		catch ( policy_rule_installer_error &exc ) {
+			LogError("policy rule not supported: " << exc);
+			for ( size_t i = 0; i < missing_objects.size(); i++ )
+				delete missing_objects[i];
+			delete rule;
+			rule = installed;
+			d->send_message( msg->create_error_response(exc) );
+			return STATE_METERING; // no change
+		}
+
+		if ( requested_rule != NULL )
+			delete requested_rule;	// replaced by a newer CONFIGURE
+		requested_rule = rule;
+		rule = installed;
+
+		set_lifetime(lifetime);
+		set_msg_sequence_number(msn);
+		set_upstream_peer(e->get_sii_handle());
+
+		// store one copy for further reference and pass one on
+		set_last_configure_message( msg->copy() );
+
+		d->send_message( build_configure_message(e, missing_objects) );
+
+		for ( size_t i = 0; i < missing_objects.size(); i++ )
+			delete missing_objects[i];
+
+		response_timer.start(d, get_response_timeout());
+
+		return STATE_METERING; // no change
+	}
+
+	/*
+	 * The downstream peer answered our last CONFIGURE. Only the objects
+	 * that changed are installed or removed, the session keeps metering
+	 * with what is installed if anything goes wrong.
+	 */
+	else if ( requested_rule != NULL 
+				&& is_mnslp_response(evt, get_last_configure_message()) ) 
+	{
+		msg_event *e = dynamic_cast<msg_event *>(evt);
+		ntlp_msg *msg = e->get_ntlp_msg();
+		mnslp_response *resp = e->get_response();
+
+		mnslp_configure *c = get_last_configure_message()->get_mnslp_configure();
+		if ( ! resp->is_response_to(c) ) {
+			LogWarn("RESPONSE doesn't match CONFIGURE, discarding");
+			return STATE_METERING; // no change
+		}
+
+		response_timer.stop();
+		set_downstream_peer(e->get_sii_handle());
+
+		mt_policy_rule *requested = requested_rule;
+		requested_rule = NULL;
+
+		if ( ! resp->is_success() ) {
+			LogWarn("reconfiguration rejected downstream.");
+			delete requested;
+			d->send_message( create_msg_for_ni(msg) );
+			return STATE_METERING; // no change
+		}
+
+		mt_policy_rule *result = d->update_policy_rules(rule, requested);
+		bool complete = ( result->get_number_mspec_objects() == 
+						  requested->get_number_mspec_objects() );
+		delete requested;
+		delete rule;
+		rule = result;
+
+		if ( complete ) {
+			LogDebug("forwarder session reconfigured.");
+			d->send_message( create_msg_for_ni(msg) );
+			state_timer.restart(d, get_lifetime());
+		}
+		else {
+			d->send_message( msg->create_response(
+							 information_code::sc_permanent_failure, 
+							 information_code::fail_internal_error) );
+		}
+		return STATE_METERING; // no change
+	}
+
+	/*
+	 * The downstream peer didn't answer our last CONFIGURE. The installed
+	 * rule stays as it is.
+	 */
+	else if ( requested_rule != NULL && is_timer(evt, response_timer) ) 
+	{
+		LogWarn("downstream peer did not answer the reconfiguration");
+
+		delete requested_rule;
+		requested_rule = NULL;
+
+		d->send_message( get_last_configure_message()->create_response(
+			information_code::sc_permanent_failure,
+			information_code::fail_nr_not_reached) );
+
+		return STATE_METERING; // no change
+	}
+
 	/*
 	 * A msg_event arrived which contains a MNSLP REFRESH message.
 	 */
-	if ( is_mnslp_refresh(evt) ) 
+	else if ( is_mnslp_refresh(evt) ) 
 	{
 				
 		msg_event *e = dynamic_cast<msg_event *>(evt);
@@ -646,6 +809,7 @@ nf_session::state_t nf_session::handle_state_metering(
 			response_timer.stop();
 
 			set_msg_sequence_number(msn);
+			set_upstream_peer(e->get_sii_handle());
 
 			// store one copy for further reference and pass one on
 			set_last_refresh_message( msg->copy() );
@@ -674,6 +838,90 @@ nf_session::state_t nf_session::handle_state_metering(
 		}
 	}
 	
+	/*
+	 * Our session was listed in a bundled REFRESH from the upstream peer.
+	 *
+	 * The refresh is passed on without waiting for the downstream peer:
+	 * in a bundle of its own if the downstream peer supports it,
+	 * individually otherwise. The NI's MSN is kept in both cases.
+	 */
+	else if ( is_bundled_refresh(evt) ) 
+	{
+		bundled_refresh_event *e = dynamic_cast<bundled_refresh_event *>(evt);
+
+		uint32 lifetime = e->get_session_lifetime();
+		uint32 msn = e->get_msg_sequence_number();
+
+		// An entry can't be checked if we don't know the upstream peer.
+		if ( get_upstream_peer() == 0
+				|| e->get_sii_handle() != get_upstream_peer() ) {
+			LogWarn("bundled refresh from unknown peer.");
+			return STATE_METERING; // no change
+		}
+
+		if ( ! is_greater_than(msn, get_msg_sequence_number()) ) {
+			LogWarn("discarding duplicate bundled refresh.");
+			e->set_accepted(); // nothing to report
+			return STATE_METERING; // no change
+		}
+
+		if ( lifetime == 0 ) {
+			LogWarn("invalid lifetime.");
+			return STATE_METERING; // no change
+		}
+
+		if ( lifetime > get_max_lifetime() )
+			lifetime = get_max_lifetime();
+
+		set_lifetime(lifetime);
+		set_msg_sequence_number(msn);
+
+		mnslp_refresh *refresh = new mnslp_refresh();
+		refresh->set_session_lifetime(lifetime);
+		refresh->set_msg_sequence_number(msn);
+
+		ntlp_msg *msg = new ntlp_msg(get_id(), refresh, get_nr_mri()->copy(), 0);
+
+		// store one copy for further reference and pass one on
+		set_last_refresh_message( msg->copy() );
+
+		response_timer.stop();
+		state_timer.restart(d, lifetime);
+
+		if ( ! d->bundle_refresh(msg, get_downstream_peer()) ) {
+			d->send_message( msg );
+			response_timer.start(d, get_response_timeout());
+		}
+
+		e->set_accepted();
+
+		return STATE_METERING; // no change
+	}
+
+	/*
+	 * The downstream peer didn't accept our last bundled refresh.
+	 */
+	else if ( is_bundled_refresh_rejected(evt) ) 
+	{
+		bundled_refresh_event *e = dynamic_cast<bundled_refresh_event *>(evt);
+
+		if ( e->get_msg_sequence_number() != get_msg_sequence_number() ) {
+			LogWarn("rejected refresh is outdated, discarding");
+			return STATE_METERING; // no change
+		}
+
+		LogWarn("downstream peer rejected bundled refresh");
+
+		response_timer.stop();
+		state_timer.stop();
+
+		// Uninstall the previous rules.
+		if (rule->get_number_rule_keys() > 0)
+			d->remove_policy_rules(rule);
+
+		return STATE_CLOSE;
+	}
+	
 	/*
 	 * Downstream peer didn't respond.
 	 * 
@@ -690,7 +938,7 @@ nf_session::state_t nf_session::handle_state_metering(
 		
 		// Uninstall the previous rules.
 		if (rule->get_number_rule_keys() > 0)
-			d->remove_policy_rules(rule);
+			d->teardown_policy_rules(rule);
 
 		// TODO: check the spec!
 		ntlp_msg *response = get_last_refresh_message()->create_response(
@@ -712,7 +960,7 @@ nf_session::state_t nf_session::handle_state_metering(
 
 		// Uninstall the previous rules.
 		if (rule->get_number_rule_keys() > 0)
-			d->remove_policy_rules(rule);
+			d->teardown_policy_rules(rule);
 
 		// TODO: ReportAsyncEvent()
 
@@ -727,7 +975,7 @@ nf_session::state_t nf_session::handle_state_metering(
 
 		// Uninstall the previous rules.
 		if (rule->get_number_rule_keys() > 0)
-			d->remove_policy_rules(rule);
+			d->teardown_policy_rules(rule);
 
 		return STATE_CLOSE;
 	}	
@@ -750,6 +998,8 @@ nf_session::state_t nf_session::handle_state_metering(
 		}
 
 		
+		set_downstream_peer(e->get_sii_handle());
+
 		if ( response->is_success() ) {
 			
 			LogDebug("upstream peer sent successful response.");
@@ -828,6 +1078,81 @@ void nf_session::process_event(dispatcher *d, event *evt) {
 	LogDebug("end process_event(): " << *this);
 }
 
+
+/**
+ * Save the session if it is metering.
+ *
+ * Sessions waiting for a response are not saved, their peers will time
+ * out and retry.
+ */
+bool nf_session::save(session_snapshot &snap) const
+{
+	session::save(snap);
+
+	if ( state != STATE_METERING || state_timer.get_expiry() == 0 )
+		return false;
+
+	snap.state = state;
+	snap.lifetime = lifetime;
+	snap.expires = state_timer.get_expiry();
+	snap.ni_mri = ( ni_mri != NULL ) ? ni_mri->copy() : NULL;
+	snap.nr_mri = ( nr_mri != NULL ) ? nr_mri->copy() : NULL;
+	snap.rule = ( rule != NULL ) ? rule->copy() : NULL;
+
+	return true;
+}
+
+
+/**
+ * Resume metering after a restart.
+ *
+ * The session waits for the next REFRESH from the NI, there is no last
+ * CONFIGURE or REFRESH message to answer timeouts with.
+ */
+void nf_session::restore(dispatcher *d, session_snapshot &snap)
+{
+	session::restore(d, snap);
+
+	state = STATE_METERING;
+	lifetime = snap.lifetime;
+
+	set_max_lifetime(config->get_nf_max_session_lifetime());
+	set_response_timeout(config->get_nf_max_session_lifetime());
+
+	set_ni_mri(snap.ni_mri);
+	snap.ni_mri = NULL;
+	set_nr_mri(snap.nr_mri);
+	snap.nr_mri = NULL;
+
+	time_t now = time(NULL);
+	int left = ( (time_t) snap.expires > now ) ? snap.expires - now : 1;
+
+	state_timer.start(d, left);
+
+	LogInfo("restored " << *this << ", " << left << "s left");
+}
+
+
+void nf_session::count_memory(session_memory_usage &usage) const
+{
+	session::count_memory(usage);
+
+	if ( ni_mri != NULL )
+		usage.mri_bytes += ni_mri->get_serialized_size(protlib::IE::protocol_v1);
+
+	if ( nr_mri != NULL )
+		usage.mri_bytes += nr_mri->get_serialized_size(protlib::IE::protocol_v1);
+
+	if ( configure_message != NULL )
+		usage.message_bytes += configure_message->get_memory_usage();
+
+	if ( refresh_message != NULL )
+		usage.message_bytes += refresh_message->get_memory_usage();
+
+	if ( requested_rule != NULL )
+		usage.rule_bytes += requested_rule->get_memory_usage();
+}
+
 /**
  * Create a new MRI but with a rewritten destination.
  * TODO AM: check how it works with NAT operation.
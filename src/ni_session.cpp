@@ -31,11 +31,13 @@
 #include <openssl/rand.h>
 
 #include "logfile.h"
+#include "mnslp_log.h"
 
 #include "mnslp_config.h"
 #include "events.h"
 #include "msg/mnslp_msg.h"
 #include "dispatcher.h"
+#include "refresh_scheduler.h"
 #include "ni_session.h"
 #include <iostream>
 
@@ -46,10 +48,12 @@ using protlib::uint32;
 
 
 #define LogWarn(msg) Log(WARNING_LOG, LOG_NORMAL, "ni_session", msg)
-#define LogInfo(msg) Log(INFO_LOG, LOG_NORMAL, "ni_session", msg)
-#define LogDebug(msg) Log(DEBUG_LOG, LOG_NORMAL, "ni_session", msg)
+#define LogInfo(msg) MNSLP_LOG_INFO("ni_session", msg)
+#define LogDebug(msg) MNSLP_LOG_DEBUG("ni_session", msg)
 
 
+session_slab ni_session::slab(sizeof(ni_session));
+
 
 /**
  * Constructor.
@@ -57,11 +61,12 @@ using protlib::uint32;
  * Use this if the session ID is known in advance.
  */
 ni_session::ni_session(const session_id &id, const mnslp_config *conf)
-		: session(id), state(STATE_CLOSE), routing_info(NULL),
-		  last_configure_msg(NULL), last_refresh_msg(NULL), lifetime(0),
+		: session(id), state(STATE_CLOSE), lifetime(0),
 		  refresh_interval(20), response_timeout(0), configure_counter(0),
-		  refresh_counter(0), max_retries(0), proxy_session(false),
-		  response_timer(this), refresh_timer(this) {
+		  refresh_counter(0), max_retries(0), proxy_mode(false),
+		  proxy_session(false), response_timer(this), refresh_timer(this),
+		  routing_info(NULL), last_configure_msg(NULL),
+		  last_refresh_msg(NULL) {
 
 	set_session_type(st_initiator);
 	set_msg_sequence_number(create_random_number());
@@ -80,11 +85,12 @@ ni_session::ni_session(const session_id &id, const mnslp_config *conf)
  * @param s the state to start in
  */
 ni_session::ni_session(state_t s)
-		: session(), state(s), routing_info(NULL),
-		  last_configure_msg(NULL), last_refresh_msg(NULL), lifetime(30),
+		: session(), state(s), lifetime(30),
 		  refresh_interval(20), response_timeout(2), configure_counter(0),
-		  refresh_counter(0), max_retries(3), proxy_session(false),
-		  response_timer(this), refresh_timer(this) {
+		  refresh_counter(0), max_retries(3), proxy_mode(false),
+		  proxy_session(false), response_timer(this), refresh_timer(this),
+		  routing_info(NULL), last_configure_msg(NULL),
+		  last_refresh_msg(NULL) {
 
 	set_session_type(st_initiator);
 	set_msg_sequence_number(create_random_number());
@@ -100,6 +106,7 @@ ni_session::ni_session(state_t s)
 ni_session::~ni_session() {
 	delete routing_info;
 	delete last_configure_msg;
+	delete last_refresh_msg;
 }
 
 
@@ -116,6 +123,20 @@ uint32 ni_session::create_random_number() const
 }
 
 
+/**
+ * Derive the refresh interval from the session lifetime.
+ *
+ * Refreshes are jittered up to 1.5 times the interval, so the interval is
+ * chosen such that the last retry of a late refresh still arrives within
+ * the lifetime.
+ */
+void ni_session::cal_refresh_interval() 
+{
+	set_refresh_interval( (uint32) ceil(
+		get_lifetime() / ( (get_max_retries()+0.5) * 1.5 ) ) );
+}
+
+
 std::ostream &mnslp::operator<<(std::ostream &out, const ni_session &s) 
 {
 	static const char *const names[] = { "CLOSE", "PENDING", "METERING" };
@@ -176,6 +197,8 @@ msg::ntlp_msg *ni_session::build_configure_message(api_configure_event *e,
  * Build a MNSLP Refresh message based on the session's state.
  *
  * This will fetch the session lifetime and also increment the MSN.
+ * Later refreshes are derived from the previous one, which saves
+ * serializing them again.
  */
 msg::ntlp_msg *ni_session::build_refresh_message() 
 {
@@ -183,6 +206,11 @@ msg::ntlp_msg *ni_session::build_refresh_message()
 
 	assert( get_mri() != NULL );
 
+	if ( get_last_refresh_message() != NULL )
+		return get_last_refresh_message()->copy_for_refresh(
+			next_msg_sequence_number(), get_lifetime(),
+			get_mri()->copy(), 0);
+
 	/*
 	 * Build a MNSLP Configure message.
 	 */
@@ -230,13 +258,13 @@ ni_session::setup_session(dispatcher *d,
 	if ( e->get_session_lifetime() != 0 )
 		set_lifetime(e->get_session_lifetime());
 
-	uint32 r = (uint32) ceil(
-		get_lifetime() / ( (get_max_retries()+0.5) * 1.5 ) );
-	assert( r > 0 );
+	cal_refresh_interval();
 
-	set_refresh_interval(r); 
+	uint32 r = get_refresh_interval();
+	assert( r > 0 );
 
-	uint32 t = (int) ceil( ( ( (rand() % 1000) / 1000.0) + 0.5 ) * r );
+	uint32 t = (int) ceil(
+		( ( (refresh_scheduler::random() % 1000) / 1000.0) + 0.5 ) * r );
 
 	set_response_timeout( t );
 
@@ -410,6 +438,8 @@ ni_session::state_t ni_session::handle_state_pending(
 			return STATE_PENDING; // no change
 		}
 
+		set_downstream_peer(e->get_sii_handle());
+
 		if ( resp->is_success() ) {
 			
 			LogDebug("initiated session " << get_id());
@@ -423,7 +453,7 @@ ni_session::state_t ni_session::handle_state_pending(
 				cal_refresh_interval();
 			}
 			
-			refresh_timer.start(d, get_refresh_interval());
+			refresh_timer.start(d, d->next_refresh(get_refresh_interval()));
 	
 			mt_policy_rule * result = d->install_policy_rules(rule);
 			
@@ -491,12 +521,23 @@ ni_session::state_t ni_session::handle_state_metering(
 		// Build a new REFRESH message, it stores a copy for refreshing.
 		set_last_refresh_message( build_refresh_message() );
 
-		// dispatcher will delete
-		d->send_message( get_last_refresh_message()->copy() );
-
         // Set the refresh counter to zero
         set_refresh_counter(0);
 
+		/*
+		 * Bundled refreshes are not answered individually. The peer only
+		 * reports the sessions it doesn't know, so we just keep refreshing.
+		 */
+		ntlp_msg *msg = get_last_refresh_message()->copy();
+
+		if ( d->bundle_refresh(msg, get_downstream_peer()) ) {
+			refresh_timer.start(d, d->next_refresh(get_refresh_interval()));
+			return STATE_METERING; // no change
+		}
+
+		// dispatcher will delete
+		d->send_message( msg );
+
 		response_timer.start(d, get_response_timeout());
 
 		return STATE_METERING; // no change
@@ -523,7 +564,7 @@ ni_session::state_t ni_session::handle_state_metering(
 		else {
 			// Uninstall the previous rules.
 			if (rule->get_number_rule_keys() > 0)
-				d->remove_policy_rules(rule);
+				d->teardown_policy_rules(rule);
 			
 			LogDebug("no response to our REFRESH message");
 			d->report_async_event("got no response to our REFRESH message");
@@ -548,6 +589,26 @@ ni_session::state_t ni_session::handle_state_metering(
 		LogDebug("Ending state metering - api teardown");
 		return STATE_CLOSE;
 	}
+	/*
+	 * The peer didn't accept our last bundled refresh.
+	 */
+	else if ( is_bundled_refresh_rejected(evt) ) {
+		bundled_refresh_event *e = dynamic_cast<bundled_refresh_event *>(evt);
+
+		if ( last_refresh_msg == NULL || e->get_msg_sequence_number()
+				!= last_refresh_msg->get_mnslp_refresh()
+					->get_msg_sequence_number() ) {
+			LogWarn("rejected refresh is outdated, discarding");
+			return STATE_METERING; // no change
+		}
+
+		// Uninstall the previous rules.
+		if (rule->get_number_rule_keys() > 0)
+			d->remove_policy_rules(rule);
+
+		d->report_async_event("REFRESH session died");
+		return STATE_CLOSE;
+	}
 	/*
 	 * Outdated timer event, discard and don't log.
 	 */
@@ -572,11 +633,13 @@ ni_session::state_t ni_session::handle_state_metering(
 			return STATE_METERING; // no change
 		}
 
+		set_downstream_peer(e->get_sii_handle());
+
 		if ( resp->is_success() ) {
 			d->report_async_event("REFRESH successful");
 
 			response_timer.stop();
-			refresh_timer.start(d, get_refresh_interval());
+			refresh_timer.start(d, d->next_refresh(get_refresh_interval()));
 
 			set_refresh_counter(0);
 
@@ -610,7 +673,8 @@ ni_session::state_t ni_session::handle_state_metering(
  */
 void ni_session::process_event(dispatcher *d, event *evt) {
 	
-	std::cout << "begin process_event(): " << std::endl;
+	MNSLP_TRACE(msg::trace::tc_session, msg::trace::ev_session_process_event,
+				get_state(), 0, 0);
 	LogDebug("begin process_event(): " << *this);
 		
 	switch ( get_state() ) {
@@ -634,4 +698,19 @@ void ni_session::process_event(dispatcher *d, event *evt) {
 	LogDebug("end process_event(): " << *this);
 }
 
+
+void ni_session::count_memory(session_memory_usage &usage) const {
+	session::count_memory(usage);
+
+	if ( routing_info != NULL )
+		usage.mri_bytes += routing_info->get_serialized_size(
+			protlib::IE::protocol_v1);
+
+	if ( last_configure_msg != NULL )
+		usage.message_bytes += last_configure_msg->get_memory_usage();
+
+	if ( last_refresh_msg != NULL )
+		usage.message_bytes += last_refresh_msg->get_memory_usage();
+}
+
 // EOF
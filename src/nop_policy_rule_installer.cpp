@@ -73,7 +73,6 @@ nop_policy_rule_installer::setup() throw (policy_rule_installer_error)
 
 	policy_rule_installer::setup();
 	
-	std::cout << "NOP:Setup()" << std::endl;
 	LogDebug("NOP: setup()");
 
 }
@@ -84,7 +83,6 @@ nop_policy_rule_installer::check(const msg::mnslp_mspec_object *object)
 		throw (policy_rule_installer_error) 
 {
 
-	std::cout << "NOP:Check()" << std::endl;
 	LogDebug("NOP: check()");
 }
 
@@ -93,7 +91,6 @@ mt_policy_rule *
 nop_policy_rule_installer::install(const mt_policy_rule *mt_rule) 
 {
 
-	std::cout << "NOP: installing policy rule" << std::endl;
 	LogDebug("NOP: installing policy rule " << *mt_rule);
 	mt_policy_rule *rule_return;
 	
@@ -119,7 +116,6 @@ nop_policy_rule_installer::install(const mt_policy_rule *mt_rule)
 mt_policy_rule * nop_policy_rule_installer::remove(const mt_policy_rule *mt_rule) 
 {
 
-	std::cout << "NOP: removing policy rule" << std::endl;
 	LogDebug("NOP: removing policy rule " << *mt_rule);
 	mt_policy_rule *rule_return;
 	
@@ -136,7 +132,6 @@ mt_policy_rule * nop_policy_rule_installer::remove(const mt_policy_rule *mt_rule
 bool nop_policy_rule_installer::remove_all() 
 {
 
-	std::cout << "NOP: removing all metering policy rules" << std::endl;
 	LogDebug("NOP: removing all metering policy rules ");
 	return true;
 }
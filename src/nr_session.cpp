@@ -27,8 +27,10 @@
 //
 // ===========================================================
 #include <openssl/rand.h>
+#include <time.h>
 
 #include "logfile.h"
+#include "mnslp_log.h"
 
 #include "mri.h"	// from NTLP
 
@@ -46,8 +48,11 @@ using protlib::uint32;
 
 #define LogError(msg) ERRLog("nr_session", msg)
 #define LogWarn(msg) WLog("nr_session", msg)
-#define LogInfo(msg) ILog("nr_session", msg)
-#define LogDebug(msg) DLog("nr_session", msg)
+#define LogInfo(msg) MNSLP_LOG_INFO("nr_session", msg)
+#define LogDebug(msg) MNSLP_LOG_DEBUG("nr_session", msg)
+
+
+session_slab nr_session::slab(sizeof(nr_session));
 
 
 /**
@@ -56,8 +61,8 @@ using protlib::uint32;
  * Use this if the session ID is known in advance.
  */
 nr_session::nr_session(const session_id &id, mnslp_config *conf)
-		: session(id), state(STATE_CLOSE), config(conf),
-		  lifetime(0), max_lifetime(0), state_timer(this) 
+		: session(id), state(STATE_CLOSE), lifetime(0),
+		  max_lifetime(0), state_timer(this), config(conf) 
 {
 
 	set_session_type(st_receiver);
@@ -74,8 +79,8 @@ nr_session::nr_session(const session_id &id, mnslp_config *conf)
  * @param msn the initial message sequence number
  */
 nr_session::nr_session(nr_session::state_t s, uint32 msn)
-		: session(), state(s), config(NULL),
-		  lifetime(0), max_lifetime(60), state_timer(this) 
+		: session(), state(s), lifetime(0),
+		  max_lifetime(60), state_timer(this), config(NULL) 
 {
 	set_session_type(st_receiver);
 	set_msg_sequence_number(msn);
@@ -241,6 +246,7 @@ nr_session::handle_state_close(dispatcher *d, event *evt)
 					delete(rule);
 					// Assign the response as the rule installed.
 					rule = result;
+					set_upstream_peer(e->get_sii_handle());
 					ntlp_msg *resp = msg->create_success_response(lifetime);
 					d->send_message(resp);
 					state_timer.start(d, lifetime);
@@ -286,10 +292,104 @@ nr_session::state_t nr_session::handle_state_metering(
 {
 	LogDebug("Starting handle_state_metering ");
 
+	/*
+	 * A msg_event arrived which contains a MNSLP CONFIGURE message that
+	 * changes what this session meters.
+	 */
+	if ( is_mnslp_configure(evt) ) 
+	{
+		msg_event *e = dynamic_cast<msg_event *>(evt);
+		ntlp_msg *msg = e->get_ntlp_msg();
+		mnslp_configure *c = e->get_configure();
+
+		uint32 lifetime = c->get_session_lifetime();
+		uint32 msn = c->get_msg_sequence_number();
+	
+		// Before proceeding check several preconditions.
+		try {
+			check_lifetime(lifetime, get_max_lifetime());
+			check_authorization(d, e);
+		}
+		catch ( override_lifetime &exp) {
+			lifetime = get_max_lifetime();
+		}
+		catch ( request_error &exp ) {
+			LogError(exp);
+			d->send_message( msg->create_error_response(exp) );
+			return STATE_METERING;
+		}
+
+		if ( ! is_greater_than(msn, get_msg_sequence_number()) ) {
+			LogWarn("duplicate configure received.");
+			return STATE_METERING; // no change
+		}
+		else if ( lifetime == 0 ) {
+			LogWarn("invalid lifetime.");
+			d->send_message( msg->create_response(
+								 information_code::sc_permanent_failure, 
+								 information_code::fail_configuration_failed) );
+			return STATE_METERING; // no change
+		}
+
+		// Build the requested rule next to the installed one.
+		mt_policy_rule *installed = rule;
+		std::vector<msg::mnslp_mspec_object *> missing_objects;
+		rule = new mt_policy_rule();
+		
+		try {
+			save_mt_policy_rule(d, e, missing_objects);
+		}
+		catch ( request_error &exp ) {
+			LogError(exp);
+			delete rule;
+			rule = installed;
+			d->send_message( msg->create_error_response(exp) );
+			return STATE_METERING;
+		}
+		
+		mt_policy_rule *requested = rule;
+		rule = installed;
+		
+		if (missing_objects.size() > 0){
+			// The installed rule stays as it is.
+			for ( size_t i = 0; i < missing_objects.size(); i++ )
+				delete missing_objects[i];
+			delete requested;
+			
+			d->send_message( msg->create_response(
+							 information_code::sc_permanent_failure, 
+							 information_code::fail_internal_error) );
+			return STATE_METERING;
+		}
+		
+		// Only the objects that changed are installed or removed.
+		mt_policy_rule *result = d->update_policy_rules(installed, requested);
+		bool complete = ( result->get_number_mspec_objects() == 
+						  requested->get_number_mspec_objects() );
+		delete requested;
+		delete installed;
+		rule = result;
+		
+		if ( complete ) {
+			LogDebug("responder session reconfigured.");
+			set_lifetime(lifetime);
+			set_msg_sequence_number(msn);
+			
+			d->send_message( msg->create_success_response(lifetime) );
+			state_timer.restart(d, lifetime);
+		}
+		else {
+			d->send_message( msg->create_response(
+							 information_code::sc_permanent_failure, 
+							 information_code::fail_internal_error) );
+		}
+		return STATE_METERING;
+	}
+
 	/*
 	 * A msg_event arrived which contains a MNSLP REFRESH message.
 	 */
-	if ( is_mnslp_refresh(evt) ) 
+	else if ( is_mnslp_refresh(evt) ) 
 	{
 		msg_event *e = dynamic_cast<msg_event *>(evt);
 		ntlp_msg *msg = e->get_ntlp_msg();
@@ -321,6 +421,7 @@ nr_session::state_t nr_session::handle_state_metering(
 
 			set_lifetime(lifetime); // could be a new lifetime!
 			set_msg_sequence_number(msn);
+			set_upstream_peer(e->get_sii_handle());
 
 			ntlp_msg *resp = msg->create_success_response(lifetime);
 
@@ -353,6 +454,46 @@ nr_session::state_t nr_session::handle_state_metering(
 			return STATE_METERING; // no change
 		}
 	}
+	/*
+	 * Our session was listed in a bundled REFRESH. There is no RESPONSE,
+	 * the dispatcher reports the entries we don't accept to the sender.
+	 */
+	else if ( is_bundled_refresh(evt) )
+	{
+		bundled_refresh_event *e = dynamic_cast<bundled_refresh_event *>(evt);
+
+		uint32 lifetime = e->get_session_lifetime();
+		uint32 msn = e->get_msg_sequence_number();
+
+		// Only the node that refreshed us individually may bundle.
+		if ( get_upstream_peer() == 0
+				|| e->get_sii_handle() != get_upstream_peer() ) {
+			LogWarn("bundled refresh from unknown peer.");
+			return STATE_METERING; // no change
+		}
+
+		if ( ! is_greater_than(msn, get_msg_sequence_number()) ) {
+			LogWarn("duplicate bundled refresh received.");
+			e->set_accepted(); // nothing to report
+			return STATE_METERING; // no change
+		}
+
+		if ( lifetime == 0 ) {
+			LogWarn("invalid lifetime.");
+			return STATE_METERING; // no change
+		}
+
+		if ( lifetime > get_max_lifetime() )
+			lifetime = get_max_lifetime();
+
+		set_lifetime(lifetime);
+		set_msg_sequence_number(msn);
+
+		state_timer.restart(d, lifetime);
+		e->set_accepted();
+
+		return STATE_METERING; // no change
+	}
 	/*
 	 * The session timeout was triggered.
 	 */
@@ -360,7 +501,7 @@ nr_session::state_t nr_session::handle_state_metering(
 		LogWarn("session timed out.");
 		// Uninstall the previous rules.
 		if (rule->get_number_rule_keys() > 0)
-			d->remove_policy_rules(rule);
+			d->teardown_policy_rules(rule);
 
 		d->report_async_event("session timed out");
 		return STATE_CLOSE;
@@ -408,4 +549,46 @@ void nr_session::process_event(dispatcher *d, event *evt)
 	LogDebug("end process_event(): " << *this);
 }
 
+
+/**
+ * Save the session if it is metering.
+ *
+ * Sessions that are not metering have no state worth saving.
+ */
+bool nr_session::save(session_snapshot &snap) const
+{
+	session::save(snap);
+
+	if ( state != STATE_METERING || state_timer.get_expiry() == 0 )
+		return false;
+
+	snap.state = state;
+	snap.lifetime = lifetime;
+	snap.expires = state_timer.get_expiry();
+	snap.rule = ( rule != NULL ) ? rule->copy() : NULL;
+
+	return true;
+}
+
+
+/**
+ * Resume metering after a restart.
+ *
+ * The session waits for the next REFRESH from the NI.
+ */
+void nr_session::restore(dispatcher *d, session_snapshot &snap)
+{
+	session::restore(d, snap);
+
+	state = STATE_METERING;
+	lifetime = snap.lifetime;
+
+	time_t now = time(NULL);
+	int left = ( (time_t) snap.expires > now ) ? snap.expires - now : 1;
+
+	state_timer.start(d, left);
+
+	LogInfo("restored " << *this << ", " << left << "s left");
+}
+
 // EOF
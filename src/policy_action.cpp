@@ -34,6 +34,7 @@
 
 #include "policy_action.h"
 #include "msg/information_code.h"
+#include "msg/mnslp_trace.h"
 #include "policy_rule_installer.h"
 
 
@@ -163,7 +164,8 @@ int policy_action::read_from_xml(xmlTextReaderPtr reader)
 	}
 	else
 	{
-		std::cout << "level found: " << xmlTextReaderDepth(reader) << std::endl;
+		MNSLP_TRACE(msg::trace::tc_config, msg::trace::ev_config_parse_error, 
+					xmlTextReaderDepth(reader), 0, 0);
 		throw policy_rule_installer_error("Export configuration file does not parse",
 			msg::information_code::sc_permanent_failure,
 			msg::information_code::fail_configuration_failed);		
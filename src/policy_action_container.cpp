@@ -218,7 +218,6 @@ policy_action_container::to_string()
 {
     std::string val_return;
 	for ( const_iterator i = actions.begin(); i != actions.end(); i++ ) {
-		std::cout << i->first << std::endl;
 		val_return.append("\n");
 		val_return.append(i->first);
 		val_return.append(":");
@@ -195,14 +195,10 @@ policy_application_configuration_container::is_export_field(std::string app,
 						msg::mnslp_field &field) const
 {
 
-	std::cout << "in is_export_field" << app << std::endl;
 	bool val_return = false;
 	// Look for the application and then the field on those mapping.
-	std::cout << "number of applications:" << applications.size() << std::endl;
 	for ( const_iterator i = applications.begin(); i != applications.end(); i++ ) {
-		std::cout << "app:" << i->first << std::endl;
 		if ( app.compare(i->first) == 0 ){
-			std::cout << "we found the application for ask for export field" << std::endl;
 			return (i->second).is_export_field(field);
 		}
 	}	
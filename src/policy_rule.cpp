@@ -54,7 +54,6 @@ mt_policy_rule::~mt_policy_rule()
 	for ( it = objects.begin(); it != objects.end(); it++)
 	{
 		delete(it->second);
-		objects.erase(it);
 	}
 }
 
@@ -227,6 +226,37 @@ size_t mt_policy_rule::get_number_rule_keys() const
 }
 
 
+/**
+ * Estimate the memory held by this rule.
+ *
+ * The MSPEC objects are estimated by their serialized size.
+ */
+size_t mt_policy_rule::get_memory_usage() const
+{
+	// A map node has a colour, three links and the value.
+	const size_t node = 4 * sizeof(void *);
+	size_t bytes = sizeof(mt_policy_rule);
+
+	for ( const_iterator i = objects.begin(); i != objects.end(); i++ ) {
+		bytes += node + sizeof(*i);
+
+		if ( i->second != NULL )
+			bytes += i->second->get_serialized_size(protlib::IE::protocol_v1);
+	}
+
+	for ( const_iterator_commands i = rule_keys.begin(); 
+			i != rule_keys.end(); i++ ) {
+		bytes += node + sizeof(*i);
+		bytes += i->second.capacity() * sizeof(std::string);
+
+		for ( size_t j = 0; j < i->second.size(); j++ )
+			bytes += i->second[j].capacity();
+	}
+
+	return bytes;
+}
+
+
 }
 
 // EOF
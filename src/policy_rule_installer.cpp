@@ -28,15 +28,48 @@
 // ===========================================================
 
 #include <libxml/xmlreader.h>
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <set>
 
+#include "logfile.h"
 #include "policy_rule_installer.h"
 #include "msg/information_code.h"
+#include "msg/mnslp_trace.h"
+#include "mnslp_log.h"
+
+
+using namespace protlib::log;
+
+
+#define LogError(msg) Log(ERROR_LOG, LOG_NORMAL, \
+	"policy_rule_installer", msg)
 
 
 namespace mnslp {
 
+const size_t policy_rule_installer::TEARDOWN_BATCH_SIZE;
+
+policy_rule_installer::policy_rule_installer(mnslp_config *conf) throw () : 
+		config(conf), collector(NULL), action_container(NULL), app_container(NULL),
+		teardown_running(false), teardown_pending(0)
+{
+	pthread_mutex_init(&teardown_mutex, NULL);
+	pthread_cond_init(&teardown_cond, NULL);
+}
+
 policy_rule_installer::~policy_rule_installer() throw()
 {
+	assert( ! teardown_running );
+	
+	// Not removed, stop_teardown() was not called.
+	for ( size_t i = 0; i < teardown_queue.size(); i++ )
+		delete teardown_queue[i];
+	
+	pthread_cond_destroy(&teardown_cond);
+	pthread_mutex_destroy(&teardown_mutex);
+	
 	if (action_container != NULL)
 		delete action_container;
 	
@@ -55,16 +88,19 @@ policy_rule_installer::setup() throw (policy_rule_installer_error)
 			// Parse and load the filter configuration.
 			parse_configuration_definition_file(config->get_configuration_file().c_str());
 			
-			std::cout << "Finish loading configuration file" << std::endl;
+			MNSLP_TRACE(msg::trace::tc_config, msg::trace::ev_config_loaded, 0, 0, 0);
 			
 			// Parse and load the export configuration.
 			parse_export_definition_file(config->get_export_config_file().c_str());
 			
-			std::cout << "Finish loading export configuration file" << std::endl;
+			MNSLP_TRACE(msg::trace::tc_config, msg::trace::ev_config_loaded, 1, 
+						std::distance(app_container->begin(), 
+									  app_container->end()), 0);
 		}
 		catch(policy_rule_installer_error &e)
 		{
-			std::cout << "Node cannot be configured as metering" << std::endl;
+			MNSLP_LOG(MNSLP_LOG_LEVEL_WARN, "policy_rule_installer",
+					  "node cannot be configured as metering");
 			config->setpar(mnslpconf_ms_is_meter, false);
 		}
 			
@@ -127,11 +163,6 @@ void policy_rule_installer::parse_configuration_definition_file(const char *file
     if (reader != NULL){
 		app_container = new policy_application_configuration_container();
 		app_container->read_from_xml(reader);
-		
-		policy_application_configuration_container::const_iterator it;
-		for (it = app_container->begin(); it != app_container->end(); it++)
-			std::cout << "number of applications:" << std::endl;
-		 
 	}
 	else{
 		throw policy_rule_installer_error("Export configuration file does not open",
@@ -163,6 +194,258 @@ policy_rule_installer::get_application_configuration_container() const
 			msg::information_code::fail_configuration_failed);
 }
 
+namespace {
+
+/*
+ * Whether two metering objects have the same content. The fingerprints
+ * tell most of the different objects apart without a full comparison.
+ */
+bool same_content(const msg::mnslp_mspec_object *a, 
+				  const msg::mnslp_mspec_object *b)
+{
+	try
+	{
+		return ( a->get_fingerprint() == b->get_fingerprint() ) 
+				&& a->isEqual(*b);
+	}
+	catch (IEError &e)
+	{
+		return false;
+	}
+}
+
+/*
+ * Find an installed object, not matched yet, with the content of object. 
+ * The object installed under the same key is tried first.
+ */
+mt_policy_rule::const_iterator 
+find_unchanged(const mt_policy_rule *installed, const mspec_rule_key &key,
+			   const msg::mnslp_mspec_object *object,
+			   const std::set<mspec_rule_key> &matched)
+{
+	mt_policy_rule::const_iterator it = installed->find(key);
+	if ( ( it != installed->end() ) && ( matched.count(it->first) == 0 )
+			&& same_content(it->second, object) )
+		return it;
+
+	for ( it = installed->begin(); it != installed->end(); it++ ){
+		if ( ( matched.count(it->first) == 0 ) 
+				&& same_content(it->second, object) )
+			return it;
+	}
+	return installed->end();
+}
+
+/*
+ * Copy an object and its commands from one rule into another one.
+ */
+void copy_object(const mt_policy_rule *from, mt_policy_rule::const_iterator it,
+				 mt_policy_rule *to)
+{
+	to->set_object(it->first, it->second->copy());
+	
+	mt_policy_rule::const_iterator_commands it_commands = 
+			from->find_commands(it->first);
+	if ( it_commands != from->end_commands() )
+		to->set_commands(it->first, it_commands->second);
+}
+
+} // namespace
+
+
+mt_policy_rule *
+policy_rule_installer::update(const mt_policy_rule *installed,
+							  const mt_policy_rule *requested)
+{
+	mt_policy_rule *rule_return = new mt_policy_rule();
+	mt_policy_rule to_install;
+	mt_policy_rule to_remove;
+	std::set<mspec_rule_key> matched;
+	mt_policy_rule::const_iterator i;
+	
+	for ( i = requested->begin(); i != requested->end(); i++ ){
+		mt_policy_rule::const_iterator it = 
+				find_unchanged(installed, i->first, i->second, matched);
+		
+		if ( it != installed->end() ){
+			matched.insert(it->first);
+			copy_object(installed, it, rule_return);
+		}
+		else {
+			to_install.set_object(i->first, i->second->copy());
+		}
+	}
+	
+	for ( i = installed->begin(); i != installed->end(); i++ ){
+		if ( matched.count(i->first) == 0 )
+			copy_object(installed, i, &to_remove);
+	}
+
+	MNSLP_TRACE(msg::trace::tc_installer, msg::trace::ev_update, matched.size(),
+				to_install.get_number_mspec_objects(), 
+				to_remove.get_number_mspec_objects());
+	
+	if ( to_remove.get_number_mspec_objects() > 0 ){
+		mt_policy_rule *removed = remove(&to_remove);
+		delete removed;
+	}
+	
+	if ( to_install.get_number_mspec_objects() > 0 ){
+		mt_policy_rule *added = install(&to_install);
+		for ( i = added->begin(); i != added->end(); i++ )
+			copy_object(added, i, rule_return);
+		delete added;
+	}
+
+	return rule_return;
+}
+
+void
+policy_rule_installer::adopt(const mt_policy_rule *rule)
+{
+	// nothing to do
+}
+
+void
+policy_rule_installer::reconcile()
+{
+	// nothing to do
+}
+
+void
+policy_rule_installer::remove_bulk(const std::vector<const mt_policy_rule *> &rules)
+{
+	for ( size_t i = 0; i < rules.size(); i++ ){
+		try
+		{
+			delete remove(rules[i]);
+		}
+		catch (policy_rule_installer_error &e)
+		{
+			LogError("unable to remove policy rule: " << e);
+		}
+	}
+}
+
+void
+policy_rule_installer::schedule_remove(mt_policy_rule *mt_object)
+{
+	pthread_mutex_lock(&teardown_mutex);
+	
+	bool queued = teardown_running;
+	if ( queued ){
+		teardown_queue.push_back(mt_object);
+		teardown_pending++;
+		pthread_cond_signal(&teardown_cond);
+	}
+	
+	pthread_mutex_unlock(&teardown_mutex);
+	
+	if ( ! queued ){
+		std::vector<mt_policy_rule *> rules(1, mt_object);
+		remove_batches(rules);
+	}
+}
+
+size_t
+policy_rule_installer::get_teardown_backlog()
+{
+	pthread_mutex_lock(&teardown_mutex);
+	size_t backlog = teardown_pending;
+	pthread_mutex_unlock(&teardown_mutex);
+	
+	return backlog;
+}
+
+void
+policy_rule_installer::start_teardown()
+{
+	pthread_mutex_lock(&teardown_mutex);
+	
+	if ( ! teardown_running ){
+		if ( pthread_create(&teardown_thread, NULL, teardown_main, this) == 0 )
+			teardown_running = true;
+		else
+			LogError("unable to start the teardown thread");
+	}
+	
+	pthread_mutex_unlock(&teardown_mutex);
+}
+
+void
+policy_rule_installer::stop_teardown()
+{
+	pthread_mutex_lock(&teardown_mutex);
+	
+	bool running = teardown_running;
+	teardown_running = false;
+	pthread_cond_signal(&teardown_cond);
+	
+	pthread_mutex_unlock(&teardown_mutex);
+	
+	if ( running )
+		pthread_join(teardown_thread, NULL);
+}
+
+void *
+policy_rule_installer::teardown_main(void *installer)
+{
+	static_cast<policy_rule_installer *>(installer)->teardown_loop();
+	return NULL;
+}
+
+/*
+ * Wait for queued rules and remove everything queued meanwhile together.
+ * After stop_teardown() the queue is drained before the thread exits.
+ */
+void
+policy_rule_installer::teardown_loop()
+{
+	std::vector<mt_policy_rule *> rules;
+	
+	pthread_mutex_lock(&teardown_mutex);
+	
+	while ( teardown_running || ! teardown_queue.empty() ){
+		if ( teardown_queue.empty() ){
+			pthread_cond_wait(&teardown_cond, &teardown_mutex);
+			continue;
+		}
+		
+		rules.swap(teardown_queue);
+		size_t num_rules = rules.size();
+		pthread_mutex_unlock(&teardown_mutex);
+		
+		remove_batches(rules);
+		
+		pthread_mutex_lock(&teardown_mutex);
+		teardown_pending -= num_rules;
+	}
+	
+	pthread_mutex_unlock(&teardown_mutex);
+}
+
+/*
+ * Remove the given rules, at most TEARDOWN_BATCH_SIZE per remove_bulk()
+ * call, delete them and leave rules empty.
+ */
+void
+policy_rule_installer::remove_batches(std::vector<mt_policy_rule *> &rules)
+{
+	std::vector<const mt_policy_rule *> batch;
+	batch.reserve(std::min(rules.size(), TEARDOWN_BATCH_SIZE));
+	
+	for ( size_t i = 0; i < rules.size(); i += TEARDOWN_BATCH_SIZE ){
+		size_t end = std::min(rules.size(), i + TEARDOWN_BATCH_SIZE);
+		batch.assign(rules.begin() + i, rules.begin() + end);
+		remove_bulk(batch);
+	}
+	
+	for ( size_t i = 0; i < rules.size(); i++ )
+		delete rules[i];
+	
+	rules.clear();
+}
+
 std::string
 policy_rule_installer::to_string() const
 {
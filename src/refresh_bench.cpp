@@ -0,0 +1,119 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file refresh_bench.cpp
+/// Peak-to-mean refresh rate with and without jitter.
+/// ----------------------------------------------------------
+/// $Id: refresh_bench.cpp 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./src/refresh_bench.cpp $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#include <cstdlib>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "refresh_scheduler.h"
+
+using namespace mnslp;
+
+
+/*
+ * Simulates the refresh timers of sessions that were all created within
+ * the same second, the way they are after a restart. Each second of
+ * simulated time counts the refreshes that go off; a refresh books its
+ * successor right away. The result is the busiest second compared to the
+ * average, measured once the first few refresh rounds are over.
+ */
+enum schedule_t { FIXED, JITTER, LOAD_AWARE };
+
+static const char *const mode_names[] = { "fixed", "jitter", "load-aware" };
+
+static const uint32 WARMUP_ROUNDS = 10;
+
+
+static double run(schedule_t mode, unsigned long sessions, uint32 interval,
+		uint32 duration) {
+
+	refresh_scheduler scheduler(mode == LOAD_AWARE);
+
+	// Refreshes due per second. A booking is at most 1.5 intervals ahead.
+	std::vector<unsigned long> due(duration + 2 * interval + 2, 0);
+	due[interval] = sessions;
+
+	uint32 warmup = WARMUP_ROUNDS * interval;
+	unsigned long peak = 0;
+	unsigned long total = 0;
+
+	for ( uint32 t = 1; t <= duration; t++ ) {
+		unsigned long count = due[t];
+
+		for ( unsigned long i = 0; i < count; i++ ) {
+			uint32 delay;
+
+			if ( mode == FIXED )
+				delay = interval;
+			else
+				delay = scheduler.next_refresh(interval, t);
+
+			due[t + delay]++;
+		}
+
+		if ( t > warmup ) {
+			if ( count > peak )
+				peak = count;
+			total += count;
+		}
+	}
+
+	double mean = double(total) / (duration - warmup);
+
+	return peak / mean;
+}
+
+
+int main(int argc, char *argv[]) {
+	unsigned long sessions = 20000;
+	uint32 lifetime = 30;
+	uint32 max_retries = 3;
+
+	if ( argc > 1 )
+		sessions = strtoul(argv[1], NULL, 10);
+
+	// The same as ni_session::cal_refresh_interval().
+	uint32 interval = (uint32) ceil( lifetime / ( (max_retries+0.5) * 1.5 ) );
+	uint32 duration = 3600;
+
+	std::cout << "sessions: " << sessions << ", refresh interval: "
+		<< interval << " s, simulated: " << duration << " s" << std::endl;
+
+	for ( int m = FIXED; m <= LOAD_AWARE; m++ ) {
+		double ratio = run(static_cast<schedule_t>(m), sessions,
+			interval, duration);
+
+		std::cout << mode_names[m] << ": peak/mean refreshes per second "
+			<< ratio << std::endl;
+	}
+
+	return 0;
+}
+
+// EOF
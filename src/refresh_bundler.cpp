@@ -0,0 +1,143 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file refresh_bundler.cpp
+/// Bundling of REFRESH messages sent to the same peer.
+/// ----------------------------------------------------------
+/// $Id: refresh_bundler.cpp 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./src/refresh_bundler.cpp $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#include <algorithm>
+#include <cassert>
+
+#include "refresh_bundler.h"
+
+
+using namespace mnslp;
+using namespace mnslp::msg;
+
+
+/**
+ * Constructor.
+ *
+ * @param enabled if false, refreshes are never bundled
+ */
+refresh_bundler::refresh_bundler(bool enabled) : enabled(enabled) {
+	pthread_rwlock_init(&lock, NULL);
+}
+
+
+refresh_bundler::~refresh_bundler() {
+	pthread_rwlock_destroy(&lock);
+}
+
+
+/**
+ * Record whether the sender of a received message accepts bundles.
+ *
+ * @param sii_handle the peer the message came from
+ * @param msg the received message
+ */
+void refresh_bundler::learn(uint32 sii_handle, const mnslp_msg *msg) {
+	if ( sii_handle == 0 || msg == NULL )
+		return;
+
+	bool capable = msg->has_flag(mnslp_msg::FLAG_REFRESH_BUNDLING);
+
+	// Nearly always, nothing changes.
+	if ( is_capable(sii_handle) == capable )
+		return;
+
+	pthread_rwlock_wrlock(&lock);
+
+	if ( capable )
+		peers.insert(sii_handle);
+	else
+		peers.erase(sii_handle);
+
+	pthread_rwlock_unlock(&lock);
+}
+
+
+/**
+ * Check if a peer accepts bundled REFRESH messages.
+ */
+bool refresh_bundler::is_capable(uint32 sii_handle) const {
+	pthread_rwlock_rdlock(&lock);
+	bool ret = peers.find(sii_handle) != peers.end();
+	pthread_rwlock_unlock(&lock);
+
+	return ret;
+}
+
+
+/**
+ * Turn the refreshes for one peer into as few messages as possible.
+ *
+ * Each resulting message is the first REFRESH of a group, with the other
+ * sessions of the group in its refresh list. A group of one is sent as
+ * it is. The messages in refreshes are consumed.
+ *
+ * @param refreshes REFRESH messages with a non-zero lifetime
+ * @param peer the SII handle all of them are sent to
+ * @param out receives the messages to send
+ */
+void refresh_bundler::bundle(const std::vector<ntlp_msg *> &refreshes,
+		uint32 peer, std::vector<ntlp_msg *> &out) {
+
+	const size_t group_size = refresh_list::MAX_ENTRIES + 1;
+
+	for ( size_t first = 0; first < refreshes.size(); first += group_size ) {
+		size_t last = std::min(first + group_size, refreshes.size());
+
+		if ( last - first == 1 ) {
+			out.push_back(refreshes[first]);
+			continue;
+		}
+
+		ntlp_msg *carrier = refreshes[first];
+		mnslp_refresh *refresh = carrier->get_mnslp_refresh();
+		assert( refresh != NULL );
+
+		// The body may be shared with the session's copy, so don't touch it.
+		mnslp_refresh *bundled = refresh->copy();
+		refresh_list *list = new refresh_list();
+
+		for ( size_t i = first + 1; i < last; i++ ) {
+			mnslp_refresh *r = refreshes[i]->get_mnslp_refresh();
+			assert( r != NULL );
+
+			list->add(refreshes[i]->get_session_id().get_id(),
+				r->get_msg_sequence_number(), r->get_session_lifetime());
+			delete refreshes[i];
+		}
+
+		bundled->set_refresh_list(list);
+
+		out.push_back(new ntlp_msg(carrier->get_session_id(), bundled,
+			carrier->get_mri()->copy(), peer));
+
+		delete carrier;
+	}
+}
+
+// EOF
@@ -0,0 +1,199 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file refresh_scheduler.cpp
+/// Jittered and load-aware scheduling of NI refreshes.
+/// ----------------------------------------------------------
+/// $Id: refresh_scheduler.cpp 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./src/refresh_scheduler.cpp $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#include <algorithm>
+#include <cassert>
+#include <openssl/rand.h>
+
+#include "refresh_scheduler.h"
+
+
+using namespace mnslp;
+
+
+const size_t refresh_scheduler::INITIAL_SLOTS;
+
+
+/**
+ * Constructor.
+ *
+ * @param load_aware spread refreshes evenly instead of picking a random delay
+ */
+refresh_scheduler::refresh_scheduler(bool load_aware)
+		: load_aware(load_aware), slots(INITIAL_SLOTS, 0), head(0), base(0) {
+
+	pthread_mutex_init(&mutex, NULL);
+}
+
+
+refresh_scheduler::~refresh_scheduler() {
+	pthread_mutex_destroy(&mutex);
+}
+
+
+/**
+ * Return a 32 bit pseudo random number.
+ *
+ * Every thread has its own xorshift generator, seeded from OpenSSL on
+ * first use. This is cheap and needs no locking, but it is not suitable
+ * for anything security related, like message sequence numbers.
+ */
+uint32 refresh_scheduler::random() {
+	static __thread unsigned long long state = 0;
+
+	if ( state == 0 ) {
+		if ( RAND_bytes((unsigned char *) &state, sizeof(state)) != 1 )
+			state = (unsigned long long) time(NULL);
+
+		state |= 1; // the generator must not start at zero
+	}
+
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+
+	return (uint32) ((state * 2685821657736338717ULL) >> 32);
+}
+
+
+/**
+ * Return a delay drawn uniformly from [interval/2, 3*interval/2].
+ */
+uint32 refresh_scheduler::jitter(uint32 interval) {
+	uint32 low = (interval + 1) / 2;
+	uint32 high = interval + interval / 2;
+
+	if ( low == 0 )
+		return 1;
+
+	return low + random() % (high - low + 1);
+}
+
+
+/**
+ * Return the delay in seconds until the next refresh of a session.
+ */
+uint32 refresh_scheduler::next_refresh(uint32 interval) {
+	if ( ! load_aware )
+		return jitter(interval);
+
+	return next_refresh(interval, time(NULL));
+}
+
+
+/**
+ * Return the delay in seconds until the next refresh of a session.
+ *
+ * In load-aware mode the refresh is booked for the least loaded second
+ * of the window. Ties are broken at random, so sessions with the same
+ * interval don't all pick the start of the window.
+ *
+ * @param interval the session's refresh interval in seconds
+ * @param now the current time
+ */
+uint32 refresh_scheduler::next_refresh(uint32 interval, time_t now) {
+	if ( ! load_aware )
+		return jitter(interval);
+
+	uint32 low = (interval + 1) / 2;
+	uint32 high = interval + interval / 2;
+
+	if ( low == 0 )
+		low = high = 1;
+
+	uint32 width = high - low + 1;
+	uint32 start = random() % width;
+
+	pthread_mutex_lock(&mutex);
+
+	advance(now);
+	grow(high + 1);
+
+	uint32 best = low + start;
+	uint32 best_load = slots[(head + best) % slots.size()];
+
+	for ( uint32 i = 1; i < width && best_load > 0; i++ ) {
+		uint32 delay = low + (start + i) % width;
+		uint32 load = slots[(head + delay) % slots.size()];
+
+		if ( load < best_load ) {
+			best = delay;
+			best_load = load;
+		}
+	}
+
+	slots[(head + best) % slots.size()]++;
+
+	pthread_mutex_unlock(&mutex);
+
+	return best;
+}
+
+
+/**
+ * Move the start of the ring to now, forgetting the seconds that passed.
+ */
+void refresh_scheduler::advance(time_t now) {
+	time_t elapsed = now - base;
+
+	// Also taken on the first call and if the clock went backwards.
+	if ( elapsed < 0 || elapsed >= (time_t) slots.size() ) {
+		std::fill(slots.begin(), slots.end(), 0);
+		head = 0;
+	}
+	else {
+		for ( time_t i = 0; i < elapsed; i++ ) {
+			slots[head] = 0;
+			head = (head + 1) % slots.size();
+		}
+	}
+
+	base = now;
+}
+
+
+/**
+ * Make the ring hold at least min_size seconds.
+ */
+void refresh_scheduler::grow(size_t min_size) {
+	if ( slots.size() >= min_size )
+		return;
+
+	size_t new_size = slots.size();
+	while ( new_size < min_size )
+		new_size *= 2;
+
+	std::vector<uint32> resized(new_size, 0);
+	for ( size_t i = 0; i < slots.size(); i++ )
+		resized[i] = slots[(head + i) % slots.size()];
+
+	slots.swap(resized);
+	head = 0;
+}
+
+// EOF
@@ -33,6 +33,7 @@
 #include "session.h"
 #include "dispatcher.h"
 #include "msg/selection_metering_entities.h"
+#include "msg/mnslp_trace.h"
 #include <iostream>
 
 
@@ -45,7 +46,7 @@ using protlib::uint32;
  * Constructor.
  *
  * A random session ID is created and the message sequence number is set to 0.
- * Additionally, the mutex is initialized.
+ * The caller holds the only reference.
  */
 session::session() : id(), msn(0), rule(NULL) {
 	init();
@@ -70,8 +71,6 @@ session::session(const session_id &sid) : id(sid), msn(0), rule(NULL) {
  */
 session::~session() 
 {
-	pthread_mutex_destroy(&mutex);
-	
 	if (rule != NULL)
 		delete rule;
 }
@@ -81,20 +80,10 @@ session::~session()
  * A helper method for the constructors, to avoid code duplication.
  */
 void session::init() {
-	pthread_mutexattr_t mutex_attr;
-
-	pthread_mutexattr_init(&mutex_attr);
-
-#ifdef _DEBUG
-	pthread_mutexattr_settype(&mutex_attr, PTHREAD_MUTEX_ERRORCHECK);
-#else
-	pthread_mutexattr_settype(&mutex_attr, PTHREAD_MUTEX_NORMAL);
-#endif
+	refs = 1;
+	upstream_peer = 0;
+	downstream_peer = 0;
 
-	pthread_mutex_init(&mutex, &mutex_attr);
-
-	pthread_mutexattr_destroy(&mutex_attr); // valid, doesn't affect mutex
-	
 	rule = new mt_policy_rule();
 }
 
@@ -102,23 +91,159 @@ void session::init() {
 /**
  * Process the given event.
  *
- * This method calls the user-defined process_event method and takes care of
- * locking.
+ * This method calls the user-defined process_event method. The caller has
+ * to own the session's mailbox.
  */
 void session::process(dispatcher *d, event *evt) 
 {
-	typedef void (*cleanup_t)(void *);
-	int ret;
+	process_event(d, evt);	// implemented by child classes
+}
 
-	pthread_cleanup_push((cleanup_t) pthread_mutex_unlock, (void *) &mutex);
-	ret = pthread_mutex_lock(&mutex);
-	assert( ret == 0 );
 
-	process_event(d, evt);	// implemented by child classes
+/**
+ * Take a reference to this session.
+ */
+void session::acquire()
+{
+	__sync_fetch_and_add(&refs, 1);
+}
+
+
+/**
+ * Give up a reference, deleting the session if it was the last one.
+ */
+void session::release()
+{
+	if ( __sync_sub_and_fetch(&refs, 1) == 0 )
+		delete this;
+}
+
+
+/**
+ * Take a snapshot of the session's persistent state.
+ *
+ * This method calls the user-defined save method. The caller has to own
+ * the session's mailbox.
+ *
+ * @return false if the session can't be restored from a snapshot
+ */
+bool session::snapshot(session_snapshot &snap)
+{
+	return save(snap);	// implemented by child classes
+}
+
+
+/**
+ * Fill in the state common to all sessions.
+ */
+bool session::save(session_snapshot &snap) const
+{
+	snap.id = id;
+	snap.type = type;
+	snap.msn = msn;
+	snap.upstream_peer = upstream_peer;
+	snap.downstream_peer = downstream_peer;
+
+	return false;
+}
+
+
+/**
+ * Add the memory this session holds to the given usage.
+ *
+ * The session object itself is accounted for by the role's slab. The
+ * session must not be processing events meanwhile.
+ */
+void session::get_memory_usage(session_memory_usage &usage)
+{
+	usage.sessions++;
+	count_memory(usage);	// extended by child classes
+}
+
 
-	ret = pthread_mutex_unlock(&mutex);
-	assert( ret == 0 );
-	pthread_cleanup_pop(0);
+void session::count_memory(session_memory_usage &usage) const
+{
+	if ( rule != NULL )
+		usage.rule_bytes += rule->get_memory_usage();
+}
+
+
+/**
+ * Take over the state common to all sessions.
+ */
+void session::restore(dispatcher *d, session_snapshot &snap)
+{
+	assert( snap.id == id );
+
+	msn = snap.msn;
+	upstream_peer = snap.upstream_peer;
+	downstream_peer = snap.downstream_peer;
+
+	if ( snap.rule != NULL ) {
+		delete rule;
+		rule = snap.rule;
+		snap.rule = NULL;
+	}
+}
+
+
+/**
+ * Constructor.
+ */
+session_snapshot::session_snapshot()
+		: id(protlib::uint128()), type(0), state(0), msn(0), lifetime(0),
+		  expires(0), upstream_peer(0), downstream_peer(0),
+		  ni_mri(NULL), nr_mri(NULL), rule(NULL)
+{
+	// nothing to do
+}
+
+
+/**
+ * Destructor.
+ *
+ * Deletes whatever no session has taken over.
+ */
+session_snapshot::~session_snapshot()
+{
+	delete ni_mri;
+	delete nr_mri;
+	delete rule;
+}
+
+
+session_memory_usage::session_memory_usage()
+		: sessions(0), object_bytes(0), reserved_bytes(0),
+		  message_bytes(0), mri_bytes(0), rule_bytes(0)
+{
+	// nothing to do
+}
+
+
+/**
+ * Return the reserved slab memory plus everything held out of line.
+ */
+size_t session_memory_usage::get_total_bytes() const
+{
+	return reserved_bytes + message_bytes + mri_bytes + rule_bytes;
+}
+
+
+std::ostream &mnslp::operator<<(std::ostream &out,
+		const session_memory_usage &u)
+{
+	return out << "[session_memory_usage: sessions=" << u.sessions
+		<< ", objects=" << u.object_bytes
+		<< ", reserved=" << u.reserved_bytes
+		<< ", messages=" << u.message_bytes
+		<< ", mris=" << u.mri_bytes
+		<< ", rules=" << u.rule_bytes
+		<< ", total=" << u.get_total_bytes();
+
+	if ( u.sessions > 0 )
+		out << ", per session=" << u.get_total_bytes() / u.sessions;
+
+	return out << "]";
 }
 
 
@@ -164,7 +289,6 @@ bool session::check_participating(const uint32 _sme)
 	
 	if (type == st_initiator)
 	{
-	   std::cout << "Initiator" << std::endl;
 	   if (_sme == msg::selection_metering_entities::sme_all)
 		   val_return = true;
 	   else if (_sme == msg::selection_metering_entities::sme_any)
@@ -178,7 +302,6 @@ bool session::check_participating(const uint32 _sme)
 	}
 	else if (type == st_forwarder)
 	{
-	   std::cout << "st_forwarder" << std::endl;
 	   if (_sme == msg::selection_metering_entities::sme_all)
 		   val_return = true;
 	   else if (_sme == msg::selection_metering_entities::sme_any)
@@ -189,7 +312,6 @@ bool session::check_participating(const uint32 _sme)
 	}
 	else if (type == st_receiver)
 	{
-	   std::cout << "st_receiver" << std::endl;
 	   if (_sme == msg::selection_metering_entities::sme_all)
 		   val_return = true;
 	   else if (_sme == msg::selection_metering_entities::sme_any)
@@ -201,6 +323,9 @@ bool session::check_participating(const uint32 _sme)
 	   else
 	       val_return = false;	
 	}
+
+	MNSLP_TRACE(msg::trace::tc_session, msg::trace::ev_session_participating,
+				type, _sme, val_return);
 	return val_return;
 }
 
@@ -0,0 +1,757 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file session_checkpoint.cpp
+/// Checkpoint log of the session table.
+/// ----------------------------------------------------------
+/// $Id: session_checkpoint.cpp 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./src/session_checkpoint.cpp $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#include <algorithm>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "logfile.h"
+#include "mnslp_log.h"
+
+#include "mri_pc.h"	// from NTLP
+#include "msg/mnslp_ie.h"
+#include "msg/object_fingerprint.h"
+#include "session_checkpoint.h"
+
+
+using namespace mnslp;
+using namespace protlib;
+using namespace protlib::log;
+
+
+#define LogError(msg) ERRLog("session_checkpoint", msg)
+#define LogWarn(msg) WLog("session_checkpoint", msg)
+#define LogInfo(msg) MNSLP_LOG_INFO("session_checkpoint", msg)
+#define LogDebug(msg) MNSLP_LOG_DEBUG("session_checkpoint", msg)
+
+
+namespace {
+
+/// The file starts with this, followed by zeros up to FILE_HEADER_SIZE.
+const char MAGIC[8] = { 'M', 'N', 'S', 'L', 'P', 'C', 'K', '1' };
+
+const size_t FILE_HEADER_SIZE = 16;
+
+/// Length of a rule key in its string representation.
+const size_t KEY_LENGTH = 36;
+
+const uint8 HAS_NI_MRI = 0x01;
+const uint8 HAS_NR_MRI = 0x02;
+
+/// Records start at multiples of 4 bytes.
+inline size_t align(size_t length) {
+	return (length + 3) & ~size_t(3);
+}
+
+inline size_t round_to_chunk(size_t length) {
+	const size_t chunk = session_checkpoint::CHUNK_SIZE;
+	return ((length + chunk - 1) / chunk) * chunk;
+}
+
+} // anonymous namespace
+
+
+const size_t session_checkpoint::CHUNK_SIZE;
+
+
+/**
+ * Constructor.
+ *
+ * The log has to be opened with open() before it is used.
+ */
+session_checkpoint::session_checkpoint(const std::string &filename)
+		: filename(filename), fd(-1), map(NULL), map_size(0),
+		  used(0), synced(0), live(0) {
+
+	pthread_mutex_init(&mutex, NULL);
+}
+
+
+/**
+ * Destructor.
+ *
+ * Compacts the log if needed, writes all records to disk and closes
+ * the file.
+ */
+session_checkpoint::~session_checkpoint() {
+	if ( map != NULL ) {
+		if ( is_compaction_due() )
+			rewrite();
+
+		msync(map, used, MS_SYNC);
+		unmap_file();
+	}
+
+	if ( fd >= 0 )
+		close(fd);
+
+	pthread_mutex_destroy(&mutex);
+}
+
+
+/**
+ * Open the log, creating it if it doesn't exist.
+ *
+ * The records in an existing log are read, so replay() can return them.
+ *
+ * @return false if the file can't be used as a checkpoint log
+ */
+bool session_checkpoint::open() {
+	fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0600);
+
+	if ( fd < 0 ) {
+		LogError("unable to open " << filename << ": " << strerror(errno));
+		return false;
+	}
+
+	struct stat st;
+	if ( fstat(fd, &st) != 0 || ! map_file(
+			round_to_chunk(std::max<size_t>(st.st_size, 1))) ) {
+		close(fd);
+		fd = -1;
+		return false;
+	}
+
+	if ( st.st_size == 0 ) {
+		memcpy(map, MAGIC, sizeof(MAGIC));
+	}
+	else if ( memcmp(map, MAGIC, sizeof(MAGIC)) != 0 ) {
+		LogError(filename << " is not a checkpoint log");
+		unmap_file();
+		close(fd);
+		fd = -1;
+		return false;
+	}
+
+	scan();
+
+	LogInfo("opened " << filename << " with " << index.size()
+		<< " sessions in " << used << " bytes");
+
+	return true;
+}
+
+
+/**
+ * Map size bytes of the file, growing the file if necessary.
+ */
+bool session_checkpoint::map_file(size_t size) {
+	if ( ftruncate(fd, size) != 0 ) {
+		LogError("unable to resize " << filename << ": " << strerror(errno));
+		return false;
+	}
+
+	void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+	if ( p == MAP_FAILED ) {
+		LogError("unable to map " << filename << ": " << strerror(errno));
+		return false;
+	}
+
+	map = static_cast<uchar *>(p);
+	map_size = size;
+
+	return true;
+}
+
+
+void session_checkpoint::unmap_file() {
+	munmap(map, map_size);
+	map = NULL;
+	map_size = 0;
+}
+
+
+/**
+ * Make room for length more bytes at the end of the log.
+ *
+ * If the file can't be grown, the log is closed and false is returned.
+ */
+bool session_checkpoint::reserve(size_t length) {
+	if ( used + length <= map_size )
+		return true;
+
+	size_t new_size = round_to_chunk(used + length);
+
+	unmap_file();
+
+	if ( ! map_file(new_size) ) {
+		LogError("checkpointing disabled");
+		return false;
+	}
+
+	return true;
+}
+
+
+/**
+ * Read the records and build the index.
+ *
+ * Whatever follows the last valid record is cleared, so stale records
+ * behind a corrupt one can't come back after it was overwritten.
+ */
+void session_checkpoint::scan() {
+	size_t pos = FILE_HEADER_SIZE;
+
+	index.clear();
+	live = 0;
+
+	while ( pos + sizeof(record_header) <= map_size ) {
+		record_header hdr;
+		memcpy(&hdr, map + pos, sizeof(hdr));
+
+		if ( hdr.length == 0 )
+			break;	// end of the log
+
+		if ( hdr.length < sizeof(hdr) || hdr.length > map_size - pos
+				|| hdr.checksum != compute_checksum(map + pos, hdr.length) ) {
+			LogWarn("corrupt record at offset " << pos
+				<< ", ignoring the rest of " << filename);
+			break;
+		}
+
+		session_id id(uint128(hdr.id[0], hdr.id[1], hdr.id[2], hdr.id[3]));
+
+		index_t::iterator i = index.find(id);
+		if ( i != index.end() ) {
+			live -= align(i->second.length);
+			index.erase(i);
+		}
+
+		if ( hdr.kind == REC_SESSION ) {
+			record_pos rec = { pos, hdr.length, hdr.checksum };
+			index.insert(std::make_pair(id, rec));
+			live += align(hdr.length);
+		}
+
+		pos += align(hdr.length);
+	}
+
+	used = pos;
+	synced = pos;
+
+	memset(map + used, 0, map_size - used);
+}
+
+
+/**
+ * Return the latest snapshot of every session in the log.
+ *
+ * The caller has to delete the snapshots. Records that can't be decoded
+ * are dropped from the log.
+ *
+ * @return the number of snapshots added
+ */
+size_t session_checkpoint::replay(std::vector<session_snapshot *> &snapshots) {
+	std::vector<session_id> broken;
+	size_t count = 0;
+
+	pthread_mutex_lock(&mutex);
+
+	for ( index_t::const_iterator i = index.begin(); i != index.end(); i++ ) {
+		session_snapshot *snap = decode(
+			map + i->second.offset + sizeof(record_header),
+			i->second.length - sizeof(record_header));
+
+		if ( snap == NULL ) {
+			LogWarn("unable to decode the record of session " << i->first);
+			broken.push_back(i->first);
+			continue;
+		}
+
+		snap->id = i->first;
+		snapshots.push_back(snap);
+		count++;
+	}
+
+	for ( size_t i = 0; i < broken.size(); i++ )
+		append(REC_REMOVE, broken[i], NULL, 0);
+
+	pthread_mutex_unlock(&mutex);
+
+	return count;
+}
+
+
+/**
+ * Record the current state of a session.
+ *
+ * Sessions that can't be restored are removed from the log instead.
+ */
+void session_checkpoint::save(session *s) {
+	assert( s != NULL );
+
+	session_snapshot snap;
+
+	if ( s->snapshot(snap) )
+		save(snap);
+	else
+		remove(s->get_id());
+}
+
+
+/**
+ * Record a session snapshot.
+ *
+ * Nothing is written if the session didn't change since its last record,
+ * which is the case for most timer events.
+ */
+void session_checkpoint::save(const session_snapshot &snap) {
+	std::vector<uchar> body;
+
+	try {
+		body = encode(snap);
+	}
+	catch ( IEError &e ) {
+		LogError("unable to save session " << snap.id);
+	}
+	catch ( NetMsgError &e ) {
+		LogError("unable to save session " << snap.id);
+	}
+
+	if ( body.empty() ) {
+		remove(snap.id);
+		return;
+	}
+
+	pthread_mutex_lock(&mutex);
+
+	index_t::const_iterator i = index.find(snap.id);
+
+	if ( i == index.end()
+			|| i->second.length != sizeof(record_header) + body.size()
+			|| memcmp(map + i->second.offset + sizeof(record_header),
+				&body[0], body.size()) != 0 )
+		append(REC_SESSION, snap.id, &body[0], body.size());
+
+	pthread_mutex_unlock(&mutex);
+}
+
+
+/**
+ * Record that a session is gone.
+ */
+void session_checkpoint::remove(const session_id &id) {
+	pthread_mutex_lock(&mutex);
+
+	if ( index.find(id) != index.end() )
+		append(REC_REMOVE, id, NULL, 0);
+
+	pthread_mutex_unlock(&mutex);
+}
+
+
+/**
+ * Append a record and update the index. Called with the mutex locked.
+ */
+void session_checkpoint::append(record_kind_t kind, const session_id &id,
+		const uchar *body, uint32 body_length) {
+
+	if ( map == NULL )
+		return;
+
+	uint32 length = sizeof(record_header) + body_length;
+
+	if ( ! reserve(align(length)) )
+		return;
+
+	uint128 value = id.get_id();
+	record_header hdr = { length, 0, uint32(kind),
+		{ value.w1, value.w2, value.w3, value.w4 } };
+
+	uchar *record = map + used;
+	memcpy(record, &hdr, sizeof(hdr));
+	if ( body_length > 0 )
+		memcpy(record + sizeof(hdr), body, body_length);
+
+	// The checksum goes in last, it makes the record valid.
+	hdr.checksum = compute_checksum(record, length);
+	memcpy(record, &hdr, sizeof(hdr));
+
+	index_t::iterator i = index.find(id);
+	if ( i != index.end() ) {
+		live -= align(i->second.length);
+		index.erase(i);
+	}
+
+	if ( kind == REC_SESSION ) {
+		record_pos rec = { used, length, hdr.checksum };
+		index.insert(std::make_pair(id, rec));
+		live += align(length);
+	}
+
+	used += align(length);
+}
+
+
+/**
+ * Start writing the records appended since the last call to disk.
+ *
+ * This doesn't wait for the disk, it is cheap enough to call after
+ * every batch of events.
+ */
+void session_checkpoint::sync() {
+	pthread_mutex_lock(&mutex);
+
+	if ( map != NULL && used > synced ) {
+		size_t page = sysconf(_SC_PAGESIZE);
+		size_t start = synced - synced % page;
+
+		msync(map + start, used - start, MS_ASYNC);
+		synced = used;
+	}
+
+	pthread_mutex_unlock(&mutex);
+}
+
+
+/**
+ * Drop all outdated records from the log.
+ */
+void session_checkpoint::compact() {
+	pthread_mutex_lock(&mutex);
+
+	if ( map != NULL )
+		rewrite();
+
+	pthread_mutex_unlock(&mutex);
+}
+
+
+/**
+ * Drop the outdated records if less than half of the log is in use.
+ *
+ * This blocks all writers until the new file is on disk, so it must not
+ * be called while processing events.
+ *
+ * @return true if the log was compacted
+ */
+bool session_checkpoint::compact_if_needed() {
+	bool due = false;
+
+	pthread_mutex_lock(&mutex);
+
+	if ( map != NULL && is_compaction_due() ) {
+		due = true;
+		rewrite();
+	}
+
+	pthread_mutex_unlock(&mutex);
+
+	return due;
+}
+
+
+/**
+ * Copy the latest records to a new file which then replaces the log.
+ * Called with the mutex locked.
+ *
+ * If anything goes wrong, the old log is kept.
+ */
+void session_checkpoint::rewrite() {
+	std::string new_name = filename + ".new";
+	size_t new_size = round_to_chunk(FILE_HEADER_SIZE + live + 1);
+
+	int new_fd = ::open(new_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if ( new_fd < 0 ) {
+		LogError("unable to create " << new_name << ": " << strerror(errno));
+		return;
+	}
+
+	void *p = MAP_FAILED;
+	if ( ftruncate(new_fd, new_size) == 0 )
+		p = mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			new_fd, 0);
+
+	if ( p == MAP_FAILED ) {
+		LogError("unable to compact " << filename << ": " << strerror(errno));
+		close(new_fd);
+		unlink(new_name.c_str());
+		return;
+	}
+
+	uchar *new_map = static_cast<uchar *>(p);
+	std::vector<size_t> offsets;
+	offsets.reserve(index.size());
+
+	memcpy(new_map, MAGIC, sizeof(MAGIC));
+	size_t pos = FILE_HEADER_SIZE;
+
+	for ( index_t::const_iterator i = index.begin(); i != index.end(); i++ ) {
+		memcpy(new_map + pos, map + i->second.offset, i->second.length);
+		offsets.push_back(pos);
+		pos += align(i->second.length);
+	}
+
+	if ( msync(new_map, pos, MS_SYNC) != 0
+			|| rename(new_name.c_str(), filename.c_str()) != 0 ) {
+		LogError("unable to replace " << filename << ": " << strerror(errno));
+		munmap(new_map, new_size);
+		close(new_fd);
+		unlink(new_name.c_str());
+		return;
+	}
+
+	size_t n = 0;
+	for ( index_t::iterator i = index.begin(); i != index.end(); i++ )
+		i->second.offset = offsets[n++];
+
+	LogInfo("compacted " << filename << " from " << used << " to "
+		<< pos << " bytes");
+
+	unmap_file();
+	close(fd);
+
+	fd = new_fd;
+	map = new_map;
+	map_size = new_size;
+	used = pos;
+	synced = pos;
+}
+
+
+size_t session_checkpoint::get_num_sessions() {
+	pthread_mutex_lock(&mutex);
+	size_t count = index.size();
+	pthread_mutex_unlock(&mutex);
+
+	return count;
+}
+
+
+size_t session_checkpoint::get_log_size() {
+	pthread_mutex_lock(&mutex);
+	size_t size = used;
+	pthread_mutex_unlock(&mutex);
+
+	return size;
+}
+
+
+/**
+ * Checksum of a record, leaving out the length and the checksum itself.
+ */
+uint32 session_checkpoint::compute_checksum(const uchar *record,
+		uint32 length) {
+
+	const size_t skip = 2 * sizeof(uint32);
+	msg::object_fingerprint fp =
+		msg::object_fingerprint::compute(record + skip, length - skip);
+
+	return uint32(fp.low ^ (fp.low >> 32));
+}
+
+
+/**
+ * Serialize the body of a session record.
+ *
+ * MRIs and metering objects use their NSLP encoding, so every object
+ * type the daemon can receive can be saved.
+ */
+std::vector<uchar> session_checkpoint::encode(const session_snapshot &snap) {
+	const IE::coding_t coding = IE::protocol_v1;
+
+	uint32 size = 2 + 5 * 4 + 1 + 4;
+
+	if ( snap.ni_mri != NULL )
+		size += snap.ni_mri->get_serialized_size(coding);
+
+	if ( snap.nr_mri != NULL )
+		size += snap.nr_mri->get_serialized_size(coding);
+
+	uint32 num_objects = 0;
+
+	if ( snap.rule != NULL ) {
+		mt_policy_rule::const_iterator i;
+		for ( i = snap.rule->begin(); i != snap.rule->end(); i++ ) {
+			size += KEY_LENGTH + 2 + i->second->get_serialized_size(coding);
+
+			mt_policy_rule::const_iterator_commands c =
+				snap.rule->find_commands(i->first);
+			if ( c != snap.rule->end_commands() )
+				for ( size_t n = 0; n < c->second.size(); n++ )
+					size += 2 + c->second[n].length();
+
+			num_objects++;
+		}
+	}
+
+	NetMsg netmsg(size);
+	uint32 bytes_written;
+
+	netmsg.encode8(snap.type);
+	netmsg.encode8(snap.state);
+	netmsg.encode32(snap.msn);
+	netmsg.encode32(snap.lifetime);
+	netmsg.encode32(snap.expires);
+	netmsg.encode32(snap.upstream_peer);
+	netmsg.encode32(snap.downstream_peer);
+
+	netmsg.encode8( (snap.ni_mri != NULL ? HAS_NI_MRI : 0)
+		| (snap.nr_mri != NULL ? HAS_NR_MRI : 0) );
+
+	if ( snap.ni_mri != NULL )
+		snap.ni_mri->serialize(netmsg, coding, bytes_written);
+
+	if ( snap.nr_mri != NULL )
+		snap.nr_mri->serialize(netmsg, coding, bytes_written);
+
+	netmsg.encode32(num_objects);
+
+	if ( snap.rule != NULL ) {
+		for ( mt_policy_rule::const_iterator i = snap.rule->begin();
+				i != snap.rule->end(); i++ ) {
+
+			std::string key = i->first.to_string();
+			netmsg.encode(reinterpret_cast<const uchar *>(key.data()),
+				KEY_LENGTH);
+
+			mt_policy_rule::const_iterator_commands c =
+				snap.rule->find_commands(i->first);
+
+			if ( c != snap.rule->end_commands() ) {
+				netmsg.encode16(c->second.size());
+				for ( size_t n = 0; n < c->second.size(); n++ ) {
+					netmsg.encode16(c->second[n].length());
+					netmsg.encode(reinterpret_cast<const uchar *>(
+						c->second[n].data()), c->second[n].length());
+				}
+			}
+			else {
+				netmsg.encode16(0);
+			}
+
+			i->second->serialize(netmsg, coding, bytes_written);
+		}
+	}
+
+	return std::vector<uchar>(netmsg.get_buffer(), netmsg.get_buffer() + size);
+}
+
+
+/**
+ * Deserialize the body of a session record.
+ *
+ * @return the snapshot, without its session ID, or NULL on error
+ */
+session_snapshot *session_checkpoint::decode(const uchar *body,
+		uint32 length) {
+
+	const IE::coding_t coding = IE::protocol_v1;
+
+	NetMsg netmsg(const_cast<uchar *>(body), length, true); // copies the data
+	IEErrorList errlist;
+	uint32 bytes_read;
+
+	session_snapshot *snap = new session_snapshot();
+
+	// NetMsg and the deserializers throw on truncated input.
+	try {
+		snap->type = netmsg.decode8();
+		snap->state = netmsg.decode8();
+		snap->msn = netmsg.decode32();
+		snap->lifetime = netmsg.decode32();
+		snap->expires = netmsg.decode32();
+		snap->upstream_peer = netmsg.decode32();
+		snap->downstream_peer = netmsg.decode32();
+
+		uint8 mris = netmsg.decode8();
+
+		if ( mris & HAS_NI_MRI ) {
+			snap->ni_mri = new ntlp::mri_pathcoupled();
+			if ( snap->ni_mri->deserialize(netmsg, coding, errlist,
+					bytes_read, false) == NULL ) {
+				delete snap;
+				return NULL;
+			}
+		}
+
+		if ( mris & HAS_NR_MRI ) {
+			snap->nr_mri = new ntlp::mri_pathcoupled();
+			if ( snap->nr_mri->deserialize(netmsg, coding, errlist,
+					bytes_read, false) == NULL ) {
+				delete snap;
+				return NULL;
+			}
+		}
+
+		snap->rule = new mt_policy_rule();
+		uint32 num_objects = netmsg.decode32();
+
+		for ( uint32 n = 0; n < num_objects; n++ ) {
+			char key_str[KEY_LENGTH + 1];
+			netmsg.decode(reinterpret_cast<uchar *>(key_str), KEY_LENGTH);
+			key_str[KEY_LENGTH] = '\0';
+
+			mspec_rule_key key;
+			if ( ! key.from_string(key_str) ) {
+				delete snap;
+				return NULL;
+			}
+
+			std::vector<std::string> names(netmsg.decode16());
+			for ( size_t k = 0; k < names.size(); k++ ) {
+				std::vector<uchar> name(netmsg.decode16());
+				if ( ! name.empty() )
+					netmsg.decode(&name[0], name.size());
+				names[k].assign(name.begin(), name.end());
+			}
+
+			IE *ie = msg::MNSLP_IEManager::instance()->deserialize(
+				netmsg, msg::cat_mnslp_object, coding, errlist, bytes_read,
+				false);
+
+			msg::mnslp_mspec_object *object =
+				dynamic_cast<msg::mnslp_mspec_object *>(ie);
+
+			if ( object == NULL ) {
+				delete ie;
+				delete snap;
+				return NULL;
+			}
+
+			snap->rule->set_object(key, object);
+			snap->rule->set_commands(key, names);
+		}
+	}
+	catch ( ... ) {
+		delete snap;
+		return NULL;
+	}
+
+	return snap;
+}
+
+
+// EOF
@@ -0,0 +1,132 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file session_mailbox.cpp
+/// Lock-free queue of the events waiting for a session.
+/// ----------------------------------------------------------
+/// $Id: session_mailbox.cpp 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./src/session_mailbox.cpp $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#include <assert.h>
+
+#include "session_mailbox.h"
+#include "events.h"
+
+
+using namespace mnslp;
+
+
+session_mailbox::session_mailbox()
+		: head(NULL), pending(NULL), claimed(0) {
+
+	// nothing to do
+}
+
+
+session_mailbox::~session_mailbox() {
+	event *evt;
+
+	while ( (evt = take()) != NULL )
+		delete evt;
+}
+
+
+/**
+ * Queue an event and take ownership of it.
+ *
+ * May be called by any thread. The caller has to try to claim() the
+ * mailbox afterwards.
+ */
+void session_mailbox::post(event *evt) {
+	node *n = new node;
+	n->evt = evt;
+
+	do {
+		n->next = head;
+	}
+	while ( ! __sync_bool_compare_and_swap(&head, n->next, n) );
+}
+
+
+/**
+ * Try to become the thread processing this mailbox's events.
+ *
+ * @return true if the caller owns the mailbox now
+ */
+bool session_mailbox::claim() {
+	return __sync_bool_compare_and_swap(&claimed, 0, 1);
+}
+
+
+/**
+ * Give up the claim, unless new events have been posted.
+ *
+ * The owner has to take() all events before.
+ *
+ * @return true if the caller still owns the mailbox
+ */
+bool session_mailbox::unclaim() {
+	assert( pending == NULL );
+
+	// This is a full barrier, head is read after the claim is gone.
+	__sync_bool_compare_and_swap(&claimed, 1, 0);
+
+	// A poster that failed to claim relies on us to see its event.
+	if ( head != NULL )
+		return claim();
+
+	return false;
+}
+
+
+/**
+ * Return the oldest queued event, or NULL if there is none.
+ *
+ * Only the owner may call this. The caller takes ownership of the event.
+ */
+event *session_mailbox::take() {
+
+	if ( pending == NULL ) {
+		node *n = __sync_lock_test_and_set(&head, (node *) NULL);
+
+		// Reverse the stack, the oldest event comes first.
+		while ( n != NULL ) {
+			node *next = n->next;
+			n->next = pending;
+			pending = n;
+			n = next;
+		}
+
+		if ( pending == NULL )
+			return NULL;
+	}
+
+	node *n = pending;
+	pending = n->next;
+
+	event *evt = n->evt;
+	delete n;
+
+	return evt;
+}
+
+// EOF
@@ -30,6 +30,7 @@
 #include <openssl/rand.h>
 
 #include "logfile.h"
+#include "mnslp_log.h"
 
 #include "session.h"
 #include "session_manager.h"
@@ -42,8 +43,8 @@ using protlib::uint32;
 
 #define LogError(msg) ERRLog("session_manager", msg)
 #define LogWarn(msg) WLog("session_manager", msg)
-#define LogInfo(msg) ILog("session_manager", msg)
-#define LogDebug(msg) DLog("session_manager", msg)
+#define LogInfo(msg) MNSLP_LOG_INFO("session_manager", msg)
+#define LogDebug(msg) MNSLP_LOG_DEBUG("session_manager", msg)
 
 
 #define install_cleanup_handler(m) \
@@ -77,11 +78,12 @@ session_manager::session_manager(mnslp_config *conf)
 /**
  * Destructor.
  *
- * Deletes all sessions in the session table.
+ * Releases all sessions in the session table. Sessions still referenced
+ * elsewhere are deleted by their last release().
  */
 session_manager::~session_manager() {
 	for ( c_iter i = session_table.begin(); i != session_table.end(); i++ )
-		delete i->second;
+		i->second->release();
 
 	pthread_mutex_destroy(&mutex);
 }
@@ -105,6 +107,8 @@ session_id session_manager::create_unique_id() const {
 
 /**
  * Creates an initiator session and adds it to the session table.
+ *
+ * The caller gets a reference to the session and has to release it.
  */
 ni_session *session_manager::create_ni_session() {
 	ni_session *s;
@@ -114,6 +118,7 @@ ni_session *session_manager::create_ni_session() {
 
 	s = new ni_session(create_unique_id(), config);
 	session_table[s->get_id()] = s;
+	s->acquire();
 
 	LogInfo("created new NI session " << s->get_id());
 
@@ -126,17 +131,32 @@ ni_session *session_manager::create_ni_session() {
 
 /**
  * Creates a forwarder session and adds it to the session table.
+ *
+ * Another thread may have created a session with this ID since the caller
+ * looked it up. In this case, that session is returned instead.
+ *
+ * The caller gets a reference to the session and has to release it.
  */
-nf_session *session_manager::create_nf_session(const session_id &sid) {
-	nf_session *s;
+session *session_manager::create_nf_session(const session_id &sid) {
+	session *s;
 
 	install_cleanup_handler(&mutex);
 	pthread_mutex_lock(&mutex);
 
-	s = new nf_session(sid, config);
-	session_table[s->get_id()] = s;
+	c_iter i = session_table.find(sid);
 
-	LogInfo("created new NF session " << s->get_id());
+	if ( i != session_table.end() ) {
+		s = i->second;
+		LogDebug("session " << sid << " exists already");
+	}
+	else {
+		s = new nf_session(sid, config);
+		session_table[sid] = s;
+
+		LogInfo("created new NF session " << s->get_id());
+	}
+
+	s->acquire();
 
 	pthread_mutex_unlock(&mutex);
 	uninstall_cleanup_handler();
@@ -147,17 +167,32 @@ nf_session *session_manager::create_nf_session(const session_id &sid) {
 
 /**
  * Creates a responder session and adds it to the session table.
+ *
+ * Another thread may have created a session with this ID since the caller
+ * looked it up. In this case, that session is returned instead.
+ *
+ * The caller gets a reference to the session and has to release it.
  */
-nr_session *session_manager::create_nr_session(const session_id &sid) {
-	nr_session *s;
+session *session_manager::create_nr_session(const session_id &sid) {
+	session *s;
 
 	install_cleanup_handler(&mutex);
 	pthread_mutex_lock(&mutex);
 
-	s = new nr_session(sid, config);
-	session_table[s->get_id()] = s;
+	c_iter i = session_table.find(sid);
+
+	if ( i != session_table.end() ) {
+		s = i->second;
+		LogDebug("session " << sid << " exists already");
+	}
+	else {
+		s = new nr_session(sid, config);
+		session_table[sid] = s;
+
+		LogInfo("created new NR session " << s->get_id());
+	}
 
-	LogInfo("created new NR session " << s->get_id());
+	s->acquire();
 
 	pthread_mutex_unlock(&mutex);
 	uninstall_cleanup_handler();
@@ -170,7 +205,9 @@ nr_session *session_manager::create_nr_session(const session_id &sid) {
  * Retrieve a session by its session ID.
  *
  * The returned session may be changed, but it is still stored in the session
- * table.
+ * table. The caller gets a reference to the session and has to release it,
+ * so the session isn't deleted while in use even if another thread removes
+ * it from the table.
  *
  * Note that this method is almost a pure "const" implementation. Even if
  * the session isn't found, the session table won't be changed. This is in
@@ -191,8 +228,10 @@ session *session_manager::get_session(const session_id &sid) {
 
 	c_iter i = session_table.find(sid);
 
-	if ( i != session_table.end() )
+	if ( i != session_table.end() ) {
 		s = i->second;
+		s->acquire();
+	}
 
 	pthread_mutex_unlock(&mutex);
 	uninstall_cleanup_handler();
@@ -201,13 +240,70 @@ session *session_manager::get_session(const session_id &sid) {
 }
 
 
+/**
+ * Return the number of sessions in the session table.
+ *
+ * This includes sessions in state FINAL that haven't been removed yet.
+ */
+size_t session_manager::get_session_count() {
+	install_cleanup_handler(&mutex);
+	pthread_mutex_lock(&mutex);
+
+	size_t count = session_table.size();
+
+	pthread_mutex_unlock(&mutex);
+	uninstall_cleanup_handler();
+
+	return count;
+}
+
+
+/**
+ * Report the memory used by the sessions of the given role.
+ *
+ * Sessions must not process events meanwhile, so this may only be called
+ * while the dispatcher threads are stopped. The slab figures come from the
+ * role's slab, which is shared by all session managers of the process.
+ */
+session_memory_usage
+session_manager::get_memory_usage(session::session_type_t role) {
+	session_memory_usage usage;
+
+	install_cleanup_handler(&mutex);
+	pthread_mutex_lock(&mutex);
+
+	for ( c_iter i = session_table.begin(); i != session_table.end(); i++ )
+		if ( i->second->get_session_type() == role )
+			i->second->get_memory_usage(usage);
+
+	pthread_mutex_unlock(&mutex);
+	uninstall_cleanup_handler();
+
+	const session_slab *slab = NULL;
+
+	switch ( role ) {
+		case session::st_initiator:	slab = &ni_session::get_slab(); break;
+		case session::st_forwarder:	slab = &nf_session::get_slab(); break;
+		case session::st_receiver:	slab = &nr_session::get_slab(); break;
+	}
+
+	if ( slab != NULL ) {
+		usage.object_bytes = slab->get_objects_in_use() * slab->get_slot_size();
+		usage.reserved_bytes = slab->get_bytes_reserved();
+	}
+
+	return usage;
+}
+
+
 /**
  * Remove a session from the session table.
  *
  * Remove the session with the given session ID from the session table. If
  * there is no session with this ID, NULL is returned.
  *
- * The returned session itself is *not* deleted.
+ * The returned session itself is *not* deleted. The caller takes over the
+ * table's reference and has to release it.
  *
  * @param sid a session ID
  * @return the session, or NULL if it isn't found
@@ -223,7 +319,7 @@ session *session_manager::remove_session(const session_id &sid) {
 	// Note: session_table[sid] creates a session if none existed before
 	session_table.erase(sid);
 
-	LogInfo("removed session " << s->get_id());
+	LogInfo("removed session " << sid);
 
 	pthread_mutex_unlock(&mutex);
 	uninstall_cleanup_handler();
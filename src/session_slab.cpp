@@ -0,0 +1,181 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file session_slab.cpp
+/// Fixed-size allocator for session objects.
+/// ----------------------------------------------------------
+/// $Id: session_slab.cpp 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./src/session_slab.cpp $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#include <stdlib.h>
+#include <new>
+
+#include "session_slab.h"
+
+
+using namespace mnslp;
+
+
+const size_t session_slab::CACHE_LINE;
+
+
+/**
+ * Constructor.
+ *
+ * No memory is allocated until the first object is requested.
+ */
+session_slab::session_slab(size_t object_size, size_t objects_per_block)
+		: object_size(object_size),
+		  slot_size((object_size + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE),
+		  objects_per_block(objects_per_block > 0 ? objects_per_block : 1),
+		  free_list(NULL), in_use(0) {
+
+	pthread_mutex_init(&mutex, NULL);
+}
+
+
+/**
+ * Destructor.
+ *
+ * Releases all blocks. The objects allocated from this slab must have
+ * been deleted before.
+ */
+session_slab::~session_slab() {
+	for ( size_t i = 0; i < blocks.size(); i++ )
+		free(blocks[i]);
+
+	pthread_mutex_destroy(&mutex);
+}
+
+
+/**
+ * Return memory for an object of the given size.
+ *
+ * Throws std::bad_alloc if no memory is available.
+ */
+void *session_slab::allocate(size_t size) {
+	if ( size != object_size )
+		return ::operator new(size);
+
+	pthread_mutex_lock(&mutex);
+
+	if ( free_list == NULL ) {
+		try {
+			add_block();
+		}
+		catch ( ... ) {
+			pthread_mutex_unlock(&mutex);
+			throw;
+		}
+	}
+
+	free_slot *slot = free_list;
+	free_list = slot->next;
+	in_use++;
+
+	pthread_mutex_unlock(&mutex);
+
+	return slot;
+}
+
+
+/**
+ * Return an object's memory to the slab.
+ *
+ * The size has to be the same that was passed to allocate().
+ */
+void session_slab::deallocate(void *p, size_t size) {
+	if ( p == NULL )
+		return;
+
+	if ( size != object_size ) {
+		::operator delete(p);
+		return;
+	}
+
+	free_slot *slot = static_cast<free_slot *>(p);
+
+	pthread_mutex_lock(&mutex);
+
+	slot->next = free_list;
+	free_list = slot;
+	in_use--;
+
+	pthread_mutex_unlock(&mutex);
+}
+
+
+/**
+ * Return the number of objects currently allocated from this slab.
+ */
+size_t session_slab::get_objects_in_use() const {
+	pthread_mutex_lock(&mutex);
+	size_t n = in_use;
+	pthread_mutex_unlock(&mutex);
+
+	return n;
+}
+
+
+/**
+ * Return the number of bytes held by this slab, including free slots.
+ */
+size_t session_slab::get_bytes_reserved() const {
+	pthread_mutex_lock(&mutex);
+	size_t n = blocks.size() * objects_per_block * slot_size;
+	pthread_mutex_unlock(&mutex);
+
+	return n;
+}
+
+
+/**
+ * Allocate a new block and put its slots on the free list.
+ *
+ * Called with the mutex held.
+ */
+void session_slab::add_block() {
+	void *block = NULL;
+
+	if ( posix_memalign(&block, CACHE_LINE, objects_per_block * slot_size) )
+		throw std::bad_alloc();
+
+	try {
+		blocks.push_back(block);
+	}
+	catch ( ... ) {
+		free(block);
+		throw;
+	}
+
+	// Link the slots in ascending address order.
+	char *base = static_cast<char *>(block);
+
+	for ( size_t i = objects_per_block; i > 0; i-- ) {
+		free_slot *slot = reinterpret_cast<free_slot *>(
+			base + ( i - 1 ) * slot_size);
+		slot->next = free_list;
+		free_list = slot;
+	}
+}
+
+// EOF
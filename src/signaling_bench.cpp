@@ -0,0 +1,576 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file signaling_bench.cpp
+/// Drive NI/NF/NR signaling flows in-process and time them.
+/// ----------------------------------------------------------
+/// $Id: signaling_bench.cpp 2558 2015-03-10 amarentes $
+/// $HeadURL: https://./src/signaling_bench.cpp $
+// ===========================================================
+//                      
+// Copyright (C) 2012-2015, all rights reserved by
+// - System and Computing Engineering, Universidad de los Andes
+//
+// More information and contact:
+// https://www.uniandes.edu.co/
+//                      
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <vector>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "logfile.h"
+#include "gist_conf.h"
+#include "network_message.h"
+
+#include "mnslp_config.h"
+#include "mnslp_daemon.h"
+#include "dispatcher.h"
+#include "cpu_placement.h"
+#include "events.h"
+#include "msg/mnslp_ie.h"
+#include "msg/mnslp_msg.h"
+#include "msg/mnslp_ipfix_message.h"
+
+using namespace protlib;
+using namespace protlib::log;
+using namespace mnslp;
+using namespace mnslp::msg;
+
+
+namespace ntlp {
+// configuration class
+gistconf gconf;
+}
+
+logfile commonlog("", false, true); // no colours, quiet start
+logfile &protlib::log::DefaultLog(commonlog);
+
+
+/*
+ * Every allocation of a thread is counted, so the allocations per event
+ * include the ones of the loopback, which stands in for GIST.
+ */
+static __thread unsigned long num_allocations = 0;
+
+void *operator new(size_t size) throw (std::bad_alloc) {
+	num_allocations++;
+
+	void *p = malloc(size == 0 ? 1 : size);
+	if ( p == NULL )
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) throw () {
+	free(p);
+}
+
+
+static double now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+
+/*
+ * The three nodes of the path. Downstream messages go from the NI towards
+ * the NR, responses go back.
+ */
+enum node_t { NI = 0, NF = 1, NR = 2, NUM_NODES = 3 };
+
+
+class bench_config : public mnslp_config {
+  public:
+	bench_config() {
+		repository_init();
+		setRepository();
+		ntlp::gconf.setRepository();
+	}
+};
+
+
+class loopback;
+
+/*
+ * A dispatcher that hands its messages to the loopback and only records
+ * the timers it is asked to start.
+ */
+class bench_dispatcher : public dispatcher {
+  public:
+	bench_dispatcher(session_manager *m, policy_rule_installer *p,
+					 mnslp_config *conf, loopback *net, node_t node)
+		: dispatcher(m, p, conf), net(net), node(node), next_timer_id(1) { }
+
+	virtual void send_message(msg::ntlp_msg *msg) throw ();
+
+	virtual id_t start_timer(const session *s, int secs) throw () {
+		id_t id = next_timer_id++;
+		timers[s->get_id()] = id;
+		return id;
+	}
+
+	virtual void report_async_event(std::string msg) throw () { }
+
+	// The initiator leaves the metering to the nodes on the path.
+	virtual bool check(const msg::mnslp_mspec_object *object) {
+		return node != NI;
+	}
+
+	/// The last timer started for a session.
+	id_t get_timer(const session_id &sid) const {
+		__gnu_cxx::hash_map<session_id, id_t>::const_iterator i = timers.find(sid);
+		return i == timers.end() ? 0 : i->second;
+	}
+
+  private:
+	loopback *net;
+	node_t node;
+	id_t next_timer_id;
+	__gnu_cxx::hash_map<session_id, id_t> timers;
+};
+
+
+/*
+ * Carries the messages between the nodes. Each message is serialized and
+ * parsed again, the way the GIST mapper does it, and queued as an event
+ * for the next node.
+ */
+class loopback {
+  public:
+	struct pending {
+		node_t node;
+		event *evt;
+	};
+
+	loopback() : num_messages(0), num_bytes(0) { }
+
+	void deliver(node_t from, msg::ntlp_msg *msg);
+
+	void enqueue(node_t to, event *evt) {
+		pending p = { to, evt };
+		queue.push_back(p);
+	}
+
+	bool empty() const { return queue.empty(); }
+
+	pending dequeue() {
+		pending p = queue.front();
+		queue.pop_front();
+		return p;
+	}
+
+	/// Sessions started by the initiator.
+	std::vector<session_id> sessions;
+
+	unsigned long num_messages;
+	unsigned long num_bytes;
+
+  private:
+	std::deque<pending> queue;
+};
+
+
+void bench_dispatcher::send_message(msg::ntlp_msg *msg) throw () {
+	net->deliver(node, msg);
+}
+
+
+void loopback::deliver(node_t from, msg::ntlp_msg *msg) {
+	const mnslp_msg *m = msg->get_mnslp_msg();
+
+	bool configure = dynamic_cast<const mnslp_configure *>(m) != NULL;
+	bool downstream = configure
+			|| dynamic_cast<const mnslp_refresh *>(m) != NULL;
+
+	if ( from == NI && configure )
+		sessions.push_back(msg->get_session_id());
+
+	int to = downstream ? from + 1 : from - 1;
+	if ( to < NI || to >= NUM_NODES ) {
+		delete msg;
+		return;
+	}
+
+	uint32 bytes_written;
+	const uchar *wire = msg->get_serialized(bytes_written);
+
+	NetMsg received(const_cast<uchar *>(wire), bytes_written);
+	IEErrorList errlist;
+	uint32 num_read;
+
+	IE *ie = MNSLP_IEManager::instance()->deserialize(received, cat_mnslp_msg,
+		IE::protocol_v1, errlist, num_read, false);
+	assert( ie != NULL );
+
+	ntlp_msg *ret = new ntlp_msg(msg->get_session_id(),
+		dynamic_cast<mnslp_msg *>(ie), msg->get_mri()->copy(),
+		msg->get_sii_handle());
+	ret->set_serialized(wire, bytes_written);
+
+	enqueue(static_cast<node_t>(to), 
+		new msg_event(new session_id(msg->get_session_id()), ret, to == NR));
+
+	num_messages++;
+	num_bytes += bytes_written;
+	delete msg;
+}
+
+
+struct bench_node {
+	bench_node(mnslp_config *conf, loopback *net, node_t type)
+		: mgr(conf), installer(conf), disp(&mgr, &installer, conf, net, type) { }
+
+	session_manager mgr;
+	nop_policy_rule_installer installer;
+	bench_dispatcher disp;
+};
+
+
+/*
+ * Results of one stage of the session life cycle.
+ */
+struct stage_result {
+	stage_result(const char *name)
+		: name(name), elapsed(0), allocations(0) { }
+
+	void report(std::ostream &out) {
+		std::sort(latencies.begin(), latencies.end());
+		size_t n = latencies.size();
+
+		out << std::setw(10) << name << ": " << n << " events, "
+			<< (unsigned long) ( n / elapsed ) << " events/s, p50 "
+			<< std::fixed << std::setprecision(1)
+			<< ( n ? latencies[n / 2] * 1e6 : 0 ) << " us, p99 "
+			<< ( n ? latencies[n * 99 / 100] * 1e6 : 0 ) << " us, "
+			<< ( n ? (double) allocations / n : 0 ) << " allocations/event"
+			<< std::endl;
+	}
+
+	const char *name;
+	double elapsed;
+	unsigned long allocations;
+	std::vector<double> latencies;	///< Seconds spent in process()
+};
+
+
+/*
+ * Process events until all nodes are idle.
+ */
+static void run_stage(loopback &net, bench_node *nodes[], stage_result &result) {
+	double start = now();
+
+	while ( ! net.empty() ) {
+		loopback::pending p = net.dequeue();
+
+		unsigned long allocations = num_allocations;
+		double t0 = now();
+
+		nodes[p.node]->disp.process(p.evt);
+		delete p.evt;
+
+		result.latencies.push_back(now() - t0);
+		result.allocations += num_allocations - allocations;
+	}
+
+	result.elapsed = now() - start;
+}
+
+
+/*
+ * An MSPEC object like the ones of test_client: a filter on the flow in an
+ * option template and the counters to export in a data template.
+ */
+static mnslp_ipfix_message *create_mspec_object() {
+	mnslp_ipfix_message *mess = new mnslp_ipfix_message(0, IPFIX_VERSION, true);
+
+	uint16_t templid = mess->new_data_template(2);
+	mess->add_field(templid, 0, IPFIX_FT_OCTETDELTACOUNT, 8);
+	mess->add_field(templid, 0, IPFIX_FT_PACKETDELTACOUNT, 8);
+
+	uint8_t addr[4] = { 10, 0, 2, 15 };
+	uint16_t port = 80;
+	uint8_t protocol = 6;
+
+	uint16_t optid = mess->new_option_template(3);
+	mess->add_field(optid, 0, IPFIX_FT_SOURCEIPV4ADDRESS, 4);
+	mess->add_field(optid, 0, IPFIX_FT_TCPDESTINATIONPORT, 2);
+	mess->add_field(optid, 0, IPFIX_FT_PROTOCOLIDENTIFIER, 1);
+
+	mnslp_ipfix_data_record data(optid);
+	data.insert_field(0, IPFIX_FT_SOURCEIPV4ADDRESS, 
+		mess->get_field_definition(0, IPFIX_FT_SOURCEIPV4ADDRESS)
+			.get_ipfix_value_field(addr, 4));
+	data.insert_field(0, IPFIX_FT_TCPDESTINATIONPORT, 
+		mess->get_field_definition(0, IPFIX_FT_TCPDESTINATIONPORT)
+			.get_ipfix_value_field(port));
+	data.insert_field(0, IPFIX_FT_PROTOCOLIDENTIFIER, 
+		mess->get_field_definition(0, IPFIX_FT_PROTOCOLIDENTIFIER)
+			.get_ipfix_value_field(protocol));
+	mess->include_data(optid, data);
+
+	return mess;
+}
+
+
+/*
+ * One run of the session life cycle on its own three nodes. Runs on
+ * different threads share nothing but the configuration.
+ */
+struct bench_run {
+	bench_run(mnslp_config *conf, int num_sessions, int num_refreshes)
+		: conf(conf), num_sessions(num_sessions),
+		  num_refreshes(num_refreshes), placement(NULL), index(0),
+		  cpu(-1), configure("configure"),
+		  refresh("refresh"), teardown("teardown"), elapsed(0),
+		  allocations(0), messages(0), bytes(0) { }
+
+	void report(std::ostream &out, bool with_memory);
+
+	mnslp_config *conf;
+	int num_sessions;
+	int num_refreshes;
+	const cpu_placement *placement;
+	size_t index;			///< of the thread in the placement
+	int cpu;				///< -1 if not pinned
+
+	stage_result configure;
+	stage_result refresh;
+	stage_result teardown;
+
+	double elapsed;
+	unsigned long allocations;
+	unsigned long messages;
+	unsigned long bytes;
+	session_memory_usage memory[NUM_NODES];
+};
+
+
+void bench_run::report(std::ostream &out, bool with_memory) {
+	unsigned long events = configure.latencies.size() 
+		+ refresh.latencies.size() + teardown.latencies.size();
+
+	out << "messages: " << messages << ", " << bytes << " bytes" << std::endl;
+
+	configure.report(out);
+	refresh.report(out);
+	teardown.report(out);
+
+	static const char *const roles[NUM_NODES] = { "NI", "NF", "NR" };
+	for ( int i = 0; with_memory && i < NUM_NODES; i++ )
+		out << std::setw(10) << roles[i] << ": " << memory[i] << std::endl;
+
+	out << "total: " << (unsigned long) ( num_sessions / elapsed ) 
+		<< " sessions/s, " << (unsigned long) ( events / elapsed ) 
+		<< " events/s, " << std::fixed << std::setprecision(1)
+		<< (double) allocations / events << " allocations/event" << std::endl;
+}
+
+
+/*
+ * The pthread start routine of a run. Everything the run uses is created
+ * after the thread is pinned, so it is placed on the thread's node.
+ */
+static void *run_bench(void *arg) {
+	bench_run *run = static_cast<bench_run *>(arg);
+	mnslp_config *conf = run->conf;
+
+	loopback net;
+	bench_node ni(conf, &net, NI), nf(conf, &net, NF), nr(conf, &net, NR);
+	bench_node *nodes[NUM_NODES] = { &ni, &nf, &nr };
+
+	mnslp_ipfix_message *mspec = create_mspec_object();
+
+	unsigned long start_allocations = num_allocations;
+	double start = now();
+
+	/*
+	 * CONFIGURE and RESPONSE for all sessions.
+	 */
+	for ( int i = 0; i < run->num_sessions; i++ ) {
+		std::vector<mnslp_mspec_object *> objects;
+		objects.push_back(mspec->copy());
+
+		net.enqueue(NI, new api_configure_event(
+			hostaddress("10.0.2.15"), hostaddress("10.0.3.15"),
+			10000 + i % 50000, 80, 6, objects, 30));
+	}
+	run_stage(net, nodes, run->configure);
+
+	/*
+	 * The refresh timer is the last one an initiator in state METERING
+	 * started, firing it sends a REFRESH.
+	 */
+	for ( int r = 0; r < run->num_refreshes; r++ ) {
+		stage_result round("refresh");
+
+		for ( size_t i = 0; i < net.sessions.size(); i++ ) {
+			const session_id &sid = net.sessions[i];
+			net.enqueue(NI, new timer_event(new session_id(sid),
+				ni.disp.get_timer(sid)));
+		}
+		run_stage(net, nodes, round);
+
+		run->refresh.elapsed += round.elapsed;
+		run->refresh.allocations += round.allocations;
+		run->refresh.latencies.insert(run->refresh.latencies.end(), 
+			round.latencies.begin(), round.latencies.end());
+	}
+
+	run->memory[NI] = ni.mgr.get_memory_usage(session::st_initiator);
+	run->memory[NF] = nf.mgr.get_memory_usage(session::st_forwarder);
+	run->memory[NR] = nr.mgr.get_memory_usage(session::st_receiver);
+
+	/*
+	 * TEARDOWN, a REFRESH with a lifetime of 0, for all sessions.
+	 */
+	for ( size_t i = 0; i < net.sessions.size(); i++ )
+		net.enqueue(NI, new api_teardown_event(new session_id(net.sessions[i])));
+	run_stage(net, nodes, run->teardown);
+
+	run->elapsed = now() - start;
+	run->allocations = num_allocations - start_allocations;
+	run->messages = net.num_messages;
+	run->bytes = net.num_bytes;
+
+	delete mspec;
+
+	return NULL;
+}
+
+
+static void *run_pinned_bench(void *arg) {
+	bench_run *run = static_cast<bench_run *>(arg);
+
+	if ( ! run->placement->pin_thread(run->index) ) {
+		std::cerr << "unable to pin to CPU " << run->cpu << std::endl;
+		run->cpu = -1;
+	}
+
+	return run_bench(arg);
+}
+
+
+/*
+ * usage: signaling_bench [sessions [refreshes [threads [cpus]]]]
+ *
+ * With several threads, each one runs the whole life cycle for its own
+ * sessions. The threads are pinned to the given CPUs in turn, like the
+ * dispatcher-cpus parameter of the daemon does, and the throughput is
+ * reported together with the NUMA allocation counters, so placements can
+ * be compared.
+ */
+int main(int argc, char *argv[]) {
+	int num_sessions = 1000;
+	int num_refreshes = 3;
+	int num_threads = 1;
+	cpu_placement cpus;
+
+	if ( argc > 1 )
+		num_sessions = atoi(argv[1]);
+	if ( argc > 2 )
+		num_refreshes = atoi(argv[2]);
+	if ( argc > 3 )
+		num_threads = std::max(atoi(argv[3]), 1);
+	if ( argc > 4 )
+		cpus = cpu_placement(argv[4]);
+
+	commonlog.set_filter(ERROR_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(WARNING_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(EVENT_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(INFO_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(DEBUG_LOG, LOG_EMERG + 1);
+
+	bench_config conf;
+	init_framework();
+
+	std::vector<bench_run *> runs;
+	for ( int i = 0; i < num_threads; i++ ) {
+		runs.push_back(new bench_run(&conf, num_sessions, num_refreshes));
+
+		if ( ! cpus.empty() ) {
+			runs[i]->placement = &cpus;
+			runs[i]->index = i;
+			runs[i]->cpu = cpus.get_cpu(i);
+		}
+	}
+
+	numa_stats numa_before, numa_after;
+	bool have_numa = numa_before.read();
+
+	double start = now();
+
+	if ( num_threads == 1 && cpus.empty() ) {
+		run_bench(runs[0]);
+	}
+	else {
+		std::vector<pthread_t> threads(num_threads);
+
+		for ( int i = 0; i < num_threads; i++ )
+			pthread_create(&threads[i], NULL,
+				cpus.empty() ? run_bench : run_pinned_bench, runs[i]);
+
+		for ( int i = 0; i < num_threads; i++ )
+			pthread_join(threads[i], NULL);
+	}
+
+	double elapsed = now() - start;
+	have_numa = have_numa && numa_after.read();
+
+	std::cout << "sessions: " << num_sessions << ", refreshes: " 
+		<< num_refreshes << ", threads: " << num_threads << std::endl;
+
+	for ( int i = 0; i < num_threads; i++ ) {
+		if ( num_threads > 1 ) {
+			std::cout << "thread " << i;
+			if ( runs[i]->cpu >= 0 )
+				std::cout << " (CPU " << runs[i]->cpu << ", node "
+					<< cpu_placement::get_node(runs[i]->cpu) << ")";
+			std::cout << ":" << std::endl;
+		}
+
+		// The slabs are shared, with several threads the figures would mix.
+		runs[i]->report(std::cout, num_threads == 1);
+	}
+
+	if ( num_threads > 1 )
+		std::cout << "all threads: " << std::fixed << std::setprecision(0)
+			<< num_threads * num_sessions / elapsed << " sessions/s"
+			<< std::endl;
+
+	if ( have_numa ) {
+		unsigned long local = numa_after.local_pages - numa_before.local_pages;
+		unsigned long other = numa_after.other_pages - numa_before.other_pages;
+
+		std::cout << "numa: " << local << " local pages, " << other
+			<< " pages on other nodes (" << std::fixed << std::setprecision(1)
+			<< ( local + other ? 100.0 * other / ( local + other ) : 0 )
+			<< "% cross-node)" << std::endl;
+	}
+
+	for ( int i = 0; i < num_threads; i++ )
+		delete runs[i];
+
+	return 0;
+}
+
+// EOF
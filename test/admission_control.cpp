@@ -0,0 +1,126 @@
+/*
+ * admission_control.cpp - Test admission control for new sessions.
+ *
+ * $Id: admission_control.cpp 2571 2015-03-10 $
+ * $HeadURL: https://./test/admission_control.cpp $
+ *
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "admission_control.h"
+
+using namespace mnslp;
+
+
+class AdmissionControlTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( AdmissionControlTest );
+
+	CPPUNIT_TEST( testUnlimited );
+	CPPUNIT_TEST( testLimits );
+	CPPUNIT_TEST( testRate );
+	CPPUNIT_TEST( testIdleBuckets );
+
+	CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void testUnlimited();
+	void testLimits();
+	void testRate();
+	void testIdleBuckets();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( AdmissionControlTest );
+
+
+void AdmissionControlTest::testUnlimited() {
+	admission_control ac;
+	ac.set_backlog(100000);
+
+	for ( int i = 0; i < 1000; i++ )
+		CPPUNIT_ASSERT( ac.admit(1, 1000000, 1000000, i)
+			== admission_control::ADMITTED );
+
+	CPPUNIT_ASSERT( ac.get_count(admission_control::ADMITTED) == 1000 );
+	CPPUNIT_ASSERT( ac.get_rejected() == 0 );
+}
+
+
+void AdmissionControlTest::testLimits() {
+	admission_control ac(10, 5, 100);
+
+	CPPUNIT_ASSERT( ac.admit(1, 9, 4, 0) == admission_control::ADMITTED );
+	CPPUNIT_ASSERT( ac.admit(1, 10, 0, 0)
+		== admission_control::REJECT_SESSIONS );
+	CPPUNIT_ASSERT( ac.admit(1, 0, 5, 0)
+		== admission_control::REJECT_INSTALLS );
+
+	// Installations in progress count as pending, too.
+	ac.begin_install();
+	CPPUNIT_ASSERT( ac.admit(1, 0, 4, 0)
+		== admission_control::REJECT_INSTALLS );
+	ac.end_install();
+	CPPUNIT_ASSERT( ac.admit(1, 0, 4, 0) == admission_control::ADMITTED );
+
+	ac.set_backlog(101);
+	CPPUNIT_ASSERT( ac.admit(1, 0, 0, 0)
+		== admission_control::REJECT_BACKLOG );
+	ac.set_backlog(100);
+	CPPUNIT_ASSERT( ac.admit(1, 0, 0, 0) == admission_control::ADMITTED );
+
+	CPPUNIT_ASSERT( ac.get_count(admission_control::ADMITTED) == 3 );
+	CPPUNIT_ASSERT( ac.get_count(admission_control::REJECT_SESSIONS) == 1 );
+	CPPUNIT_ASSERT( ac.get_count(admission_control::REJECT_INSTALLS) == 2 );
+	CPPUNIT_ASSERT( ac.get_count(admission_control::REJECT_BACKLOG) == 1 );
+	CPPUNIT_ASSERT( ac.get_rejected() == 4 );
+}
+
+
+void AdmissionControlTest::testRate() {
+	admission_control ac(0, 0, 0, 10, 3);	// 10 per second, burst of 3
+
+	// A new neighbour starts with a full bucket.
+	for ( int i = 0; i < 3; i++ )
+		CPPUNIT_ASSERT( ac.admit(1, 0, 0, 1000) == admission_control::ADMITTED );
+	CPPUNIT_ASSERT( ac.admit(1, 0, 0, 1000) == admission_control::REJECT_RATE );
+
+	// Each neighbour has a bucket of its own.
+	CPPUNIT_ASSERT( ac.admit(2, 0, 0, 1000) == admission_control::ADMITTED );
+
+	// One token every 100ms.
+	CPPUNIT_ASSERT( ac.admit(1, 0, 0, 1099) == admission_control::REJECT_RATE );
+	CPPUNIT_ASSERT( ac.admit(1, 0, 0, 1100) == admission_control::ADMITTED );
+	CPPUNIT_ASSERT( ac.admit(1, 0, 0, 1100) == admission_control::REJECT_RATE );
+
+	// The bucket never holds more than the burst.
+	for ( int i = 0; i < 3; i++ )
+		CPPUNIT_ASSERT( ac.admit(1, 0, 0, 60000) == admission_control::ADMITTED );
+	CPPUNIT_ASSERT( ac.admit(1, 0, 0, 60000) == admission_control::REJECT_RATE );
+
+	CPPUNIT_ASSERT( ac.get_count(admission_control::REJECT_RATE) == 4 );
+}
+
+
+void AdmissionControlTest::testIdleBuckets() {
+	admission_control ac(0, 0, 0, 10, 3);
+
+	for ( uint32 peer = 1; peer <= 100; peer++ )
+		CPPUNIT_ASSERT( ac.admit(peer, 0, 0, 1000) == admission_control::ADMITTED );
+	CPPUNIT_ASSERT( ac.get_bucket_count() == 100 );
+
+	// Peer 1 keeps sending, its bucket never fills up again.
+	for ( int i = 0; i < 3; i++ )
+		ac.admit(1, 0, 0, 1000);
+
+	// The idle neighbours are forgotten, their buckets were full again.
+	CPPUNIT_ASSERT( ac.admit(1, 0, 0, 20000) == admission_control::ADMITTED );
+	CPPUNIT_ASSERT( ac.get_bucket_count() == 1 );
+
+	// A returning neighbour gets a full bucket.
+	for ( int i = 0; i < 3; i++ )
+		CPPUNIT_ASSERT( ac.admit(2, 0, 0, 20000) == admission_control::ADMITTED );
+	CPPUNIT_ASSERT( ac.admit(2, 0, 0, 20000) == admission_control::REJECT_RATE );
+}
+
+// EOF
@@ -0,0 +1,70 @@
+/*
+ * cpu_placement.cpp - Test the cpu_placement class.
+ *
+ * $Id: cpu_placement.cpp 2571 2015-03-10 $
+ * $HeadURL: https://./test/cpu_placement.cpp $
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "cpu_placement.h"
+
+using namespace mnslp;
+
+
+class CpuPlacementTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( CpuPlacementTest );
+
+	CPPUNIT_TEST( testParse );
+	CPPUNIT_TEST( testInvalid );
+	CPPUNIT_TEST( testPin );
+
+	CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void testParse();
+	void testInvalid();
+	void testPin();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( CpuPlacementTest );
+
+
+void CpuPlacementTest::testParse() {
+	cpu_placement cpus("0-2,5");
+
+	CPPUNIT_ASSERT( cpus.size() == 4 );
+	CPPUNIT_ASSERT( cpus.get_cpu(0) == 0 );
+	CPPUNIT_ASSERT( cpus.get_cpu(2) == 2 );
+	CPPUNIT_ASSERT( cpus.get_cpu(3) == 5 );
+
+	// Threads beyond the list start over.
+	CPPUNIT_ASSERT( cpus.get_cpu(4) == 0 );
+}
+
+
+void CpuPlacementTest::testInvalid() {
+	CPPUNIT_ASSERT( cpu_placement("").empty() );
+	CPPUNIT_ASSERT( cpu_placement("x,-1,7-6").empty() );
+
+	cpu_placement cpus("1,x,3");
+	CPPUNIT_ASSERT( cpus.size() == 2 );
+	CPPUNIT_ASSERT( cpus.get_cpu(1) == 3 );
+
+	CPPUNIT_ASSERT( ! cpu_placement().pin_thread(0) );
+}
+
+
+void CpuPlacementTest::testPin() {
+	cpu_set_t saved;
+	CPPUNIT_ASSERT( sched_getaffinity(0, sizeof(saved), &saved) == 0 );
+
+	// CPU 0 is always there, but a restricted test host may refuse it.
+	if ( cpu_placement("0").pin_thread(0) )
+		CPPUNIT_ASSERT( cpu_placement::get_current_cpu() == 0 );
+
+	sched_setaffinity(0, sizeof(saved), &saved);
+}
+
+// EOF
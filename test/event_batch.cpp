@@ -0,0 +1,203 @@
+/*
+ * event_batch.cpp - Test the event_batch class.
+ *
+ * $Id: event_batch.cpp 2438 2015-03-10 $
+ * $HeadURL: https://./test/event_batch.cpp $
+ *
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "event_batch.h"
+
+using namespace mnslp;
+using namespace protlib;
+
+
+class EventBatchTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( EventBatchTest );
+
+	CPPUNIT_TEST( testAdd );
+	CPPUNIT_TEST( testGroupBySession );
+	CPPUNIT_TEST( testDequeueBatch );
+	CPPUNIT_TEST( testClassify );
+	CPPUNIT_TEST( testLanes );
+
+	CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void testAdd();
+	void testGroupBySession();
+	void testDequeueBatch();
+	void testClassify();
+	void testLanes();
+
+  private:
+	event *create_event(uint32 sid) {
+		return new route_changed_bad_event(
+			new session_id(uint128(sid, 0, 0, 0)));
+	}
+
+	uint32 get_sid(const event_batch &batch, size_t i) {
+		return batch.get(i)->get_session_id()->get_id().w1;
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( EventBatchTest );
+
+
+void EventBatchTest::testAdd() {
+	event_batch batch(4);
+
+	CPPUNIT_ASSERT( batch.empty() );
+
+	batch.add(NULL);
+	CPPUNIT_ASSERT( batch.empty() );
+
+	batch.add(create_event(1));
+	batch.add(create_event(2));
+	CPPUNIT_ASSERT( batch.size() == 2 );
+
+	batch.clear();
+	CPPUNIT_ASSERT( batch.empty() );
+
+	// Left over events are deleted by the destructor.
+	batch.add(create_event(3));
+}
+
+
+void EventBatchTest::testGroupBySession() {
+	event_batch batch(8);
+
+	batch.add(create_event(1));
+	batch.add(create_event(2));
+	batch.add(new network_notification_event());
+	batch.add(create_event(1));
+	batch.add(create_event(3));
+	batch.add(create_event(2));
+	batch.add(create_event(1));
+
+	event *first = batch.get(0);
+	event *third = batch.get(3);
+
+	batch.group_by_session();
+
+	CPPUNIT_ASSERT( batch.size() == 7 );
+	CPPUNIT_ASSERT( get_sid(batch, 0) == 1 );
+	CPPUNIT_ASSERT( get_sid(batch, 1) == 1 );
+	CPPUNIT_ASSERT( get_sid(batch, 2) == 1 );
+	CPPUNIT_ASSERT( get_sid(batch, 3) == 2 );
+	CPPUNIT_ASSERT( get_sid(batch, 4) == 2 );
+	CPPUNIT_ASSERT( batch.get(5)->get_session_id() == NULL );
+	CPPUNIT_ASSERT( get_sid(batch, 6) == 3 );
+
+	// Events of a session keep their relative order.
+	CPPUNIT_ASSERT( batch.get(0) == first );
+	CPPUNIT_ASSERT( batch.get(1) == third );
+}
+
+
+void EventBatchTest::testDequeueBatch() {
+	FastQueue queue;
+	std::vector<message *> msgs;
+
+	for ( int i = 0; i < 5; i++ )
+		queue.enqueue(new message(message::type_transport));
+
+	CPPUNIT_ASSERT( dequeue_batch(&queue, msgs, 3, 10) == 3 );
+	CPPUNIT_ASSERT( msgs.size() == 3 );
+
+	// A partial batch is returned when the queue runs empty.
+	CPPUNIT_ASSERT( dequeue_batch(&queue, msgs, 3, 10) == 2 );
+	CPPUNIT_ASSERT( msgs.size() == 5 );
+
+	CPPUNIT_ASSERT( dequeue_batch(&queue, msgs, 3, 10) == 0 );
+
+	for ( size_t i = 0; i < msgs.size(); i++ )
+		delete msgs[i];
+}
+
+
+void EventBatchTest::testClassify() {
+	timer_event t(NULL, 1);
+	api_teardown_event td(NULL);
+	route_changed_bad_event rc(NULL);
+	api_configure_event c(hostaddress("10.0.0.1"), hostaddress("10.0.0.2"));
+
+	CPPUNIT_ASSERT( event_lanes::classify(&t) == event_lanes::LANE_TIMER );
+	CPPUNIT_ASSERT( event_lanes::classify(&td) == event_lanes::LANE_REFRESH );
+	CPPUNIT_ASSERT( event_lanes::classify(&rc) == event_lanes::LANE_RESPONSE );
+	CPPUNIT_ASSERT( event_lanes::classify(&c) == event_lanes::LANE_NEW );
+}
+
+
+void EventBatchTest::testLanes() {
+	event_lanes lanes("2,1,1,1");
+
+	CPPUNIT_ASSERT( lanes.empty() );
+	CPPUNIT_ASSERT( lanes.next() == NULL );
+	CPPUNIT_ASSERT( lanes.get_weight(event_lanes::LANE_TIMER) == 2 );
+
+	// Four route changes followed by four timers.
+	for ( uint32 i = 1; i <= 4; i++ )
+		lanes.add(create_event(i));
+	for ( uint32 i = 5; i <= 8; i++ )
+		lanes.add(new timer_event(new session_id(uint128(i, 0, 0, 0)), i));
+	lanes.add(NULL);
+
+	CPPUNIT_ASSERT( lanes.size() == 8 );
+	CPPUNIT_ASSERT( lanes.size(event_lanes::LANE_TIMER) == 4 );
+	CPPUNIT_ASSERT( lanes.size(event_lanes::LANE_RESPONSE) == 4 );
+
+	// Two timers per response, each lane in order; empty lanes are skipped.
+	const uint32 expected[] = { 5, 6, 1, 7, 8, 2, 3, 4 };
+
+	for ( int i = 0; i < 8; i++ ) {
+		event *evt = lanes.next();
+		CPPUNIT_ASSERT( evt != NULL );
+		CPPUNIT_ASSERT( evt->get_session_id()->get_id().w1 == expected[i] );
+		delete evt;
+	}
+
+	CPPUNIT_ASSERT( lanes.empty() );
+
+	// A timer doesn't overtake a waiting event of its session.
+	lanes.add(create_event(1));
+	lanes.add(new timer_event(new session_id(uint128(1, 0, 0, 0)), 1));
+	lanes.add(new timer_event(new session_id(uint128(2, 0, 0, 0)), 2));
+
+	CPPUNIT_ASSERT( lanes.size(event_lanes::LANE_RESPONSE) == 2 );
+	CPPUNIT_ASSERT( lanes.size(event_lanes::LANE_TIMER) == 1 );
+
+	event *first = lanes.next();
+	CPPUNIT_ASSERT( is_timer(first) );
+	CPPUNIT_ASSERT( first->get_session_id()->get_id().w1 == 2 );
+	delete first;
+
+	event *second = lanes.next();
+	CPPUNIT_ASSERT( ! is_timer(second) );
+	delete second;
+
+	event *third = lanes.next();
+	CPPUNIT_ASSERT( is_timer(third) );
+	CPPUNIT_ASSERT( third->get_session_id()->get_id().w1 == 1 );
+	delete third;
+
+	// Once session 1 has no waiting events, its timers use their lane again.
+	lanes.add(new timer_event(new session_id(uint128(1, 0, 0, 0)), 1));
+	CPPUNIT_ASSERT( lanes.size(event_lanes::LANE_TIMER) == 1 );
+	CPPUNIT_ASSERT( lanes.size(event_lanes::LANE_RESPONSE) == 0 );
+
+	lanes.clear();
+	CPPUNIT_ASSERT( lanes.empty() );
+
+	// Missing or invalid weights are 1. Left over events are deleted.
+	event_lanes defaults("3,x");
+	CPPUNIT_ASSERT( defaults.get_weight(event_lanes::LANE_TIMER) == 3 );
+	CPPUNIT_ASSERT( defaults.get_weight(event_lanes::LANE_REFRESH) == 1 );
+	CPPUNIT_ASSERT( defaults.get_weight(event_lanes::LANE_NEW) == 1 );
+	defaults.add(create_event(1));
+}
+
+// EOF
@@ -4,6 +4,8 @@
  * $Id: generic_object_test.cpp 1733 2014-11-05 14:55:00 $
  * $HeadURL: https://./test/generic_object_test.cpp $
  */
+#include <cstring>
+
 #include "generic_object_test.h"
 
 using namespace mnslp::msg;
@@ -112,6 +114,90 @@ void GenericObjectTest::testReadWrite() {
 }
 
 
+// The cached wire format has to follow changes made after serializing.
+void GenericObjectTest::testEncodingCache() {
+	mnslp_object *p1 = createInstance1();
+	mnslp_object *p2 = createInstance1();
+
+	const IE::coding_t CODING = IE::protocol_v1;
+
+	NetMsg msg1( p1->get_serialized_size(CODING) );
+	uint32 bytes_written1;
+	p1->serialize(msg1, CODING, bytes_written1);
+
+	CPPUNIT_ASSERT( bytes_written1 == p1->get_encoded_size() );
+
+	mutate1(p1);
+	mutate1(p2);
+
+	mnslp_object *p3 = p1->copy();
+	CPPUNIT_ASSERT( p3->get_encoded_size() == p2->get_serialized_size(CODING) );
+
+	mnslp_object *blank = createInstance1();
+	tryReadWrite(p1, blank);
+	delete blank;
+
+	uint32 len1, len2;
+	const uchar *buf1 = p1->get_encoded(len1);
+	const uchar *buf2 = p2->get_encoded(len2);
+
+	CPPUNIT_ASSERT( len1 == len2 );
+	CPPUNIT_ASSERT( memcmp(buf1, buf2, len1) == 0 );
+
+	delete p1;
+	delete p2;
+	delete p3;
+}
+
+
+namespace {
+
+struct encoding_reader {
+	const mnslp_object *obj;
+	const uchar *buffer;
+	uint32 length;
+};
+
+void *read_encoding(void *arg) {
+	encoding_reader *r = static_cast<encoding_reader *>(arg);
+
+	r->obj->get_fingerprint();
+	r->buffer = r->obj->get_encoded(r->length);
+
+	return NULL;
+}
+
+} // anonymous namespace
+
+
+// Threads sharing an object fill its cache once.
+void GenericObjectTest::testSharedEncoding() {
+	mnslp_object *p1 = createInstance2();
+
+	const int NUM_THREADS = 4;
+	pthread_t threads[NUM_THREADS];
+	encoding_reader readers[NUM_THREADS];
+
+	for ( int i = 0; i < NUM_THREADS; i++ ) {
+		readers[i].obj = p1;
+		pthread_create(&threads[i], NULL, read_encoding, &readers[i]);
+	}
+
+	for ( int i = 0; i < NUM_THREADS; i++ )
+		pthread_join(threads[i], NULL);
+
+	uint32 length;
+	const uchar *buffer = p1->get_encoded(length);
+
+	for ( int i = 0; i < NUM_THREADS; i++ ) {
+		CPPUNIT_ASSERT( readers[i].buffer == buffer );
+		CPPUNIT_ASSERT( readers[i].length == length );
+	}
+
+	delete p1;
+}
+
+
 /**
  * Test a serialize/deserialize cycle.
  *
@@ -20,7 +20,9 @@ using namespace mnslp::msg;
 	CPPUNIT_TEST( testComparison ); \
 	CPPUNIT_TEST( testCopying ); \
 	CPPUNIT_TEST( testSerialize ); \
-	CPPUNIT_TEST( testReadWrite );
+	CPPUNIT_TEST( testReadWrite ); \
+	CPPUNIT_TEST( testEncodingCache ); \
+	CPPUNIT_TEST( testSharedEncoding );
 
 
 /**
@@ -65,6 +67,8 @@ class GenericObjectTest : public CppUnit::TestCase {
 	virtual void testCopying();
 	virtual void testSerialize();
 	virtual void testReadWrite();
+	virtual void testEncodingCache();
+	virtual void testSharedEncoding();
 
   protected:
 	virtual void tryReadWrite(mnslp_object *obj, mnslp_object *blank);
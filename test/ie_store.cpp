@@ -0,0 +1,127 @@
+/*
+ * ie_store.cpp - Test the ie_store class.
+ *
+ * $Id: ie_store.cpp 2438 2015-03-10 $
+ * $HeadURL: https://./test/ie_store.cpp $
+ *
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "msg/ie_store.h"
+#include "msg/msg_sequence_number.h"
+
+using namespace protlib;
+using namespace mnslp::msg;
+
+
+class IeStoreTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( IeStoreTest );
+
+	CPPUNIT_TEST( testOrder );
+	CPPUNIT_TEST( testMaxSequence );
+	CPPUNIT_TEST( testCopying );
+	CPPUNIT_TEST( testHeapFallback );
+
+	CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void testOrder();
+	void testMaxSequence();
+	void testCopying();
+	void testHeapFallback();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( IeStoreTest );
+
+
+void IeStoreTest::testOrder() {
+	ie_store store;
+
+	store.set(ie_object_key(30, 1), new msg_sequence_number(3));
+	store.set(ie_object_key(10, 1), new msg_sequence_number(1));
+	store.set(ie_object_key(20, 1), new msg_sequence_number(2));
+
+	CPPUNIT_ASSERT( store.size() == 3 );
+
+	uint32 expected = 1;
+	for ( ie_store::const_iterator i = store.begin(); i != store.end(); i++ ) {
+		msg_sequence_number *msn = dynamic_cast<msg_sequence_number *>(i->second);
+		CPPUNIT_ASSERT( msn->get_value() == expected );
+		expected++;
+	}
+
+	// Replacing an entry keeps the number of entries.
+	store.set(ie_object_key(20, 1), new msg_sequence_number(22));
+	CPPUNIT_ASSERT( store.size() == 3 );
+
+	IE *ie = store.remove(ie_object_key(20, 1));
+	CPPUNIT_ASSERT( ie != NULL );
+	CPPUNIT_ASSERT( store.get(ie_object_key(20, 1)) == NULL );
+	CPPUNIT_ASSERT( store.remove(ie_object_key(20, 1)) == NULL );
+	CPPUNIT_ASSERT( store.size() == 2 );
+	delete ie;
+}
+
+
+void IeStoreTest::testMaxSequence() {
+	ie_store store;
+
+	CPPUNIT_ASSERT( store.getMaxSequence(100) == 0 );
+
+	store.set(ie_object_key(100, 1), new msg_sequence_number(1));
+	store.set(ie_object_key(100, 3), new msg_sequence_number(3));
+	store.set(ie_object_key(100, 2), new msg_sequence_number(2));
+	store.set(ie_object_key(10, 1), new msg_sequence_number(1));
+
+	CPPUNIT_ASSERT( store.getMaxSequence(100) == 3 );
+	CPPUNIT_ASSERT( store.getMaxSequence(10) == 1 );
+
+	delete store.remove(ie_object_key(100, 3));
+	CPPUNIT_ASSERT( store.getMaxSequence(100) == 2 );
+
+	delete store.remove(ie_object_key(10, 1));
+	CPPUNIT_ASSERT( store.getMaxSequence(10) == 0 );
+}
+
+
+void IeStoreTest::testCopying() {
+	ie_store store;
+
+	store.set(ie_object_key(100, 1), new msg_sequence_number(1));
+	store.set(ie_object_key(100, 2), new msg_sequence_number(2));
+
+	ie_store copy(store);
+	CPPUNIT_ASSERT( copy == store );
+	CPPUNIT_ASSERT( copy.get(ie_object_key(100, 1)) != store.get(ie_object_key(100, 1)) );
+
+	ie_store assigned;
+	assigned = store;
+	CPPUNIT_ASSERT( assigned == store );
+	CPPUNIT_ASSERT( assigned.getMaxSequence(100) == 2 );
+}
+
+
+void IeStoreTest::testHeapFallback() {
+	ie_store store;
+	uint32 entries = ie_store::INLINE_ENTRIES * 3;
+
+	for ( uint32 i = entries; i > 0; i-- )
+		store.set(ie_object_key(100, i), new msg_sequence_number(i));
+
+	CPPUNIT_ASSERT( store.size() == entries );
+	CPPUNIT_ASSERT( store.getMaxSequence(100) == entries );
+
+	for ( uint32 i = 1; i <= entries; i++ ) {
+		msg_sequence_number *msn = dynamic_cast<msg_sequence_number *>(
+				store.get(ie_object_key(100, i)));
+		CPPUNIT_ASSERT( msn != NULL );
+		CPPUNIT_ASSERT( msn->get_value() == i );
+	}
+
+	ie_store copy(store);
+	CPPUNIT_ASSERT( copy == store );
+}
+
+// EOF
@@ -0,0 +1,325 @@
+/*
+ * ipfix_collector.cpp - Test the ipfix_collector class.
+ *
+ * $Id: ipfix_collector.cpp 2571 2015-03-10 $
+ * $HeadURL: https://./test/ipfix_collector.cpp $
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <vector>
+
+#include "ipfix_collector.h"
+
+using namespace mnslp;
+
+
+/*
+ * Builds messages byte by byte, in network byte order.
+ */
+class message_writer {
+  public:
+	message_writer(int version, uint32 domain) : version(version) {
+		put16(version);
+		put16(0);			// count or length, set by get()
+		put32(0);
+		if ( version == 9 )
+			put32(0);
+		put32(1);			// sequence number
+		put32(domain);
+	}
+
+	void put8(uchar v) {
+		buf.push_back(v);
+	}
+
+	void put16(uint16 v) {
+		put8(v >> 8);
+		put8(v);
+	}
+
+	void put32(uint32 v) {
+		put16(v >> 16);
+		put16(v);
+	}
+
+	void put64(uint64 v) {
+		put32(v >> 32);
+		put32(v);
+	}
+
+	void start_set(uint16 id) {
+		set_start = buf.size();
+		put16(id);
+		put16(0);
+	}
+
+	void end_set() {
+		uint16 length = buf.size() - set_start;
+		buf[set_start + 2] = length >> 8;
+		buf[set_start + 3] = length;
+	}
+
+	const std::vector<uchar> &get() {
+		if ( version == 10 ) {
+			buf[2] = buf.size() >> 8;
+			buf[3] = buf.size();
+		}
+		return buf;
+	}
+
+  private:
+	int version;
+	size_t set_start;
+	std::vector<uchar> buf;
+};
+
+
+class IpfixCollectorTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( IpfixCollectorTest );
+
+	CPPUNIT_TEST( testFixedRecords );
+	CPPUNIT_TEST( testVariableRecords );
+	CPPUNIT_TEST( testMissingTemplate );
+	CPPUNIT_TEST( testNetflow9 );
+	CPPUNIT_TEST( testWorkers );
+	CPPUNIT_TEST( testExporters );
+
+	CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void testFixedRecords();
+	void testVariableRecords();
+	void testMissingTemplate();
+	void testNetflow9();
+	void testWorkers();
+	void testExporters();
+
+  private:
+	static void add_template(message_writer &w);
+	static void add_records(message_writer &w, int nrecords);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( IpfixCollectorTest );
+
+
+/*
+ * Template 256: sourceIPv4Address, octetDeltaCount, packetDeltaCount
+ * with 4 bytes.
+ */
+void IpfixCollectorTest::add_template(message_writer &w) {
+	w.start_set(2);
+	w.put16(256);
+	w.put16(3);
+	w.put16(8);  w.put16(4);
+	w.put16(1);  w.put16(8);
+	w.put16(2);  w.put16(4);
+	w.end_set();
+}
+
+
+void IpfixCollectorTest::add_records(message_writer &w, int nrecords) {
+	w.start_set(256);
+	for ( int i = 0; i < nrecords; i++ ) {
+		w.put32(0x0a000001 + i);
+		w.put64(1000);
+		w.put32(10);
+	}
+	w.put16(0);		// padding
+	w.end_set();
+}
+
+
+void IpfixCollectorTest::testFixedRecords() {
+	ipfix_domain domain;
+	message_writer w(10, 7);
+
+	add_template(w);
+	add_records(w, 3);
+
+	const std::vector<uchar> &msg = w.get();
+	CPPUNIT_ASSERT( domain.decode(&msg[0], msg.size()) == 3 );
+
+	// The template is kept for the next message.
+	message_writer w2(10, 7);
+	add_records(w2, 2);
+
+	const std::vector<uchar> &msg2 = w2.get();
+	CPPUNIT_ASSERT( domain.decode(&msg2[0], msg2.size()) == 2 );
+
+	const ipfix_counters &c = domain.get_counters();
+	CPPUNIT_ASSERT( c.messages == 2 );
+	CPPUNIT_ASSERT( c.records == 5 );
+	CPPUNIT_ASSERT( c.octets == 5000 );
+	CPPUNIT_ASSERT( c.packets == 50 );
+	CPPUNIT_ASSERT( domain.get_malformed() == 0 );
+}
+
+
+void IpfixCollectorTest::testVariableRecords() {
+	ipfix_domain domain;
+	message_writer w(10, 7);
+
+	// An enterprise field, a string, and a 2 byte packetDeltaCount.
+	w.start_set(2);
+	w.put16(300);
+	w.put16(3);
+	w.put16(0x8000 | 5);  w.put16(4);  w.put32(12345);
+	w.put16(82);  w.put16(65535);
+	w.put16(2);  w.put16(2);
+	w.end_set();
+
+	w.start_set(300);
+	w.put32(0);  w.put8(3);  w.put8('e');  w.put8('t');  w.put8('h');
+	w.put16(7);
+	w.put32(0);  w.put8(0);  w.put16(5);
+	w.put8(0);		// padding
+	w.end_set();
+
+	const std::vector<uchar> &msg = w.get();
+	CPPUNIT_ASSERT( domain.decode(&msg[0], msg.size()) == 2 );
+	CPPUNIT_ASSERT( domain.get_counters().packets == 12 );
+	CPPUNIT_ASSERT( domain.get_counters().octets == 0 );
+}
+
+
+void IpfixCollectorTest::testMissingTemplate() {
+	ipfix_domain domain;
+	message_writer w(10, 7);
+
+	add_records(w, 2);
+
+	const std::vector<uchar> &msg = w.get();
+	CPPUNIT_ASSERT( domain.decode(&msg[0], msg.size()) == 0 );
+	CPPUNIT_ASSERT( domain.get_missing_templates() == 1 );
+
+	// Cut short.
+	CPPUNIT_ASSERT( domain.decode(&msg[0], 10) == 0 );
+	CPPUNIT_ASSERT( domain.get_malformed() == 1 );
+}
+
+
+void IpfixCollectorTest::testNetflow9() {
+	ipfix_domain domain;
+	message_writer w(9, 3);
+
+	w.start_set(0);
+	w.put16(256);
+	w.put16(2);
+	w.put16(1);  w.put16(4);
+	w.put16(2);  w.put16(4);
+	w.end_set();
+
+	w.start_set(256);
+	w.put32(1500);  w.put32(1);
+	w.put32(500);  w.put32(2);
+	w.end_set();
+
+	const std::vector<uchar> &msg = w.get();
+
+	uint32 id;
+	size_t length;
+	CPPUNIT_ASSERT( ipfix_collector::parse_header(&msg[0], msg.size(), id, length) );
+	CPPUNIT_ASSERT( id == 3 );
+
+	CPPUNIT_ASSERT( domain.decode(&msg[0], msg.size()) == 2 );
+	CPPUNIT_ASSERT( domain.get_counters().octets == 2000 );
+	CPPUNIT_ASSERT( domain.get_counters().packets == 3 );
+}
+
+
+void IpfixCollectorTest::testWorkers() {
+	ipfix_collector collector("127.0.0.1", 0, ipfix_collector::UDP, 3);
+	CPPUNIT_ASSERT( collector.start() );
+
+	mspec_rule_key key;
+	collector.bind_rule(5, key);
+
+	for ( uint32 domain = 1; domain <= 6; domain++ ) {
+		message_writer w(10, domain);
+		add_template(w);
+		add_records(w, domain);
+
+		const std::vector<uchar> &msg = w.get();
+		CPPUNIT_ASSERT( collector.submit(&msg[0], msg.size()) );
+	}
+
+	uchar garbage[20] = { 0 };
+	CPPUNIT_ASSERT( ! collector.submit(garbage, sizeof(garbage)) );
+
+	collector.flush();
+
+	ipfix_counters c;
+	CPPUNIT_ASSERT( collector.get_counters(key, c) );
+	CPPUNIT_ASSERT( c.records == 5 );
+	CPPUNIT_ASSERT( c.octets == 5000 );
+
+	CPPUNIT_ASSERT( collector.get_counters(6, c) );
+	CPPUNIT_ASSERT( c.records == 6 );
+	CPPUNIT_ASSERT( ! collector.get_counters(7, c) );
+
+	ipfix_collector_stats s = collector.get_stats();
+	CPPUNIT_ASSERT( s.received == 6 );
+	CPPUNIT_ASSERT( s.malformed == 1 );
+	CPPUNIT_ASSERT( s.records == 21 );
+
+	// A rule sharing the task doesn't reset the counters.
+	mspec_rule_key shared;
+	collector.bind_rule(5, shared);
+	CPPUNIT_ASSERT( collector.get_counters(shared, c) );
+	CPPUNIT_ASSERT( c.records == 5 );
+
+	collector.unbind_rule(key);
+	CPPUNIT_ASSERT( ! collector.get_counters(key, c) );
+	CPPUNIT_ASSERT( collector.get_counters(shared, c) );
+
+	collector.stop();
+}
+
+void IpfixCollectorTest::testExporters() {
+	ipfix_collector collector("127.0.0.1", 0, ipfix_collector::UDP, 2);
+	CPPUNIT_ASSERT( collector.start() );
+
+	message_writer templates(10, 5);
+	add_template(templates);
+
+	message_writer records(10, 5);
+	add_records(records, 2);
+
+	const std::vector<uchar> &t = templates.get();
+	const std::vector<uchar> &r = records.get();
+
+	// Each exporter has its own templates for the same domain ID.
+	CPPUNIT_ASSERT( collector.submit(&t[0], t.size(), "10.0.0.1:4739") );
+	CPPUNIT_ASSERT( collector.submit(&r[0], r.size(), "10.0.0.2:4739") );
+	CPPUNIT_ASSERT( collector.submit(&r[0], r.size(), "10.0.0.1:4739") );
+	collector.flush();
+
+	ipfix_counters c;
+	CPPUNIT_ASSERT( collector.get_counters(5, c) );
+	CPPUNIT_ASSERT( c.records == 2 );
+	CPPUNIT_ASSERT( collector.get_stats().missing_templates == 1 );
+
+	// The counters of a domain ID add up all exporters.
+	CPPUNIT_ASSERT( collector.submit(&t[0], t.size(), "10.0.0.2:4739") );
+	CPPUNIT_ASSERT( collector.submit(&r[0], r.size(), "10.0.0.2:4739") );
+	collector.flush();
+
+	CPPUNIT_ASSERT( collector.get_counters(5, c) );
+	CPPUNIT_ASSERT( c.records == 4 );
+	CPPUNIT_ASSERT( c.messages == 5 );
+
+	// Templates end with the transport session, the counters don't.
+	collector.end_session("10.0.0.1:4739");
+	CPPUNIT_ASSERT( collector.submit(&r[0], r.size(), "10.0.0.1:4739") );
+	collector.flush();
+
+	CPPUNIT_ASSERT( collector.get_counters(5, c) );
+	CPPUNIT_ASSERT( c.records == 4 );
+	CPPUNIT_ASSERT( collector.get_stats().missing_templates == 2 );
+
+	collector.stop();
+}
+
+// EOF
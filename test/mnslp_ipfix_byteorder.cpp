@@ -0,0 +1,226 @@
+/*
+ * mnslp_ipfix_byteorder.cpp - Test the bulk byte order conversion and the
+ *							   column by column coding of IPFIX records.
+ *
+ * $Id: mnslp_ipfix_byteorder.cpp 2438 2015-03-10 $
+ * $HeadURL: https://./test/mnslp_ipfix_byteorder.cpp $
+ *
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "msg/mnslp_ipfix_message.h"
+#include "msg/mnslp_ipfix_byteorder.h"
+
+using namespace mnslp::msg;
+
+
+class MnslpIpfixByteorderTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( MnslpIpfixByteorderTest );
+
+	CPPUNIT_TEST( testConvert );
+	CPPUNIT_TEST( testExport );
+	CPPUNIT_TEST( testImport );
+
+	CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void setUp();
+	void tearDown();
+	void testConvert();
+	void testExport();
+	void testImport();
+
+  private:
+	static const int NUM_RECORDS = 20;
+
+	size_t saved_min_records;
+
+	mnslp_ipfix_message *build_message(bool encode_network);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( MnslpIpfixByteorderTest );
+
+
+void MnslpIpfixByteorderTest::setUp() {
+	saved_min_records = mnslp_ipfix_message::get_bulk_min_records();
+}
+
+
+void MnslpIpfixByteorderTest::tearDown() {
+	mnslp_ipfix_message::set_bulk_min_records(saved_min_records);
+}
+
+
+/*
+ * A template whose fields all have a fixed length, with NUM_RECORDS records.
+ */
+mnslp_ipfix_message *
+MnslpIpfixByteorderTest::build_message(bool encode_network) {
+	mnslp_ipfix_message *mess = 
+		new mnslp_ipfix_message(12345, IPFIX_VERSION, encode_network);
+
+	uint16_t templid = mess->new_data_template( 5 );
+	mess->add_field(templid, 0, IPFIX_FT_SOURCEIPV4ADDRESS, 4);
+	mess->add_field(templid, 0, IPFIX_FT_SOURCETRANSPORTPORT, 2);
+	mess->add_field(templid, 0, IPFIX_FT_PROTOCOLIDENTIFIER, 1);
+	mess->add_field(templid, 0, IPFIX_FT_INGRESSINTERFACE, 4);
+	mess->add_field(templid, 0, IPFIX_FT_OCTETDELTACOUNT, 8);
+
+	mnslp_ipfix_field addr = mess->get_field_definition(0, IPFIX_FT_SOURCEIPV4ADDRESS);
+	mnslp_ipfix_field port = mess->get_field_definition(0, IPFIX_FT_SOURCETRANSPORTPORT);
+	mnslp_ipfix_field proto = mess->get_field_definition(0, IPFIX_FT_PROTOCOLIDENTIFIER);
+	mnslp_ipfix_field iface = mess->get_field_definition(0, IPFIX_FT_INGRESSINTERFACE);
+	mnslp_ipfix_field octets = mess->get_field_definition(0, IPFIX_FT_OCTETDELTACOUNT);
+
+	for ( int i = 0; i < NUM_RECORDS; i++ ) {
+		uint8_t addr_value[4] = { 10, 0, (uint8_t) (i >> 8), (uint8_t) i };
+		uint16_t port_value = 1024 + i;
+		uint8_t proto_value = 6;
+		uint32_t iface_value = 0x01020300 + i;
+		uint64_t octets_value = 0x0102030405060700ULL + i;
+
+		mnslp_ipfix_value_field faddr = addr.get_ipfix_value_field(addr_value, 4);
+		mnslp_ipfix_value_field fport = port.get_ipfix_value_field(port_value);
+		mnslp_ipfix_value_field fproto = proto.get_ipfix_value_field(proto_value);
+		mnslp_ipfix_value_field fiface = iface.get_ipfix_value_field(iface_value);
+		mnslp_ipfix_value_field foctets = octets.get_ipfix_value_field(octets_value);
+
+		mnslp_ipfix_data_record data(templid);
+		data.insert_field(0, IPFIX_FT_SOURCEIPV4ADDRESS, faddr);
+		data.insert_field(0, IPFIX_FT_SOURCETRANSPORTPORT, fport);
+		data.insert_field(0, IPFIX_FT_PROTOCOLIDENTIFIER, fproto);
+		data.insert_field(0, IPFIX_FT_INGRESSINTERFACE, fiface);
+		data.insert_field(0, IPFIX_FT_OCTETDELTACOUNT, foctets);
+		mess->include_data(templid, data);
+	}
+
+	return mess;
+}
+
+
+/*
+ * Rewrite an exported message, where every record travels in its own set,
+ * so that all the data records share one set, as other exporters do. The
+ * message must be encoded in host byte order.
+ */
+static size_t merge_data_sets(const uchar *in, size_t len, uchar *out) {
+	size_t i = IPFIX_HDR_BYTES, o = IPFIX_HDR_BYTES, data_set = 0;
+	uint16_t setid, setlen;
+
+	memcpy(out, in, IPFIX_HDR_BYTES);
+
+	while ( i + 4 <= len ) {
+		memcpy(&setid, in + i, 2);
+		memcpy(&setlen, in + i + 2, 2);
+
+		if ( setid > 255 ) {
+			if ( data_set == 0 ) {
+				data_set = o;
+				o += 4;
+			}
+			memcpy(out + o, in + i + 4, setlen - 4);
+			o += setlen - 4;
+		}
+		else {
+			memcpy(out + o, in + i, setlen);
+			o += setlen;
+		}
+		i += setlen;
+	}
+
+	setlen = o - data_set;
+	memcpy(out + data_set, &setid, 2);
+	memcpy(out + data_set + 2, &setlen, 2);
+
+	uint16_t length = o;
+	memcpy(out + 2, &length, 2);
+	return o;
+}
+
+
+void MnslpIpfixByteorderTest::testConvert() {
+	for ( size_t n = 0; n < 40; n++ ) {
+		uint16_t v16[40];
+		uint32_t v32[40];
+		uint64_t v64[40];
+
+		for ( size_t i = 0; i < n; i++ ) {
+			v16[i] = 0x0102 * i + 1;
+			v32[i] = 0x01020304 * i + 1;
+			v64[i] = 0x0102030405060708ULL * i + 1;
+		}
+
+		ipfix_hton_n(v16, n);
+		ipfix_hton_n(v32, n);
+		ipfix_hton_n(v64, n);
+
+		for ( size_t i = 0; i < n; i++ ) {
+			uint64_t expected = 0x0102030405060708ULL * i + 1;
+			CPPUNIT_ASSERT( v16[i] == htons(0x0102 * i + 1) );
+			CPPUNIT_ASSERT( v32[i] == htonl(0x01020304 * i + 1) );
+			CPPUNIT_ASSERT( v64[i] == HTONLL(expected) );
+		}
+	}
+}
+
+
+void MnslpIpfixByteorderTest::testExport() {
+	for ( int encode_network = 0; encode_network < 2; encode_network++ ) {
+		mnslp_ipfix_message::set_bulk_min_records(0);
+		mnslp_ipfix_message *scalar = build_message(encode_network);
+		scalar->output();
+
+		mnslp_ipfix_message::set_bulk_min_records(2);
+		mnslp_ipfix_message *bulk = build_message(encode_network);
+		bulk->output();
+
+		// Both paths write the same bytes, but for the export time.
+		CPPUNIT_ASSERT( bulk->get_offset() == scalar->get_offset() );
+		CPPUNIT_ASSERT( memcmp(bulk->get_message(), scalar->get_message(), 4) == 0 );
+		CPPUNIT_ASSERT( memcmp(bulk->get_message() + 8, scalar->get_message() + 8, 
+							   bulk->get_offset() - 8) == 0 );
+
+		delete scalar;
+		delete bulk;
+	}
+}
+
+
+void MnslpIpfixByteorderTest::testImport() {
+	mnslp_ipfix_message::set_bulk_min_records(0);
+	mnslp_ipfix_message *mess = build_message(false);
+	mess->output();
+
+	uchar merged[4096];
+	CPPUNIT_ASSERT( mess->get_offset() <= (int) sizeof(merged) );
+	size_t len = merge_data_sets(mess->get_message(), mess->get_offset(), merged);
+
+	mnslp_ipfix_message scalar(merged, len, false);
+
+	mnslp_ipfix_message::set_bulk_min_records(2);
+	mnslp_ipfix_message bulk(merged, len, false);
+
+	CPPUNIT_ASSERT( bulk.isEqual(scalar) );
+	CPPUNIT_ASSERT( scalar.isEqual(bulk) );
+
+	// The records read column by column are the ones that were exported.
+	uint16_t templid = mess->get_template_list().front();
+	int types[5] = { IPFIX_FT_SOURCEIPV4ADDRESS, IPFIX_FT_SOURCETRANSPORTPORT,
+					 IPFIX_FT_PROTOCOLIDENTIFIER, IPFIX_FT_INGRESSINTERFACE,
+					 IPFIX_FT_OCTETDELTACOUNT };
+	for ( int i = 0; i < 5; i++ ) {
+		mnslp_ipfix_field field = mess->get_field_definition(0, types[i]);
+		std::list<std::string> expected = 
+			mess->get_field_data_values(mess->get_template(templid), field);
+		std::list<std::string> values = 
+			bulk.get_field_data_values(bulk.get_template(templid), field);
+		CPPUNIT_ASSERT( expected.size() == NUM_RECORDS );
+		CPPUNIT_ASSERT( values == expected );
+	}
+
+	delete mess;
+}
+
+// EOF
@@ -0,0 +1,170 @@
+/*
+ * mnslp_ipfix_codec.cpp - Test the IPFIX field codecs.
+ *
+ * $Id: mnslp_ipfix_codec.cpp 2438 2015-03-10 $
+ * $HeadURL: https://./test/mnslp_ipfix_codec.cpp $
+ *
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "msg/mnslp_ipfix_message.h"
+#include "msg/mnslp_ipfix_codec.h"
+
+using namespace mnslp::msg;
+
+
+class MnslpIpfixCodecTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( MnslpIpfixCodecTest );
+
+	CPPUNIT_TEST( testIntegers );
+	CPPUNIT_TEST( testFloat );
+	CPPUNIT_TEST( testBytes );
+	CPPUNIT_TEST( testString );
+	CPPUNIT_TEST( testGeneric );
+
+	CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void testIntegers();
+	void testFloat();
+	void testBytes();
+	void testString();
+	void testGeneric();
+
+  private:
+	void checkRoundTrip(const ipfix_field_type_t &type, uint16_t flength,
+						const mnslp_ipfix_value_field &value);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( MnslpIpfixCodecTest );
+
+
+/*
+ * Encode the value with the resolved kernels for both relay flags, check 
+ * the output against the field codec and decode it back.
+ */
+void MnslpIpfixCodecTest::checkRoundTrip(const ipfix_field_type_t &type, 
+										 uint16_t flength,
+										 const mnslp_ipfix_value_field &value) {
+	mnslp_ipfix_field field(type);
+	int len = value.get_length();
+
+	for ( int relay_f = 0; relay_f < 2; relay_f++ ) {
+		uint8_t expected[32], out[32];
+		memset(expected, 0, sizeof(expected));
+		memset(out, 0, sizeof(out));
+
+		CPPUNIT_ASSERT( field.encode(value, expected, relay_f) == 0 );
+
+		ipfix_encode_fn encode = ipfix_resolve_encoder(type, flength, relay_f);
+		CPPUNIT_ASSERT( encode(field, value, out) == 0 );
+		CPPUNIT_ASSERT( memcmp(out, expected, len) == 0 );
+
+		ipfix_decode_fn decode = ipfix_resolve_decoder(type, flength, relay_f);
+		mnslp_ipfix_value_field decoded = decode(field, out, len);
+		CPPUNIT_ASSERT( decoded.get_length() == len );
+		CPPUNIT_ASSERT( decoded == value );
+	}
+}
+
+
+void MnslpIpfixCodecTest::testIntegers() {
+	ipfix_field_type_t type8 = { 0, IPFIX_FT_PROTOCOLIDENTIFIER, 1, 
+								 IPFIX_CODING_UINT, "protocolIdentifier", "" };
+	ipfix_field_type_t type16 = { 0, IPFIX_FT_SOURCETRANSPORTPORT, 2, 
+								  IPFIX_CODING_UINT, "sourceTransportPort", "" };
+	ipfix_field_type_t type32 = { 0, IPFIX_FT_INGRESSINTERFACE, 4, 
+								  IPFIX_CODING_UINT, "ingressInterface", "" };
+	ipfix_field_type_t type64 = { 0, IPFIX_FT_OCTETDELTACOUNT, 8, 
+								  IPFIX_CODING_UINT, "octetDeltaCount", "" };
+
+	uint8_t value8 = 17;
+	uint16_t value16 = 0x1234;
+	uint32_t value32 = 0x12345678;
+	uint64_t value64 = 0x0102030405060708ULL;
+
+	mnslp_ipfix_value_field field8, field16, field32, field64;
+	field8.set_value_int8(value8);
+	field16.set_value_int16(value16);
+	field32.set_value_int32(value32);
+	field64.set_value_int64(value64);
+
+	checkRoundTrip(type8, 1, field8);
+	checkRoundTrip(type16, 2, field16);
+	checkRoundTrip(type32, 4, field32);
+	checkRoundTrip(type64, 8, field64);
+
+	// Without relay the value goes in network byte order.
+	mnslp_ipfix_field field(type16);
+	uint8_t out[2];
+	ipfix_resolve_encoder(type16, 2, 0)(field, field16, out);
+	CPPUNIT_ASSERT( out[0] == 0x12 && out[1] == 0x34 );
+}
+
+
+void MnslpIpfixCodecTest::testFloat() {
+	ipfix_field_type_t type = { 0, 1000, 8, IPFIX_CODING_FLOAT, "float64", "" };
+
+	uint64_t bits = 0x400921FB54442D18ULL;
+	mnslp_ipfix_value_field value;
+	value.set_value_float64(bits);
+
+	checkRoundTrip(type, 8, value);
+}
+
+
+void MnslpIpfixCodecTest::testBytes() {
+	ipfix_field_type_t addr_type = { 0, IPFIX_FT_SOURCEIPV4ADDRESS, 4, 
+									 IPFIX_CODING_IPADDR, "sourceIPv4Address", "" };
+	ipfix_field_type_t bytes_type = { 0, 1001, 65535, 
+									  IPFIX_CODING_BYTES, "octets", "" };
+
+	uint8_t addr[4] = { 10, 0, 0, 1 };
+	mnslp_ipfix_value_field addr_value;
+	addr_value.set_value_vunit8(addr, 4);
+	checkRoundTrip(addr_type, 4, addr_value);
+
+	uint8_t bytes[6] = { 1, 2, 3, 4, 5, 6 };
+	mnslp_ipfix_value_field bytes_value;
+	bytes_value.set_value_vunit8(bytes, 6);
+	checkRoundTrip(bytes_type, IPFIX_FT_VARLEN, bytes_value);
+}
+
+
+void MnslpIpfixCodecTest::testString() {
+	ipfix_field_type_t type = { 0, 1002, 65535, 
+								IPFIX_CODING_STRING, "name", "" };
+	mnslp_ipfix_field field(type);
+
+	char name[] = "metering";
+	mnslp_ipfix_value_field value;
+	value.set_value_vchar(name, 8);
+
+	uint8_t out[8];
+	CPPUNIT_ASSERT( 
+		ipfix_resolve_encoder(type, IPFIX_FT_VARLEN, 0)(field, value, out) == 0 );
+	CPPUNIT_ASSERT( memcmp(out, name, 8) == 0 );
+
+	mnslp_ipfix_value_field decoded = 
+		ipfix_resolve_decoder(type, IPFIX_FT_VARLEN, 0)(field, out, 8);
+	CPPUNIT_ASSERT( decoded.get_length() == 8 );
+	CPPUNIT_ASSERT( memcmp(decoded.get_value_string(), name, 8) == 0 );
+}
+
+
+void MnslpIpfixCodecTest::testGeneric() {
+	// A field sent with a length different from its type uses the 
+	// field codec, which rejects values that do not fit the type.
+	ipfix_field_type_t type = { 0, IPFIX_FT_OCTETDELTACOUNT, 8, 
+								IPFIX_CODING_UINT, "octetDeltaCount", "" };
+	mnslp_ipfix_field field(type);
+	uint8_t in[4] = { 0, 0, 0, 1 };
+
+	ipfix_decode_fn decode = ipfix_resolve_decoder(type, 4, 0);
+	CPPUNIT_ASSERT( decode != ipfix_resolve_decoder(type, 8, 0) );
+	CPPUNIT_ASSERT_THROW( decode(field, in, 4), mnslp_ipfix_bad_argument );
+}
+
+// EOF
@@ -0,0 +1,114 @@
+/*
+ * mnslp_ipfix_template.cpp - Test the mnslp_ipfix_template class.
+ *
+ * $Id: mnslp_ipfix_template.cpp 2438 2015-03-10 $
+ * $HeadURL: https://./test/mnslp_ipfix_template.cpp $
+ *
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "msg/mnslp_ipfix_message.h"
+
+using namespace mnslp::msg;
+
+
+class MnslpIpfixTemplateTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( MnslpIpfixTemplateTest );
+
+	CPPUNIT_TEST( testDescriptors );
+	CPPUNIT_TEST( testRecompile );
+	CPPUNIT_TEST( testCopy );
+
+	CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void setUp();
+	void testDescriptors();
+	void testRecompile();
+	void testCopy();
+
+  private:
+	mnslp_ipfix_template templ;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( MnslpIpfixTemplateTest );
+
+
+void MnslpIpfixTemplateTest::setUp() {
+	ipfix_field_type_t scope_type = { 0, IPFIX_FT_SOURCEIPV4ADDRESS, 4, 
+									  IPFIX_CODING_IPADDR, "sourceIPv4Address", "" };
+	ipfix_field_type_t data_type = { 0, IPFIX_FT_OCTETDELTACOUNT, 8, 
+									 IPFIX_CODING_UINT, "octetDeltaCount", "" };
+
+	mnslp_ipfix_field scope_field(scope_type);
+	mnslp_ipfix_field data_field(data_type);
+
+	templ.set_id(256);
+	templ.set_type(OPTION_TEMPLATE);
+	templ.add_scope_field(4, KNOWN, 0, scope_field);
+	templ.add_data_field(IPFIX_FT_VARLEN, KNOWN, 1, data_field);
+}
+
+
+void MnslpIpfixTemplateTest::testDescriptors() {
+	const std::vector<ipfix_field_descriptor_t> &fields = 
+			templ.get_field_descriptors();
+
+	CPPUNIT_ASSERT( fields.size() == 2 );
+
+	// Scope fields come first.
+	CPPUNIT_ASSERT( fields[0].ftype == IPFIX_FT_SOURCEIPV4ADDRESS );
+	CPPUNIT_ASSERT( fields[0].flength == 4 );
+	CPPUNIT_ASSERT( ! fields[0].varlen );
+	CPPUNIT_ASSERT( fields[0].coding == IPFIX_CODING_IPADDR );
+	CPPUNIT_ASSERT( fields[0].relay_f == 0 );
+
+	CPPUNIT_ASSERT( fields[1].ftype == IPFIX_FT_OCTETDELTACOUNT );
+	CPPUNIT_ASSERT( fields[1].varlen );
+	CPPUNIT_ASSERT( fields[1].relay_f == 1 );
+
+	// The descriptors point to the definitions held by the template.
+	CPPUNIT_ASSERT( fields[1].elem == &templ.get_field(1).elem );
+	CPPUNIT_ASSERT( &templ.get_field_descriptor(1) == &fields[1] );
+
+	CPPUNIT_ASSERT_THROW( templ.get_field_descriptor(2), 
+						  mnslp_ipfix_bad_argument );
+}
+
+
+void MnslpIpfixTemplateTest::testRecompile() {
+	CPPUNIT_ASSERT( templ.get_field_descriptors().size() == 2 );
+
+	ipfix_field_type_t data_type = { 0, IPFIX_FT_PACKETDELTACOUNT, 8, 
+									 IPFIX_CODING_UINT, "packetDeltaCount", "" };
+	mnslp_ipfix_field data_field(data_type);
+	templ.add_data_field(8, UNKNOWN, 0, data_field);
+
+	const std::vector<ipfix_field_descriptor_t> &fields = 
+			templ.get_field_descriptors();
+	CPPUNIT_ASSERT( fields.size() == 3 );
+	CPPUNIT_ASSERT( fields[2].ftype == IPFIX_FT_PACKETDELTACOUNT );
+	CPPUNIT_ASSERT( fields[2].elem == &templ.get_field(2).elem );
+
+	templ.remove_unknown_fields();
+	CPPUNIT_ASSERT( templ.get_field_descriptors().size() == 2 );
+}
+
+
+void MnslpIpfixTemplateTest::testCopy() {
+	templ.get_field_descriptors();
+
+	mnslp_ipfix_template *copy = templ.copy();
+	const std::vector<ipfix_field_descriptor_t> &fields = 
+			copy->get_field_descriptors();
+
+	CPPUNIT_ASSERT( fields.size() == 2 );
+	CPPUNIT_ASSERT( fields[0].elem == &copy->get_field(0).elem );
+	CPPUNIT_ASSERT( fields[0].elem != templ.get_field_descriptor(0).elem );
+
+	delete copy;
+}
+
+// EOF
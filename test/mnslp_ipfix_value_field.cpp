@@ -0,0 +1,150 @@
+/*
+ * mnslp_ipfix_value_field.cpp - Test the IPFIX field value storage.
+ *
+ * $Id: mnslp_ipfix_value_field.cpp 2438 2015-03-10 $
+ * $HeadURL: https://./test/mnslp_ipfix_value_field.cpp $
+ *
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "msg/mnslp_ipfix_field.h"
+
+using namespace mnslp::msg;
+
+
+class MnslpIpfixValueFieldTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( MnslpIpfixValueFieldTest );
+
+	CPPUNIT_TEST( testNumbers );
+	CPPUNIT_TEST( testInline );
+	CPPUNIT_TEST( testShared );
+	CPPUNIT_TEST( testAssign );
+	CPPUNIT_TEST( testEquals );
+
+	CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void testNumbers();
+	void testInline();
+	void testShared();
+	void testAssign();
+	void testEquals();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( MnslpIpfixValueFieldTest );
+
+
+void MnslpIpfixValueFieldTest::testNumbers() {
+	mnslp_ipfix_value_field value;
+	uint16_t port = 8080;
+	uint64_t octets = 0x0102030405060708ULL;
+
+	value.set_value_int16(port);
+	CPPUNIT_ASSERT( value.get_length() == 2 );
+	CPPUNIT_ASSERT( value.get_value_int16() == 8080 );
+	CPPUNIT_ASSERT( value.get_value_int32() == 0 );
+	CPPUNIT_ASSERT( value.get_value_string() == NULL );
+	CPPUNIT_ASSERT( value.get_value_byte() == NULL );
+
+	// Setting another width replaces the previous value.
+	value.set_value_int64(octets);
+	CPPUNIT_ASSERT( value.get_length() == 8 );
+	CPPUNIT_ASSERT( value.get_value_int64() == octets );
+	CPPUNIT_ASSERT( value.get_value_int16() == 0 );
+}
+
+void MnslpIpfixValueFieldTest::testInline() {
+	uint8_t addr[16];
+	for ( int i = 0; i < 16; i++ )
+		addr[i] = i + 1;
+
+	mnslp_ipfix_value_field value;
+	value.set_value_vunit8(addr, 16);
+	CPPUNIT_ASSERT( value.is_inline() );
+	CPPUNIT_ASSERT( value.get_length() == 16 );
+	CPPUNIT_ASSERT( memcmp(value.get_value_address(), addr, 16) == 0 );
+	CPPUNIT_ASSERT( value.get_value_string() == NULL );
+
+	// Copies own their bytes.
+	mnslp_ipfix_value_field copy(value);
+	CPPUNIT_ASSERT( copy.is_inline() );
+	CPPUNIT_ASSERT( copy.get_value_byte() != value.get_value_byte() );
+	CPPUNIT_ASSERT( copy == value );
+}
+
+void MnslpIpfixValueFieldTest::testShared() {
+	const char *name = "a-long-application-name";
+	int len = strlen(name);
+
+	mnslp_ipfix_value_field *value = new mnslp_ipfix_value_field();
+	value->set_value_vchar(name, len);
+	CPPUNIT_ASSERT( !value->is_inline() );
+	CPPUNIT_ASSERT( value->get_length() == len );
+
+	// Copies point to the same immutable buffer, which outlives the original.
+	mnslp_ipfix_value_field copy(*value);
+	CPPUNIT_ASSERT( copy.get_value_string() == value->get_value_string() );
+	delete value;
+
+	CPPUNIT_ASSERT( memcmp(copy.get_value_string(), name, len) == 0 );
+
+	// Replacing the value drops the reference.
+	uint8_t flag = 1;
+	copy.set_value_int8(flag);
+	CPPUNIT_ASSERT( copy.is_inline() );
+	CPPUNIT_ASSERT( copy.get_value_int8() == 1 );
+}
+
+void MnslpIpfixValueFieldTest::testAssign() {
+	const char *name = "a-long-application-name";
+	int len = strlen(name);
+	uint8_t mac[6] = { 0x00, 0x1b, 0x21, 0x3c, 0x4d, 0x5e };
+
+	mnslp_ipfix_value_field str, bytes;
+	str.set_value_vchar(name, len);
+	bytes.set_value_vunit8(mac, 6);
+
+	mnslp_ipfix_value_field target;
+	target = str;
+	CPPUNIT_ASSERT( target == str );
+
+	target = bytes;
+	CPPUNIT_ASSERT( target == bytes );
+	CPPUNIT_ASSERT( target.get_value_string() == NULL );
+
+	target = target;
+	CPPUNIT_ASSERT( target == bytes );
+
+	str = str;
+	CPPUNIT_ASSERT( memcmp(str.get_value_string(), name, len) == 0 );
+}
+
+void MnslpIpfixValueFieldTest::testEquals() {
+	uint32_t addr = 0x0a000001;
+	uint32_t other = 0x0a000002;
+	uint8_t raw[4] = { 0x0a, 0x00, 0x00, 0x01 };
+
+	mnslp_ipfix_value_field a, b, c;
+	a.set_value_int32(addr);
+	b.set_value_int32(addr);
+	c.set_value_int32(other);
+	CPPUNIT_ASSERT( a == b );
+	CPPUNIT_ASSERT( a != c );
+
+	// Same length but different kind of value.
+	c.set_value_vunit8(raw, 4);
+	CPPUNIT_ASSERT( a != c );
+
+	mnslp_ipfix_value_field s1, s2;
+	s1.set_value_vchar("a-long-application-name", 23);
+	s2.set_value_vchar("a-long-application-nome", 23);
+	CPPUNIT_ASSERT( s1 != s2 );
+	s2.set_value_vchar("a-long-application-name", 23);
+	CPPUNIT_ASSERT( s1 == s2 );
+
+	CPPUNIT_ASSERT( mnslp_ipfix_value_field() == mnslp_ipfix_value_field() );
+}
+
+// EOF
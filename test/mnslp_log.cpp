@@ -0,0 +1,166 @@
+/*
+ * mnslp_log.cpp - Test the logging facade and its per-thread rings.
+ *
+ * $Id: mnslp_log.cpp 2572 2015-03-10 $
+ * $HeadURL: https://./test/mnslp_log.cpp $
+ */
+#include <pthread.h>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "mnslp_log.h"
+
+using namespace mnslp::logging;
+
+
+class MnslpLogTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( MnslpLogTest );
+
+	CPPUNIT_TEST( testRingOrder );
+	CPPUNIT_TEST( testRingFull );
+	CPPUNIT_TEST( testLevelFilter );
+	CPPUNIT_TEST( testWriterThreads );
+
+	CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void setUp();
+	void tearDown();
+
+	void testRingOrder();
+	void testRingFull();
+	void testLevelFilter();
+	void testWriterThreads();
+
+  private:
+	int saved_level;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( MnslpLogTest );
+
+
+static int evaluated = 0;
+
+static int count_evaluation() {
+	return ++evaluated;
+}
+
+
+static void *log_lots(void *) {
+	for ( int i = 0; i < 2000; i++ )
+		write(MNSLP_LOG_LEVEL_DEBUG, "test", "message");
+
+	return NULL;
+}
+
+
+void MnslpLogTest::setUp() {
+	saved_level = get_level();
+}
+
+
+void MnslpLogTest::tearDown() {
+	set_level(saved_level);
+}
+
+
+void MnslpLogTest::testRingOrder() {
+	log_ring ring;
+
+	CPPUNIT_ASSERT( ring.empty() );
+
+	for ( int i = 0; i < 3; i++ ) {
+		std::string text(1, 'a' + i);
+		CPPUNIT_ASSERT( ring.push(MNSLP_LOG_LEVEL_INFO + i % 2, "m", text) );
+	}
+
+	int level;
+	const char *module;
+	std::string text;
+
+	for ( int i = 0; i < 3; i++ ) {
+		CPPUNIT_ASSERT( ring.pop(level, module, text) );
+		CPPUNIT_ASSERT( text == std::string(1, 'a' + i) );
+		CPPUNIT_ASSERT( level == MNSLP_LOG_LEVEL_INFO + i % 2 );
+		CPPUNIT_ASSERT( std::string(module) == "m" );
+	}
+
+	CPPUNIT_ASSERT( ! ring.pop(level, module, text) );
+	CPPUNIT_ASSERT( ring.empty() );
+}
+
+
+void MnslpLogTest::testRingFull() {
+	log_ring ring;
+
+	for ( unsigned i = 0; i < log_ring::RING_SIZE; i++ ) {
+		std::string text("x");
+		CPPUNIT_ASSERT( ring.push(MNSLP_LOG_LEVEL_DEBUG, "m", text) );
+	}
+
+	// A full ring refuses the record and leaves it to the caller.
+	std::string text("overflow");
+	CPPUNIT_ASSERT( ! ring.push(MNSLP_LOG_LEVEL_DEBUG, "m", text) );
+	CPPUNIT_ASSERT( text == "overflow" );
+
+	int level;
+	const char *module;
+	std::string out;
+	CPPUNIT_ASSERT( ring.pop(level, module, out) );
+
+	// The freed slot is usable again after wrapping around.
+	CPPUNIT_ASSERT( ring.push(MNSLP_LOG_LEVEL_DEBUG, "m", text) );
+
+	unsigned popped = 0;
+	while ( ring.pop(level, module, out) )
+		popped++;
+
+	CPPUNIT_ASSERT( popped == log_ring::RING_SIZE );
+	CPPUNIT_ASSERT( out == "overflow" );
+}
+
+
+void MnslpLogTest::testLevelFilter() {
+	set_level(MNSLP_LOG_LEVEL_WARN);
+
+	CPPUNIT_ASSERT( is_enabled(MNSLP_LOG_LEVEL_ERROR) );
+	CPPUNIT_ASSERT( is_enabled(MNSLP_LOG_LEVEL_WARN) );
+	CPPUNIT_ASSERT( ! is_enabled(MNSLP_LOG_LEVEL_INFO) );
+
+	// Disabled statements don't evaluate their arguments.
+	evaluated = 0;
+	MNSLP_LOG_INFO("test", "value " << count_evaluation());
+	MNSLP_LOG_DEBUG("test", "value " << count_evaluation());
+	CPPUNIT_ASSERT( evaluated == 0 );
+
+	set_level(MNSLP_LOG_LEVEL_DEBUG);
+	MNSLP_LOG(MNSLP_LOG_LEVEL_DEBUG, "test", "value " << count_evaluation());
+	CPPUNIT_ASSERT( evaluated == (MNSLP_LOG_LEVEL >= MNSLP_LOG_LEVEL_DEBUG) );
+}
+
+
+void MnslpLogTest::testWriterThreads() {
+	set_level(MNSLP_LOG_LEVEL_DEBUG);
+
+	start_writer();
+	CPPUNIT_ASSERT( is_writer_running() );
+
+	// More records than a ring holds, from threads that exit while
+	// their records may still be queued.
+	pthread_t threads[4];
+	for ( int i = 0; i < 4; i++ )
+		pthread_create(&threads[i], NULL, log_lots, NULL);
+
+	for ( int i = 0; i < 4; i++ )
+		pthread_join(threads[i], NULL);
+
+	stop_writer();
+	CPPUNIT_ASSERT( ! is_writer_running() );
+
+	// Logging keeps working synchronously after the writer stopped.
+	write(MNSLP_LOG_LEVEL_DEBUG, "test", "after stop");
+}
+
+// EOF
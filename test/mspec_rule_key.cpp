@@ -44,6 +44,12 @@ class MspecRuleKeyTest : public CppUnit::TestCase {
 		keyStr1 = key1.to_string();
 		
 		keyStr3 = key3.to_string();
+		
+		mspec_rule_key key5;
+		CPPUNIT_ASSERT( key5.from_string(keyStr1) );
+		CPPUNIT_ASSERT( key5 == key1 );
+		CPPUNIT_ASSERT( ! key5.from_string("not a key") );
+		CPPUNIT_ASSERT( key5 == key1 );
 				
 	}
 
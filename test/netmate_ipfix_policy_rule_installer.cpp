@@ -9,7 +9,10 @@
 
 
 #include <string>
+#include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <set>
 
 #include "netmate_ipfix_policy_rule_installer.h"
 #include "msg/mnslp_ipfix_field.h"
@@ -36,12 +39,67 @@ class netmate_ipfix_policy_rule_installer_test : public netmate_ipfix_policy_rul
 };
 
 
+/*
+ * Counts the commands instead of sending them to the metering application,
+ * and answers them the way NetMate does.
+ */
+class netmate_ipfix_policy_rule_installer_counter : public netmate_ipfix_policy_rule_installer
+{
+  public:
+  
+	netmate_ipfix_policy_rule_installer_counter(mnslp_config *conf): 
+		netmate_ipfix_policy_rule_installer(conf), num_add(0), num_remove(0),
+		fail_remove(false), fail_list(false), fail_query(false),
+		reject_code(200) { }
+
+	virtual bool execute_command(std::string action, std::string post_fields)
+	{
+		if ( action == "/add_task" )
+			num_add++;
+		else {
+			num_remove++;
+			last_remove = post_fields;
+			if ( fail_remove || (fail_list && post_fields.find(',') != std::string::npos) )
+				check_reply(action, reject_code, reject_code == 200 ? 
+					"<reply status=\"Error\">unknown rule</reply>" : "");
+		}
+		check_reply(action, 200, "<reply status=\"OK\"></reply>");
+		return true;
+	}
+
+	virtual void list_tasks(std::set<std::string> &names)
+			throw (policy_rule_installer_error)
+	{
+		if ( fail_query )
+			throw policy_rule_installer_error("get_info failed");
+		names = metering_tasks;
+	}
+
+	int num_add;
+	int num_remove;
+	std::string last_remove;
+	bool fail_remove;
+	bool fail_list;
+	bool fail_query;
+	unsigned long reject_code;	///< HTTP status of rejected commands
+	std::set<std::string> metering_tasks;	///< what get_info returns
+};
+
+
 
 class NetmateIpfixPolicyRuleInstallerTest : public CppUnit::TestFixture {
 
 	CPPUNIT_TEST_SUITE( NetmateIpfixPolicyRuleInstallerTest );
 
 	CPPUNIT_TEST( general_test );
+	CPPUNIT_TEST( shared_task_test );
+	CPPUNIT_TEST( update_test );
+	CPPUNIT_TEST( command_cache_test );
+	CPPUNIT_TEST( bulk_remove_test );
+	CPPUNIT_TEST( failed_remove_test );
+	CPPUNIT_TEST( rejected_remove_test );
+	CPPUNIT_TEST( reconcile_test );
+	CPPUNIT_TEST( domain_test );
 
 	CPPUNIT_TEST_SUITE_END();
 
@@ -53,6 +111,14 @@ class NetmateIpfixPolicyRuleInstallerTest : public CppUnit::TestFixture {
 	void add_export_fields3();
 	void add_configuration_fields(msg::mnslp_ipfix_message *mess);
 	void general_test();
+	void shared_task_test();
+	void update_test();
+	void command_cache_test();
+	void bulk_remove_test();
+	void failed_remove_test();
+	void rejected_remove_test();
+	void reconcile_test();
+	void domain_test();
 	void tearDown();
 
   private:
@@ -261,3 +327,387 @@ void NetmateIpfixPolicyRuleInstallerTest::general_test()
 	
 	
 }
+
+void NetmateIpfixPolicyRuleInstallerTest::shared_task_test() 
+{
+	netmate_ipfix_policy_rule_installer_counter *counter = 
+			new netmate_ipfix_policy_rule_installer_counter(conf);
+	counter->setup();
+	
+	// Two sessions asking for the same metering.
+	mt_policy_rule *first = new mt_policy_rule();
+	first->set_object(mess1->copy());
+	mt_policy_rule *second = new mt_policy_rule();
+	second->set_object(mess1->copy());
+	
+	mt_policy_rule *installed1 = counter->install(first);
+	int num_add = counter->num_add;
+	CPPUNIT_ASSERT( num_add > 0 );
+	
+	// The second one shares the tasks of the first one.
+	mt_policy_rule *installed2 = counter->install(second);
+	CPPUNIT_ASSERT( counter->num_add == num_add );
+	CPPUNIT_ASSERT( installed2->get_number_rule_keys() == 1 );
+	CPPUNIT_ASSERT( installed1->begin_commands()->second == 
+					installed2->begin_commands()->second );
+	
+	// Only the last session removes the tasks.
+	mt_policy_rule *removed1 = counter->remove(installed1);
+	CPPUNIT_ASSERT( counter->num_remove == 0 );
+	
+	mt_policy_rule *removed2 = counter->remove(installed2);
+	CPPUNIT_ASSERT( counter->num_remove == num_add );
+	
+	// Once removed, the same request installs its tasks again.
+	mt_policy_rule *installed3 = counter->install(first);
+	CPPUNIT_ASSERT( counter->num_add == 2 * num_add );
+	
+	delete(installed3);
+	delete(removed2);
+	delete(removed1);
+	delete(installed2);
+	delete(installed1);
+	delete(second);
+	delete(first);
+	delete(counter);
+}
+
+void NetmateIpfixPolicyRuleInstallerTest::update_test() 
+{
+	netmate_ipfix_policy_rule_installer_counter *counter = 
+			new netmate_ipfix_policy_rule_installer_counter(conf);
+	counter->setup();
+	
+	mt_policy_rule *first = new mt_policy_rule();
+	first->set_object(mess1->copy());
+	first->set_object(mess2->copy());
+	
+	mt_policy_rule *installed = counter->install(first);
+	CPPUNIT_ASSERT( installed->get_number_mspec_objects() == 2 );
+	int num_add = counter->num_add;
+	
+	// Nothing changes, so nothing is sent to the metering application.
+	mt_policy_rule *same = new mt_policy_rule();
+	same->set_object(mess2->copy());
+	same->set_object(mess1->copy());
+	
+	mt_policy_rule *result1 = counter->update(installed, same);
+	CPPUNIT_ASSERT( result1->get_number_mspec_objects() == 2 );
+	CPPUNIT_ASSERT( counter->num_add == num_add );
+	CPPUNIT_ASSERT( counter->num_remove == 0 );
+	
+	// mess2 is dropped and mess3 is added, mess1 keeps its tasks.
+	mt_policy_rule *changed = new mt_policy_rule();
+	changed->set_object(mess1->copy());
+	changed->set_object(mess3->copy());
+	
+	mt_policy_rule *result2 = counter->update(result1, changed);
+	CPPUNIT_ASSERT( result2->get_number_mspec_objects() == 2 );
+	CPPUNIT_ASSERT( result2->get_number_rule_keys() == 2 );
+	CPPUNIT_ASSERT( counter->num_add > num_add );
+	CPPUNIT_ASSERT( counter->num_remove > 0 );
+	CPPUNIT_ASSERT( counter->num_add - num_add < num_add );
+	
+	delete(result2);
+	delete(changed);
+	delete(result1);
+	delete(same);
+	delete(installed);
+	delete(first);
+	delete(counter);
+}
+
+void NetmateIpfixPolicyRuleInstallerTest::command_cache_test() 
+{
+	mspec_rule_key key1;
+	mspec_rule_key key2;
+	msg::mnslp_ipfix_message *copy1 = mess1->copy();
+	
+	std::map<std::string, std::string> commands1 = 
+			netmate->create_postfield_command(key1, mess1);
+	CPPUNIT_ASSERT( netmate->get_number_cached_commands() == 1 );
+	
+	// The same content is compiled once, only the key differs.
+	std::map<std::string, std::string> commands2 = 
+			netmate->create_postfield_command(key2, copy1);
+	CPPUNIT_ASSERT( netmate->get_number_cached_commands() == 1 );
+	CPPUNIT_ASSERT( commands1.size() == commands2.size() );
+	CPPUNIT_ASSERT( netmate->command_fingerprint(key1, commands1.begin()->second) ==
+					netmate->command_fingerprint(key2, commands2.begin()->second) );
+	
+	// Compiling with the cache gives the same commands as without it.
+	CPPUNIT_ASSERT( commands1 == 
+		netmate->build_commands(key1, netmate->compile_command(mess1)) );
+	
+	netmate->create_postfield_command(key1, mess2);
+	CPPUNIT_ASSERT( netmate->get_number_cached_commands() == 2 );
+	
+	// The least recently used command goes first.
+	netmate->set_command_cache_size(1);
+	CPPUNIT_ASSERT( netmate->get_number_cached_commands() == 1 );
+	netmate->create_postfield_command(key1, mess3);
+	CPPUNIT_ASSERT( netmate->get_number_cached_commands() == 1 );
+	
+	delete(copy1);
+}
+
+void NetmateIpfixPolicyRuleInstallerTest::bulk_remove_test() 
+{
+	netmate_ipfix_policy_rule_installer_counter *counter = 
+			new netmate_ipfix_policy_rule_installer_counter(conf);
+	counter->setup();
+	
+	msg::mnslp_ipfix_message *messages[] = { mess1, mess2, mess3 };
+	std::vector<const mt_policy_rule *> installed;
+	
+	for ( int i = 0; i < 3; i++ ){
+		mt_policy_rule *rule = new mt_policy_rule();
+		rule->set_object(messages[i]->copy());
+		installed.push_back(counter->install(rule));
+		delete(rule);
+	}
+	
+	// The tasks of all rules go in one request.
+	counter->remove_bulk(installed);
+	CPPUNIT_ASSERT( counter->num_remove == 1 );
+	CPPUNIT_ASSERT( std::count(counter->last_remove.begin(), 
+							   counter->last_remove.end(), ',') == 
+					counter->num_add - 1 );
+	
+	// Queued rules are removed by the teardown thread.
+	counter->start_teardown();
+	for ( size_t i = 0; i < installed.size(); i++ )
+		counter->schedule_remove(counter->install(installed[i]));
+	counter->stop_teardown();
+	
+	CPPUNIT_ASSERT( counter->num_remove >= 2 );
+	CPPUNIT_ASSERT( counter->num_remove <= 4 );
+	
+	// A metering application without list support gets one request per task.
+	counter->fail_list = true;
+	int num_remove = counter->num_remove;
+	std::vector<const mt_policy_rule *> again;
+	for ( size_t i = 0; i < installed.size(); i++ )
+		again.push_back(counter->install(installed[i]));
+	int num_tasks = counter->num_add / 3;
+	counter->remove_bulk(again);
+	CPPUNIT_ASSERT( counter->num_remove - num_remove == 1 + num_tasks );
+	CPPUNIT_ASSERT( counter->last_remove.find(',') == std::string::npos );
+	counter->fail_list = false;
+	
+	for ( size_t i = 0; i < again.size(); i++ )
+		delete(again[i]);
+	
+	// Everything removed, so installing again sends the commands again.
+	int num_add = counter->num_add;
+	delete(counter->install(installed[0]));
+	CPPUNIT_ASSERT( counter->num_add > num_add );
+	
+	for ( size_t i = 0; i < installed.size(); i++ )
+		delete(installed[i]);
+	delete(counter);
+}
+
+void NetmateIpfixPolicyRuleInstallerTest::failed_remove_test() 
+{
+	netmate_ipfix_policy_rule_installer_counter *counter = 
+			new netmate_ipfix_policy_rule_installer_counter(conf);
+	counter->setup();
+	
+	mt_policy_rule *rule = new mt_policy_rule();
+	rule->set_object(mess1->copy());
+	
+	mt_policy_rule *installed1 = counter->install(rule);
+	int num_add = counter->num_add;
+	
+	// The metering application keeps the tasks it could not remove.
+	counter->fail_remove = true;
+	mt_policy_rule *removed1 = counter->remove(installed1);
+	CPPUNIT_ASSERT( counter->num_remove == num_add );
+	CPPUNIT_ASSERT( removed1->begin_commands()->second.empty() );
+	
+	// So the next session shares them instead of installing them again.
+	counter->fail_remove = false;
+	mt_policy_rule *installed2 = counter->install(rule);
+	CPPUNIT_ASSERT( counter->num_add == num_add );
+	
+	// And removes them with its own last reference.
+	mt_policy_rule *removed2 = counter->remove(installed2);
+	CPPUNIT_ASSERT( counter->num_remove == 2 * num_add );
+	
+	mt_policy_rule *installed3 = counter->install(rule);
+	CPPUNIT_ASSERT( counter->num_add == 2 * num_add );
+	
+	// An HTTP error doesn't count as removed either.
+	counter->fail_remove = true;
+	counter->reject_code = 404;
+	mt_policy_rule *removed3 = counter->remove(installed3);
+	CPPUNIT_ASSERT( counter->num_remove == 3 * num_add );
+	CPPUNIT_ASSERT( removed3->begin_commands()->second.empty() );
+	counter->fail_remove = false;
+	
+	delete(counter->install(rule));
+	CPPUNIT_ASSERT( counter->num_add == 2 * num_add );
+	
+	delete(removed3);
+	delete(installed3);
+	delete(removed2);
+	delete(installed2);
+	delete(removed1);
+	delete(installed1);
+	delete(rule);
+	delete(counter);
+}
+
+void NetmateIpfixPolicyRuleInstallerTest::rejected_remove_test() 
+{
+	// Only a successful status and reply count as done.
+	netmate_ipfix_policy_rule_installer_test::check_reply("/rm_task", 200, 
+			"<reply status=\"OK\"></reply>");
+	CPPUNIT_ASSERT_THROW( netmate_ipfix_policy_rule_installer_test::check_reply(
+			"/rm_task", 500, ""), policy_rule_installer_error );
+	CPPUNIT_ASSERT_THROW( netmate_ipfix_policy_rule_installer_test::check_reply(
+			"/rm_task", 200, "<reply status='error'>no such rule</reply>"), 
+			policy_rule_installer_error );
+	
+	netmate_ipfix_policy_rule_installer_counter *counter = 
+			new netmate_ipfix_policy_rule_installer_counter(conf);
+	counter->setup();
+	
+	msg::mnslp_ipfix_message *messages[] = { mess1, mess2, mess3 };
+	std::vector<const mt_policy_rule *> installed;
+	
+	for ( int i = 0; i < 3; i++ ){
+		mt_policy_rule *rule = new mt_policy_rule();
+		rule->set_object(messages[i]->copy());
+		installed.push_back(counter->install(rule));
+		delete(rule);
+	}
+	int num_add = counter->num_add;
+	
+	// The list is refused, so every task is removed on its own.
+	counter->fail_list = true;
+	counter->reject_code = 500;
+	counter->remove_bulk(installed);
+	CPPUNIT_ASSERT( counter->num_remove == 1 + num_add );
+	counter->fail_list = false;
+	
+	// They are gone, so installing again sends the commands again.
+	std::vector<const mt_policy_rule *> again;
+	for ( size_t i = 0; i < installed.size(); i++ )
+		again.push_back(counter->install(installed[i]));
+	CPPUNIT_ASSERT( counter->num_add == 2 * num_add );
+	
+	// Tasks the metering application refuses to remove are kept ...
+	counter->fail_remove = true;
+	counter->remove_bulk(again);
+	counter->fail_remove = false;
+	
+	// ... and shared by the next sessions.
+	std::vector<const mt_policy_rule *> shared;
+	for ( size_t i = 0; i < installed.size(); i++ )
+		shared.push_back(counter->install(installed[i]));
+	CPPUNIT_ASSERT( counter->num_add == 2 * num_add );
+	
+	for ( size_t i = 0; i < installed.size(); i++ ){
+		delete(shared[i]);
+		delete(again[i]);
+		delete(installed[i]);
+	}
+	delete(counter);
+}
+
+void NetmateIpfixPolicyRuleInstallerTest::reconcile_test() 
+{
+	netmate_ipfix_policy_rule_installer_counter *before = 
+			new netmate_ipfix_policy_rule_installer_counter(conf);
+	before->setup();
+	
+	mt_policy_rule *rule = new mt_policy_rule();
+	rule->set_object(mess1->copy());
+	
+	mt_policy_rule *installed = before->install(rule);
+	int num_add = before->num_add;
+	CPPUNIT_ASSERT( num_add > 0 );
+	
+	std::set<std::string> names;
+	mt_policy_rule::const_iterator_commands it;
+	for ( it = installed->begin_commands(); it != installed->end_commands(); it++ )
+		names.insert(it->second.begin(), it->second.end());
+	
+	// The metering application still has the tasks, so they are shared.
+	netmate_ipfix_policy_rule_installer_counter *kept = 
+			new netmate_ipfix_policy_rule_installer_counter(conf);
+	kept->setup();
+	kept->metering_tasks = names;
+	kept->adopt(installed);
+	kept->reconcile();
+	delete(kept->install(rule));
+	CPPUNIT_ASSERT( kept->num_add == 0 );
+	
+	// It lost them while we were down, so they are installed again.
+	netmate_ipfix_policy_rule_installer_counter *lost = 
+			new netmate_ipfix_policy_rule_installer_counter(conf);
+	lost->setup();
+	lost->adopt(installed);
+	lost->reconcile();
+	delete(lost->install(rule));
+	CPPUNIT_ASSERT( lost->num_add == num_add );
+	
+	// Nothing adopted is shared if the tasks can't be listed.
+	netmate_ipfix_policy_rule_installer_counter *unknown = 
+			new netmate_ipfix_policy_rule_installer_counter(conf);
+	unknown->setup();
+	unknown->fail_query = true;
+	unknown->metering_tasks = names;
+	unknown->adopt(installed);
+	unknown->reconcile();
+	delete(unknown->install(rule));
+	CPPUNIT_ASSERT( unknown->num_add == num_add );
+	
+	// Only the tasks of our rule group are picked from a reply.
+	std::set<std::string> parsed;
+	netmate_ipfix_policy_rule_installer_test::parse_task_list(
+		"<info name=\"tasklist\">NETMATE_IPFIX.a_1, NETMATE_IPFIX.b_2\n"
+		"OTHER.c_1 XNETMATE_IPFIX.d_1</info>", parsed);
+	CPPUNIT_ASSERT( parsed.size() == 2 );
+	CPPUNIT_ASSERT( parsed.count("a_1") == 1 );
+	CPPUNIT_ASSERT( parsed.count("b_2") == 1 );
+	
+	delete(unknown);
+	delete(lost);
+	delete(kept);
+	delete(installed);
+	delete(rule);
+	delete(before);
+}
+
+void NetmateIpfixPolicyRuleInstallerTest::domain_test() 
+{
+	// The ID only depends on the task name and 0 is never used.
+	uint32 domain1 = netmate_ipfix_policy_rule_installer_test::task_domain("a_1");
+	uint32 domain2 = netmate_ipfix_policy_rule_installer_test::task_domain("b_1");
+	CPPUNIT_ASSERT( domain1 != 0 && domain2 != 0 );
+	CPPUNIT_ASSERT( domain1 != domain2 );
+	CPPUNIT_ASSERT( domain1 == 
+				netmate_ipfix_policy_rule_installer_test::task_domain("a_1") );
+	
+	// Tasks exporting the same way are shared whatever their ID.
+	mspec_rule_key key1;
+	mspec_rule_key key2;
+	std::ostringstream command1;
+	command1 << "Rule=1." << key1.to_string() << "_1 -e target=ipfix:[::1]:4739;odid="
+			 << domain1 << " -a a";
+	std::ostringstream command2;
+	command2 << "Rule=1." << key2.to_string() << "_1 -e target=ipfix:[::1]:4739;odid="
+			 << domain2 << " -a a";
+	CPPUNIT_ASSERT( netmate->command_fingerprint(key1, command1.str()) ==
+					netmate->command_fingerprint(key2, command2.str()) );
+	
+	// Other targets aren't.
+	std::ostringstream command3;
+	command3 << "Rule=1." << key2.to_string() << "_1 -e target=ipfix:[::1]:4740;odid="
+			 << domain2 << " -a a";
+	CPPUNIT_ASSERT( netmate->command_fingerprint(key1, command1.str()) !=
+					netmate->command_fingerprint(key2, command3.str()) );
+}
@@ -41,6 +41,7 @@ class ForwarderTest : public CppUnit::TestCase {
 	CPPUNIT_TEST( testClose );
 	CPPUNIT_TEST( testPending );
 	CPPUNIT_TEST( testMetering );
+	CPPUNIT_TEST( testReconfigure );
 	CPPUNIT_TEST( testIntegratedStateMachine );
 
 	CPPUNIT_TEST_SUITE_END();
@@ -57,6 +58,7 @@ class ForwarderTest : public CppUnit::TestCase {
 	void testClose();
 	void testPending();
 	void testMetering();
+	void testReconfigure();
 	void testIntegratedStateMachine();
 
   private:
@@ -522,6 +524,76 @@ void ForwarderTest::testMetering() {
 	
 }
 
+void ForwarderTest::testReconfigure() {
+
+	nf_session_test s1(nf_session::STATE_CLOSE, conf);
+
+	process(s1, new msg_event(new session_id(s1.get_id()),
+		create_mnslp_configure()));
+	process(s1, new msg_event(new session_id(s1.get_id()),
+		create_mnslp_response(information_code::sc_success,
+			information_code::suc_successfully_processed,
+			information_code::obj_none, START_MSN)));
+	ASSERT_STATE(s1, nf_session::STATE_METERING);
+	size_t installed = s1.get_number_mspec_objects();
+
+	/*
+	 * STATE_METERING ---[rx_CONFIGURE && CONFIGURE(Lifetime > 0) ]---> STATE_METERING
+	 */
+	event *e1 = new msg_event(new session_id(s1.get_id()),
+		create_mnslp_configure(START_MSN+1, 10));
+
+	process(s1, e1);
+	ASSERT_STATE(s1, nf_session::STATE_METERING);
+	ASSERT_CONFIGURE_MESSAGE_SENT(d);
+	ASSERT_TIMER_STARTED(d, s1.get_response_timer());
+
+	/*
+	 * STATE_METERING ---[rx_RESPONSE(SUCCESS,CONFIGURE)]---> STATE_METERING
+	 */
+	event *e2 = new msg_event(new session_id(s1.get_id()),
+		create_mnslp_response(information_code::sc_success,
+			information_code::suc_successfully_processed,
+			information_code::obj_none, START_MSN+1));
+
+	process(s1, e2);
+	ASSERT_STATE(s1, nf_session::STATE_METERING);
+	ASSERT_RESPONSE_MESSAGE_SENT(d, information_code::sc_success);
+	ASSERT_TIMER_STARTED(d, s1.get_state_timer());
+	CPPUNIT_ASSERT( s1.get_number_mspec_objects() == installed );
+
+	/*
+	 * STATE_METERING ---[rx_RESPONSE(ERROR,CONFIGURE)]---> STATE_METERING
+	 */
+	process(s1, new msg_event(new session_id(s1.get_id()),
+		create_mnslp_configure(START_MSN+2, 10)));
+	ASSERT_CONFIGURE_MESSAGE_SENT(d);
+
+	event *e3 = new msg_event(new session_id(s1.get_id()),
+		create_mnslp_response(information_code::sc_permanent_failure, 0,
+			information_code::obj_none, START_MSN+2));
+
+	process(s1, e3);
+	ASSERT_STATE(s1, nf_session::STATE_METERING);
+	ASSERT_RESPONSE_MESSAGE_SENT(d, information_code::sc_permanent_failure);
+	CPPUNIT_ASSERT( s1.get_number_mspec_objects() == installed );
+
+	/*
+	 * STATE_METERING ---[rx_CONFIGURE, RESPONSE_TIMEOUT]---> STATE_METERING
+	 */
+	process(s1, new msg_event(new session_id(s1.get_id()),
+		create_mnslp_configure(START_MSN+3, 10)));
+	ASSERT_CONFIGURE_MESSAGE_SENT(d);
+
+	s1.get_response_timer().set_id(47);
+	timer_event *e4 = new timer_event(NULL, 47);
+
+	process(s1, e4);
+	ASSERT_STATE(s1, nf_session::STATE_METERING);
+	ASSERT_RESPONSE_MESSAGE_SENT(d, information_code::sc_permanent_failure);
+	CPPUNIT_ASSERT( s1.get_number_mspec_objects() == installed );
+}
+
 void 
 ForwarderTest::testIntegratedStateMachine()
 {
@@ -43,6 +43,7 @@ class ResponderTest : public CppUnit::TestCase {
 
 	CPPUNIT_TEST( testClose );
 	CPPUNIT_TEST( testMetering );
+	CPPUNIT_TEST( testBundledRefresh );
 	CPPUNIT_TEST( testIntegratedStateMachine );
 
 	CPPUNIT_TEST_SUITE_END();
@@ -58,6 +59,7 @@ class ResponderTest : public CppUnit::TestCase {
 
 	void testClose();
 	void testMetering();
+	void testBundledRefresh();
 	void testIntegratedStateMachine();
 
   private:
@@ -354,6 +356,63 @@ ResponderTest::testMetering() {
 	std::cout << "Test Metering 5" << std::endl;
 }
 
+void 
+ResponderTest::testBundledRefresh() {
+
+	/*
+	 * STATE_METERING ---[rx_BUNDLED_REFRESH && REFRESH(Lifetime>0) ]---> STATE_METERING
+	 */
+	nr_session_test s1(nr_session::STATE_METERING, START_MSN);
+	s1.set_upstream_peer(5);
+	bundled_refresh_event e1(new session_id(), START_MSN+1, 10, 5);
+
+	d->clear();
+	s1.process(d, &e1);
+	ASSERT_STATE(s1, nr_session::STATE_METERING);
+	CPPUNIT_ASSERT( e1.is_accepted() );
+	CPPUNIT_ASSERT( s1.get_msg_sequence_number() == START_MSN+1 );
+	CPPUNIT_ASSERT( s1.get_lifetime() == 10 );
+	ASSERT_NO_MESSAGE(d);
+	ASSERT_TIMER_STARTED(d, s1.get_state_timer());
+
+	/*
+	 * STATE_METERING ---[rx_BUNDLED_REFRESH && wrong peer ]---> STATE_METERING
+	 */
+	bundled_refresh_event e2(new session_id(), START_MSN+2, 10, 6);
+
+	d->clear();
+	s1.process(d, &e2);
+	ASSERT_STATE(s1, nr_session::STATE_METERING);
+	CPPUNIT_ASSERT( ! e2.is_accepted() );
+	CPPUNIT_ASSERT( s1.get_msg_sequence_number() == START_MSN+1 );
+	ASSERT_NO_TIMER(d);
+
+	/*
+	 * STATE_METERING ---[rx_BUNDLED_REFRESH && unknown peer ]---> STATE_METERING
+	 */
+	nr_session_test s3(nr_session::STATE_METERING, START_MSN);
+	bundled_refresh_event e4(new session_id(), START_MSN+1, 10, 5);
+
+	d->clear();
+	s3.process(d, &e4);
+	ASSERT_STATE(s3, nr_session::STATE_METERING);
+	CPPUNIT_ASSERT( ! e4.is_accepted() );
+	CPPUNIT_ASSERT( s3.get_msg_sequence_number() == START_MSN );
+	ASSERT_NO_TIMER(d);
+
+	/*
+	 * STATE_CLOSE ---[rx_BUNDLED_REFRESH ]---> STATE_CLOSE
+	 */
+	nr_session_test s2(nr_session::STATE_CLOSE);
+	bundled_refresh_event e3(new session_id(), START_MSN+1, 10, 5);
+
+	d->clear();
+	s2.process(d, &e3);
+	ASSERT_STATE(s2, nr_session::STATE_CLOSE);
+	CPPUNIT_ASSERT( ! e3.is_accepted() );
+	ASSERT_NO_MESSAGE(d);
+}
+
 void 
 ResponderTest::testIntegratedStateMachine()
 {
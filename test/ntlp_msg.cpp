@@ -0,0 +1,136 @@
+/*
+ * ntlp_msg.cpp - Test sharing the body and wire format of NTLP messages.
+ *
+ * $Id: ntlp_msg.cpp 2438 2015-03-10 $
+ * $HeadURL: https://./test/ntlp_msg.cpp $
+ *
+ */
+#include <cstring>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "network_message.h"
+
+#include "msg/ntlp_msg.h"
+#include "msg/mnslp_refresh.h"
+
+using namespace mnslp::msg;
+
+
+class NtlpMsgTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( NtlpMsgTest );
+
+	CPPUNIT_TEST( testCopy );
+	CPPUNIT_TEST( testRefresh );
+	CPPUNIT_TEST( testSetSerialized );
+
+	CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void testCopy();
+	void testRefresh();
+	void testSetSerialized();
+
+  private:
+	ntlp_msg *create_refresh(uint32 msn, uint32 lifetime) const;
+	bool same_wire(const ntlp_msg *m1, const ntlp_msg *m2) const;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( NtlpMsgTest );
+
+
+ntlp_msg *NtlpMsgTest::create_refresh(uint32 msn, uint32 lifetime) const {
+	mnslp_refresh *refresh = new mnslp_refresh();
+	refresh->set_msg_sequence_number(msn);
+	refresh->set_session_lifetime(lifetime);
+
+	return new ntlp_msg(session_id(), refresh,
+		new ntlp::mri_pathcoupled(), 0);
+}
+
+
+bool NtlpMsgTest::same_wire(const ntlp_msg *m1, const ntlp_msg *m2) const {
+	uint32 len1, len2;
+	const uchar *w1 = m1->get_serialized(len1);
+	const uchar *w2 = m2->get_serialized(len2);
+
+	return len1 == len2 && memcmp(w1, w2, len1) == 0;
+}
+
+
+void NtlpMsgTest::testCopy() {
+	ntlp_msg *m1 = create_refresh(7, 30);
+	CPPUNIT_ASSERT( ! m1->is_shared() );
+
+	uint32 len1, len2;
+	const uchar *w1 = m1->get_serialized(len1);
+
+	ntlp_msg *m2 = m1->copy();
+	CPPUNIT_ASSERT( m1->is_shared() );
+	CPPUNIT_ASSERT( m2->get_mnslp_msg() == m1->get_mnslp_msg() );
+	CPPUNIT_ASSERT( m2->get_mri() != m1->get_mri() );
+
+	const uchar *w2 = m2->get_serialized(len2);
+	CPPUNIT_ASSERT( w1 == w2 );
+	CPPUNIT_ASSERT( len1 == len2 );
+
+	delete m1;
+	CPPUNIT_ASSERT( ! m2->is_shared() );
+	CPPUNIT_ASSERT( m2->get_mnslp_refresh() != NULL );
+	CPPUNIT_ASSERT( m2->get_mnslp_refresh()->get_msg_sequence_number() == 7 );
+	delete m2;
+}
+
+
+void NtlpMsgTest::testRefresh() {
+	ntlp_msg *m1 = create_refresh(7, 30);
+
+	// not serialized yet: the copy is serialized from scratch
+	ntlp_msg *m2 = m1->copy_for_refresh(8, 30, m1->get_mri()->copy(), 0);
+	CPPUNIT_ASSERT( ! m1->is_shared() );
+	CPPUNIT_ASSERT( m2->get_mnslp_refresh()->get_msg_sequence_number() == 8 );
+
+	// serialized: the copy's wire format is patched
+	ntlp_msg *m3 = m2->copy_for_refresh(9, 0, m2->get_mri()->copy(), 0);
+	ntlp_msg *expected = create_refresh(9, 0);
+
+	CPPUNIT_ASSERT( m3->get_mnslp_refresh()->get_msg_sequence_number() == 9 );
+	CPPUNIT_ASSERT( m3->get_mnslp_refresh()->get_session_lifetime() == 0 );
+	CPPUNIT_ASSERT( same_wire(m3, expected) );
+	CPPUNIT_ASSERT( ! same_wire(m2, m3) );
+
+	// the copy is sent with the session's SII handle
+	ntlp_msg *m4 = m3->copy_for_refresh(10, 30, m3->get_mri()->copy(), 42);
+	CPPUNIT_ASSERT( m4->get_sii_handle() == 42 );
+	CPPUNIT_ASSERT( m3->get_sii_handle() == 0 );
+	delete m4;
+
+	delete expected;
+	delete m3;
+	delete m2;
+	delete m1;
+}
+
+
+void NtlpMsgTest::testSetSerialized() {
+	ntlp_msg *m1 = create_refresh(7, 30);
+
+	uint32 len1;
+	const uchar *w1 = m1->get_serialized(len1);
+
+	ntlp_msg *m2 = create_refresh(7, 30);
+	m2->set_serialized(w1, len1);
+
+	ntlp_msg *m3 = m2->copy_for_forwarding();
+	CPPUNIT_ASSERT( m2->is_shared() );
+	CPPUNIT_ASSERT( m3->get_sii_handle() == 0 );
+	CPPUNIT_ASSERT( same_wire(m1, m3) );
+
+	delete m3;
+	delete m2;
+	delete m1;
+}
+
+// EOF
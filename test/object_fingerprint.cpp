@@ -0,0 +1,175 @@
+/*
+ * object_fingerprint.cpp - Test the fingerprints of MNSLP objects.
+ *
+ * $Id: object_fingerprint.cpp 2438 2015-03-10 $
+ * $HeadURL: https://./test/object_fingerprint.cpp $
+ *
+ */
+#include <time.h>
+#include <unistd.h>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "msg/mnslp_ipfix_message.h"
+#include "msg/object_fingerprint.h"
+
+using namespace mnslp::msg;
+
+
+class ObjectFingerprintTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( ObjectFingerprintTest );
+
+	CPPUNIT_TEST( testCompute );
+	CPPUNIT_TEST( testCopy );
+	CPPUNIT_TEST( testImport );
+	CPPUNIT_TEST( testChange );
+	CPPUNIT_TEST( testClockTick );
+
+	CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void testCompute();
+	void testCopy();
+	void testImport();
+	void testChange();
+	void testClockTick();
+
+  private:
+	uint16_t add_record(mnslp_ipfix_message *mess, uint16_t templid, 
+						uint16_t port);
+	mnslp_ipfix_message *build_message(int nrecords, 
+									   int version = IPFIX_VERSION,
+									   int sourceid = 1);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( ObjectFingerprintTest );
+
+
+uint16_t ObjectFingerprintTest::add_record(mnslp_ipfix_message *mess, 
+										   uint16_t templid, uint16_t port) {
+	uint8_t proto_value = 17;
+	mnslp_ipfix_field fport = mess->get_field_definition(0, IPFIX_FT_SOURCETRANSPORTPORT);
+	mnslp_ipfix_field fproto = mess->get_field_definition(0, IPFIX_FT_PROTOCOLIDENTIFIER);
+	mnslp_ipfix_value_field vport = fport.get_ipfix_value_field(port);
+	mnslp_ipfix_value_field vproto = fproto.get_ipfix_value_field(proto_value);
+
+	mnslp_ipfix_data_record data(templid);
+	data.insert_field(0, IPFIX_FT_SOURCETRANSPORTPORT, vport);
+	data.insert_field(0, IPFIX_FT_PROTOCOLIDENTIFIER, vproto);
+	mess->include_data(templid, data);
+	return templid;
+}
+
+
+mnslp_ipfix_message *ObjectFingerprintTest::build_message(int nrecords, 
+															int version,
+															int sourceid) {
+	mnslp_ipfix_message *mess = new mnslp_ipfix_message(sourceid, version, true);
+
+	uint16_t templid = mess->new_data_template( 2 );
+	mess->add_field(templid, 0, IPFIX_FT_SOURCETRANSPORTPORT, 2);
+	mess->add_field(templid, 0, IPFIX_FT_PROTOCOLIDENTIFIER, 1);
+
+	for ( int i = 0; i < nrecords; i++ )
+		add_record(mess, templid, 5000 + i);
+
+	mess->output();
+	return mess;
+}
+
+
+void ObjectFingerprintTest::testCompute() {
+	const char *text = "The quick brown fox jumps over the lazy dog";
+
+	object_fingerprint fp = object_fingerprint::compute(text, strlen(text));
+	CPPUNIT_ASSERT( fp.high == 0xe34bbc7bbc071b6cULL );
+	CPPUNIT_ASSERT( fp.low == 0x7a433ca9c49a9347ULL );
+
+	CPPUNIT_ASSERT( object_fingerprint::compute(text, 0) == object_fingerprint() );
+
+	object_fingerprint other = object_fingerprint::compute(text, strlen(text) - 1);
+	CPPUNIT_ASSERT( fp != other );
+	CPPUNIT_ASSERT( (fp < other) != (other < fp) );
+	CPPUNIT_ASSERT( !(fp < fp) );
+}
+
+
+void ObjectFingerprintTest::testCopy() {
+	mnslp_ipfix_message *mess = build_message(3);
+	mnslp_ipfix_message copy(*mess);
+
+	CPPUNIT_ASSERT( mess->get_fingerprint() == copy.get_fingerprint() );
+	CPPUNIT_ASSERT( mess->isEqual(copy) );
+	CPPUNIT_ASSERT( copy.isEqual(*mess) );
+
+	delete mess;
+}
+
+
+void ObjectFingerprintTest::testImport() {
+	mnslp_ipfix_message *mess = build_message(3);
+
+	// The fingerprint of a decoded message is set from the received bytes.
+	mnslp_ipfix_message decoded(mess->get_message(), mess->get_offset(), true);
+	CPPUNIT_ASSERT( decoded.get_fingerprint() == mess->get_fingerprint() );
+	CPPUNIT_ASSERT( decoded.isEqual(*mess) );
+
+	delete mess;
+}
+
+
+void ObjectFingerprintTest::testChange() {
+	mnslp_ipfix_message *mess = build_message(3);
+	mnslp_ipfix_message *longer = build_message(3);
+	object_fingerprint before = longer->get_fingerprint();
+
+	// A message with more records than the other one is not equal to it.
+	add_record(longer, longer->get_template_list().front(), 6000);
+	CPPUNIT_ASSERT( longer->get_fingerprint() != before );
+	CPPUNIT_ASSERT( mess->notEqual(*longer) );
+	CPPUNIT_ASSERT( longer->notEqual(*mess) );
+
+	delete longer;
+	delete mess;
+}
+
+
+void ObjectFingerprintTest::testClockTick() {
+	mnslp_ipfix_message *first = build_message(3);
+	mnslp_ipfix_message *first_nf9 = build_message(3, IPFIX_VERSION_NF9);
+
+	time_t start = time(NULL);
+	while ( time(NULL) == start )
+		usleep(10000);
+
+	// Built again one second later, only the header differs.
+	mnslp_ipfix_message *second = build_message(3);
+	mnslp_ipfix_message *second_nf9 = build_message(3, IPFIX_VERSION_NF9);
+	second_nf9->output(); // advances the NF9 sequence number
+
+	CPPUNIT_ASSERT( first->get_offset() == second->get_offset() );
+	CPPUNIT_ASSERT( memcmp(first->get_message(), second->get_message(), 
+						   IPFIX_HDR_BYTES) != 0 );
+
+	CPPUNIT_ASSERT( first->get_fingerprint() == second->get_fingerprint() );
+	CPPUNIT_ASSERT( first->isEqual(*second) );
+
+	CPPUNIT_ASSERT( first_nf9->get_fingerprint() == second_nf9->get_fingerprint() );
+	CPPUNIT_ASSERT( first_nf9->isEqual(*second_nf9) );
+
+	// The observation domain is part of the content.
+	mnslp_ipfix_message *other_domain = build_message(3, IPFIX_VERSION, 2);
+	CPPUNIT_ASSERT( other_domain->get_fingerprint() != first->get_fingerprint() );
+	CPPUNIT_ASSERT( other_domain->notEqual(*first) );
+
+	delete other_domain;
+
+	delete second_nf9;
+	delete second;
+	delete first_nf9;
+	delete first;
+}
+
+// EOF
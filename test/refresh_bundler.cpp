@@ -0,0 +1,157 @@
+/*
+ * refresh_bundler.cpp - Test bundling REFRESH messages by peer.
+ *
+ * $Id: refresh_bundler.cpp 2571 2015-03-10 $
+ * $HeadURL: https://./test/refresh_bundler.cpp $
+ *
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "mri.h"	// from NTLP
+
+#include "refresh_bundler.h"
+#include "msg/mnslp_refresh.h"
+
+using namespace mnslp;
+using namespace mnslp::msg;
+
+
+class RefreshBundlerTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( RefreshBundlerTest );
+
+	CPPUNIT_TEST( testLearn );
+	CPPUNIT_TEST( testSingle );
+	CPPUNIT_TEST( testBundle );
+	CPPUNIT_TEST( testSplit );
+
+	CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void testLearn();
+	void testSingle();
+	void testBundle();
+	void testSplit();
+
+  private:
+	static const uint32 PEER = 42;
+
+	ntlp_msg *create_refresh(uint32 id, uint32 msn, uint32 lifetime) const;
+	void clear(std::vector<ntlp_msg *> &msgs) const;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( RefreshBundlerTest );
+
+
+ntlp_msg *RefreshBundlerTest::create_refresh(uint32 id, uint32 msn,
+		uint32 lifetime) const {
+
+	mnslp_refresh *refresh = new mnslp_refresh();
+	refresh->set_msg_sequence_number(msn);
+	refresh->set_session_lifetime(lifetime);
+
+	return new ntlp_msg(session_id(uint128(0, 0, 0, id)), refresh,
+		new ntlp::mri_pathcoupled(), 0);
+}
+
+
+void RefreshBundlerTest::clear(std::vector<ntlp_msg *> &msgs) const {
+	for ( size_t i = 0; i < msgs.size(); i++ )
+		delete msgs[i];
+	msgs.clear();
+}
+
+
+void RefreshBundlerTest::testLearn() {
+	refresh_bundler bundler;
+	mnslp_refresh refresh;
+
+	CPPUNIT_ASSERT( bundler.is_enabled() );
+	CPPUNIT_ASSERT( refresh.has_flag(mnslp_msg::FLAG_REFRESH_BUNDLING) );
+	CPPUNIT_ASSERT( ! bundler.is_capable(PEER) );
+
+	bundler.learn(PEER, &refresh);
+	CPPUNIT_ASSERT( bundler.is_capable(PEER) );
+	CPPUNIT_ASSERT( ! bundler.is_capable(PEER + 1) );
+
+	// Messages created locally have no peer.
+	bundler.learn(0, &refresh);
+	CPPUNIT_ASSERT( ! bundler.is_capable(0) );
+
+	refresh_bundler disabled(false);
+	CPPUNIT_ASSERT( ! disabled.is_enabled() );
+}
+
+
+void RefreshBundlerTest::testSingle() {
+	std::vector<ntlp_msg *> in, out;
+
+	ntlp_msg *msg = create_refresh(1, 10, 30);
+	in.push_back(msg);
+
+	refresh_bundler::bundle(in, PEER, out);
+
+	// A single refresh is sent as it is.
+	CPPUNIT_ASSERT( out.size() == 1 );
+	CPPUNIT_ASSERT( out[0] == msg );
+	CPPUNIT_ASSERT( out[0]->get_mnslp_refresh()->get_refresh_list() == NULL );
+
+	clear(out);
+}
+
+
+void RefreshBundlerTest::testBundle() {
+	std::vector<ntlp_msg *> in, out;
+
+	for ( uint32 i = 1; i <= 3; i++ )
+		in.push_back(create_refresh(i, 10 + i, 30 * i));
+
+	refresh_bundler::bundle(in, PEER, out);
+	CPPUNIT_ASSERT( out.size() == 1 );
+
+	ntlp_msg *msg = out[0];
+	CPPUNIT_ASSERT( msg->get_session_id() == session_id(uint128(0, 0, 0, 1)) );
+	CPPUNIT_ASSERT( msg->get_sii_handle() == PEER );
+
+	mnslp_refresh *refresh = msg->get_mnslp_refresh();
+	CPPUNIT_ASSERT( refresh != NULL );
+	CPPUNIT_ASSERT( refresh->get_msg_sequence_number() == 11 );
+	CPPUNIT_ASSERT( refresh->get_session_lifetime() == 30 );
+	CPPUNIT_ASSERT( refresh->check() );
+
+	refresh_list *list = refresh->get_refresh_list();
+	CPPUNIT_ASSERT( list != NULL );
+	CPPUNIT_ASSERT( list->size() == 2 );
+
+	refresh_list::const_iterator i = list->begin();
+	CPPUNIT_ASSERT( i->session == uint128(0, 0, 0, 2) );
+	CPPUNIT_ASSERT( i->msn == 12 && i->lifetime == 60 );
+	i++;
+	CPPUNIT_ASSERT( i->session == uint128(0, 0, 0, 3) );
+	CPPUNIT_ASSERT( i->msn == 13 && i->lifetime == 90 );
+
+	clear(out);
+}
+
+
+void RefreshBundlerTest::testSplit() {
+	std::vector<ntlp_msg *> in, out;
+
+	const size_t count = refresh_list::MAX_ENTRIES + 3;
+
+	for ( size_t i = 0; i < count; i++ )
+		in.push_back(create_refresh(i, 1, 30));
+
+	refresh_bundler::bundle(in, PEER, out);
+	CPPUNIT_ASSERT( out.size() == 2 );
+
+	refresh_list *l1 = out[0]->get_mnslp_refresh()->get_refresh_list();
+	refresh_list *l2 = out[1]->get_mnslp_refresh()->get_refresh_list();
+	CPPUNIT_ASSERT( l1 != NULL && l1->is_full() );
+	CPPUNIT_ASSERT( l2 != NULL && l2->size() == 1 );
+
+	clear(out);
+}
+
+// EOF
@@ -0,0 +1,53 @@
+/*
+ * Test the Refresh List Object
+ *
+ * $Id: refresh_list.cpp 2571 2015-03-10 $
+ * $HeadURL: https://./test/refresh_list.cpp $
+ */
+#include "generic_object_test.h"
+
+using namespace mnslp::msg;
+
+
+class RefreshListTest : public GenericObjectTest {
+
+	CPPUNIT_TEST_SUITE( RefreshListTest );
+
+	MNSLP_OBJECT_DEFAULT_TESTS();
+	CPPUNIT_TEST( testCapacity );
+
+	CPPUNIT_TEST_SUITE_END();
+
+  public:
+	virtual mnslp_object *createInstance1() const {
+		return new refresh_list();
+	}
+
+	virtual mnslp_object *createInstance2() const {
+		refresh_list *list = new refresh_list();
+		list->add(uint128(1, 2, 3, 4), 7, 30);
+		list->add(uint128(5, 6, 7, 8), 9, 60);
+		return list;
+	}
+
+	virtual void mutate1(mnslp_object *o) const {
+		refresh_list *list = dynamic_cast<refresh_list *>(o);
+		list->add(uint128(1, 2, 3, 4), 8, 30);
+	}
+
+	void testCapacity() {
+		refresh_list list;
+
+		for ( size_t i = 0; i < refresh_list::MAX_ENTRIES; i++ )
+			CPPUNIT_ASSERT( list.add(uint128(0, 0, 0, i), i, 30) );
+
+		CPPUNIT_ASSERT( list.is_full() );
+		CPPUNIT_ASSERT( ! list.add(uint128(1, 0, 0, 0), 1, 30) );
+		CPPUNIT_ASSERT( list.size() == refresh_list::MAX_ENTRIES );
+		CPPUNIT_ASSERT( list.check() );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( RefreshListTest );
+
+// EOF
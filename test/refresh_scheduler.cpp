@@ -0,0 +1,95 @@
+/*
+ * refresh_scheduler.cpp - Test the jittered refresh scheduling.
+ *
+ * $Id: refresh_scheduler.cpp 2558 2015-03-10 $
+ * $HeadURL: https://./test/refresh_scheduler.cpp $
+ *
+ */
+#include <vector>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "refresh_scheduler.h"
+
+using namespace mnslp;
+
+
+class RefreshSchedulerTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( RefreshSchedulerTest );
+
+	CPPUNIT_TEST( testJitter );
+	CPPUNIT_TEST( testLoadAware );
+	CPPUNIT_TEST( testAdvance );
+
+	CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void testJitter();
+	void testLoadAware();
+	void testAdvance();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( RefreshSchedulerTest );
+
+
+void RefreshSchedulerTest::testJitter() {
+	refresh_scheduler s;
+	std::vector<int> seen(16, 0);
+
+	CPPUNIT_ASSERT( ! s.is_load_aware() );
+
+	for ( int i = 0; i < 1000; i++ ) {
+		uint32 delay = s.next_refresh(10);
+		CPPUNIT_ASSERT( delay >= 5 && delay <= 15 );
+		seen[delay]++;
+	}
+
+	// not stuck at a single value
+	CPPUNIT_ASSERT( seen[10] < 1000 );
+
+	CPPUNIT_ASSERT( refresh_scheduler::jitter(1) == 1 );
+	CPPUNIT_ASSERT( refresh_scheduler::jitter(0) == 1 );
+}
+
+
+void RefreshSchedulerTest::testLoadAware() {
+	refresh_scheduler s(true);
+	std::vector<int> seen(16, 0);
+
+	CPPUNIT_ASSERT( s.is_load_aware() );
+
+	// 11 possible delays, so every one of them is booked exactly twice
+	for ( int i = 0; i < 22; i++ ) {
+		uint32 delay = s.next_refresh(10, 1000);
+		CPPUNIT_ASSERT( delay >= 5 && delay <= 15 );
+		seen[delay]++;
+	}
+
+	for ( int i = 5; i <= 15; i++ )
+		CPPUNIT_ASSERT_EQUAL( 2, seen[i] );
+
+	// intervals longer than the initial ring
+	for ( int i = 0; i < 10; i++ ) {
+		uint32 delay = s.next_refresh(1000, 1000);
+		CPPUNIT_ASSERT( delay >= 500 && delay <= 1500 );
+	}
+}
+
+
+void RefreshSchedulerTest::testAdvance() {
+	refresh_scheduler s(true);
+
+	// book every second of [1005, 1015]
+	for ( int i = 0; i < 11; i++ )
+		s.next_refresh(10, 1000);
+
+	// five seconds later, [1005, 1009] are gone, [1010, 1015] still booked
+	for ( int i = 0; i < 5; i++ ) {
+		uint32 delay = s.next_refresh(10, 1005);
+		CPPUNIT_ASSERT( delay >= 11 );
+	}
+}
+
+// EOF
@@ -0,0 +1,345 @@
+/*
+ * session_checkpoint.cpp - Test the checkpoint log of the session table.
+ *
+ * $Id: session_checkpoint.cpp 2571 2015-03-10 $
+ * $HeadURL: https://./test/session_checkpoint.cpp $
+ *
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mri.h"	// from NTLP
+
+#include "session_checkpoint.h"
+#include "session_manager.h"
+#include "nop_policy_rule_installer.h"
+#include "msg/mnslp_ie.h"
+#include "msg/mnslp_ipfix_message.h"
+
+#include "utils.h"
+
+using namespace mnslp;
+using namespace mnslp::msg;
+
+
+class SessionCheckpointTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( SessionCheckpointTest );
+
+	CPPUNIT_TEST( testReplay );
+	CPPUNIT_TEST( testUnchanged );
+	CPPUNIT_TEST( testCorruptRecord );
+	CPPUNIT_TEST( testCompact );
+	CPPUNIT_TEST( testCompactPadding );
+	CPPUNIT_TEST( testInvalidFile );
+	CPPUNIT_TEST( testRestore );
+
+	CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void setUp();
+	void tearDown();
+
+	void testReplay();
+	void testUnchanged();
+	void testCorruptRecord();
+	void testCompact();
+	void testCompactPadding();
+	void testInvalidFile();
+	void testRestore();
+
+  private:
+	std::string filename;
+
+	void fill(session_snapshot &snap, session::session_type_t type,
+		uint32 msn, time_t expires) const;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SessionCheckpointTest );
+
+
+void SessionCheckpointTest::setUp() {
+	MNSLP_IEManager::clear();
+	MNSLP_IEManager::register_known_ies();
+
+	filename = "session_checkpoint_test.log";
+	unlink(filename.c_str());
+}
+
+
+void SessionCheckpointTest::tearDown() {
+	unlink(filename.c_str());
+}
+
+
+void SessionCheckpointTest::fill(session_snapshot &snap,
+		session::session_type_t type, uint32 msn, time_t expires) const {
+
+	snap.id = session_id();
+	snap.type = type;
+	snap.state = 2;
+	snap.msn = msn;
+	snap.lifetime = 30;
+	snap.expires = expires;
+	snap.upstream_peer = 7;
+	snap.downstream_peer = 8;
+	snap.ni_mri = new ntlp::mri_pathcoupled(
+		hostaddress("192.168.0.5"), 32, 80,
+		hostaddress("192.168.0.4"), 32, 10000,
+		"tcp", 0, 0, 0, false);
+	snap.nr_mri = new ntlp::mri_pathcoupled(
+		hostaddress("192.168.0.4"), 32, 10000,
+		hostaddress("192.168.0.5"), 32, 80,
+		"tcp", 0, 0, 0, true);
+
+	mnslp_ipfix_message *mess = new mnslp_ipfix_message(0, IPFIX_VERSION, true);
+	uint16_t templid = mess->new_data_template(2);
+	mess->add_field(templid, 0, IPFIX_FT_OCTETDELTACOUNT, 8);
+	mess->add_field(templid, 0, IPFIX_FT_PACKETDELTACOUNT, 8);
+
+	snap.rule = new mt_policy_rule();
+	mspec_rule_key key = snap.rule->set_object(mess);
+	snap.rule->set_commands(key, std::vector<std::string>(2, key.to_string()));
+}
+
+
+void SessionCheckpointTest::testReplay() {
+	session_snapshot snap1, snap2;
+	fill(snap1, session::st_forwarder, 10, 1000);
+	fill(snap2, session::st_receiver, 20, 2000);
+
+	{
+		session_checkpoint cp(filename);
+		CPPUNIT_ASSERT( cp.open() );
+		CPPUNIT_ASSERT( cp.get_num_sessions() == 0 );
+
+		cp.save(snap1);
+		cp.save(snap2);
+		cp.remove(snap1.id);
+		CPPUNIT_ASSERT( cp.get_num_sessions() == 1 );
+	}
+
+	session_checkpoint cp(filename);
+	CPPUNIT_ASSERT( cp.open() );
+	CPPUNIT_ASSERT( cp.get_num_sessions() == 1 );
+
+	std::vector<session_snapshot *> snapshots;
+	CPPUNIT_ASSERT( cp.replay(snapshots) == 1 );
+	CPPUNIT_ASSERT( snapshots.size() == 1 );
+
+	session_snapshot *snap = snapshots[0];
+	CPPUNIT_ASSERT( snap->id == snap2.id );
+	CPPUNIT_ASSERT( snap->type == session::st_receiver );
+	CPPUNIT_ASSERT( snap->state == 2 );
+	CPPUNIT_ASSERT( snap->msn == 20 );
+	CPPUNIT_ASSERT( snap->lifetime == 30 );
+	CPPUNIT_ASSERT( snap->expires == 2000 );
+	CPPUNIT_ASSERT( snap->upstream_peer == 7 );
+	CPPUNIT_ASSERT( snap->downstream_peer == 8 );
+	CPPUNIT_ASSERT( snap->ni_mri != NULL && *snap->ni_mri == *snap2.ni_mri );
+	CPPUNIT_ASSERT( snap->nr_mri != NULL && *snap->nr_mri == *snap2.nr_mri );
+
+	// Same keys, task names and objects.
+	CPPUNIT_ASSERT( snap->rule != NULL && *snap->rule == *snap2.rule );
+
+	delete snap;
+}
+
+
+void SessionCheckpointTest::testUnchanged() {
+	session_snapshot snap;
+	fill(snap, session::st_forwarder, 10, 1000);
+
+	session_checkpoint cp(filename);
+	CPPUNIT_ASSERT( cp.open() );
+
+	cp.save(snap);
+	size_t size = cp.get_log_size();
+
+	cp.save(snap);
+	CPPUNIT_ASSERT( cp.get_log_size() == size );
+
+	snap.msn++;
+	cp.save(snap);
+	CPPUNIT_ASSERT( cp.get_log_size() > size );
+	CPPUNIT_ASSERT( cp.get_num_sessions() == 1 );
+
+	// Removing a session that isn't in the log writes nothing.
+	size = cp.get_log_size();
+	cp.remove(session_id());
+	CPPUNIT_ASSERT( cp.get_log_size() == size );
+}
+
+
+void SessionCheckpointTest::testCorruptRecord() {
+	session_snapshot snap1, snap2, snap3;
+	fill(snap1, session::st_forwarder, 10, 1000);
+	fill(snap2, session::st_forwarder, 20, 1000);
+	fill(snap3, session::st_forwarder, 30, 1000);
+
+	size_t offset;
+	{
+		session_checkpoint cp(filename);
+		CPPUNIT_ASSERT( cp.open() );
+		cp.save(snap1);
+		offset = cp.get_log_size();
+		cp.save(snap2);
+	}
+
+	// Damage the body of the second record, as if the write was cut short.
+	int fd = open(filename.c_str(), O_WRONLY);
+	CPPUNIT_ASSERT( fd >= 0 );
+	CPPUNIT_ASSERT( pwrite(fd, "\xff\xff\xff\xff", 4, offset + 40) == 4 );
+	close(fd);
+
+	{
+		session_checkpoint cp(filename);
+		CPPUNIT_ASSERT( cp.open() );
+		CPPUNIT_ASSERT( cp.get_num_sessions() == 1 );
+		CPPUNIT_ASSERT( cp.get_log_size() == offset );
+
+		cp.save(snap3);
+	}
+
+	session_checkpoint cp(filename);
+	CPPUNIT_ASSERT( cp.open() );
+	CPPUNIT_ASSERT( cp.get_num_sessions() == 2 );
+
+	std::vector<session_snapshot *> snapshots;
+	CPPUNIT_ASSERT( cp.replay(snapshots) == 2 );
+
+	for ( size_t i = 0; i < snapshots.size(); i++ ) {
+		CPPUNIT_ASSERT( snapshots[i]->id != snap2.id );
+		delete snapshots[i];
+	}
+}
+
+
+void SessionCheckpointTest::testCompact() {
+	session_snapshot snap1, snap2;
+	fill(snap1, session::st_forwarder, 0, 1000);
+	fill(snap2, session::st_forwarder, 0, 1000);
+
+	session_checkpoint cp(filename);
+	CPPUNIT_ASSERT( cp.open() );
+
+	cp.save(snap2);
+	size_t record = cp.get_log_size();
+
+	for ( int i = 0; i < 100; i++ ) {
+		snap1.msn = i;
+		cp.save(snap1);
+	}
+	CPPUNIT_ASSERT( cp.get_log_size() > 100 * (record / 2) );
+
+	// Saving doesn't compact, and less than a chunk isn't worth it.
+	CPPUNIT_ASSERT( ! cp.compact_if_needed() );
+	CPPUNIT_ASSERT( cp.get_log_size() > 100 * (record / 2) );
+
+	cp.compact();
+	CPPUNIT_ASSERT( cp.get_num_sessions() == 2 );
+	CPPUNIT_ASSERT( cp.get_log_size() < 3 * record );
+
+	// The log still works after it was replaced.
+	cp.remove(snap2.id);
+
+	session_checkpoint reopened(filename);
+	CPPUNIT_ASSERT( reopened.open() );
+
+	std::vector<session_snapshot *> snapshots;
+	CPPUNIT_ASSERT( reopened.replay(snapshots) == 1 );
+	CPPUNIT_ASSERT( snapshots[0]->id == snap1.id );
+	CPPUNIT_ASSERT( snapshots[0]->msn == 99 );
+	delete snapshots[0];
+}
+
+
+void SessionCheckpointTest::testCompactPadding() {
+	session_snapshot snap;
+	fill(snap, session::st_forwarder, 0, 1000);
+
+	session_checkpoint cp(filename);
+	CPPUNIT_ASSERT( cp.open() );
+
+	// Records are padded to 4 bytes in the file. Fill the log until the
+	// padded records just cross a chunk, the records alone stay below it.
+	size_t num = 0;
+	while ( cp.get_log_size() < session_checkpoint::CHUNK_SIZE ) {
+		snap.id = session_id();
+		cp.save(snap);
+		num++;
+	}
+
+	snap.msn = 1;
+	cp.save(snap);
+
+	cp.compact();
+	CPPUNIT_ASSERT( cp.get_num_sessions() == num );
+	CPPUNIT_ASSERT( cp.get_log_size() >= session_checkpoint::CHUNK_SIZE );
+
+	session_checkpoint reopened(filename);
+	CPPUNIT_ASSERT( reopened.open() );
+	CPPUNIT_ASSERT( reopened.get_num_sessions() == num );
+
+	std::vector<session_snapshot *> snapshots;
+	CPPUNIT_ASSERT( reopened.replay(snapshots) == num );
+	for ( size_t i = 0; i < snapshots.size(); i++ )
+		delete snapshots[i];
+}
+
+
+void SessionCheckpointTest::testInvalidFile() {
+	int fd = open(filename.c_str(), O_WRONLY | O_CREAT, 0600);
+	CPPUNIT_ASSERT( fd >= 0 );
+	CPPUNIT_ASSERT( write(fd, "no checkpoint", 13) == 13 );
+	close(fd);
+
+	session_checkpoint cp(filename);
+	CPPUNIT_ASSERT( ! cp.open() );
+	CPPUNIT_ASSERT( ! cp.is_open() );
+}
+
+
+void SessionCheckpointTest::testRestore() {
+	mock_mnslp_config conf;
+	session_manager mgr(&conf);
+	nop_policy_rule_installer installer(&conf);
+	mock_dispatcher d(&mgr, &installer, &conf);
+
+	session_snapshot live, expired;
+	fill(live, session::st_forwarder, 10, time(NULL) + 60);
+	fill(expired, session::st_receiver, 20, time(NULL) - 1);
+
+	session_checkpoint cp(filename);
+	CPPUNIT_ASSERT( cp.open() );
+	cp.save(live);
+	cp.save(expired);
+
+	CPPUNIT_ASSERT( d.restore_sessions(&cp) == 1 );
+
+	session *s = mgr.get_session(live.id);
+	CPPUNIT_ASSERT( s != NULL );
+	CPPUNIT_ASSERT( s->get_session_type() == session::st_forwarder );
+	CPPUNIT_ASSERT( s->get_msg_sequence_number() == 10 );
+	CPPUNIT_ASSERT( s->get_upstream_peer() == 7 );
+	CPPUNIT_ASSERT( d.get_timer() != 0 );
+
+	CPPUNIT_ASSERT( mgr.get_session(expired.id) == NULL );
+	CPPUNIT_ASSERT( cp.get_num_sessions() == 1 );
+
+	// The restored session is saved as it was.
+	cp.save(s);
+	CPPUNIT_ASSERT( cp.get_num_sessions() == 1 );
+
+	std::vector<session_snapshot *> snapshots;
+	CPPUNIT_ASSERT( cp.replay(snapshots) == 1 );
+	CPPUNIT_ASSERT( snapshots[0]->msn == 10 );
+	CPPUNIT_ASSERT( *snapshots[0]->rule == *live.rule );
+	delete snapshots[0];
+}
+
+// EOF
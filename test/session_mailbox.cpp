@@ -0,0 +1,204 @@
+/*
+ * session_mailbox.cpp - Test the session_mailbox class.
+ *
+ * $Id: session_mailbox.cpp 2571 2015-03-10 $
+ * $HeadURL: https://./test/session_mailbox.cpp $
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <vector>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "session_mailbox.h"
+#include "events.h"
+
+using namespace mnslp;
+
+
+class SessionMailboxTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( SessionMailboxTest );
+
+	CPPUNIT_TEST( testOrder );
+	CPPUNIT_TEST( testClaim );
+	CPPUNIT_TEST( testPostWhileClaimed );
+	CPPUNIT_TEST( testThreads );
+
+	CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void testOrder();
+	void testClaim();
+	void testPostWhileClaimed();
+	void testThreads();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SessionMailboxTest );
+
+
+namespace {
+
+class numbered_event : public event {
+  public:
+	numbered_event(int thread, int seq) : thread(thread), seq(seq) { }
+	int thread;
+	int seq;
+};
+
+}
+
+
+void SessionMailboxTest::testOrder() {
+	session_mailbox mailbox;
+
+	CPPUNIT_ASSERT( mailbox.is_empty() );
+
+	for ( int i = 0; i < 3; i++ )
+		mailbox.post(new numbered_event(0, i));
+
+	CPPUNIT_ASSERT( mailbox.claim() );
+
+	numbered_event *e = dynamic_cast<numbered_event *>(mailbox.take());
+	CPPUNIT_ASSERT( e != NULL && e->seq == 0 );
+	delete e;
+
+	// Posted after the first take(), still comes after the others.
+	mailbox.post(new numbered_event(0, 3));
+
+	for ( int i = 1; i < 4; i++ ) {
+		e = dynamic_cast<numbered_event *>(mailbox.take());
+		CPPUNIT_ASSERT( e != NULL && e->seq == i );
+		delete e;
+	}
+
+	CPPUNIT_ASSERT( mailbox.take() == NULL );
+	CPPUNIT_ASSERT( mailbox.is_empty() );
+	CPPUNIT_ASSERT( ! mailbox.unclaim() );
+}
+
+
+void SessionMailboxTest::testClaim() {
+	session_mailbox mailbox;
+
+	CPPUNIT_ASSERT( mailbox.claim() );
+	CPPUNIT_ASSERT( ! mailbox.claim() );
+	CPPUNIT_ASSERT( ! mailbox.unclaim() );
+	CPPUNIT_ASSERT( mailbox.claim() );
+	CPPUNIT_ASSERT( ! mailbox.unclaim() );
+
+	// Deleted by the destructor.
+	mailbox.post(new numbered_event(0, 0));
+}
+
+
+void SessionMailboxTest::testPostWhileClaimed() {
+	session_mailbox mailbox;
+
+	CPPUNIT_ASSERT( mailbox.claim() );
+
+	// Another thread posts and fails to claim.
+	mailbox.post(new numbered_event(1, 0));
+	CPPUNIT_ASSERT( ! mailbox.claim() );
+
+	// So the owner keeps the mailbox and has to process the event.
+	CPPUNIT_ASSERT( mailbox.unclaim() );
+
+	event *e = mailbox.take();
+	CPPUNIT_ASSERT( e != NULL );
+	delete e;
+
+	CPPUNIT_ASSERT( ! mailbox.unclaim() );
+}
+
+
+namespace {
+
+const int NUM_THREADS = 4;
+const int NUM_EVENTS = 20000;
+
+struct shared_state {
+	session_mailbox mailbox;
+	int next[NUM_THREADS];		///< Next expected seq per thread
+	int processed;
+	bool in_order;
+	volatile int owners;		///< Threads processing at the same time
+	bool exclusive;
+};
+
+void drain(shared_state *s) {
+	if ( __sync_add_and_fetch(&s->owners, 1) != 1 )
+		s->exclusive = false;
+
+	event *evt;
+	while ( (evt = s->mailbox.take()) != NULL ) {
+		numbered_event *e = dynamic_cast<numbered_event *>(evt);
+
+		if ( e->seq != s->next[e->thread] )
+			s->in_order = false;
+
+		s->next[e->thread] = e->seq + 1;
+		s->processed++;
+		delete e;
+	}
+
+	__sync_sub_and_fetch(&s->owners, 1);
+}
+
+struct thread_arg {
+	shared_state *state;
+	int thread;
+};
+
+// Post like dispatcher::deliver() does.
+void *poster(void *p) {
+	thread_arg *arg = static_cast<thread_arg *>(p);
+	shared_state *s = arg->state;
+
+	for ( int i = 0; i < NUM_EVENTS; i++ ) {
+		s->mailbox.post(new numbered_event(arg->thread, i));
+
+		if ( s->mailbox.claim() ) {
+			do
+				drain(s);
+			while ( s->mailbox.unclaim() );
+		}
+		else if ( i % 64 == 0 )
+			sched_yield();
+	}
+
+	return NULL;
+}
+
+}
+
+
+void SessionMailboxTest::testThreads() {
+	shared_state s;
+	s.processed = 0;
+	s.in_order = true;
+	s.owners = 0;
+	s.exclusive = true;
+
+	pthread_t threads[NUM_THREADS];
+	thread_arg args[NUM_THREADS];
+
+	for ( int i = 0; i < NUM_THREADS; i++ ) {
+		s.next[i] = 0;
+		args[i].state = &s;
+		args[i].thread = i;
+		pthread_create(&threads[i], NULL, poster, &args[i]);
+	}
+
+	for ( int i = 0; i < NUM_THREADS; i++ )
+		pthread_join(threads[i], NULL);
+
+	// No event was left behind.
+	CPPUNIT_ASSERT( s.mailbox.is_empty() );
+	CPPUNIT_ASSERT_EQUAL( NUM_THREADS * NUM_EVENTS, s.processed );
+	CPPUNIT_ASSERT( s.in_order );
+	CPPUNIT_ASSERT( s.exclusive );
+}
+
+// EOF
@@ -21,12 +21,18 @@ class SessionManagerTest : public CppUnit::TestCase {
 
 	CPPUNIT_TEST( testGetRetrieve );
 	CPPUNIT_TEST( testRemove );
+	CPPUNIT_TEST( testMemoryUsage );
+	CPPUNIT_TEST( testReferences );
+	CPPUNIT_TEST( testCreateExisting );
 
 	CPPUNIT_TEST_SUITE_END();
 
   public:
 	void testGetRetrieve();
 	void testRemove();
+	void testMemoryUsage();
+	void testReferences();
+	void testCreateExisting();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION( SessionManagerTest );
@@ -59,4 +65,76 @@ void SessionManagerTest::testRemove() {
 	CPPUNIT_ASSERT( mgr.get_session(s1->get_id()) == NULL );
 }
 
+void SessionManagerTest::testMemoryUsage() {
+	mock_mnslp_config conf;
+	session_manager mgr = session_manager(&conf);
+
+	mgr.create_nr_session(session_id());
+	mgr.create_nr_session(session_id());
+	mgr.create_ni_session();
+
+	session_memory_usage nr = mgr.get_memory_usage(session::st_receiver);
+	CPPUNIT_ASSERT( nr.sessions == 2 );
+	CPPUNIT_ASSERT( nr.rule_bytes >= 2 * sizeof(mt_policy_rule) );
+	CPPUNIT_ASSERT( nr.message_bytes == 0 );
+
+	// The slab is shared with sessions of other test cases.
+	CPPUNIT_ASSERT( nr.object_bytes >= 2 * sizeof(nr_session) );
+	CPPUNIT_ASSERT( nr.reserved_bytes >= nr.object_bytes );
+	CPPUNIT_ASSERT( nr.get_total_bytes() > nr.reserved_bytes );
+
+	session_memory_usage ni = mgr.get_memory_usage(session::st_initiator);
+	CPPUNIT_ASSERT( ni.sessions == 1 );
+
+	session_memory_usage nf = mgr.get_memory_usage(session::st_forwarder);
+	CPPUNIT_ASSERT( nf.sessions == 0 );
+	CPPUNIT_ASSERT( nf.rule_bytes == 0 );
+}
+
+void SessionManagerTest::testReferences() {
+	mock_mnslp_config conf;
+	session_manager mgr = session_manager(&conf);
+	const session_slab &slab = nr_session::get_slab();
+
+	size_t in_use = slab.get_objects_in_use();
+
+	session *s1 = mgr.create_nr_session(session_id());
+	CPPUNIT_ASSERT( slab.get_objects_in_use() == in_use + 1 );
+
+	session *s2 = mgr.get_session(s1->get_id());
+	CPPUNIT_ASSERT( s1 == s2 );
+
+	// Removed from the table, but still referenced twice.
+	session *s3 = mgr.remove_session(s1->get_id());
+	CPPUNIT_ASSERT( s1 == s3 );
+	s3->release();
+	s2->release();
+	CPPUNIT_ASSERT( slab.get_objects_in_use() == in_use + 1 );
+
+	s1->release();
+	CPPUNIT_ASSERT( slab.get_objects_in_use() == in_use );
+}
+
+void SessionManagerTest::testCreateExisting() {
+	mock_mnslp_config conf;
+	session_manager mgr = session_manager(&conf);
+	const session_slab &slab = nf_session::get_slab();
+
+	size_t in_use = slab.get_objects_in_use();
+	session_id sid;
+
+	// Two CONFIGUREs for a new session handled at the same time.
+	session *s1 = mgr.create_nf_session(sid);
+	session *s2 = mgr.create_nf_session(sid);
+	CPPUNIT_ASSERT( s1 == s2 );
+	CPPUNIT_ASSERT( mgr.get_session_count() == 1 );
+	CPPUNIT_ASSERT( slab.get_objects_in_use() == in_use + 1 );
+
+	session *s3 = mgr.remove_session(sid);
+	s3->release();
+	s2->release();
+	s1->release();
+	CPPUNIT_ASSERT( slab.get_objects_in_use() == in_use );
+}
+
 // EOF
@@ -0,0 +1,88 @@
+/*
+ * session_slab.cpp - Test the session_slab class.
+ *
+ * $Id: session_slab.cpp 2571 2015-03-10 $
+ * $HeadURL: https://./test/session_slab.cpp $
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "session_slab.h"
+
+using namespace mnslp;
+
+
+class SessionSlabTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( SessionSlabTest );
+
+	CPPUNIT_TEST( testAllocate );
+	CPPUNIT_TEST( testReuse );
+	CPPUNIT_TEST( testOtherSize );
+
+	CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void testAllocate();
+	void testReuse();
+	void testOtherSize();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SessionSlabTest );
+
+
+void SessionSlabTest::testAllocate() {
+	session_slab slab(100, 4);
+
+	CPPUNIT_ASSERT( slab.get_slot_size() == 128 );
+	CPPUNIT_ASSERT( slab.get_bytes_reserved() == 0 );
+
+	void *p[5];
+	for ( int i = 0; i < 5; i++ ) {
+		p[i] = slab.allocate(100);
+		CPPUNIT_ASSERT( p[i] != NULL );
+		CPPUNIT_ASSERT( (size_t) p[i] % session_slab::CACHE_LINE == 0 );
+	}
+
+	// The slots of a block are handed out in address order.
+	CPPUNIT_ASSERT( (char *) p[1] - (char *) p[0] == 128 );
+
+	CPPUNIT_ASSERT( slab.get_objects_in_use() == 5 );
+	CPPUNIT_ASSERT( slab.get_bytes_reserved() == 2 * 4 * 128 );
+
+	for ( int i = 0; i < 5; i++ )
+		slab.deallocate(p[i], 100);
+
+	CPPUNIT_ASSERT( slab.get_objects_in_use() == 0 );
+}
+
+
+void SessionSlabTest::testReuse() {
+	session_slab slab(64, 2);
+
+	void *p1 = slab.allocate(64);
+	slab.deallocate(p1, 64);
+
+	void *p2 = slab.allocate(64);
+	CPPUNIT_ASSERT( p1 == p2 );
+	CPPUNIT_ASSERT( slab.get_bytes_reserved() == 2 * 64 );
+
+	slab.deallocate(p2, 64);
+	slab.deallocate(NULL, 64);
+	CPPUNIT_ASSERT( slab.get_objects_in_use() == 0 );
+}
+
+
+void SessionSlabTest::testOtherSize() {
+	session_slab slab(64);
+
+	// As requested by a subclass with additional members.
+	void *p = slab.allocate(200);
+	CPPUNIT_ASSERT( p != NULL );
+	CPPUNIT_ASSERT( slab.get_objects_in_use() == 0 );
+	CPPUNIT_ASSERT( slab.get_bytes_reserved() == 0 );
+
+	slab.deallocate(p, 200);
+}
+
+// EOF
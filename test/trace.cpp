@@ -0,0 +1,92 @@
+/*
+ * trace.cpp - Test the structured trace channel.
+ *
+ * $Id: trace.cpp 2438 2015-03-10 $
+ * $HeadURL: https://./test/trace.cpp $
+ *
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <sstream>
+
+#include "msg/mnslp_trace.h"
+
+using namespace mnslp::msg;
+
+
+class TraceTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( TraceTest );
+
+	CPPUNIT_TEST( testParseComponents );
+	CPPUNIT_TEST( testDisabled );
+	CPPUNIT_TEST( testRecord );
+
+	CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void tearDown();
+
+	void testParseComponents();
+	void testDisabled();
+	void testRecord();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TraceTest );
+
+
+void TraceTest::tearDown() {
+	trace::set_mask(0);
+	trace::clear();
+}
+
+
+void TraceTest::testParseComponents() {
+	uint32_t mask = trace::parse_components("ipfix,session");
+
+	CPPUNIT_ASSERT( mask == ( (1u << trace::tc_ipfix) 
+							| (1u << trace::tc_session) ) );
+	CPPUNIT_ASSERT( trace::parse_components("") == 0 );
+	CPPUNIT_ASSERT( trace::parse_components("unknown") == 0 );
+	CPPUNIT_ASSERT( trace::parse_components("all") 
+						== (1u << trace::tc_max) - 1 );
+	CPPUNIT_ASSERT( trace::parse_components("all,none,events") 
+						== (1u << trace::tc_events) );
+}
+
+
+void TraceTest::testDisabled() {
+	trace::set_mask(0);
+	trace::clear();
+
+	MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_import, 42, 0, 0);
+
+	std::ostringstream os;
+	trace::dump(os);
+	CPPUNIT_ASSERT( os.str().find("ipfix_import") == std::string::npos );
+}
+
+
+void TraceTest::testRecord() {
+	trace::clear();
+	trace::enable(trace::tc_ipfix);
+
+	CPPUNIT_ASSERT( trace::is_enabled(trace::tc_ipfix) );
+	CPPUNIT_ASSERT( ! trace::is_enabled(trace::tc_session) );
+
+	MNSLP_TRACE(trace::tc_ipfix, trace::ev_ipfix_import_set, 2, 48, 16);
+	MNSLP_TRACE(trace::tc_session, trace::ev_session_process_event, 1, 0, 0);
+
+	std::ostringstream os;
+	trace::dump(os);
+	CPPUNIT_ASSERT( os.str().find("ipfix ipfix_import_set 2 48 16") 
+						!= std::string::npos );
+	CPPUNIT_ASSERT( os.str().find("session_process_event") 
+						== std::string::npos );
+
+	trace::disable(trace::tc_ipfix);
+	CPPUNIT_ASSERT( ! trace::is_enabled(trace::tc_ipfix) );
+}
+
+// EOF